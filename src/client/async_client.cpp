@@ -0,0 +1,235 @@
+#include "async_client.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <random>
+
+AsyncClient::AsyncClient(AsyncClientOptions opts)
+    : opts_(std::move(opts)),
+      epoch_(std::chrono::steady_clock::now()),
+      wheel_(4096),
+      next_txid_(std::random_device{}()) {
+    if (opts_.tick_ms <= 0) opts_.tick_ms = 1;
+    if (opts_.retry_backoff_ms < 0) {
+        error_ = "negative retry_backoff_ms";
+        return;
+    }
+
+    sockaddr_in srv{};
+    srv.sin_family = AF_INET;
+    srv.sin_port = htons(static_cast<uint16_t>(opts_.server_port));
+    if (inet_pton(AF_INET, opts_.server_ip.c_str(), &srv.sin_addr) <= 0) {
+        error_ = "invalid server IP " + opts_.server_ip;
+        return;
+    }
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        error_ = std::string("socket() failed: ") + strerror(errno);
+        return;
+    }
+    // connected socket: the kernel filters datagrams from other peers
+    if (connect(fd, reinterpret_cast<sockaddr*>(&srv), sizeof(srv)) < 0) {
+        error_ = std::string("connect() failed: ") + strerror(errno);
+        close(fd);
+        return;
+    }
+    sock_ = fd;
+    running_ = true;
+    io_thread_ = std::thread(&AsyncClient::io_loop, this);
+}
+
+AsyncClient::~AsyncClient() {
+    running_ = false;
+    if (io_thread_.joinable()) io_thread_.join();
+    if (sock_ >= 0) close(sock_);
+
+    std::unordered_map<uint32_t, Pending> left;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        left.swap(pending_);
+    }
+    for (auto &kv : left) {
+        AttachResult r;
+        r.error = "cancelled";
+        r.attempts = kv.second.attempts;
+        kv.second.cb(r);
+    }
+}
+
+uint64_t AsyncClient::current_tick() const {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count();
+    return static_cast<uint64_t>(ms / opts_.tick_ms);
+}
+
+bool AsyncClient::send_datagram(const std::vector<uint8_t> &d) {
+    for (;;) {
+        ssize_t n = send(sock_, d.data(), d.size(), 0);
+        if (n >= 0) {
+            sent_++;
+            return true;
+        }
+        if (errno == EINTR) continue;
+        // a full send buffer or a pending ICMP error counts as a lost datagram; the timer resends it
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNREFUSED) return true;
+        spdlog::warn("AsyncClient send failed: {}", strerror(errno));
+        return false;
+    }
+}
+
+void AsyncClient::attach(const std::vector<std::string> &imsis, Callback cb) {
+    requests_++;
+    AttachResult fail;
+    if (!ok()) {
+        fail.error = error_;
+        cb(fail);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lk(m_);
+    if (pending_.size() >= opts_.max_in_flight) {
+        lk.unlock();
+        fail.error = "too many requests in flight";
+        cb(fail);
+        return;
+    }
+    uint32_t txid = next_txid_++;
+    while (pending_.count(txid)) txid = next_txid_++;
+
+    Pending p;
+    p.datagram = encode_v2_request(txid, imsis); // throws on bad input
+    p.count = imsis.size();
+    p.cb = std::move(cb);
+    p.attempts = 1;
+    uint64_t timeout_ticks = (static_cast<uint64_t>(opts_.timeout_ms) + opts_.tick_ms - 1) / opts_.tick_ms;
+    p.due_tick = current_tick() + std::max<uint64_t>(timeout_ticks, 1);
+    wheel_.schedule(txid, p.due_tick);
+    auto it = pending_.emplace(txid, std::move(p)).first;
+
+    // sent under the lock so the reply cannot overtake the insert
+    if (!send_datagram(it->second.datagram)) {
+        Pending failed = std::move(it->second);
+        pending_.erase(it);
+        lk.unlock();
+        fail.error = "send failed";
+        fail.attempts = 1;
+        failed.cb(fail);
+    }
+}
+
+std::future<AttachResult> AsyncClient::attach(const std::vector<std::string> &imsis) {
+    auto promise = std::make_shared<std::promise<AttachResult>>();
+    auto fut = promise->get_future();
+    attach(imsis, [promise](const AttachResult &r) { promise->set_value(r); });
+    return fut;
+}
+
+size_t AsyncClient::in_flight() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return pending_.size();
+}
+
+AsyncClient::Stats AsyncClient::stats() const {
+    Stats s;
+    s.requests = requests_.load();
+    s.sent = sent_.load();
+    s.retries = retries_.load();
+    s.replies = replies_.load();
+    s.timeouts = timeouts_.load();
+    s.unmatched = unmatched_.load();
+    return s;
+}
+
+// called with m_ held
+void AsyncClient::on_timer(uint32_t txid, uint64_t due, std::vector<std::pair<Callback, AttachResult>> &done) {
+    auto it = pending_.find(txid);
+    if (it == pending_.end() || it->second.due_tick != due) return; // completed or rescheduled
+    Pending &p = it->second;
+
+    if (p.backing_off) {
+        p.backing_off = false;
+        p.attempts++;
+        retries_++;
+        send_datagram(p.datagram);
+        uint64_t timeout_ticks = (static_cast<uint64_t>(opts_.timeout_ms) + opts_.tick_ms - 1) / opts_.tick_ms;
+        p.due_tick = due + std::max<uint64_t>(timeout_ticks, 1);
+        wheel_.schedule(txid, p.due_tick);
+        return;
+    }
+
+    if (p.attempts > opts_.retries) {
+        timeouts_++;
+        AttachResult r;
+        r.error = "timeout";
+        r.attempts = p.attempts;
+        done.emplace_back(std::move(p.cb), std::move(r));
+        pending_.erase(it);
+        return;
+    }
+
+    uint64_t backoff_ms = static_cast<uint64_t>(opts_.retry_backoff_ms) << std::min(p.attempts - 1, 16);
+    p.backing_off = true;
+    // at least one tick: a timer due now would fire for the next tick with a
+    // stale due_tick and be dropped, leaving the request pending forever
+    p.due_tick = due + std::max<uint64_t>(backoff_ms / opts_.tick_ms, 1);
+    wheel_.schedule(txid, p.due_tick);
+}
+
+// called with m_ held
+void AsyncClient::on_reply(const uint8_t *data, size_t len, std::vector<std::pair<Callback, AttachResult>> &done) {
+    ProtoHeader hdr;
+    std::vector<ResultCode> results;
+    if (!decode_v2_reply(data, len, hdr, results)) {
+        unmatched_++;
+        return;
+    }
+    auto it = pending_.find(hdr.txid);
+    if (it == pending_.end() || results.size() != it->second.count) {
+        unmatched_++;
+        return;
+    }
+    replies_++;
+    AttachResult r;
+    r.ok = true;
+    r.results = std::move(results);
+    r.attempts = it->second.attempts;
+    done.emplace_back(std::move(it->second.cb), std::move(r));
+    pending_.erase(it);
+}
+
+void AsyncClient::io_loop() {
+    std::vector<std::pair<Callback, AttachResult>> done;
+    uint8_t buf[1500];
+    while (running_) {
+        pollfd pfd{sock_, POLLIN, 0};
+        int pr = poll(&pfd, 1, opts_.tick_ms);
+        if (pr < 0 && errno != EINTR) {
+            spdlog::error("AsyncClient poll failed: {}", strerror(errno));
+            break;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            if (pr > 0) {
+                for (;;) {
+                    ssize_t n = recv(sock_, buf, sizeof(buf), 0);
+                    if (n < 0) {
+                        // ECONNREFUSED: ICMP port unreachable from an earlier send; the timers handle it
+                        if (errno == EINTR || errno == ECONNREFUSED) continue;
+                        break;
+                    }
+                    on_reply(buf, static_cast<size_t>(n), done);
+                }
+            }
+            wheel_.advance(current_tick(), [&](uint32_t txid, uint64_t due) { on_timer(txid, due, done); });
+        }
+
+        for (auto &d : done) d.first(d.second);
+        done.clear();
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "protocol.h"
+#include "timer_wheel.h"
+
+struct AsyncClientOptions {
+    std::string server_ip = "127.0.0.1";
+    int server_port = 9000;
+    int timeout_ms = 2000;      // per attempt
+    int retries = 2;            // resends after the first attempt times out
+    int retry_backoff_ms = 100; // pause before the first resend, doubled for each next one
+    size_t max_in_flight = 4096;
+    int tick_ms = 5;            // timer wheel resolution
+};
+
+struct AttachResult {
+    bool ok = false;
+    std::string error;               // "timeout", "send failed", "cancelled", ...
+    std::vector<ResultCode> results; // one per IMSI, in request order
+    int attempts = 0;
+};
+
+// Persistent UDP client for protocol v2. Each attach() is one datagram with a
+// fresh txid; any number of them can be in flight at once and replies are
+// matched back by txid. A background thread receives replies and drives a
+// timer wheel of per-attempt deadlines: a request that times out is resent
+// (same txid, so a late reply to an earlier attempt still completes it) after
+// an exponential backoff, and fails with "timeout" once retries run out.
+// Callbacks run on that thread and must not block.
+class AsyncClient {
+public:
+    using Callback = std::function<void(const AttachResult&)>;
+
+    struct Stats {
+        uint64_t requests = 0;
+        uint64_t sent = 0;       // datagrams, including resends
+        uint64_t retries = 0;
+        uint64_t replies = 0;
+        uint64_t timeouts = 0;   // requests failed after the last attempt
+        uint64_t unmatched = 0;  // replies for unknown txids and non-v2 datagrams
+    };
+
+    explicit AsyncClient(AsyncClientOptions opts);
+    // pending requests complete with "cancelled"
+    ~AsyncClient();
+
+    AsyncClient(const AsyncClient&) = delete;
+    AsyncClient& operator=(const AsyncClient&) = delete;
+
+    bool ok() const { return sock_ >= 0; }
+    const std::string &error() const { return error_; }
+
+    // Throws std::invalid_argument on a bad IMSI or too many of them (see
+    // encode_v2_request). Other failures are reported through the callback.
+    void attach(const std::vector<std::string> &imsis, Callback cb);
+    std::future<AttachResult> attach(const std::vector<std::string> &imsis);
+
+    size_t in_flight() const;
+    Stats stats() const;
+
+private:
+    struct Pending {
+        std::vector<uint8_t> datagram;
+        size_t count = 0;
+        Callback cb;
+        int attempts = 0;
+        bool backing_off = false; // waiting to resend rather than for a reply
+        uint64_t due_tick = 0;    // the timer that is still current
+    };
+
+    void io_loop();
+    uint64_t current_tick() const;
+    void on_timer(uint32_t txid, uint64_t due, std::vector<std::pair<Callback, AttachResult>> &done);
+    void on_reply(const uint8_t *data, size_t len, std::vector<std::pair<Callback, AttachResult>> &done);
+    bool send_datagram(const std::vector<uint8_t> &d);
+
+    AsyncClientOptions opts_;
+    int sock_ = -1;
+    std::string error_;
+    std::chrono::steady_clock::time_point epoch_;
+
+    mutable std::mutex m_;
+    std::unordered_map<uint32_t, Pending> pending_;
+    TimerWheel<uint32_t> wheel_;
+    uint32_t next_txid_;
+
+    std::atomic<bool> running_{false};
+    std::thread io_thread_;
+
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> sent_{0};
+    std::atomic<uint64_t> retries_{0};
+    std::atomic<uint64_t> replies_{0};
+    std::atomic<uint64_t> timeouts_{0};
+    std::atomic<uint64_t> unmatched_{0};
+};
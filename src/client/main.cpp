@@ -1,10 +1,13 @@
 #include "imsi_to_bcd.h"
+#include "protocol.h"
+#include "async_client.h"
 #include <iostream>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <cctype>
 #include <chrono>
+#include <sstream>
 
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
@@ -24,6 +27,9 @@ struct ClientConfig {
     std::string log_file = "client.log";
     std::string log_level = "info";
     int tx_timeout_ms = 2000;
+    int protocol_version = 1; // 2 = binary protocol, implied by several IMSIs
+    int retries = 0;          // v2 only: resends after a timeout
+    int retry_backoff_ms = 100;
 };
 
 static ClientConfig load_config(const std::string &path) {
@@ -40,6 +46,9 @@ static ClientConfig load_config(const std::string &path) {
         if (j.contains("log_file")) cfg.log_file = j["log_file"].get<std::string>();
         if (j.contains("log_level")) cfg.log_level = j["log_level"].get<std::string>();
         if (j.contains("tx_timeout_ms")) cfg.tx_timeout_ms = j["tx_timeout_ms"].get<int>();
+        if (j.contains("protocol_version")) cfg.protocol_version = j["protocol_version"].get<int>();
+        if (j.contains("retries")) cfg.retries = j["retries"].get<int>();
+        if (j.contains("retry_backoff_ms")) cfg.retry_backoff_ms = j["retry_backoff_ms"].get<int>();
     } catch (const std::exception &e) {
         spdlog::warn("Failed to parse config '{}': {}", path, e.what());
     }
@@ -61,13 +70,63 @@ static void init_logger(const std::string &log_file, const std::string &level) {
     else spdlog::set_level(spdlog::level::info);
 }
 
+static std::vector<std::string> split_imsis(const std::string &arg) {
+    std::vector<std::string> out;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+// protocol v2 through AsyncClient: txid matching, timeout and retries
+static int run_v2(const ClientConfig &cfg, const std::vector<std::string> &imsis) {
+    AsyncClientOptions opts;
+    opts.server_ip = cfg.server_ip;
+    opts.server_port = cfg.server_port;
+    opts.timeout_ms = cfg.tx_timeout_ms;
+    opts.retries = cfg.retries;
+    opts.retry_backoff_ms = cfg.retry_backoff_ms;
+    AsyncClient client(opts);
+    if (!client.ok()) {
+        spdlog::error("Client setup failed: {}", client.error());
+        std::cerr << client.error() << "\n";
+        return 5;
+    }
+
+    std::future<AttachResult> fut;
+    try {
+        if (imsis.empty()) throw std::invalid_argument("IMSI cannot be empty");
+        fut = client.attach(imsis);
+    } catch (const std::exception &e) {
+        spdlog::error("Invalid IMSI list: {}", e.what());
+        std::cerr << "Invalid IMSI: " << e.what() << "\n";
+        return 3;
+    }
+    spdlog::info("Sent {} IMSIs (v2)", imsis.size());
+
+    AttachResult res = fut.get();
+    if (!res.ok) {
+        spdlog::warn("Request failed after {} attempt(s): {}", res.attempts, res.error);
+        std::cerr << res.error << "\n";
+        return res.error == "timeout" ? 7 : 6;
+    }
+    spdlog::info("Received v2 reply after {} attempt(s)", res.attempts);
+    for (size_t i = 0; i < imsis.size(); ++i) {
+        std::cout << imsis[i] << " " << result_code_name(res.results[i]) << "\n";
+    }
+    std::cout.flush();
+    return 0;
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::cerr << "Usage: pgw_client IMSI [config.json]\n";
+        std::cerr << "Usage: pgw_client IMSI[,IMSI...] [config.json]\n";
         return 2;
     }
 
-    std::string imsi = argv[1];
+    std::vector<std::string> imsis = split_imsis(argv[1]);
     std::string cfg_path = "configs/pgw_client_conf.json";
     if (argc > 2) cfg_path = argv[2];
 
@@ -79,11 +138,14 @@ int main(int argc, char** argv) {
 
     spdlog::info("Using server {}:{}", cfg.server_ip, cfg.server_port);
 
+    if (imsis.size() > 1 || cfg.protocol_version == 2) return run_v2(cfg, imsis);
+
     std::vector<uint8_t> bcd;
     try {
-        bcd = encode_imsi_bcd(imsi);
+        if (imsis.empty()) throw std::invalid_argument("IMSI cannot be empty");
+        bcd = encode_imsi_bcd(imsis[0]);
     } catch (const std::exception &e) {
-        spdlog::error("Invalid IMSI '{}': {}", imsi, e.what());
+        spdlog::error("Invalid IMSI '{}': {}", argv[1], e.what());
         std::cerr << "Invalid IMSI: " << e.what() << "\n";
         return 3;
     }
@@ -113,7 +175,7 @@ int main(int argc, char** argv) {
         close(sock);
         return 6;
     }
-    spdlog::info("Sent IMSI '{}' as {} bytes", imsi, sent);
+    spdlog::info("Sent IMSI '{}' as {} bytes", imsis[0], sent);
 
     struct timeval tv{};
     tv.tv_sec = cfg.tx_timeout_ms / 1000;
@@ -122,7 +184,7 @@ int main(int argc, char** argv) {
         spdlog::warn("setsockopt SO_RCVTIMEO failed: {}", strerror(errno));
     }
 
-    char buf[256];
+    char buf[1500];
     sockaddr_in from{};
     socklen_t fromlen = sizeof(from);
     ssize_t r = recvfrom(sock, buf, sizeof(buf)-1, 0, reinterpret_cast<sockaddr*>(&from), &fromlen);
@@ -132,18 +194,17 @@ int main(int argc, char** argv) {
             std::cerr << "timeout\n";
             close(sock);
             return 7;
-        } else {
-            spdlog::error("recvfrom failed: {}", strerror(errno));
-            std::cerr << "recvfrom failed: " << strerror(errno) << "\n";
-            close(sock);
-            return 8;
         }
+        spdlog::error("recvfrom failed: {}", strerror(errno));
+        std::cerr << "recvfrom failed: " << strerror(errno) << "\n";
+        close(sock);
+        return 8;
     }
+
     buf[r] = '\0';
     std::string reply(buf);
     spdlog::info("Received reply '{}' ({} bytes) from {}:{}", reply, r,
                  inet_ntoa(from.sin_addr), ntohs(from.sin_port));
-
     std::cout << reply << std::endl;
 
     close(sock);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Hashed timer wheel: `slots` buckets of one tick each. schedule() and
+// advance() are O(1) per timer regardless of how many are pending. Timers
+// further out than one revolution sit in their bucket until the wheel has
+// turned enough times. There is no cancel: callers keep their own record of
+// the current due tick and ignore stale firings.
+template <typename Key>
+class TimerWheel {
+public:
+    explicit TimerWheel(size_t slots) {
+        size_t n = 1;
+        while (n < slots) n <<= 1;
+        buckets_.resize(n);
+        mask_ = n - 1;
+    }
+
+    uint64_t now() const { return now_; }
+
+    // due ticks in the past fire on the next advance()
+    void schedule(const Key &key, uint64_t due_tick) {
+        if (due_tick <= now_) due_tick = now_ + 1;
+        buckets_[due_tick & mask_].push_back({key, due_tick});
+        ++size_;
+    }
+
+    size_t size() const { return size_; }
+
+    // moves the wheel to `tick`, calling fire(key, due_tick) for every timer
+    // that became due; fire may schedule new timers
+    template <typename Fire>
+    void advance(uint64_t tick, Fire &&fire) {
+        while (now_ < tick) {
+            ++now_;
+            auto &bucket = buckets_[now_ & mask_];
+            if (bucket.empty()) continue;
+            fired_.clear();
+            size_t keep = 0;
+            for (size_t i = 0; i < bucket.size(); ++i) {
+                if (bucket[i].due <= now_) fired_.push_back(bucket[i]);
+                else bucket[keep++] = bucket[i];
+            }
+            bucket.resize(keep);
+            size_ -= fired_.size();
+            for (const auto &e : fired_) fire(e.key, e.due);
+        }
+    }
+
+private:
+    struct Entry {
+        Key key;
+        uint64_t due;
+    };
+
+    std::vector<std::vector<Entry>> buckets_;
+    std::vector<Entry> fired_;
+    size_t mask_ = 0;
+    uint64_t now_ = 0;
+    size_t size_ = 0;
+};
@@ -0,0 +1,47 @@
+#include "capture.h"
+
+#include <cstring>
+#include <cerrno>
+
+CaptureReader::CaptureReader(const std::string &path) {
+    f_ = std::fopen(path.c_str(), "rb");
+    if (!f_) {
+        error_ = "cannot open " + path + ": " + strerror(errno);
+        return;
+    }
+    if (std::fread(&hdr_, sizeof(hdr_), 1, f_) != 1 ||
+        std::memcmp(hdr_.magic, capture_magic, sizeof(capture_magic)) != 0) {
+        error_ = path + " is not a capture file";
+    } else if (hdr_.version != capture_version) {
+        error_ = path + ": unsupported capture version " + std::to_string(hdr_.version);
+    } else {
+        return;
+    }
+    std::fclose(f_);
+    f_ = nullptr;
+}
+
+CaptureReader::~CaptureReader() {
+    if (f_) std::fclose(f_);
+}
+
+bool CaptureReader::next(CaptureRecordHeader &rec, std::vector<uint8_t> &payload) {
+    if (!f_) return false;
+    size_t n = std::fread(&rec, 1, sizeof(rec), f_);
+    if (n != sizeof(rec)) {
+        truncated_ = n != 0;
+        return false;
+    }
+    payload.resize(rec.len);
+    if (rec.len > 0 && std::fread(payload.data(), 1, rec.len, f_) != rec.len) {
+        truncated_ = true;
+        return false;
+    }
+    return true;
+}
+
+void CaptureReader::rewind() {
+    if (!f_) return;
+    std::fseek(f_, static_cast<long>(sizeof(hdr_)), SEEK_SET);
+    truncated_ = false;
+}
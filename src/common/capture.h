@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+// Capture file of received datagrams, written by pgw_server (capture_file)
+// and fed back by pgw_replay. A 16-byte file header
+//   char magic[6] "PGWCAP" | u16 version | i64 start_ns
+// is followed by one record per datagram, in arrival order:
+//   i64 ts_ns | u32 src_ip | u16 src_port | u16 len | len payload bytes
+// Timestamps are CLOCK_REALTIME nanoseconds (the kernel receive time when the
+// socket provides it); src_ip and src_port are kept in network order as
+// they come from the socket. Native byte order otherwise.
+
+constexpr char capture_magic[6] = {'P', 'G', 'W', 'C', 'A', 'P'};
+constexpr uint16_t capture_version = 1;
+
+struct CaptureFileHeader {
+    char magic[6];
+    uint16_t version;
+    int64_t start_ns;
+};
+
+struct CaptureRecordHeader {
+    int64_t ts_ns;
+    uint32_t src_ip;
+    uint16_t src_port;
+    uint16_t len;
+};
+
+static_assert(sizeof(CaptureFileHeader) == 16, "capture header layout");
+static_assert(sizeof(CaptureRecordHeader) == 16, "capture record layout");
+
+class CaptureReader {
+public:
+    explicit CaptureReader(const std::string &path);
+    ~CaptureReader();
+
+    CaptureReader(const CaptureReader&) = delete;
+    CaptureReader& operator=(const CaptureReader&) = delete;
+
+    bool ok() const { return f_ != nullptr; }
+    const std::string &error() const { return error_; }
+    int64_t start_ns() const { return hdr_.start_ns; }
+
+    // false at the end of the capture; a record cut short (the server was
+    // killed mid-write) ends it as well and sets truncated()
+    bool next(CaptureRecordHeader &rec, std::vector<uint8_t> &payload);
+    bool truncated() const { return truncated_; }
+
+    // back to the first record
+    void rewind();
+
+private:
+    FILE *f_ = nullptr;
+    CaptureFileHeader hdr_{};
+    std::string error_;
+    bool truncated_ = false;
+};
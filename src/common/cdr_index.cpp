@@ -0,0 +1,305 @@
+#include "cdr_index.h"
+#include "imsi_to_bcd.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+
+// sidecar layout (native byte order, the index never leaves the host):
+//   "PGWI" | u32 version | u64 start | u64 end | u64 records | i64 min_ts | i64 max_ts | u64 n
+//   n x { u64 imsi, u64 offset }
+static constexpr char index_magic[4] = {'P', 'G', 'W', 'I'};
+static constexpr uint32_t index_version = 1;
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t start;
+    uint64_t end;
+    uint64_t records;
+    int64_t min_ts;
+    int64_t max_ts;
+    uint64_t count;
+};
+static_assert(sizeof(IndexHeader) == 56, "sidecar header layout");
+
+namespace {
+
+// read-only mapping, unmapped on scope exit
+struct Mapping {
+    const char *data = nullptr;
+    size_t len = 0;
+
+    bool map(int fd, size_t n) {
+        if (n == 0) return true;
+        void *p = mmap(nullptr, n, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED) return false;
+        data = static_cast<const char*>(p);
+        len = n;
+        return true;
+    }
+
+    ~Mapping() {
+        if (data) munmap(const_cast<char*>(data), len);
+    }
+};
+
+struct Fd {
+    int fd = -1;
+    explicit Fd(int f) : fd(f) {}
+    ~Fd() { if (fd >= 0) ::close(fd); }
+};
+
+bool set_err(std::string *err, const std::string &msg) {
+    if (err) *err = msg + (errno ? std::string(": ") + strerror(errno) : std::string());
+    return false;
+}
+
+// splits "ts, imsi, ..." into its first two fields
+bool split_record(const char *line, size_t len, const char *&imsi, size_t &imsi_len, int64_t &ts) {
+    const char *end = line + len;
+    const char *c1 = static_cast<const char*>(memchr(line, ',', len));
+    if (!c1 || c1 + 2 > end) return false;
+    ts = parse_cdr_time(line, static_cast<size_t>(c1 - line));
+    imsi = c1 + 1;
+    while (imsi < end && *imsi == ' ') ++imsi;
+    const char *c2 = static_cast<const char*>(memchr(imsi, ',', static_cast<size_t>(end - imsi)));
+    imsi_len = static_cast<size_t>((c2 ? c2 : end) - imsi);
+    return true;
+}
+
+bool load_header(const std::string &path, IndexHeader &h, Fd &fd, uint64_t &file_size) {
+    fd.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd.fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd.fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(h)) return false;
+    if (pread(fd.fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h))) return false;
+    file_size = static_cast<uint64_t>(st.st_size);
+    return std::memcmp(h.magic, index_magic, 4) == 0 && h.version == index_version &&
+           file_size == sizeof(h) + h.count * sizeof(CdrIndexEntry);
+}
+
+} // namespace
+
+std::string cdr_index_path(const std::string &cdr_file, uint64_t segment) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), ".%06llu.idx", static_cast<unsigned long long>(segment));
+    return cdr_file + buf;
+}
+
+int64_t parse_cdr_time(const char *s, size_t len) {
+    char buf[40];
+    if (len == 0 || len >= sizeof(buf)) return -1;
+    std::memcpy(buf, s, len);
+    buf[len] = '\0';
+    std::tm tm{};
+    const char *rest = strptime(buf, "%Y-%m-%dT%H:%M:%S%z", &tm);
+    if (!rest) return -1;
+    long gmtoff = tm.tm_gmtoff; // timegm() normalises the struct and resets it
+    return static_cast<int64_t>(timegm(&tm)) - gmtoff;
+}
+
+void index_cdr_records(const char *data, size_t len, uint64_t base, uint64_t boundary, CdrSegmentIndex &out) {
+    const char *end = data + len;
+    const char *line = data;
+    while (line < end && base + static_cast<uint64_t>(line - data) < boundary) {
+        const char *nl = static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(end - line)));
+        if (!nl) break;
+        uint64_t offset = base + static_cast<uint64_t>(line - data);
+        const char *imsi;
+        size_t imsi_len;
+        int64_t ts;
+        if (split_record(line, static_cast<size_t>(nl - line), imsi, imsi_len, ts)) {
+            uint64_t key = pack_imsi(imsi, imsi_len);
+            if (key) out.entries.push_back({key, offset});
+            if (ts >= 0) {
+                out.min_ts = std::min(out.min_ts, ts);
+                out.max_ts = std::max(out.max_ts, ts);
+            }
+        }
+        out.records++;
+        line = nl + 1;
+        out.end = base + static_cast<uint64_t>(line - data);
+    }
+}
+
+bool write_cdr_index(const std::string &path, const CdrSegmentIndex &idx) {
+    std::vector<CdrIndexEntry> entries = idx.entries;
+    std::sort(entries.begin(), entries.end(), [](const CdrIndexEntry &a, const CdrIndexEntry &b) {
+        return a.imsi != b.imsi ? a.imsi < b.imsi : a.offset < b.offset;
+    });
+
+    IndexHeader h{};
+    std::memcpy(h.magic, index_magic, 4);
+    h.version = index_version;
+    h.start = idx.start;
+    h.end = idx.end;
+    h.records = idx.records;
+    h.min_ts = idx.min_ts;
+    h.max_ts = idx.max_ts;
+    h.count = entries.size();
+
+    // readers only ever see complete sidecars
+    std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+              (entries.empty() || std::fwrite(entries.data(), sizeof(CdrIndexEntry), entries.size(), f) == entries.size());
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t update_cdr_indexes(const std::string &cdr_file, uint64_t segment_bytes, uint64_t committed,
+                          uint64_t *indexed_end, std::string *err) {
+    CdrIndexCursor cursor;
+    size_t written = update_cdr_indexes(cdr_file, segment_bytes, committed, cursor, err);
+    if (indexed_end) *indexed_end = cursor.end;
+    return written;
+}
+
+size_t update_cdr_indexes(const std::string &cdr_file, uint64_t segment_bytes, uint64_t committed,
+                          CdrIndexCursor &cursor, std::string *err) {
+    errno = 0;
+    // sidecars written since the last call (or by another process)
+    for (;; ++cursor.segment) {
+        IndexHeader h{};
+        Fd fd(-1);
+        uint64_t size = 0;
+        if (!load_header(cdr_index_path(cdr_file, cursor.segment), h, fd, size)) break;
+        cursor.end = h.end;
+    }
+    if (segment_bytes == 0) return 0;
+    if (committed != 0 && cursor.end + segment_bytes > committed) return 0; // active segment still open
+
+    Fd fd(::open(cdr_file.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd.fd < 0) {
+        set_err(err, "cannot open " + cdr_file);
+        return 0;
+    }
+    if (committed == 0) {
+        struct stat st{};
+        if (fstat(fd.fd, &st) == 0) committed = static_cast<uint64_t>(st.st_size);
+    }
+
+    size_t written = 0;
+    uint64_t start = cursor.end;
+    // a segment is sealed once the file has grown past its boundary
+    while (start + segment_bytes <= committed) {
+        uint64_t boundary = start + segment_bytes;
+        // the record crossing the boundary is short, a little slack covers it
+        uint64_t map_end = std::min(committed, boundary + (1u << 20));
+        uint64_t aligned = start & ~static_cast<uint64_t>(sysconf(_SC_PAGESIZE) - 1);
+        size_t len = static_cast<size_t>(map_end - aligned);
+        void *p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd.fd, static_cast<off_t>(aligned));
+        if (p == MAP_FAILED) {
+            set_err(err, "mmap of " + cdr_file + " failed");
+            break;
+        }
+        madvise(p, len, MADV_SEQUENTIAL);
+
+        CdrSegmentIndex idx;
+        idx.start = start;
+        idx.end = start;
+        const char *data = static_cast<const char*>(p) + (start - aligned);
+        index_cdr_records(data, static_cast<size_t>(map_end - start), start, boundary, idx);
+        munmap(p, len);
+
+        if (idx.end == start || idx.end < boundary) break; // no complete record crossed the boundary yet
+        if (!write_cdr_index(cdr_index_path(cdr_file, cursor.segment), idx)) {
+            set_err(err, "cannot write " + cdr_index_path(cdr_file, cursor.segment));
+            break;
+        }
+        ++written;
+        ++cursor.segment;
+        start = idx.end;
+        cursor.end = start;
+    }
+    return written;
+}
+
+bool query_cdr(const std::string &cdr_file, uint64_t committed, const CdrQuery &q,
+               CdrQueryResult &out, std::string *err) {
+    errno = 0;
+    const uint64_t key = pack_imsi(q.imsi);
+    if (!key) return set_err(err, "invalid imsi");
+
+    Fd fd(::open(cdr_file.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd.fd < 0) return set_err(err, "cannot open " + cdr_file);
+    struct stat st{};
+    if (fstat(fd.fd, &st) != 0) return set_err(err, "cannot stat " + cdr_file);
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    if (committed == 0 || committed > size) {
+        committed = size;
+    }
+
+    Mapping cdr;
+    if (!cdr.map(fd.fd, static_cast<size_t>(committed))) return set_err(err, "mmap of " + cdr_file + " failed");
+    // trailing partial record (file written by someone else) is ignored
+    while (committed > 0 && cdr.data[committed - 1] != '\n') --committed;
+
+    auto take = [&](uint64_t offset) {
+        if (offset >= committed) return;
+        const char *line = cdr.data + offset;
+        const char *nl = static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(committed - offset)));
+        size_t len = static_cast<size_t>((nl ? nl : cdr.data + committed) - line);
+        const char *imsi;
+        size_t imsi_len;
+        int64_t ts;
+        if (!split_record(line, len, imsi, imsi_len, ts)) return;
+        if (pack_imsi(imsi, imsi_len) != key) return;
+        if (ts < q.from_ts || ts > q.to_ts) return;
+        out.records.emplace_back(line, len);
+    };
+
+    // sealed segments through their sidecars
+    uint64_t tail = 0;
+    for (uint64_t segment = 0;; ++segment) {
+        IndexHeader h{};
+        Fd ifd(-1);
+        uint64_t isize = 0;
+        if (!load_header(cdr_index_path(cdr_file, segment), h, ifd, isize)) break;
+        if (h.end > committed) break;
+        tail = h.end;
+        if (h.min_ts <= h.max_ts && (h.max_ts < q.from_ts || h.min_ts > q.to_ts)) {
+            out.segments_skipped++;
+            continue;
+        }
+        out.segments_searched++;
+        Mapping im;
+        if (!im.map(ifd.fd, static_cast<size_t>(isize))) return set_err(err, "mmap of sidecar failed");
+        const auto *first = reinterpret_cast<const CdrIndexEntry*>(im.data + sizeof(IndexHeader));
+        const auto *last = first + h.count;
+        auto lo = std::lower_bound(first, last, key, [](const CdrIndexEntry &e, uint64_t k) { return e.imsi < k; });
+        for (auto it = lo; it != last && it->imsi == key; ++it) take(it->offset);
+    }
+
+    // unsealed tail: look for ", <imsi>," and walk back to the line start
+    std::string needle = ", " + q.imsi + ",";
+    out.tail_bytes_scanned = committed - tail;
+    const char *p = cdr.data + tail;
+    const char *end = cdr.data + committed;
+    while (p < end) {
+        const char *hit = static_cast<const char*>(memmem(p, static_cast<size_t>(end - p), needle.data(), needle.size()));
+        if (!hit) break;
+        const char *line = hit;
+        while (line > cdr.data + tail && line[-1] != '\n') --line;
+        take(static_cast<uint64_t>(line - cdr.data));
+        const char *nl = static_cast<const char*>(memchr(hit, '\n', static_cast<size_t>(end - hit)));
+        p = nl ? nl + 1 : end;
+    }
+
+    if (q.limit > 0 && out.records.size() > q.limit) {
+        out.records.erase(out.records.begin(), out.records.end() - static_cast<std::ptrdiff_t>(q.limit));
+    }
+    return true;
+}
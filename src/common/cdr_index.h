@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+// Sidecar index for the flat CDR file ("ts, imsi, action" lines).
+//
+// The file is split into segments of roughly segment_bytes: a segment holds
+// the records that start within segment_bytes of its first record. Once the
+// file has grown past a segment, the segment is sealed and gets an immutable
+// sidecar <cdr_file>.<n>.idx with its byte range, time range and
+// (packed IMSI, offset) pairs sorted by IMSI. Queries binary-search the
+// mapped sidecars and skip segments outside the requested time range;
+// only the unsealed tail is scanned linearly.
+
+constexpr uint64_t cdr_index_default_segment_bytes = 64ull << 20;
+
+struct CdrIndexEntry {
+    uint64_t imsi;   // pack_imsi()
+    uint64_t offset; // absolute byte offset of the record
+};
+
+struct CdrSegmentIndex {
+    uint64_t start = 0;
+    uint64_t end = 0; // one past the last record
+    uint64_t records = 0;
+    int64_t min_ts = std::numeric_limits<int64_t>::max(); // empty range until a timestamp parses
+    int64_t max_ts = std::numeric_limits<int64_t>::min();
+    std::vector<CdrIndexEntry> entries;
+};
+
+std::string cdr_index_path(const std::string &cdr_file, uint64_t segment);
+
+// "2025-11-08T15:36:42+0300" -> unix seconds, -1 if it does not parse
+int64_t parse_cdr_time(const char *s, size_t len);
+
+// Indexes the records of `data` (mapped at file offset `base`) that start
+// below `boundary`; data must end on a record boundary.
+void index_cdr_records(const char *data, size_t len, uint64_t base, uint64_t boundary, CdrSegmentIndex &out);
+
+bool write_cdr_index(const std::string &path, const CdrSegmentIndex &idx);
+
+// Writes sidecars for every sealed segment below `committed` that has none
+// yet. Returns the number of segments indexed; `indexed_end` receives the
+// end of the last indexed segment.
+size_t update_cdr_indexes(const std::string &cdr_file, uint64_t segment_bytes, uint64_t committed,
+                          uint64_t *indexed_end = nullptr, std::string *err = nullptr);
+
+// where indexing got to: the first segment without a sidecar and its start
+struct CdrIndexCursor {
+    uint64_t segment = 0;
+    uint64_t end = 0;
+};
+
+// Same, resuming from `cursor` and advancing it, for a caller that keeps
+// indexing a growing file: sidecars already passed are not reopened, and
+// the CDR file is only opened once a segment can be sealed.
+size_t update_cdr_indexes(const std::string &cdr_file, uint64_t segment_bytes, uint64_t committed,
+                          CdrIndexCursor &cursor, std::string *err = nullptr);
+
+struct CdrQuery {
+    std::string imsi;
+    int64_t from_ts = std::numeric_limits<int64_t>::min();
+    int64_t to_ts = std::numeric_limits<int64_t>::max();
+    size_t limit = 1000; // most recent records kept
+};
+
+struct CdrQueryResult {
+    std::vector<std::string> records; // oldest first
+    size_t segments_searched = 0;
+    size_t segments_skipped = 0;      // outside the time range
+    uint64_t tail_bytes_scanned = 0;  // unindexed bytes
+};
+
+// `committed` bounds the readable part of the file (pass 0 to use its size)
+bool query_cdr(const std::string &cdr_file, uint64_t committed, const CdrQuery &q,
+               CdrQueryResult &out, std::string *err = nullptr);
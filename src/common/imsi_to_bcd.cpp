@@ -47,4 +47,23 @@ std::string decode_imsi_bcd(const std::vector<uint8_t> &bcd) {
         }
     }
     return imsi;
-}
\ No newline at end of file
+}
+
+uint64_t pack_imsi(const char *digits, size_t len) {
+    if (len == 0 || len > 15) return 0;
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (digits[i] < '0' || digits[i] > '9') return 0;
+        value = value * 10 + static_cast<uint64_t>(digits[i] - '0');
+    }
+    return (static_cast<uint64_t>(len) << 56) | value;
+}
+
+std::string unpack_imsi(uint64_t packed) {
+    size_t len = static_cast<size_t>(packed >> 56);
+    uint64_t value = packed & ((1ull << 56) - 1);
+    if (len == 0 || len > 15) return {};
+    std::string imsi(len, '0');
+    for (size_t i = len; i-- > 0; value /= 10) imsi[i] = static_cast<char>('0' + value % 10);
+    return imsi;
+}
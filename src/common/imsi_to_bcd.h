@@ -6,3 +6,12 @@
 std::vector<uint8_t> encode_imsi_bcd(const std::string &imsi);
 
 std::string decode_imsi_bcd(const std::vector<uint8_t> &bcd);
+
+// IMSI (up to 15 digits) packed into one integer: digit count in the top byte,
+// numeric value below, so leading zeros survive. Returns 0 for invalid input.
+uint64_t pack_imsi(const char *digits, size_t len);
+inline uint64_t pack_imsi(const std::string &imsi) { return pack_imsi(imsi.data(), imsi.size()); }
+std::string unpack_imsi(uint64_t packed);
+
+// 1 to 15 digits, the only IMSIs the server keeps sessions for
+inline bool valid_imsi(const std::string &imsi) { return pack_imsi(imsi) != 0; }
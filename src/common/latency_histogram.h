@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear latency histogram in microseconds, ~6% resolution: values
+// below 16 are exact, above that each power of two is split into 16 buckets.
+// record() is lock-free and may be called from several threads.
+class LatencyHistogram {
+public:
+    void record(uint64_t us) {
+        buckets_[index(us)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t m = max_.load(std::memory_order_relaxed);
+        while (us > m && !max_.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t count() const {
+        uint64_t total = 0;
+        for (const auto &b : buckets_) total += b.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+    // lower bound of the bucket holding the q-th quantile, 0 if empty
+    uint64_t percentile(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t want = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= want) return lower_bound(i);
+        }
+        return max();
+    }
+
+private:
+    static constexpr size_t sub = 16;
+
+    static size_t index(uint64_t us) {
+        if (us < sub) return static_cast<size_t>(us);
+        int msb = 63 - __builtin_clzll(us);
+        return static_cast<size_t>(msb - 3) * sub + ((us >> (msb - 4)) & (sub - 1));
+    }
+    static uint64_t lower_bound(size_t idx) {
+        if (idx < sub) return idx;
+        size_t msb = idx / sub + 3;
+        return (sub + idx % sub) << (msb - 4);
+    }
+
+    std::array<std::atomic<uint64_t>, 64 * sub> buckets_{};
+    std::atomic<uint64_t> max_{0};
+};
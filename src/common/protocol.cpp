@@ -0,0 +1,152 @@
+#include "protocol.h"
+#include "imsi_to_bcd.h"
+#include <stdexcept>
+
+static void put_header(std::vector<uint8_t> &out, ProtoType type, uint32_t txid, uint16_t count) {
+    out.push_back(proto_v2_magic);
+    out.push_back(proto_v2_version);
+    out.push_back(static_cast<uint8_t>(type));
+    out.push_back(0);
+    for (int shift = 24; shift >= 0; shift -= 8) out.push_back(static_cast<uint8_t>(txid >> shift));
+    out.push_back(static_cast<uint8_t>(count >> 8));
+    out.push_back(static_cast<uint8_t>(count));
+}
+
+static bool get_header(const uint8_t *data, size_t len, ProtoType expected, ProtoHeader &hdr) {
+    if (!is_proto_v2(data, len)) return false;
+    if (data[2] != static_cast<uint8_t>(expected)) return false;
+    hdr.type = expected;
+    hdr.flags = data[3];
+    hdr.txid = (uint32_t(data[4]) << 24) | (uint32_t(data[5]) << 16) | (uint32_t(data[6]) << 8) | data[7];
+    hdr.count = static_cast<uint16_t>((data[8] << 8) | data[9]);
+    return hdr.count <= proto_v2_max_imsis;
+}
+
+bool is_proto_v2(const uint8_t *data, size_t len) {
+    return len >= proto_v2_header_size && data[0] == proto_v2_magic && data[1] == proto_v2_version;
+}
+
+static std::vector<uint8_t> encode_entries(ProtoType type, uint32_t txid, const std::vector<std::string> &imsis) {
+    if (imsis.empty() || imsis.size() > proto_v2_max_imsis) {
+        throw std::invalid_argument("v2 request must carry 1.." + std::to_string(proto_v2_max_imsis) + " IMSIs");
+    }
+    std::vector<uint8_t> out;
+    out.reserve(proto_v2_header_size + imsis.size() * 9);
+    put_header(out, type, txid, static_cast<uint16_t>(imsis.size()));
+    for (const auto &imsi : imsis) {
+        if (imsi.size() > 15) throw std::invalid_argument("IMSI longer than 15 digits");
+        auto bcd = encode_imsi_bcd(imsi);
+        out.push_back(static_cast<uint8_t>(bcd.size()));
+        out.insert(out.end(), bcd.begin(), bcd.end());
+    }
+    return out;
+}
+
+std::vector<uint8_t> encode_v2_request(uint32_t txid, const std::vector<std::string> &imsis) {
+    return encode_entries(ProtoType::request, txid, imsis);
+}
+
+std::vector<uint8_t> encode_v2_reply(uint32_t txid, const std::vector<ResultCode> &results) {
+    std::vector<uint8_t> out;
+    out.reserve(proto_v2_header_size + results.size());
+    put_header(out, ProtoType::reply, txid, static_cast<uint16_t>(results.size()));
+    for (auto rc : results) out.push_back(static_cast<uint8_t>(rc));
+    return out;
+}
+
+// strict counterpart of decode_imsi_bcd: digits only, filler only at the end
+static bool decode_bcd_strict(const uint8_t *p, size_t n, std::string &imsi) {
+    imsi.clear();
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t low = p[i] & 0x0F;
+        uint8_t high = (p[i] >> 4) & 0x0F;
+        if (low > 9) return false;
+        imsi.push_back(static_cast<char>('0' + low));
+        if (high == 0x0F) return i + 1 == n;
+        if (high > 9) return false;
+        imsi.push_back(static_cast<char>('0' + high));
+    }
+    return !imsi.empty();
+}
+
+static bool decode_entries(const uint8_t *data, size_t len, ProtoType type, ProtoHeader &hdr,
+                           std::vector<std::string> &imsis) {
+    if (!get_header(data, len, type, hdr)) return false;
+    imsis.resize(hdr.count);
+    size_t pos = proto_v2_header_size;
+    for (uint16_t i = 0; i < hdr.count; ++i) {
+        if (pos >= len) return false;
+        size_t n = data[pos++];
+        if (pos + n > len) return false;
+        if (n == 0 || n > 8 || !decode_bcd_strict(data + pos, n, imsis[i]) || imsis[i].size() > 15) {
+            imsis[i].clear();
+        }
+        pos += n;
+    }
+    return true;
+}
+
+bool decode_v2_request(const uint8_t *data, size_t len, ProtoHeader &hdr, std::vector<std::string> &imsis) {
+    return decode_entries(data, len, ProtoType::request, hdr, imsis);
+}
+
+bool decode_v2_reply(const uint8_t *data, size_t len, ProtoHeader &hdr, std::vector<ResultCode> &results) {
+    if (!get_header(data, len, ProtoType::reply, hdr)) return false;
+    if (len < proto_v2_header_size + hdr.count) return false;
+    results.clear();
+    for (uint16_t i = 0; i < hdr.count; ++i) {
+        results.push_back(static_cast<ResultCode>(data[proto_v2_header_size + i]));
+    }
+    return true;
+}
+
+std::vector<uint8_t> encode_status_query(uint32_t txid, const std::vector<std::string> &imsis) {
+    return encode_entries(ProtoType::status_query, txid, imsis);
+}
+
+bool decode_status_query(const uint8_t *data, size_t len, ProtoHeader &hdr, std::vector<std::string> &imsis) {
+    return decode_entries(data, len, ProtoType::status_query, hdr, imsis);
+}
+
+std::vector<uint8_t> encode_status_reply(uint32_t txid, const std::vector<bool> &active) {
+    std::vector<uint8_t> out;
+    out.reserve(proto_v2_header_size + (active.size() + 7) / 8);
+    put_header(out, ProtoType::status_reply, txid, static_cast<uint16_t>(active.size()));
+    out.resize(proto_v2_header_size + (active.size() + 7) / 8, 0);
+    for (size_t i = 0; i < active.size(); ++i) {
+        if (active[i]) out[proto_v2_header_size + i / 8] |= static_cast<uint8_t>(1u << (i % 8));
+    }
+    return out;
+}
+
+bool decode_status_reply(const uint8_t *data, size_t len, ProtoHeader &hdr, std::vector<bool> &active) {
+    if (!get_header(data, len, ProtoType::status_reply, hdr)) return false;
+    if (len < proto_v2_header_size + (hdr.count + 7u) / 8) return false;
+    active.assign(hdr.count, false);
+    for (uint16_t i = 0; i < hdr.count; ++i) {
+        active[i] = (data[proto_v2_header_size + i / 8] >> (i % 8)) & 1;
+    }
+    return true;
+}
+
+const char *result_code_name(ResultCode rc) {
+    switch (rc) {
+        case ResultCode::created: return "created";
+        case ResultCode::active: return "active";
+        case ResultCode::rejected: return "rejected";
+        case ResultCode::no_capacity: return "no_capacity";
+        case ResultCode::busy: return "busy";
+        case ResultCode::not_owner: return "not_owner";
+        case ResultCode::malformed: return "malformed";
+    }
+    return "unknown";
+}
+
+ResultCode result_code_from_reply(const std::string &reply) {
+    if (reply == "created") return ResultCode::created;
+    if (reply == "active") return ResultCode::active;
+    if (reply == "rejected") return ResultCode::rejected;
+    if (reply == "no_capacity") return ResultCode::no_capacity;
+    if (reply == "busy") return ResultCode::busy;
+    return ResultCode::malformed;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Wire protocol v2, carried alongside the legacy "one BCD IMSI in, ASCII word
+// out" datagrams. Every v2 datagram starts with a 10-byte header (big-endian):
+//   u8 magic 0xAE | u8 version 2 | u8 type | u8 flags | u32 txid | u16 count
+// A request carries `count` entries of u8 bcd_len | bcd bytes; the reply
+// echoes the txid and carries `count` one-byte result codes in request order.
+// 0xAE can never start a legacy datagram: its low nibble is not a BCD digit.
+//
+// Status queries (read-only, served on a separate port) use the same framing
+// and entries with type status_query; the status_reply carries one bit per
+// IMSI, bit i of byte i/8 (least significant first) set when the session is
+// active.
+
+constexpr uint8_t proto_v2_magic = 0xAE;
+constexpr uint8_t proto_v2_version = 2;
+constexpr size_t proto_v2_header_size = 10;
+constexpr size_t proto_v2_max_imsis = 128; // keeps a full request under one MTU
+
+enum class ProtoType : uint8_t { request = 1, reply = 2, status_query = 3, status_reply = 4 };
+
+enum class ResultCode : uint8_t {
+    created = 1,
+    active = 2,
+    rejected = 3,
+    no_capacity = 4,
+    busy = 5,
+    not_owner = 6,  // cluster: the IMSI belongs to another node
+    malformed = 7,  // entry could not be decoded
+};
+
+struct ProtoHeader {
+    ProtoType type = ProtoType::request;
+    uint8_t flags = 0;
+    uint32_t txid = 0;
+    uint16_t count = 0;
+};
+
+bool is_proto_v2(const uint8_t *data, size_t len);
+
+// Throws std::invalid_argument on a bad IMSI or too many entries.
+std::vector<uint8_t> encode_v2_request(uint32_t txid, const std::vector<std::string> &imsis);
+std::vector<uint8_t> encode_v2_reply(uint32_t txid, const std::vector<ResultCode> &results);
+
+// Return false if the datagram is structurally broken. A single undecodable
+// entry of an otherwise valid request comes back as an empty string.
+bool decode_v2_request(const uint8_t *data, size_t len, ProtoHeader &hdr, std::vector<std::string> &imsis);
+bool decode_v2_reply(const uint8_t *data, size_t len, ProtoHeader &hdr, std::vector<ResultCode> &results);
+
+// Status queries. Same limits and error handling as the request functions.
+std::vector<uint8_t> encode_status_query(uint32_t txid, const std::vector<std::string> &imsis);
+bool decode_status_query(const uint8_t *data, size_t len, ProtoHeader &hdr, std::vector<std::string> &imsis);
+std::vector<uint8_t> encode_status_reply(uint32_t txid, const std::vector<bool> &active);
+bool decode_status_reply(const uint8_t *data, size_t len, ProtoHeader &hdr, std::vector<bool> &active);
+
+const char *result_code_name(ResultCode rc);
+// maps the legacy ASCII reply ("created", "active", ...) to its code
+ResultCode result_code_from_reply(const std::string &reply);
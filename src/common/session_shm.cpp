@@ -0,0 +1,103 @@
+#include "session_shm.h"
+#include "imsi_to_bcd.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+std::string session_shm_path(const std::string &name) {
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+SessionShmReader::SessionShmReader(const std::string &name) {
+    int fd = shm_open(session_shm_path(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SessionShmHeader)) {
+        ::close(fd);
+        return;
+    }
+    size_t len = static_cast<size_t>(st.st_size);
+    void *p = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return;
+
+    const auto *hdr = static_cast<const SessionShmHeader*>(p);
+    if (hdr->magic.load(std::memory_order_acquire) != session_shm_magic || hdr->version != session_shm_version ||
+        hdr->slots == 0 || (hdr->slots & (hdr->slots - 1)) != 0 || session_shm_bytes(hdr->slots) != len) {
+        munmap(p, len);
+        return;
+    }
+    hdr_ = hdr;
+    slots_ = reinterpret_cast<const SessionShmSlot*>(hdr + 1);
+    len_ = len;
+}
+
+SessionShmReader::~SessionShmReader() {
+    if (hdr_) munmap(const_cast<SessionShmHeader*>(hdr_), len_);
+}
+
+static int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool SessionShmReader::fresh(std::chrono::milliseconds max_age) const {
+    if (!hdr_) return false;
+    int64_t hb = hdr_->heartbeat_ns.load(std::memory_order_acquire);
+    return hb != 0 && steady_ns() - hb <= std::chrono::duration_cast<std::chrono::nanoseconds>(max_age).count();
+}
+
+bool SessionShmReader::lookup(const std::string &imsi, uint64_t *idle_ms) const {
+    if (!hdr_) return false;
+    const uint64_t key = pack_imsi(imsi);
+    if (!key) return false;
+
+    const uint64_t mask = hdr_->slots - 1;
+    for (int pass = 0; pass < 1000; ++pass) {
+        uint64_t moves = hdr_->moves.load(std::memory_order_acquire);
+        uint64_t i = session_shm_home(key, hdr_->slots);
+        for (uint64_t n = 0; n <= mask; ++n, i = (i + 1) & mask) {
+            const SessionShmSlot &s = slots_[i];
+            uint64_t k;
+            int64_t ts;
+            // seqlock read; a writer holds a slot for a few stores, so this rarely spins
+            for (int attempt = 0;; ++attempt) {
+                uint32_t s1 = s.seq.load(std::memory_order_acquire);
+                k = s.key.load(std::memory_order_relaxed);
+                ts = s.last_seen_ns.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if ((s1 & 1) == 0 && s.seq.load(std::memory_order_relaxed) == s1) break;
+                if (attempt == 1000) return false; // writer died mid-update
+            }
+            if (k == session_shm_empty) break;
+            if (k != key) continue;
+            if (idle_ms) {
+                int64_t d = steady_ns() - ts;
+                *idle_ms = d > 0 ? static_cast<uint64_t>(d / 1000000) : 0;
+            }
+            return true;
+        }
+        // a miss only counts if no removal moved an entry past us meanwhile
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((moves & 1) == 0 && hdr_->moves.load(std::memory_order_relaxed) == moves) return false;
+    }
+    return false;
+}
+
+uint64_t SessionShmReader::sessions() const {
+    return hdr_ ? hdr_->sessions.load(std::memory_order_relaxed) : 0;
+}
+
+uint64_t SessionShmReader::generation() const {
+    return hdr_ ? hdr_->generation.load(std::memory_order_acquire) : 0;
+}
+
+uint64_t SessionShmReader::slots() const {
+    return hdr_ ? hdr_->slots : 0;
+}
+
+int64_t SessionShmReader::session_timeout_ms() const {
+    return hdr_ ? hdr_->session_timeout_ms : 0;
+}
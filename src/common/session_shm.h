@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Read-only mirror of the session table in POSIX shared memory.
+//
+// The segment is a header followed by `slots` fixed-size slots forming an
+// open-addressing table keyed by pack_imsi(). pgw_server is the only writer.
+// Every slot carries its own sequence counter (odd while the slot is being
+// written), so readers in other processes never take a lock, never block the
+// server and never see a torn entry. Removal shifts later entries of the
+// probe chain back (no tombstones, so churn never lengthens probes); while it
+// does, the header's `moves` counter is odd and a reader that missed retries.
+// Native byte order: the mirror never leaves the host.
+
+constexpr uint32_t session_shm_magic = 0x4d574750; // "PGWM"
+constexpr uint32_t session_shm_version = 2;
+
+constexpr uint64_t session_shm_empty = 0; // pack_imsi() never returns 0
+
+struct SessionShmHeader {
+    std::atomic<uint32_t> magic;           // stored last, once the segment is initialised
+    uint32_t version;
+    uint64_t slots;                        // power of two
+    int64_t session_timeout_ms;
+    int32_t pid;
+    uint32_t reserved;
+    std::atomic<uint64_t> generation;      // bumped whenever the mirror is cleared
+    std::atomic<uint64_t> sessions;
+    std::atomic<int64_t> heartbeat_ns;     // steady clock of the last update, 0 once the writer is gone
+    std::atomic<uint64_t> moves;           // odd while remove() shifts entries back
+};
+
+struct SessionShmSlot {
+    std::atomic<uint32_t> seq;
+    uint32_t reserved;
+    std::atomic<uint64_t> key;             // pack_imsi() or empty
+    std::atomic<int64_t> last_seen_ns;     // steady clock, shared by all processes on the host
+};
+
+static_assert(sizeof(SessionShmHeader) == 64, "shm header layout");
+static_assert(sizeof(SessionShmSlot) == 24, "shm slot layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm atomics must be address-free");
+
+inline size_t session_shm_bytes(uint64_t slots) {
+    return sizeof(SessionShmHeader) + static_cast<size_t>(slots) * sizeof(SessionShmSlot);
+}
+
+// first probe position of `key` in a table of `slots` (a power of two)
+inline uint64_t session_shm_home(uint64_t key, uint64_t slots) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return key & (slots - 1);
+}
+
+// "/name" as shm_open() expects it
+std::string session_shm_path(const std::string &name);
+
+// Lock-free reader for local processes (monitoring agents, policy engine).
+// Link against `common`; a lookup is a few hundred nanoseconds at most and
+// does not touch the server.
+class SessionShmReader {
+public:
+    explicit SessionShmReader(const std::string &name);
+    ~SessionShmReader();
+
+    SessionShmReader(const SessionShmReader&) = delete;
+    SessionShmReader& operator=(const SessionShmReader&) = delete;
+
+    bool ok() const { return hdr_ != nullptr; }
+
+    // false if the server is gone or has not updated the mirror within max_age;
+    // a restarted server publishes a new segment, reopen the reader then
+    bool fresh(std::chrono::milliseconds max_age) const;
+
+    // true if the IMSI has a session; idle_ms receives the time since its last refresh
+    bool lookup(const std::string &imsi, uint64_t *idle_ms = nullptr) const;
+
+    uint64_t sessions() const;
+    uint64_t generation() const;
+    uint64_t slots() const;
+    int64_t session_timeout_ms() const;
+
+private:
+    const SessionShmHeader *hdr_ = nullptr;
+    const SessionShmSlot *slots_ = nullptr;
+    size_t len_ = 0;
+};
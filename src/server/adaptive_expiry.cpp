@@ -0,0 +1,73 @@
+#include "adaptive_expiry.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+AdaptiveExpiry::AdaptiveExpiry(Options opts) : opts_(opts), timeout_sec_(opts.timeout.count()) {}
+
+double AdaptiveExpiry::level(double value, double low, double high) {
+    if (value <= low) return 0.0;
+    if (value >= high || high <= low) return 1.0;
+    return (value - low) / (high - low);
+}
+
+std::chrono::seconds AdaptiveExpiry::update(size_t sessions, size_t capacity, uint64_t rss_bytes) {
+    double occupancy = capacity ? static_cast<double>(sessions) / static_cast<double>(capacity) : 0.0;
+    double p = 0.0;
+    if (capacity) p = level(occupancy, opts_.occupancy_low, opts_.occupancy_high);
+    if (opts_.memory_high_bytes > 0) {
+        p = std::max(p, level(static_cast<double>(rss_bytes), static_cast<double>(opts_.memory_low_bytes),
+                              static_cast<double>(opts_.memory_high_bytes)));
+    }
+
+    int64_t timeout = opts_.timeout.count();
+    if (enabled()) {
+        double span = static_cast<double>(timeout - opts_.min_timeout.count());
+        timeout -= static_cast<int64_t>(std::lround(span * p));
+    }
+    occupancy_ = occupancy;
+    rss_bytes_ = rss_bytes;
+    pressure_ = p;
+    timeout_sec_ = timeout;
+    return std::chrono::seconds(timeout);
+}
+
+const char *AdaptiveExpiry::state() const {
+    double p = pressure_.load();
+    if (p <= 0.0) return "normal";
+    return p < 1.0 ? "elevated" : "critical";
+}
+
+nlohmann::json AdaptiveExpiry::json() const {
+    return {
+        {"enabled", enabled()},
+        {"state", state()},
+        {"pressure", pressure()},
+        {"timeout_sec", opts_.timeout.count()},
+        {"min_timeout_sec", opts_.min_timeout.count()},
+        {"low_activity_timeout_sec", timeout_sec_.load()},
+        {"occupancy", {
+            {"value", occupancy_.load()},
+            {"low", opts_.occupancy_low},
+            {"high", opts_.occupancy_high}
+        }},
+        {"memory", {
+            {"rss_bytes", rss_bytes_.load()},
+            {"low_bytes", opts_.memory_low_bytes},
+            {"high_bytes", opts_.memory_high_bytes}
+        }}
+    };
+}
+
+uint64_t AdaptiveExpiry::process_rss_bytes() {
+    // second field of statm: resident pages
+    FILE *f = std::fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long long size = 0, resident = 0;
+    int n = std::fscanf(f, "%llu %llu", &size, &resident);
+    std::fclose(f);
+    if (n != 2) return 0;
+    return static_cast<uint64_t>(resident) * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+#include <nlohmann/json.hpp>
+
+// Adaptive session timeout for low-activity sessions.
+//
+// Pressure is read from two signals, table occupancy (sessions / capacity)
+// and process RSS, each with a low and a high watermark. Below low a signal
+// contributes nothing, at or above high it contributes 1, linearly in
+// between; the larger of the two is the pressure. The low-activity timeout
+// slides from the configured session timeout (no pressure) down to the
+// minimum (full pressure), so it shortens as load builds and comes back on
+// its own as it drains. Refreshed sessions always keep the full timeout.
+//
+// update() is called by the cleaner; the getters may be read from any thread.
+class AdaptiveExpiry {
+public:
+    struct Options {
+        std::chrono::seconds timeout{30};     // session_timeout_sec
+        std::chrono::seconds min_timeout{0};  // at full pressure; 0 = adaptive expiry off
+        double occupancy_low = 0.7;
+        double occupancy_high = 0.9;
+        uint64_t memory_low_bytes = 0;        // 0 = memory is not watched
+        uint64_t memory_high_bytes = 0;
+    };
+
+    explicit AdaptiveExpiry(Options opts);
+
+    bool enabled() const { return opts_.min_timeout.count() > 0 && opts_.min_timeout < opts_.timeout; }
+
+    // takes the current readings and returns the low-activity timeout;
+    // capacity 0 (unbounded table) leaves occupancy out
+    std::chrono::seconds update(size_t sessions, size_t capacity, uint64_t rss_bytes);
+
+    std::chrono::seconds low_activity_timeout() const { return std::chrono::seconds(timeout_sec_.load()); }
+    double pressure() const { return pressure_.load(); }
+    // "normal", "elevated" (between watermarks) or "critical" (at a high watermark)
+    const char *state() const;
+
+    nlohmann::json json() const;
+
+    // resident set size of this process, 0 if unknown
+    static uint64_t process_rss_bytes();
+
+private:
+    static double level(double value, double low, double high);
+
+    Options opts_;
+    std::atomic<double> occupancy_{0};
+    std::atomic<uint64_t> rss_bytes_{0};
+    std::atomic<double> pressure_{0};
+    std::atomic<int64_t> timeout_sec_;
+};
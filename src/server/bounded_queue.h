@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+// Bounded lock-free multi-producer/multi-consumer queue (Vyukov). push() and
+// pop() never block: a full queue makes push() fail, and callers decide what
+// to drop. Capacity is rounded up to a power of two.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        cells_ = std::make_unique<Cell[]>(cap);
+        for (size_t i = 0; i < cap; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    bool push(T value) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell *c;
+        for (;;) {
+            c = &cells_[pos & mask_];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        c->value = std::move(value);
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &out) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        Cell *c;
+        for (;;) {
+            c = &cells_[pos & mask_];
+            size_t seq = c->seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(c->value);
+        c->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // approximate, for metrics
+    size_t size() const {
+        size_t t = tail_.load(std::memory_order_relaxed);
+        size_t h = head_.load(std::memory_order_relaxed);
+        return t >= h ? t - h : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
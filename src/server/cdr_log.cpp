@@ -0,0 +1,157 @@
+#include "cdr_log.h"
+#include "trace.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+static size_t page_size() {
+    static const size_t p = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return p;
+}
+
+CdrLog::CdrLog(std::string path) : path_(std::move(path)) {
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        spdlog::error("Failed to open CDR file '{}': {}", path_, strerror(errno));
+        return;
+    }
+    rd_fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (rd_fd_ < 0) {
+        spdlog::warn("Failed to open CDR file '{}' for reading: {}", path_, strerror(errno));
+    }
+    scan_existing();
+}
+
+CdrLog::~CdrLog() {
+    if (fd_ >= 0) ::close(fd_);
+    if (rd_fd_ >= 0) ::close(rd_fd_);
+}
+
+void CdrLog::scan_existing() {
+    checkpoints_.push_back(0);
+    struct stat st{};
+    if (fstat(fd_, &st) != 0 || st.st_size == 0) return;
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    uint64_t records = 0;
+    bool torn = false;
+
+    void *p = rd_fd_ >= 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, rd_fd_, 0) : MAP_FAILED;
+    if (p == MAP_FAILED) {
+        spdlog::warn("Cannot scan CDR file '{}', sequence numbers start from 0", path_);
+    } else {
+        madvise(p, size, MADV_SEQUENTIAL);
+        const char *data = static_cast<const char*>(p);
+        const char *end = data + size;
+        for (const char *c = data; (c = static_cast<const char*>(memchr(c, '\n', end - c))); ++c) {
+            ++records;
+            if (records % checkpoint_every == 0) checkpoints_.push_back(static_cast<uint64_t>(c + 1 - data));
+        }
+        torn = data[size - 1] != '\n';
+        munmap(p, size);
+    }
+
+    // a partial last record (crash mid-write) is terminated so the next one starts on its own line
+    if (torn) {
+        spdlog::warn("CDR file '{}' ends with a partial record", path_);
+        const char nl = '\n';
+        if (::write(fd_, &nl, 1) == 1) {
+            ++size;
+            ++records;
+            if (records % checkpoint_every == 0) checkpoints_.push_back(size);
+        }
+    }
+    size_.store(size, std::memory_order_release);
+    records_.store(records, std::memory_order_release);
+}
+
+bool CdrLog::append(const std::string &record) {
+    if (fd_ < 0) return false;
+    std::string line;
+    line.reserve(record.size() + 1);
+    line.append(record).push_back('\n');
+
+    int64_t t0 = trace_now_ns();
+    {
+        std::lock_guard<InstrumentedMutex> lk(m_);
+        ssize_t w = ::write(fd_, line.data(), line.size());
+        if (w != static_cast<ssize_t>(line.size())) {
+            spdlog::error("CDR write failed: {}", w < 0 ? strerror(errno) : "short write");
+            return false;
+        }
+        uint64_t n = records_.load(std::memory_order_relaxed) + 1;
+        uint64_t end = size_.load(std::memory_order_relaxed) + line.size();
+        if (n % checkpoint_every == 0) checkpoints_.push_back(end);
+        records_.store(n, std::memory_order_release);
+        // seq_cst pairs with the waiter's increment: either it sees the new size
+        // or we see it waiting
+        size_.store(end, std::memory_order_seq_cst);
+    }
+    if (waiters_.load(std::memory_order_seq_cst) > 0) wake_all();
+    PGW_TRACE_SPAN_END(cdr_append, t0, line.size());
+    return true;
+}
+
+uint64_t CdrLog::offset_of_seq(uint64_t seq) const {
+    uint64_t base_seq, offset;
+    {
+        std::lock_guard<InstrumentedMutex> lk(m_);
+        if (seq >= records_.load(std::memory_order_relaxed)) return size_.load(std::memory_order_relaxed);
+        size_t k = std::min<size_t>(seq / checkpoint_every, checkpoints_.size() - 1);
+        base_seq = k * checkpoint_every;
+        offset = checkpoints_[k];
+    }
+    // walk the remaining lines inside the mapped file
+    uint64_t skip = seq - base_seq;
+    while (skip > 0) {
+        uint64_t found = 0;
+        size_t n = map_range(offset, 1 << 20, [&](const char *data, size_t len) {
+            const char *end = data + len;
+            for (const char *c = data; skip > 0 && (c = static_cast<const char*>(memchr(c, '\n', end - c))); ++c) {
+                --skip;
+                found = static_cast<uint64_t>(c + 1 - data);
+            }
+            return true;
+        });
+        if (n == 0) break;
+        offset += skip == 0 ? found : n;
+    }
+    return offset;
+}
+
+size_t CdrLog::map_range(uint64_t offset, size_t len, const std::function<bool(const char*, size_t)> &f) const {
+    uint64_t end = size();
+    if (rd_fd_ < 0 || offset >= end || len == 0) return 0;
+    len = static_cast<size_t>(std::min<uint64_t>(len, end - offset));
+
+    uint64_t aligned = offset & ~static_cast<uint64_t>(page_size() - 1);
+    size_t map_len = static_cast<size_t>(offset - aligned) + len;
+    void *p = mmap(nullptr, map_len, PROT_READ, MAP_SHARED, rd_fd_, static_cast<off_t>(aligned));
+    if (p == MAP_FAILED) {
+        spdlog::warn("mmap of CDR file failed: {}", strerror(errno));
+        return 0;
+    }
+    bool ok = f(static_cast<const char*>(p) + (offset - aligned), len);
+    munmap(p, map_len);
+    return ok ? len : 0;
+}
+
+bool CdrLog::wait_beyond(uint64_t offset, std::chrono::milliseconds timeout) const {
+    std::unique_lock<std::mutex> lk(wait_m_);
+    waiters_.fetch_add(1, std::memory_order_seq_cst);
+    bool ok = wait_cv_.wait_for(lk, timeout, [&]() { return size_.load(std::memory_order_seq_cst) > offset; });
+    waiters_.fetch_sub(1, std::memory_order_relaxed);
+    return ok;
+}
+
+void CdrLog::wake_all() const {
+    // taking the lock orders the notify after a waiter's predicate check
+    { std::lock_guard<std::mutex> lk(wait_m_); }
+    wait_cv_.notify_all();
+}
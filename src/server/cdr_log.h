@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+#include "instrumented_mutex.h"
+
+// Append-only CDR file. Records are whole lines written with one write(2),
+// so every byte below size() is a complete record. Readers map the written
+// part of the file with mmap and never go through user-space copies; the
+// writer only takes its own mutex, and the waiters' one only when a reader
+// is actually blocked in wait_beyond().
+class CdrLog {
+public:
+    // records between seq checkpoints; seq -> offset scans at most this many lines
+    static constexpr uint64_t checkpoint_every = 4096;
+
+    explicit CdrLog(std::string path);
+    ~CdrLog();
+
+    CdrLog(const CdrLog&) = delete;
+    CdrLog& operator=(const CdrLog&) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+    const std::string &path() const { return path_; }
+
+    // appends one record (without the trailing newline), returns false on I/O error
+    bool append(const std::string &record);
+
+    uint64_t size() const { return size_.load(std::memory_order_acquire); }
+    uint64_t records() const { return records_.load(std::memory_order_acquire); }
+
+    // byte offset of record `seq` (0-based); seq past the end gives size()
+    uint64_t offset_of_seq(uint64_t seq) const;
+
+    // hands [offset, offset + len) of the written part to f without copying;
+    // returns the number of bytes passed, 0 if nothing is available or f failed
+    size_t map_range(uint64_t offset, size_t len, const std::function<bool(const char*, size_t)> &f) const;
+
+    // blocks until size() > offset or the timeout passes
+    bool wait_beyond(uint64_t offset, std::chrono::milliseconds timeout) const;
+    void wake_all() const;
+
+    // wait/hold times of the writer mutex
+    InstrumentedMutex::Stats lock_stats() const { return m_.stats(); }
+
+private:
+    void scan_existing();
+
+    std::string path_;
+    int fd_ = -1;    // O_APPEND writer
+    int rd_fd_ = -1; // shared by readers for mmap
+
+    mutable InstrumentedMutex m_;
+    // long-poll readers wait here, away from the writer mutex
+    mutable std::mutex wait_m_;
+    mutable std::condition_variable wait_cv_;
+    mutable std::atomic<uint32_t> waiters_{0};
+    std::vector<uint64_t> checkpoints_; // offset of record k * checkpoint_every
+    std::atomic<uint64_t> size_{0};
+    std::atomic<uint64_t> records_{0};
+};
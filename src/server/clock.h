@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <thread>
+#include <set>
+
+// Time source for session ageing, the cleaner, offload pacing and CDR
+// timestamps. pgw_server runs on SystemClock; tests inject ManualClock and
+// move simulated time forward explicitly, so timeouts and offload ticks take
+// no real time. Network timeouts and latency measurements stay on real time.
+class Clock {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+    using wall_time_point = std::chrono::system_clock::time_point;
+
+    virtual ~Clock() = default;
+
+    virtual time_point now() const = 0;
+    virtual wall_time_point wall_now() const = 0;
+
+    // blocks until now() >= t; returns false early once `running` is cleared
+    virtual bool sleep_until(time_point t, const std::atomic<bool> &running) = 0;
+
+    template <typename Rep, typename Period>
+    bool sleep_for(std::chrono::duration<Rep, Period> d, const std::atomic<bool> &running) {
+        return sleep_until(now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(d), running);
+    }
+};
+
+class SystemClock final : public Clock {
+public:
+    time_point now() const override { return std::chrono::steady_clock::now(); }
+    wall_time_point wall_now() const override { return std::chrono::system_clock::now(); }
+
+    bool sleep_until(time_point t, const std::atomic<bool> &running) override {
+        // short slices so a stop request is noticed quickly
+        for (auto n = now(); n < t; n = now()) {
+            if (!running) return false;
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(t - n, std::chrono::milliseconds(50)));
+        }
+        return true;
+    }
+};
+
+// Simulated time, only moved by advance(). Sleepers wake as soon as the
+// simulated deadline is reached; wall time moves in step with it.
+class ManualClock final : public Clock {
+public:
+    explicit ManualClock(time_point start = time_point{} + std::chrono::hours(1),
+                         wall_time_point wall_start = std::chrono::system_clock::now())
+        : start_(start), wall_start_(wall_start), now_(start) {}
+
+    time_point now() const override {
+        std::lock_guard<std::mutex> lk(m_);
+        return now_;
+    }
+
+    wall_time_point wall_now() const override {
+        std::lock_guard<std::mutex> lk(m_);
+        return wall_start_ + std::chrono::duration_cast<wall_time_point::duration>(now_ - start_);
+    }
+
+    bool sleep_until(time_point t, const std::atomic<bool> &running) override {
+        std::unique_lock<std::mutex> lk(m_);
+        auto it = deadlines_.insert(t);
+        while (now_ < t) {
+            if (!running) break;
+            // `running` is not tied to our mutex, poll it
+            cv_.wait_for(lk, std::chrono::milliseconds(5));
+        }
+        deadlines_.erase(it);
+        return now_ >= t;
+    }
+
+    // threads blocked in sleep_until() that only a later advance() can wake;
+    // tests wait for one before a jump so its deadline is not computed after it
+    size_t sleepers() const {
+        std::lock_guard<std::mutex> lk(m_);
+        return static_cast<size_t>(std::distance(deadlines_.upper_bound(now_), deadlines_.end()));
+    }
+
+    template <typename Rep, typename Period>
+    void advance(std::chrono::duration<Rep, Period> d) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            now_ += std::chrono::duration_cast<std::chrono::steady_clock::duration>(d);
+        }
+        cv_.notify_all();
+    }
+
+private:
+    const time_point start_;
+    const wall_time_point wall_start_;
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    time_point now_;
+    std::multiset<time_point> deadlines_;
+};
@@ -0,0 +1,187 @@
+#include "cluster.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+ClusterMember cluster_member_from_json(const nlohmann::json &j) {
+    ClusterMember m;
+    m.id = j.at("id").get<std::string>();
+    if (j.contains("ip")) m.ip = j["ip"].get<std::string>();
+    if (j.contains("udp_port")) m.udp_port = j["udp_port"].get<int>();
+    if (j.contains("http_port")) m.http_port = j["http_port"].get<int>();
+    return m;
+}
+
+nlohmann::json cluster_member_to_json(const ClusterMember &m) {
+    return {{"id", m.id}, {"ip", m.ip}, {"udp_port", m.udp_port}, {"http_port", m.http_port}};
+}
+
+static uint64_t mix64(uint64_t x) {
+    // splitmix64 finaliser: FNV alone clusters badly on near-identical IMSIs
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+static uint64_t fnv1a(const std::string &s) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+uint64_t imsi_hash(const std::string &imsi) {
+    return mix64(fnv1a(imsi));
+}
+
+HashRing::HashRing(std::vector<ClusterMember> members, int vnodes) {
+    std::sort(members.begin(), members.end(),
+              [](const ClusterMember &a, const ClusterMember &b) { return a.id < b.id; });
+    vnodes = std::max(1, vnodes);
+    for (auto &m : members) {
+        Node n;
+        n.member = std::move(m);
+        n.udp_addr.sin_family = AF_INET;
+        n.udp_addr.sin_port = htons(static_cast<uint16_t>(n.member.udp_port));
+        if (inet_pton(AF_INET, n.member.ip.c_str(), &n.udp_addr.sin_addr) <= 0) {
+            spdlog::error("Cluster member {} has invalid ip '{}'", n.member.id, n.member.ip);
+        }
+        nodes_.push_back(std::move(n));
+    }
+    points_.reserve(nodes_.size() * static_cast<size_t>(vnodes));
+    for (uint32_t i = 0; i < nodes_.size(); ++i) {
+        for (int v = 0; v < vnodes; ++v) {
+            points_.emplace_back(mix64(fnv1a(nodes_[i].member.id + "#" + std::to_string(v))), i);
+        }
+    }
+    std::sort(points_.begin(), points_.end());
+}
+
+const HashRing::Node *HashRing::owner(const std::string &imsi) const {
+    if (points_.empty()) return nullptr;
+    uint64_t h = imsi_hash(imsi);
+    auto it = std::lower_bound(points_.begin(), points_.end(), std::make_pair(h, uint32_t{0}));
+    if (it == points_.end()) it = points_.begin();
+    return &nodes_[it->second];
+}
+
+bool HashRing::contains(const std::string &id) const {
+    return std::any_of(nodes_.begin(), nodes_.end(), [&](const Node &n) { return n.member.id == id; });
+}
+
+ClusterForwarder::ClusterForwarder(int reply_sock, int timeout_ms, ForwardCounters &counters)
+    : reply_sock_(reply_sock), timeout_ms_(std::max(1, timeout_ms)), counters_(counters) {
+    if (pipe(wake_) < 0) {
+        spdlog::error("Cluster forwarder pipe() failed: {}", strerror(errno));
+        wake_[0] = wake_[1] = -1;
+    } else {
+        fcntl(wake_[0], F_SETFL, O_NONBLOCK);
+        fcntl(wake_[1], F_SETFL, O_NONBLOCK);
+    }
+    thread_ = std::thread(&ClusterForwarder::run, this);
+}
+
+ClusterForwarder::~ClusterForwarder() {
+    running_ = false;
+    if (wake_[1] >= 0) {
+        char c = 0;
+        (void)!write(wake_[1], &c, 1);
+    }
+    if (thread_.joinable()) thread_.join();
+    if (wake_[0] >= 0) close(wake_[0]);
+    if (wake_[1] >= 0) close(wake_[1]);
+}
+
+void ClusterForwarder::forward(const sockaddr_in &client, const uint8_t *data, size_t len, const sockaddr_in &owner) {
+    Job job{client, owner, {}};
+    job.payload.reserve(len + 1);
+    job.payload.push_back(cluster_forward_marker);
+    job.payload.insert(job.payload.end(), data, data + len);
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        queue_.push_back(std::move(job));
+    }
+    if (wake_[1] >= 0) {
+        char c = 0;
+        (void)!write(wake_[1], &c, 1);
+    }
+}
+
+void ClusterForwarder::run() {
+    std::vector<Pending> pending;
+    std::vector<Job> jobs;
+    std::vector<pollfd> fds;
+
+    while (running_) {
+        {
+            std::lock_guard<std::mutex> lk(m_);
+            jobs.swap(queue_);
+        }
+        auto now = std::chrono::steady_clock::now();
+        for (auto &job : jobs) {
+            int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+            if (fd < 0) {
+                spdlog::warn("Cluster forward socket() failed: {}", strerror(errno));
+                continue;
+            }
+            if (sendto(fd, job.payload.data(), job.payload.size(), 0,
+                       reinterpret_cast<const sockaddr*>(&job.owner), sizeof(job.owner)) < 0) {
+                spdlog::warn("Cluster forward sendto failed: {}", strerror(errno));
+                close(fd);
+                continue;
+            }
+            counters_.forwarded++;
+            pending.push_back({fd, job.client, now + std::chrono::milliseconds(timeout_ms_)});
+        }
+        jobs.clear();
+
+        fds.clear();
+        fds.push_back({wake_[0], POLLIN, 0});
+        for (const auto &p : pending) fds.push_back({p.fd, POLLIN, 0});
+        poll(fds.data(), fds.size(), pending.empty() ? 200 : 10);
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(wake_[0], drain, sizeof(drain)) > 0) {}
+        }
+
+        now = std::chrono::steady_clock::now();
+        size_t keep = 0;
+        for (size_t i = 0; i < pending.size(); ++i) {
+            Pending &p = pending[i];
+            bool done = false;
+            if (fds[i + 1].revents & POLLIN) {
+                uint8_t buf[512];
+                ssize_t r = recv(p.fd, buf, sizeof(buf), 0);
+                if (r >= 0) {
+                    sendto(reply_sock_, buf, static_cast<size_t>(r), 0,
+                           reinterpret_cast<const sockaddr*>(&p.client), sizeof(p.client));
+                    counters_.relayed++;
+                    done = true;
+                }
+            }
+            if (!done && now >= p.deadline) {
+                counters_.timeouts++;
+                done = true;
+            }
+            if (done) close(p.fd);
+            else pending[keep++] = p;
+        }
+        pending.resize(keep);
+    }
+
+    for (const auto &p : pending) close(p.fd);
+}
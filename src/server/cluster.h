@@ -0,0 +1,98 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+#include <netinet/in.h>
+#include <nlohmann/json.hpp>
+
+struct ClusterMember {
+    std::string id;
+    std::string ip = "127.0.0.1";
+    int udp_port = 9000;
+    int http_port = 8080;
+};
+
+ClusterMember cluster_member_from_json(const nlohmann::json &j);
+nlohmann::json cluster_member_to_json(const ClusterMember &m);
+
+// First byte of a datagram relayed between nodes. 0xB is not a BCD digit, so
+// it can never start a client request; the owner handles such datagrams
+// locally without another ownership check.
+constexpr uint8_t cluster_forward_marker = 0xFB;
+
+uint64_t imsi_hash(const std::string &imsi);
+
+// Consistent-hash ring: each member owns `vnodes` points on a 64-bit circle,
+// an IMSI belongs to the first point clockwise from its hash. Immutable once
+// built; the server swaps whole rings on membership changes.
+class HashRing {
+public:
+    struct Node {
+        ClusterMember member;
+        sockaddr_in udp_addr{};
+    };
+
+    HashRing(std::vector<ClusterMember> members, int vnodes);
+
+    // nullptr only for an empty ring
+    const Node *owner(const std::string &imsi) const;
+
+    const std::vector<Node> &members() const { return nodes_; }
+    bool contains(const std::string &id) const;
+
+private:
+    std::vector<Node> nodes_;
+    std::vector<std::pair<uint64_t, uint32_t>> points_; // sorted by hash
+};
+
+struct ForwardCounters {
+    std::atomic<uint64_t> forwarded{0};
+    std::atomic<uint64_t> relayed{0};
+    std::atomic<uint64_t> timeouts{0};
+};
+
+// Relays datagrams for IMSIs owned by other nodes. Each in-flight request gets
+// its own ephemeral socket, so the owner's reply is matched without any
+// protocol support and relayed to the client from the main UDP socket.
+class ClusterForwarder {
+public:
+    ClusterForwarder(int reply_sock, int timeout_ms, ForwardCounters &counters);
+    ~ClusterForwarder();
+
+    ClusterForwarder(const ClusterForwarder&) = delete;
+    ClusterForwarder& operator=(const ClusterForwarder&) = delete;
+
+    // called from the UDP thread; never blocks on the network
+    void forward(const sockaddr_in &client, const uint8_t *data, size_t len, const sockaddr_in &owner);
+
+private:
+    struct Job {
+        sockaddr_in client;
+        sockaddr_in owner;
+        std::vector<uint8_t> payload;
+    };
+    struct Pending {
+        int fd;
+        sockaddr_in client;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void run();
+
+    int reply_sock_;
+    int timeout_ms_;
+    int wake_[2] = {-1, -1};
+
+    std::mutex m_;
+    std::vector<Job> queue_;
+
+    ForwardCounters &counters_;
+    std::atomic<bool> running_{true};
+    std::thread thread_;
+};
@@ -0,0 +1,151 @@
+#include "cold_tier.h"
+#include "session_shm.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+ColdTier::ColdTier(std::string path, uint64_t slots) : path_(std::move(path)) {
+    uint64_t n = 1024;
+    while (n < slots) n <<= 1;
+
+    ::unlink(path_.c_str());
+    int fd = ::open(path_.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        spdlog::error("Failed to create cold tier file '{}': {}", path_, strerror(errno));
+        return;
+    }
+    size_t len = 2 * n * sizeof(Entry);
+    if (ftruncate(fd, static_cast<off_t>(len)) != 0) {
+        spdlog::error("Failed to size cold tier file '{}': {}", path_, strerror(errno));
+        ::close(fd);
+        ::unlink(path_.c_str());
+        return;
+    }
+    void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        spdlog::error("Failed to map cold tier file '{}': {}", path_, strerror(errno));
+        ::unlink(path_.c_str());
+        return;
+    }
+    // probes land anywhere in the table; readahead would only evict useful pages
+    madvise(p, n * sizeof(Entry), MADV_RANDOM);
+
+    base_ = p;
+    len_ = len;
+    table_ = static_cast<Entry*>(p);
+    fifo_ = table_ + n;
+    mask_ = n - 1;
+    spdlog::info("Cold session tier in '{}' ({} slots)", path_, n);
+}
+
+ColdTier::~ColdTier() {
+    if (!base_) return;
+    munmap(base_, len_);
+    ::unlink(path_.c_str());
+}
+
+uint64_t ColdTier::home(uint64_t key) const {
+    return session_shm_home(key, mask_ + 1);
+}
+
+uint64_t ColdTier::slot_of(uint64_t key) const {
+    for (uint64_t i = home(key);; i = (i + 1) & mask_) {
+        if (table_[i].key == key) return i;
+        if (table_[i].key == 0) return mask_ + 1;
+    }
+}
+
+bool ColdTier::find(uint64_t key, int64_t &last_seen_ns) const {
+    uint64_t i = slot_of(key);
+    if (i > mask_) return false;
+    last_seen_ns = table_[i].last_seen_ns;
+    return true;
+}
+
+bool ColdTier::contains(uint64_t key) const {
+    return base_ && key != 0 && slot_of(key) <= mask_;
+}
+
+bool ColdTier::put(uint64_t key, int64_t last_seen_ns) {
+    if (!base_ || key == 0) return false;
+    // keep probe chains short
+    if (size_ + 1 > (mask_ + 1) / 4 * 3) return false;
+    if (fifo_tail_ - fifo_head_ > mask_) compact_fifo();
+    uint64_t i = home(key);
+    for (; table_[i].key != 0; i = (i + 1) & mask_) {
+        if (table_[i].key == key) return false;
+    }
+    table_[i] = {key, last_seen_ns};
+    // demotions come oldest first, but a session adopted from another node or
+    // a replica can be older than the tail: slide it back to its place, as
+    // SessionTable::adopt does on the hot list
+    uint64_t pos = fifo_tail_++;
+    for (; pos != fifo_head_ && fifo_[(pos - 1) & mask_].last_seen_ns > last_seen_ns; --pos) {
+        fifo_[pos & mask_] = fifo_[(pos - 1) & mask_];
+    }
+    fifo_[pos & mask_] = {key, last_seen_ns};
+    ++size_;
+    return true;
+}
+
+// backward-shift deletion: no tombstones, probe chains stay as short as at insert
+void ColdTier::remove_slot(uint64_t i) {
+    uint64_t hole = i;
+    for (uint64_t j = (i + 1) & mask_; table_[j].key != 0; j = (j + 1) & mask_) {
+        uint64_t h = home(table_[j].key);
+        // move j into the hole unless its home lies cyclically in (hole, j]
+        bool stays = hole <= j ? (hole < h && h <= j) : (hole < h || h <= j);
+        if (!stays) {
+            table_[hole] = table_[j];
+            hole = j;
+        }
+    }
+    table_[hole] = {0, 0};
+    --size_;
+}
+
+// drops stale FIFO entries in place; at most 3/4 of the FIFO is live, so
+// this frees at least a quarter of it and runs once per that many demotions
+void ColdTier::compact_fifo() {
+    uint64_t out = fifo_head_;
+    for (uint64_t i = fifo_head_; i != fifo_tail_; ++i) {
+        const Entry e = fifo_[i & mask_];
+        int64_t ts;
+        if (find(e.key, ts) && ts == e.last_seen_ns) fifo_[out++ & mask_] = e;
+    }
+    fifo_tail_ = out;
+}
+
+bool ColdTier::take(uint64_t key, int64_t &last_seen_ns) {
+    if (!base_ || key == 0) return false;
+    uint64_t i = slot_of(key);
+    if (i > mask_) return false;
+    last_seen_ns = table_[i].last_seen_ns;
+    remove_slot(i);
+    return true;
+}
+
+bool ColdTier::erase(uint64_t key) {
+    int64_t ts;
+    return take(key, ts);
+}
+
+bool ColdTier::oldest(uint64_t &key, int64_t &last_seen_ns) {
+    while (fifo_head_ != fifo_tail_) {
+        const Entry &e = fifo_[fifo_head_ & mask_];
+        int64_t ts;
+        if (find(e.key, ts) && ts == e.last_seen_ns) {
+            key = e.key;
+            last_seen_ns = ts;
+            return true;
+        }
+        ++fifo_head_;
+    }
+    return false;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Cold tier of the session table: idle sessions demoted out of RAM into a
+// memory-mapped file on local disk. 16 bytes per session (packed IMSI and
+// last-seen time), so the kernel can page the bulk of a large table out and
+// back on demand; resident memory is whatever the page cache keeps.
+//
+// The file holds an open-addressing table (linear probing, backward-shift
+// deletion, at most 3/4 full) and a FIFO of demotions kept in last-seen
+// order: sessions are demoted oldest first, and the rare one older than the
+// tail (adopted or replicated with an old last-seen time) is inserted at its
+// place. Expiry and oldest-first walks read it from the front; entries whose
+// session was promoted, removed or demoted again since are skipped as stale
+// and compacted away when the FIFO fills up.
+//
+// The file is recreated on start: last-seen times are steady-clock values
+// that mean nothing to another process. Not thread-safe, like SessionTable.
+class ColdTier {
+public:
+    // slots is rounded up to a power of two; the file is sparse
+    ColdTier(std::string path, uint64_t slots);
+    ~ColdTier();
+
+    ColdTier(const ColdTier&) = delete;
+    ColdTier& operator=(const ColdTier&) = delete;
+
+    bool ok() const { return base_ != nullptr; }
+    const std::string &path() const { return path_; }
+    uint64_t slots() const { return mask_ + 1; }
+    size_t size() const { return size_; }
+
+    // false if the key is already present or the tier is full
+    bool put(uint64_t key, int64_t last_seen_ns);
+    bool contains(uint64_t key) const;
+    // removes the session and returns its last-seen time
+    bool take(uint64_t key, int64_t &last_seen_ns);
+    bool erase(uint64_t key);
+
+    // oldest session still in the tier, skipping stale FIFO entries
+    bool oldest(uint64_t &key, int64_t &last_seen_ns);
+
+    // visit sessions oldest first, f(key, last_seen_ns) returns false to stop
+    template <typename F>
+    void for_each(F &&f) const {
+        for (uint64_t i = fifo_head_; i != fifo_tail_; ++i) {
+            const Entry &e = fifo_[i & mask_];
+            int64_t ts;
+            if (find(e.key, ts) && ts == e.last_seen_ns && !f(e.key, e.last_seen_ns)) return;
+        }
+    }
+
+private:
+    struct Entry {
+        uint64_t key;          // 0 = empty slot
+        int64_t last_seen_ns;
+    };
+
+    uint64_t home(uint64_t key) const;
+    bool find(uint64_t key, int64_t &last_seen_ns) const;
+    uint64_t slot_of(uint64_t key) const; // slots() if absent
+    void remove_slot(uint64_t i);
+    void compact_fifo();
+
+    std::string path_;
+    void *base_ = nullptr;
+    size_t len_ = 0;
+    Entry *table_ = nullptr;
+    Entry *fifo_ = nullptr;
+    uint64_t mask_ = 0;
+    size_t size_ = 0;
+    uint64_t fifo_head_ = 0;
+    uint64_t fifo_tail_ = 0;
+};
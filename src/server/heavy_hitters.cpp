@@ -0,0 +1,241 @@
+#include "heavy_hitters.h"
+
+#include "imsi_to_bcd.h"
+
+#include <spdlog/spdlog.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <algorithm>
+#include <unordered_map>
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+SpaceSaving::SpaceSaving(size_t k) : k_(k) {
+    heap_.reserve(k_);
+    uint64_t slots = 4;
+    while (slots < 2 * static_cast<uint64_t>(k_)) slots <<= 1;
+    slot_keys_.assign(slots, 0);
+    slot_pos_.assign(slots, 0);
+    mask_ = slots - 1;
+}
+
+uint32_t *SpaceSaving::lookup(uint64_t key) {
+    for (uint64_t i = mix(key) & mask_;; i = (i + 1) & mask_) {
+        if (slot_keys_[i] == key) return &slot_pos_[i];
+        if (slot_keys_[i] == 0) return nullptr;
+    }
+}
+
+void SpaceSaving::index_put(uint64_t key, uint32_t pos) {
+    uint64_t i = mix(key) & mask_;
+    while (slot_keys_[i] != 0 && slot_keys_[i] != key) i = (i + 1) & mask_;
+    slot_keys_[i] = key;
+    slot_pos_[i] = pos;
+}
+
+void SpaceSaving::index_erase(uint64_t key) {
+    uint64_t i = mix(key) & mask_;
+    while (slot_keys_[i] != key) {
+        if (slot_keys_[i] == 0) return;
+        i = (i + 1) & mask_;
+    }
+    // backward-shift deletion keeps probe chains intact without tombstones
+    for (uint64_t j = (i + 1) & mask_; slot_keys_[j] != 0; j = (j + 1) & mask_) {
+        uint64_t home = mix(slot_keys_[j]) & mask_;
+        if (((j - home) & mask_) >= ((j - i) & mask_)) {
+            slot_keys_[i] = slot_keys_[j];
+            slot_pos_[i] = slot_pos_[j];
+            i = j;
+        }
+    }
+    slot_keys_[i] = 0;
+}
+
+void SpaceSaving::place(size_t i, const Entry &e) {
+    heap_[i] = e;
+    *lookup(e.key) = static_cast<uint32_t>(i);
+}
+
+void SpaceSaving::sift_down(size_t i) {
+    Entry e = heap_[i];
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= heap_.size()) break;
+        if (c + 1 < heap_.size() && heap_[c + 1].count < heap_[c].count) ++c;
+        if (heap_[c].count >= e.count) break;
+        place(i, heap_[c]);
+        i = c;
+    }
+    place(i, e);
+}
+
+void SpaceSaving::add(uint64_t key, uint64_t n) {
+    if (k_ == 0 || key == 0) return;
+    total_ += n;
+    if (uint32_t *pos = lookup(key)) {
+        size_t i = *pos;
+        heap_[i].count += n;
+        sift_down(i); // counts only grow, so an entry only moves towards the leaves
+        return;
+    }
+    if (heap_.size() < k_) {
+        // n can be below counts already tracked, so sift up from the end
+        size_t i = heap_.size();
+        heap_.push_back({key, n, 0});
+        index_put(key, static_cast<uint32_t>(i));
+        while (i > 0) {
+            size_t parent = (i - 1) / 2;
+            if (heap_[parent].count <= heap_[i].count) break;
+            Entry e = heap_[i];
+            place(i, heap_[parent]);
+            place(parent, e);
+            i = parent;
+        }
+        return;
+    }
+    // replace the smallest counter
+    Entry &min = heap_[0];
+    index_erase(min.key);
+    Entry e{key, min.count + n, min.count};
+    index_put(key, 0);
+    heap_[0] = e;
+    sift_down(0);
+}
+
+void SpaceSaving::clear() {
+    heap_.clear();
+    std::fill(slot_keys_.begin(), slot_keys_.end(), 0);
+    total_ = 0;
+}
+
+std::vector<SpaceSaving::Entry> SpaceSaving::top() const {
+    std::vector<Entry> out(heap_);
+    std::sort(out.begin(), out.end(), [](const Entry &a, const Entry &b) { return a.count > b.count; });
+    return out;
+}
+
+static constexpr int slots_per_window = 10;
+
+static std::string imsi_name(uint64_t key) {
+    return unpack_imsi(key);
+}
+
+static std::string peer_name(uint64_t key) {
+    in_addr a{};
+    a.s_addr = static_cast<uint32_t>(key);
+    char buf[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &a, buf, sizeof(buf));
+    return buf;
+}
+
+HeavyHitters::HeavyHitters(Options opts)
+    : opts_(opts),
+      slot_(std::max<std::chrono::milliseconds>(std::chrono::seconds(1), opts.window / slots_per_window)),
+      imsis_(opts.top),
+      peers_(opts.top) {
+    if (enabled()) ring_.resize(slots(opts_.window));
+}
+
+size_t HeavyHitters::slots(std::chrono::seconds window) const {
+    auto n = (std::chrono::milliseconds(window) + slot_ - std::chrono::milliseconds(1)) / slot_;
+    return std::max<size_t>(1, static_cast<size_t>(n));
+}
+
+void HeavyHitters::rotate(time_point now) {
+    if (!enabled()) return;
+    if (!started_) {
+        started_ = true;
+        slot_start_ = now;
+        return;
+    }
+    auto elapsed = static_cast<size_t>((now - slot_start_) / slot_);
+    slot_start_ += elapsed * slot_;
+
+    Slot s;
+    s.imsis = imsis_.top();
+    s.peers = peers_.top();
+    s.imsi_total = imsis_.total();
+    s.peer_total = peers_.total();
+    imsis_.clear();
+    peers_.clear();
+    if (opts_.alert_share > 0) {
+        alert("IMSI", s.imsis, s.imsi_total, imsi_name);
+        alert("source", s.peers, s.peer_total, peer_name);
+    }
+
+    std::lock_guard<std::mutex> lk(m_);
+    ring_[published_++ % ring_.size()] = std::move(s);
+    // quiet slots in between (no datagrams, no tick) are published empty
+    for (size_t i = 1; i < std::min(elapsed, ring_.size() + 1); ++i) ring_[published_++ % ring_.size()] = Slot{};
+}
+
+void HeavyHitters::alert(const char *kind, const std::vector<SpaceSaving::Entry> &top, uint64_t total,
+                         std::string (*name_of)(uint64_t)) const {
+    if (top.empty() || total == 0) return;
+    double share = static_cast<double>(top[0].count - top[0].error) / static_cast<double>(total);
+    if (share <= opts_.alert_share) return;
+    spdlog::warn("Heavy hitter: {} {} sent at least {:.0f}% of {} datagrams in {} ms",
+                 kind, name_of(top[0].key), share * 100.0, total, slot_.count());
+}
+
+// sums one key kind over the newest n slots; a key's count is summed over
+// the slots where it made the top-k, `guaranteed` is the matching lower bound
+static nlohmann::json merge_slots(const std::vector<const std::vector<SpaceSaving::Entry>*> &slots,
+                                  uint64_t total, size_t limit, std::string (*name_of)(uint64_t)) {
+    struct Merged {
+        uint64_t count = 0;
+        uint64_t guaranteed = 0;
+    };
+    std::unordered_map<uint64_t, Merged> keys;
+    for (const auto *entries : slots) {
+        for (const auto &e : *entries) {
+            auto &m = keys[e.key];
+            m.count += e.count;
+            m.guaranteed += e.count - e.error;
+        }
+    }
+    std::vector<std::pair<uint64_t, Merged>> sorted(keys.begin(), keys.end());
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+        return a.second.count != b.second.count ? a.second.count > b.second.count : a.first < b.first;
+    });
+    nlohmann::json top = nlohmann::json::array();
+    for (size_t i = 0; i < sorted.size() && i < limit; ++i) {
+        const Merged &m = sorted[i].second;
+        top.push_back({
+            {"key", name_of(sorted[i].first)},
+            {"count", m.count},
+            {"guaranteed", m.guaranteed},
+            {"share", total ? static_cast<double>(m.count) / static_cast<double>(total) : 0.0}
+        });
+    }
+    return {{"total", total}, {"top", std::move(top)}};
+}
+
+nlohmann::json HeavyHitters::json(std::chrono::seconds window, size_t limit) const {
+    nlohmann::json j;
+    j["enabled"] = enabled();
+    if (!enabled()) return j;
+
+    std::lock_guard<std::mutex> lk(m_);
+    size_t n = std::min({slots(window), ring_.size(), published_});
+    std::vector<const std::vector<SpaceSaving::Entry>*> imsis, peers;
+    uint64_t imsi_total = 0, peer_total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const Slot &s = ring_[(published_ - 1 - i) % ring_.size()];
+        imsis.push_back(&s.imsis);
+        peers.push_back(&s.peers);
+        imsi_total += s.imsi_total;
+        peer_total += s.peer_total;
+    }
+    j["window_sec"] = std::chrono::duration<double>(slot_ * n).count();
+    j["slot_ms"] = slot_.count();
+    j["imsis"] = merge_slots(imsis, imsi_total, limit, imsi_name);
+    j["sources"] = merge_slots(peers, peer_total, limit, peer_name);
+    return j;
+}
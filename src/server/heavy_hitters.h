@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+// Space-Saving top-k counter over uint64 keys (0 is reserved). Fixed memory:
+// k counters in a min-heap by count plus an open-addressing index, no
+// allocation after construction. A key that is not tracked replaces the
+// smallest counter and inherits its count as the error bound, so every key
+// seen more than total/k times is guaranteed to be in the table and
+// count - error <= true count <= count.
+class SpaceSaving {
+public:
+    struct Entry {
+        uint64_t key = 0;
+        uint64_t count = 0;
+        uint64_t error = 0;
+    };
+
+    explicit SpaceSaving(size_t k);
+
+    void add(uint64_t key, uint64_t n = 1);
+    void clear();
+
+    size_t capacity() const { return k_; }
+    uint64_t total() const { return total_; }
+
+    // tracked keys, largest count first
+    std::vector<Entry> top() const;
+
+private:
+    uint32_t *lookup(uint64_t key);
+    void index_put(uint64_t key, uint32_t pos);
+    void index_erase(uint64_t key);
+    void sift_down(size_t i);
+    void place(size_t i, const Entry &e);
+
+    size_t k_;
+    uint64_t total_ = 0;
+    std::vector<Entry> heap_;
+    std::vector<uint64_t> slot_keys_; // index: key -> heap position, linear probing
+    std::vector<uint32_t> slot_pos_;
+    uint64_t mask_ = 0;
+};
+
+// Busiest IMSIs and source addresses over a sliding window, to tell a
+// looping UE or a misbehaving SGW from genuine growth.
+//
+// The UDP loop feeds the current slot (window / 10, at least a second) with
+// no locking; when a slot ends its top-k summary is published under a mutex
+// into a ring covering the window. Queries merge the published slots, so
+// they lag by at most one slot; a key that made the top-k in only some
+// slots is counted for those.
+class HeavyHitters {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    struct Options {
+        size_t top = 0;                     // counters per slot and key kind, 0 = off
+        std::chrono::seconds window{60};
+        double alert_share = 0;             // warn when one key exceeds this share of a slot, 0 = off
+    };
+
+    explicit HeavyHitters(Options opts);
+
+    bool enabled() const { return opts_.top > 0; }
+    std::chrono::seconds window() const { return opts_.window; }
+    std::chrono::milliseconds slot() const { return slot_; }
+
+    // UDP loop only
+    void add_peer(uint32_t ip, time_point now) { tick(now); peers_.add(static_cast<uint64_t>(ip) | (1ull << 32)); }
+    void add_imsi(uint64_t packed) { if (packed) imsis_.add(packed); }
+    // closes the current slot once it has run its length
+    void tick(time_point now) {
+        if (!started_ || now - slot_start_ >= slot_) rotate(now);
+    }
+
+    // any thread: up to `limit` keys of each kind over the last `window`
+    nlohmann::json json(std::chrono::seconds window, size_t limit) const;
+
+private:
+    struct Slot {
+        std::vector<SpaceSaving::Entry> imsis, peers;
+        uint64_t imsi_total = 0, peer_total = 0;
+    };
+
+    // slots covering `window`, at least one
+    size_t slots(std::chrono::seconds window) const;
+    void rotate(time_point now);
+    void alert(const char *kind, const std::vector<SpaceSaving::Entry> &top, uint64_t total,
+               std::string (*name_of)(uint64_t)) const;
+
+    Options opts_;
+    std::chrono::milliseconds slot_;
+    SpaceSaving imsis_;
+    SpaceSaving peers_;
+    time_point slot_start_{};
+    bool started_ = false;
+
+    mutable std::mutex m_;
+    std::vector<Slot> ring_;  // guarded by m_
+    size_t published_ = 0;    // slots published so far; ring_[(published_ - 1) % size] is the newest
+};
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <array>
+#include <cstdint>
+
+// std::mutex that keeps wait and hold times. An uncontended lock() costs a
+// try_lock and one clock read; only contended acquisitions time the wait.
+// Counters are updated by the lock holder, so plain relaxed stores suffice
+// and readers (stats()) never touch the mutex itself.
+class InstrumentedMutex {
+public:
+    // wait histogram upper bounds: 1us, 4us, 16us, 64us, 256us, 1ms, 4ms, more
+    static constexpr size_t buckets = 8;
+
+    struct Stats {
+        uint64_t acquisitions = 0;
+        uint64_t contended = 0;
+        uint64_t wait_ns = 0;
+        uint64_t max_wait_ns = 0;
+        uint64_t hold_ns = 0;
+        uint64_t max_hold_ns = 0;
+        std::array<uint64_t, buckets> wait_histogram{};
+    };
+
+    void lock() {
+        if (m_.try_lock()) {
+            acquired_ns_ = now_ns();
+        } else {
+            int64_t t0 = now_ns();
+            m_.lock();
+            acquired_ns_ = now_ns();
+            record_wait(static_cast<uint64_t>(acquired_ns_ - t0));
+        }
+        bump(acquisitions_, 1);
+    }
+
+    bool try_lock() {
+        if (!m_.try_lock()) return false;
+        acquired_ns_ = now_ns();
+        bump(acquisitions_, 1);
+        return true;
+    }
+
+    void unlock() {
+        uint64_t held = static_cast<uint64_t>(now_ns() - acquired_ns_);
+        bump(hold_ns_, held);
+        if (held > max_hold_ns_.load(std::memory_order_relaxed)) max_hold_ns_.store(held, std::memory_order_relaxed);
+        m_.unlock();
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+        s.contended = contended_.load(std::memory_order_relaxed);
+        s.wait_ns = wait_ns_.load(std::memory_order_relaxed);
+        s.max_wait_ns = max_wait_ns_.load(std::memory_order_relaxed);
+        s.hold_ns = hold_ns_.load(std::memory_order_relaxed);
+        s.max_hold_ns = max_hold_ns_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < buckets; ++i) s.wait_histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // only the holder writes, a load/store pair is enough
+    static void bump(std::atomic<uint64_t> &a, uint64_t v) {
+        a.store(a.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+    void record_wait(uint64_t ns) {
+        bump(contended_, 1);
+        bump(wait_ns_, ns);
+        if (ns > max_wait_ns_.load(std::memory_order_relaxed)) max_wait_ns_.store(ns, std::memory_order_relaxed);
+        size_t b = 0;
+        for (uint64_t limit = 1000; b + 1 < buckets && ns >= limit; limit *= 4) ++b;
+        bump(histogram_[b], 1);
+    }
+
+    std::mutex m_;
+    int64_t acquired_ns_ = 0; // valid while held
+    std::atomic<uint64_t> acquisitions_{0};
+    std::atomic<uint64_t> contended_{0};
+    std::atomic<uint64_t> wait_ns_{0};
+    std::atomic<uint64_t> max_wait_ns_{0};
+    std::atomic<uint64_t> hold_ns_{0};
+    std::atomic<uint64_t> max_hold_ns_{0};
+    std::array<std::atomic<uint64_t>, buckets> histogram_{};
+};
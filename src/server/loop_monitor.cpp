@@ -0,0 +1,139 @@
+#include "loop_monitor.h"
+
+#include <spdlog/spdlog.h>
+
+LoopMonitor::LoopMonitor(std::string name) : name_(std::move(name)), phase_start_ns_(now_ns()) {}
+
+int64_t LoopMonitor::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// single writer: the loop thread
+void LoopMonitor::busy() {
+    if (busy_.load(std::memory_order_relaxed)) return;
+    int64_t now = now_ns();
+    int64_t start = phase_start_ns_.load(std::memory_order_relaxed);
+    idle_ns_.store(idle_ns_.load(std::memory_order_relaxed) + static_cast<uint64_t>(now - start),
+                   std::memory_order_relaxed);
+    phase_start_ns_.store(now, std::memory_order_relaxed);
+    busy_.store(true, std::memory_order_release);
+}
+
+void LoopMonitor::idle() {
+    if (!busy_.load(std::memory_order_relaxed)) return;
+    int64_t now = now_ns();
+    uint64_t d = static_cast<uint64_t>(now - phase_start_ns_.load(std::memory_order_relaxed));
+    busy_ns_.store(busy_ns_.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+    last_busy_ns_.store(d, std::memory_order_relaxed);
+    if (d > max_busy_ns_.load(std::memory_order_relaxed)) max_busy_ns_.store(d, std::memory_order_relaxed);
+    iterations_.store(iterations_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    phase_start_ns_.store(now, std::memory_order_relaxed);
+    busy_.store(false, std::memory_order_release);
+}
+
+LoopMonitor::Snapshot LoopMonitor::snapshot() const {
+    Snapshot s;
+    bool busy = busy_.load(std::memory_order_acquire);
+    int64_t start = phase_start_ns_.load(std::memory_order_relaxed);
+    s.busy_ns = busy_ns_.load(std::memory_order_relaxed);
+    s.idle_ns = idle_ns_.load(std::memory_order_relaxed);
+    s.iterations = iterations_.load(std::memory_order_relaxed);
+    s.last_busy_ns = last_busy_ns_.load(std::memory_order_relaxed);
+    s.max_busy_ns = max_busy_ns_.load(std::memory_order_relaxed);
+    s.busy_since_ns = busy ? start : 0;
+    return s;
+}
+
+Watchdog::Watchdog(std::chrono::milliseconds stall_threshold) : threshold_(stall_threshold) {}
+
+Watchdog::~Watchdog() {
+    stop();
+}
+
+void Watchdog::watch(const LoopMonitor *m) {
+    std::lock_guard<std::mutex> lk(m_);
+    Watched w;
+    w.m = m;
+    w.window_start = m->snapshot();
+    w.window_start_ns = LoopMonitor::now_ns();
+    loops_.push_back(w);
+}
+
+void Watchdog::start() {
+    std::lock_guard<std::mutex> lk(m_);
+    if (thread_.joinable()) return;
+    stop_ = false;
+    thread_ = std::thread(&Watchdog::run, this);
+}
+
+void Watchdog::stop() {
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void Watchdog::run() {
+    try {
+        std::unique_lock<std::mutex> lk(m_);
+        while (!cv_.wait_for(lk, std::chrono::milliseconds(100), [this]() { return stop_; })) {
+            int64_t now = LoopMonitor::now_ns();
+            for (auto &w : loops_) sample(w, now);
+        }
+    } catch (const std::exception &e) {
+        spdlog::error("Exception in watchdog thread: {}", e.what());
+    }
+}
+
+// called with m_ held
+void Watchdog::sample(Watched &w, int64_t now) {
+    LoopMonitor::Snapshot s = w.m->snapshot();
+
+    if (threshold_.count() > 0 && s.busy_since_ns != 0) {
+        int64_t busy_ms = (now - s.busy_since_ns) / 1000000;
+        if (busy_ms >= threshold_.count() && w.reported_phase != s.busy_since_ns) {
+            w.reported_phase = s.busy_since_ns;
+            w.stalls++;
+            stalls_++;
+            spdlog::warn("Watchdog: {} loop stalled for {} ms", w.m->name(), busy_ms);
+        }
+    } else if (w.reported_phase != 0) {
+        spdlog::info("Watchdog: {} loop recovered after {} ms", w.m->name(), s.last_busy_ns / 1000000);
+        w.reported_phase = 0;
+    }
+
+    // utilisation over ~1 s windows, counting the running busy phase
+    if (now - w.window_start_ns >= 1000000000LL) {
+        auto running = [&](const LoopMonitor::Snapshot &x, int64_t at) {
+            return x.busy_since_ns ? static_cast<uint64_t>(at - x.busy_since_ns) : 0;
+        };
+        uint64_t busy = (s.busy_ns + running(s, now)) - (w.window_start.busy_ns + running(w.window_start, w.window_start_ns));
+        uint64_t total = static_cast<uint64_t>(now - w.window_start_ns);
+        w.utilisation = total ? std::min(1.0, static_cast<double>(busy) / static_cast<double>(total)) : 0.0;
+        w.window_start = s;
+        w.window_start_ns = now;
+    }
+}
+
+nlohmann::json Watchdog::json() const {
+    std::lock_guard<std::mutex> lk(m_);
+    nlohmann::json j = nlohmann::json::object();
+    int64_t now = LoopMonitor::now_ns();
+    for (const auto &w : loops_) {
+        LoopMonitor::Snapshot s = w.m->snapshot();
+        j[w.m->name()] = {
+            {"utilisation", w.utilisation},
+            {"busy_ms", s.busy_ns / 1000000},
+            {"idle_ms", s.idle_ns / 1000000},
+            {"iterations", s.iterations},
+            {"last_busy_us", s.last_busy_ns / 1000},
+            {"max_busy_us", s.max_busy_ns / 1000},
+            {"busy_now_ms", s.busy_since_ns ? (now - s.busy_since_ns) / 1000000 : 0},
+            {"stalls", w.stalls}
+        };
+    }
+    return j;
+}
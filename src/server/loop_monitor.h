@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+// Busy/idle accounting for one event loop. The loop itself calls busy() when
+// it leaves its wait (recvmsg, sleep) and idle() when it goes back to it;
+// both are a clock read and a few relaxed stores on the loop's own counters.
+class LoopMonitor {
+public:
+    struct Snapshot {
+        uint64_t busy_ns = 0;
+        uint64_t idle_ns = 0;
+        uint64_t iterations = 0;
+        uint64_t last_busy_ns = 0;
+        uint64_t max_busy_ns = 0;
+        int64_t busy_since_ns = 0; // start of the running busy phase, 0 while idle
+    };
+
+    explicit LoopMonitor(std::string name);
+
+    const std::string &name() const { return name_; }
+
+    void busy();
+    void idle();
+
+    Snapshot snapshot() const;
+
+    static int64_t now_ns();
+
+private:
+    std::string name_;
+    std::atomic<int64_t> phase_start_ns_;
+    std::atomic<bool> busy_{false};
+    std::atomic<uint64_t> busy_ns_{0};
+    std::atomic<uint64_t> idle_ns_{0};
+    std::atomic<uint64_t> iterations_{0};
+    std::atomic<uint64_t> last_busy_ns_{0};
+    std::atomic<uint64_t> max_busy_ns_{0};
+};
+
+// Samples the watched loops every 100 ms: utilisation over the last second
+// and a warning when a loop has been busy longer than stall_ms without
+// getting back to its wait.
+class Watchdog {
+public:
+    explicit Watchdog(std::chrono::milliseconds stall_threshold);
+    ~Watchdog();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator=(const Watchdog&) = delete;
+
+    // monitors must outlive the watchdog; call before start()
+    void watch(const LoopMonitor *m);
+
+    void start();
+    void stop();
+
+    uint64_t stalls() const { return stalls_.load(); }
+    nlohmann::json json() const;
+
+private:
+    struct Watched {
+        const LoopMonitor *m;
+        LoopMonitor::Snapshot window_start;
+        int64_t window_start_ns = 0;
+        double utilisation = 0.0;
+        int64_t reported_phase = 0; // busy_since_ns of the stall already logged
+        uint64_t stalls = 0;
+    };
+
+    void run();
+    void sample(Watched &w, int64_t now);
+
+    std::chrono::milliseconds threshold_;
+    std::vector<Watched> loops_;
+    mutable std::mutex m_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+    std::atomic<uint64_t> stalls_{0};
+};
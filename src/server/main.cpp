@@ -47,6 +47,65 @@ Config load_config_from_file(const std::string &path) {
         if (j.contains("graceful_shutdown_rate")) cfg.graceful_shutdown_rate = j["graceful_shutdown_rate"].get<int>();
         if (j.contains("log_file")) cfg.log_file = j["log_file"].get<std::string>();
         if (j.contains("log_level")) cfg.log_level = j["log_level"].get<std::string>();
+        if (j.contains("max_sessions")) cfg.max_sessions = j["max_sessions"].get<size_t>();
+        if (j.contains("capacity_policy")) cfg.capacity_policy = j["capacity_policy"].get<std::string>();
+        if (j.contains("udp_rcvbuf_bytes")) cfg.udp_rcvbuf_bytes = j["udp_rcvbuf_bytes"].get<int>();
+        if (j.contains("rate_limit_pps")) cfg.rate_limit_pps = j["rate_limit_pps"].get<uint32_t>();
+        if (j.contains("rate_limit_burst")) cfg.rate_limit_burst = j["rate_limit_burst"].get<uint32_t>();
+        if (j.contains("rate_limit_table_size")) cfg.rate_limit_table_size = j["rate_limit_table_size"].get<size_t>();
+        if (j.contains("overload_lag_ms")) cfg.overload_lag_ms = j["overload_lag_ms"].get<int>();
+        if (j.contains("overload_action")) cfg.overload_action = j["overload_action"].get<std::string>();
+        if (j.contains("retransmit_cache_ms")) cfg.retransmit_cache_ms = j["retransmit_cache_ms"].get<uint32_t>();
+        if (j.contains("retransmit_cache_size")) cfg.retransmit_cache_size = j["retransmit_cache_size"].get<size_t>();
+        if (j.contains("cdr_index_segment_bytes")) cfg.cdr_index_segment_bytes = j["cdr_index_segment_bytes"].get<uint64_t>();
+        if (j.contains("session_shm_name")) cfg.session_shm_name = j["session_shm_name"].get<std::string>();
+        if (j.contains("session_shm_slots")) cfg.session_shm_slots = j["session_shm_slots"].get<uint64_t>();
+        if (j.contains("trace_ring_size")) cfg.trace_ring_size = j["trace_ring_size"].get<size_t>();
+        if (j.contains("cold_tier_file")) cfg.cold_tier_file = j["cold_tier_file"].get<std::string>();
+        if (j.contains("cold_tier_idle_sec")) cfg.cold_tier_idle_sec = j["cold_tier_idle_sec"].get<int>();
+        if (j.contains("cold_tier_slots")) cfg.cold_tier_slots = j["cold_tier_slots"].get<uint64_t>();
+        if (j.contains("status_udp_port")) cfg.status_udp_port = j["status_udp_port"].get<int>();
+        if (j.contains("status_threads")) cfg.status_threads = j["status_threads"].get<int>();
+        if (j.contains("watchdog_stall_ms")) cfg.watchdog_stall_ms = j["watchdog_stall_ms"].get<int>();
+        if (j.contains("capture_file")) cfg.capture_file = j["capture_file"].get<std::string>();
+        if (j.contains("capture_buffer_bytes")) cfg.capture_buffer_bytes = j["capture_buffer_bytes"].get<size_t>();
+        if (j.contains("adaptive_timeout_min_sec")) cfg.adaptive_timeout_min_sec = j["adaptive_timeout_min_sec"].get<int>();
+        if (j.contains("adaptive_min_refreshes")) cfg.adaptive_min_refreshes = j["adaptive_min_refreshes"].get<uint32_t>();
+        if (j.contains("adaptive_occupancy_low")) cfg.adaptive_occupancy_low = j["adaptive_occupancy_low"].get<double>();
+        if (j.contains("adaptive_occupancy_high")) cfg.adaptive_occupancy_high = j["adaptive_occupancy_high"].get<double>();
+        if (j.contains("adaptive_memory_low_mb")) cfg.adaptive_memory_low_mb = j["adaptive_memory_low_mb"].get<uint64_t>();
+        if (j.contains("adaptive_memory_high_mb")) cfg.adaptive_memory_high_mb = j["adaptive_memory_high_mb"].get<uint64_t>();
+        if (j.contains("capture_max_bytes")) cfg.capture_max_bytes = j["capture_max_bytes"].get<uint64_t>();
+        if (j.contains("expected_sessions")) cfg.expected_sessions = j["expected_sessions"].get<size_t>();
+        if (j.contains("huge_pages")) cfg.huge_pages = j["huge_pages"].get<std::string>();
+        if (j.contains("prefault")) cfg.prefault = j["prefault"].get<bool>();
+        if (j.contains("heavy_hitters_top")) cfg.heavy_hitters_top = j["heavy_hitters_top"].get<size_t>();
+        if (j.contains("heavy_hitters_window_sec")) cfg.heavy_hitters_window_sec = j["heavy_hitters_window_sec"].get<int>();
+        if (j.contains("heavy_hitters_alert_share")) cfg.heavy_hitters_alert_share = j["heavy_hitters_alert_share"].get<double>();
+        if (j.contains("events_buffer")) cfg.events_buffer = j["events_buffer"].get<size_t>();
+        if (j.contains("xdp_interface")) cfg.xdp_interface = j["xdp_interface"].get<std::string>();
+        if (j.contains("xdp_queue")) cfg.xdp_queue = j["xdp_queue"].get<uint32_t>();
+        if (j.contains("xdp_mode")) cfg.xdp_mode = j["xdp_mode"].get<std::string>();
+        if (j.contains("xdp_frames")) cfg.xdp_frames = j["xdp_frames"].get<uint32_t>();
+        if (j.contains("expiry_max_per_tick")) cfg.expiry_max_per_tick = j["expiry_max_per_tick"].get<size_t>();
+        if (j.contains("expiry_budget_ms")) cfg.expiry_budget_ms = j["expiry_budget_ms"].get<int>();
+        if (j.contains("max_streams")) cfg.max_streams = j["max_streams"].get<size_t>();
+        if (j.contains("cluster_node_id")) cfg.cluster_node_id = j["cluster_node_id"].get<std::string>();
+        if (j.contains("cluster_members")) {
+            for (auto &m : j["cluster_members"]) cfg.cluster_members.push_back(cluster_member_from_json(m));
+        }
+        if (j.contains("cluster_mode")) cfg.cluster_mode = j["cluster_mode"].get<std::string>();
+        if (j.contains("cluster_vnodes")) cfg.cluster_vnodes = j["cluster_vnodes"].get<int>();
+        if (j.contains("cluster_forward_timeout_ms")) cfg.cluster_forward_timeout_ms = j["cluster_forward_timeout_ms"].get<int>();
+        if (j.contains("cluster_batch")) cfg.cluster_batch = j["cluster_batch"].get<size_t>();
+        if (j.contains("replication_role")) cfg.replication_role = j["replication_role"].get<std::string>();
+        if (j.contains("replication_peer")) cfg.replication_peer = j["replication_peer"].get<std::string>();
+        if (j.contains("replication_port")) cfg.replication_port = j["replication_port"].get<int>();
+        if (j.contains("replication_queue")) cfg.replication_queue = j["replication_queue"].get<size_t>();
+        if (j.contains("replication_batch_ms")) cfg.replication_batch_ms = j["replication_batch_ms"].get<int>();
+        if (j.contains("replication_takeover_ms")) cfg.replication_takeover_ms = j["replication_takeover_ms"].get<int>();
+        if (j.contains("migration_peer")) cfg.migration_peer = j["migration_peer"].get<std::string>();
+        if (j.contains("migration_batch")) cfg.migration_batch = j["migration_batch"].get<size_t>();
         if (j.contains("blacklist")) {
             for (auto &v : j["blacklist"]) cfg.blacklist.push_back(v.get<std::string>());
         }
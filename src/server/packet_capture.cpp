@@ -0,0 +1,154 @@
+#include "packet_capture.h"
+
+#include <spdlog/spdlog.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+
+// records sit in the ring 16-byte aligned; a header with this length marks
+// the unused tail of the ring before a record that did not fit
+static constexpr uint16_t ring_pad = 0xFFFF;
+static constexpr size_t ring_align = 16;
+
+PacketCapture::PacketCapture(std::string path, size_t buffer_bytes, uint64_t max_bytes)
+    : path_(std::move(path)), max_bytes_(max_bytes) {
+    size_t cap = 64 * 1024;
+    while (cap < buffer_bytes) cap <<= 1;
+    ring_ = std::make_unique<uint8_t[]>(cap);
+    mask_ = cap - 1;
+
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        spdlog::error("Failed to open capture file '{}': {}", path_, strerror(errno));
+        return;
+    }
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    CaptureFileHeader hdr{};
+    std::memcpy(hdr.magic, capture_magic, sizeof(capture_magic));
+    hdr.version = capture_version;
+    hdr.start_ns = now.tv_sec * 1000000000LL + now.tv_nsec;
+    if (!write_all(reinterpret_cast<const uint8_t*>(&hdr), sizeof(hdr))) {
+        ::close(fd_);
+        fd_ = -1;
+        return;
+    }
+    bytes_.store(sizeof(hdr), std::memory_order_relaxed);
+    writer_ = std::thread(&PacketCapture::writer_loop, this);
+    spdlog::info("Capturing received datagrams to '{}' ({} byte buffer)", path_, cap);
+}
+
+PacketCapture::~PacketCapture() {
+    close();
+}
+
+void PacketCapture::append(int64_t ts_ns, uint32_t src_ip, uint16_t src_port, const uint8_t *data, size_t len) {
+    if (closing_.load(std::memory_order_relaxed) || limit_reached_.load(std::memory_order_relaxed)) return;
+    const size_t cap = mask_ + 1;
+    const size_t need = (sizeof(CaptureRecordHeader) + len + ring_align - 1) & ~(ring_align - 1);
+    if (len >= ring_pad || need > cap / 2) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    size_t off = tail & mask_;
+    size_t pad = off + need > cap ? cap - off : 0;
+    if (tail + pad + need - head_.load(std::memory_order_acquire) > cap) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    if (pad) {
+        CaptureRecordHeader marker{0, 0, 0, ring_pad};
+        std::memcpy(&ring_[off], &marker, sizeof(marker));
+        tail += pad;
+        off = 0;
+    }
+    CaptureRecordHeader rec{ts_ns, src_ip, src_port, static_cast<uint16_t>(len)};
+    std::memcpy(&ring_[off], &rec, sizeof(rec));
+    std::memcpy(&ring_[off + sizeof(rec)], data, len);
+    tail_.store(tail + need, std::memory_order_release);
+}
+
+bool PacketCapture::drain(std::vector<uint8_t> &out) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    const uint64_t tail = tail_.load(std::memory_order_acquire);
+    if (head == tail) return false;
+    const size_t cap = mask_ + 1;
+    uint64_t written = bytes_.load(std::memory_order_relaxed);
+    uint64_t records = 0;
+    while (head != tail) {
+        size_t off = head & mask_;
+        CaptureRecordHeader rec;
+        std::memcpy(&rec, &ring_[off], sizeof(rec));
+        if (rec.len == ring_pad) {
+            head += cap - off;
+            continue;
+        }
+        size_t len = sizeof(rec) + rec.len;
+        if (max_bytes_ > 0 && written + out.size() + len > max_bytes_) {
+            if (!limit_reached_.exchange(true)) {
+                spdlog::warn("Capture file '{}' reached capture_max_bytes, capture stopped", path_);
+            }
+            head = tail;
+            break;
+        }
+        out.insert(out.end(), &ring_[off], &ring_[off] + len);
+        head += (len + ring_align - 1) & ~(ring_align - 1);
+        ++records;
+    }
+    head_.store(head, std::memory_order_release);
+    records_.store(records_.load(std::memory_order_relaxed) + records, std::memory_order_relaxed);
+    return true;
+}
+
+bool PacketCapture::write_all(const uint8_t *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            spdlog::error("Failed to write capture file '{}': {}", path_, strerror(errno));
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void PacketCapture::writer_loop() {
+    std::vector<uint8_t> batch;
+    batch.reserve(mask_ + 1);
+    for (;;) {
+        // read the flag first: whatever was published before close() is drained below
+        bool closing = closing_.load(std::memory_order_acquire);
+        batch.clear();
+        if (drain(batch)) {
+            if (!batch.empty()) {
+                if (!write_all(batch.data(), batch.size())) {
+                    limit_reached_ = true;
+                    return;
+                }
+                bytes_.store(bytes_.load(std::memory_order_relaxed) + batch.size(), std::memory_order_relaxed);
+            }
+            continue;
+        }
+        if (closing) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+void PacketCapture::close() {
+    if (closing_.exchange(true, std::memory_order_acq_rel)) return;
+    if (writer_.joinable()) writer_.join();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        spdlog::info("Capture '{}' closed: {} datagrams, {} bytes, {} dropped",
+                     path_, records(), bytes(), dropped());
+    }
+    fd_ = -1;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "capture.h"
+
+// Records received datagrams to a capture file (format in capture.h).
+//
+// append() runs on the UDP thread, the only producer: it copies the datagram
+// into a byte ring and publishes it with one release store, no lock and no
+// syscall. A background thread drains the ring to the file in large writes.
+// If the writer falls behind and the ring is full, the datagram is left out
+// of the capture and counted in dropped(); the UDP loop is never held up.
+class PacketCapture {
+public:
+    // buffer_bytes is rounded up to a power of two; max_bytes caps the file, 0 = no cap
+    PacketCapture(std::string path, size_t buffer_bytes, uint64_t max_bytes);
+    ~PacketCapture();
+
+    PacketCapture(const PacketCapture&) = delete;
+    PacketCapture& operator=(const PacketCapture&) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+    const std::string &path() const { return path_; }
+
+    // producer side, one thread only; src_ip and src_port in network order
+    void append(int64_t ts_ns, uint32_t src_ip, uint16_t src_port, const uint8_t *data, size_t len);
+
+    // writes out what is buffered and closes the file; later appends are ignored
+    void close();
+
+    uint64_t records() const { return records_.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    bool limit_reached() const { return limit_reached_.load(std::memory_order_relaxed); }
+
+private:
+    void writer_loop();
+    // moves published records from the ring into out, returns false if there were none
+    bool drain(std::vector<uint8_t> &out);
+    bool write_all(const uint8_t *data, size_t len);
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t max_bytes_;
+
+    std::unique_ptr<uint8_t[]> ring_;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<uint64_t> head_{0}; // consumer position
+    alignas(64) std::atomic<uint64_t> tail_{0}; // producer position
+    std::atomic<uint64_t> dropped_{0};
+
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<bool> limit_reached_{false};
+    std::atomic<bool> closing_{false};
+    std::thread writer_;
+};
@@ -0,0 +1,67 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+SourceRateLimiter::SourceRateLimiter(size_t table_size, uint32_t pps, uint32_t burst)
+    : slots_(round_up_pow2(std::max<size_t>(table_size, probe_window))),
+      mask_(slots_.size() - 1),
+      pps_(std::min(pps, max_pps)),
+      burst_milli_(std::max<uint32_t>(burst, 1) * 1000) {}
+
+bool SourceRateLimiter::allow(uint32_t addr, uint64_t now_ns) {
+    if (!enabled()) return true;
+    if (now_ns == 0) now_ns = 1;
+
+    Slot &s = lookup(addr);
+    if (s.last_ns == 0 || s.addr != addr) {
+        s.addr = addr;
+        s.tokens = burst_milli_;
+        s.last_ns = now_ns;
+    } else if (now_ns > s.last_ns) {
+        // cap elapsed time so the multiplication cannot overflow
+        uint64_t elapsed = std::min<uint64_t>(now_ns - s.last_ns, 1000000000000ull);
+        uint64_t refill = elapsed * pps_ / 1000000; // milli-tokens
+        if (s.tokens + refill >= burst_milli_) {
+            s.tokens = burst_milli_;
+            s.last_ns = now_ns;
+        } else if (refill > 0) {
+            // advance only by the time actually credited, so gaps shorter than
+            // one milli-token still add up for a fast sender
+            s.tokens = static_cast<uint32_t>(s.tokens + refill);
+            s.last_ns += refill * 1000000 / pps_;
+        }
+    }
+
+    if (s.tokens < 1000) return false;
+    s.tokens -= 1000;
+    return true;
+}
+
+size_t SourceRateLimiter::tracked() const {
+    return static_cast<size_t>(std::count_if(slots_.begin(), slots_.end(),
+                                             [](const Slot &s) { return s.last_ns != 0; }));
+}
+
+SourceRateLimiter::Slot &SourceRateLimiter::lookup(uint32_t addr) {
+    // fibonacci hashing spreads sequential addresses across the table
+    size_t h = static_cast<size_t>((static_cast<uint64_t>(addr) * 0x9E3779B97F4A7C15ull) >> 32) & mask_;
+    Slot *victim = nullptr;
+    for (size_t i = 0; i < probe_window; ++i) {
+        Slot &s = slots_[(h + i) & mask_];
+        if (s.last_ns != 0 && s.addr == addr) return s;
+        if (s.last_ns == 0) {
+            if (!victim || victim->last_ns != 0) victim = &s;
+        } else if (!victim || (victim->last_ns != 0 && s.last_ns < victim->last_ns)) {
+            victim = &s;
+        }
+    }
+    // no match: take the empty or stalest slot, allow() resets its bucket
+    victim->last_ns = 0;
+    return *victim;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Per-source token bucket over a fixed-size open-addressing table.
+// Each slot is 16 bytes; the table never grows, a source that does not fit
+// in its probe window takes over the stalest slot there. Only the UDP thread
+// touches it, so there is no locking.
+class SourceRateLimiter {
+public:
+    // pps == 0 disables limiting, pps is capped at 10M; table_size is rounded
+    // up to a power of two
+    SourceRateLimiter(size_t table_size, uint32_t pps, uint32_t burst);
+
+    bool enabled() const { return pps_ != 0; }
+
+    // addr is the IPv4 source address in network byte order,
+    // now_ns a monotonic timestamp in nanoseconds
+    bool allow(uint32_t addr, uint64_t now_ns);
+
+    size_t tracked() const;
+
+private:
+    struct Slot {
+        uint32_t addr = 0;
+        uint32_t tokens = 0; // milli-tokens
+        uint64_t last_ns = 0; // 0 = empty
+    };
+
+    static constexpr size_t probe_window = 8;
+    // elapsed ns (capped at 1e12) * pps must fit in 64 bits
+    static constexpr uint32_t max_pps = 10000000;
+
+    Slot &lookup(uint32_t addr);
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+    uint32_t pps_;
+    uint32_t burst_milli_;
+};
@@ -0,0 +1,444 @@
+#include "replication.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+static constexpr char frame_magic[4] = {'P', 'G', 'W', 'R'};
+static constexpr size_t max_frame_deltas = 4096;
+static constexpr int heartbeat_ms = 500;
+
+static void put_u32(std::string &out, uint32_t v) {
+    for (int s = 24; s >= 0; s -= 8) out.push_back(static_cast<char>((v >> s) & 0xFF));
+}
+
+static void put_u64(std::string &out, uint64_t v) {
+    for (int s = 56; s >= 0; s -= 8) out.push_back(static_cast<char>((v >> s) & 0xFF));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    return (static_cast<uint64_t>(get_u32(p)) << 32) | get_u32(p + 4);
+}
+
+static uint64_t wall_us() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+static int64_t steady_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t w = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += w;
+        len -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+// reads exactly len bytes; gives up when `running` drops or the peer goes away
+static bool recv_all(int fd, uint8_t *data, size_t len, const std::atomic<bool> &running) {
+    while (len > 0) {
+        ssize_t r = ::recv(fd, data, len, 0);
+        if (r == 0) return false;
+        if (r < 0) {
+            if ((errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) && running) continue;
+            return false;
+        }
+        data += r;
+        len -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+std::string encode_replication_frame(const ReplicationFrame &f) {
+    std::string ups = encode_session_batch(f.upserts);
+    std::string rms = encode_session_batch(f.removes);
+    std::string out;
+    out.reserve(replication_header_size + 8 + ups.size() + rms.size());
+    out.append(frame_magic, sizeof(frame_magic));
+    out.push_back(static_cast<char>(f.type));
+    put_u64(out, f.seq);
+    put_u64(out, f.sent_us);
+    put_u32(out, static_cast<uint32_t>(8 + ups.size() + rms.size()));
+    put_u32(out, static_cast<uint32_t>(ups.size()));
+    out += ups;
+    put_u32(out, static_cast<uint32_t>(rms.size()));
+    out += rms;
+    return out;
+}
+
+bool decode_replication_header(const uint8_t *hdr, ReplicationFrame &f, uint32_t &body_len) {
+    if (std::memcmp(hdr, frame_magic, sizeof(frame_magic)) != 0) return false;
+    f.type = hdr[4];
+    f.seq = get_u64(hdr + 5);
+    f.sent_us = get_u64(hdr + 13);
+    body_len = get_u32(hdr + 21);
+    return f.type >= ReplicationFrame::batch && f.type <= ReplicationFrame::heartbeat;
+}
+
+uint64_t replication_body_limit(uint8_t type, size_t max_sessions) {
+    // two length-prefixed batches: 9-byte header each, at most 1 + 8 + 4
+    // bytes per valid record
+    constexpr uint64_t framing = 8 + 2 * 9, per_record = 13;
+    if (type != ReplicationFrame::snapshot) return framing + per_record * max_frame_deltas;
+    uint64_t sessions = max_sessions != 0 ? max_sessions : 1u << 24;
+    return framing + per_record * sessions;
+}
+
+bool decode_replication_body(const std::string &body, ReplicationFrame &f) {
+    const auto *p = reinterpret_cast<const uint8_t*>(body.data());
+    if (body.size() < 4) return false;
+    uint32_t ups_len = get_u32(p);
+    if (4 + static_cast<size_t>(ups_len) + 4 > body.size()) return false;
+    uint32_t rms_len = get_u32(p + 4 + ups_len);
+    if (8 + static_cast<size_t>(ups_len) + rms_len != body.size()) return false;
+    return decode_session_batch(body.substr(4, ups_len), f.upserts) &&
+           decode_session_batch(body.substr(8 + ups_len, rms_len), f.removes);
+}
+
+// sender
+
+ReplicationSender::ReplicationSender(std::string host, int port, size_t queue_capacity, int batch_ms, SnapshotFn snapshot)
+    : host_(std::move(host)), port_(port), batch_ms_(std::max(1, batch_ms)), snapshot_(std::move(snapshot)),
+      queue_(std::max<size_t>(queue_capacity, 1024)) {
+    thread_ = std::thread(&ReplicationSender::run, this);
+}
+
+ReplicationSender::~ReplicationSender() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    close_peer();
+}
+
+void ReplicationSender::push(ReplicaOp op, const std::string &imsi, std::chrono::steady_clock::time_point at) {
+    if (!queue_.push(ReplicaDelta{op, imsi, at})) {
+        // never wait here: lose the delta and let the standby catch up from a snapshot
+        dropped_++;
+        resync_ = true;
+    }
+}
+
+nlohmann::json ReplicationSender::stats() const {
+    return {
+        {"role", "active"},
+        {"peer", host_ + ":" + std::to_string(port_)},
+        {"connected", connected_.load()},
+        {"seq_sent", sent_seq_.load()},
+        {"seq_acked", acked_seq_.load()},
+        {"queue_depth", queue_.size()},
+        {"deltas", deltas_.load()},
+        {"dropped", dropped_.load()},
+        {"snapshots", snapshots_.load()},
+        {"bytes_sent", bytes_.load()},
+        {"lag_us", lag_us_.load()},
+        {"restarts", restarts_.load()}
+    };
+}
+
+bool ReplicationSender::connect_peer() {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port_));
+    if (inet_pton(AF_INET, host_.c_str(), &addr.sin_addr) <= 0 ||
+        ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return false;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    struct timeval tv{};
+    tv.tv_sec = 1;
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    fd_ = fd;
+    connected_ = true;
+    inflight_.clear();
+    ack_buf_.clear();
+    spdlog::info("Replication connected to standby {}:{}", host_, port_);
+    return true;
+}
+
+void ReplicationSender::close_peer() {
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    if (connected_) spdlog::warn("Replication stream to {}:{} closed", host_, port_);
+    connected_ = false;
+}
+
+bool ReplicationSender::send_frame(ReplicationFrame &f, time_point oldest_event) {
+    f.seq = ++seq_;
+    f.sent_us = wall_us();
+    std::string data = encode_replication_frame(f);
+    if (!send_all(fd_, data.data(), data.size())) {
+        close_peer();
+        resync_ = true;
+        return false;
+    }
+    bytes_ += data.size();
+    sent_seq_ = f.seq;
+    last_send_ = std::chrono::steady_clock::now();
+    if (f.type != ReplicationFrame::heartbeat) inflight_.emplace_back(f.seq, oldest_event);
+    return true;
+}
+
+bool ReplicationSender::send_snapshot() {
+    resync_ = false;
+    ReplicationFrame f;
+    f.type = ReplicationFrame::snapshot;
+    f.upserts = snapshot_();
+    snapshots_++;
+    spdlog::info("Replication snapshot: {} sessions", f.upserts.size());
+    return send_frame(f, std::chrono::steady_clock::now());
+}
+
+void ReplicationSender::read_acks() {
+    uint8_t buf[256];
+    for (;;) {
+        ssize_t r = ::recv(fd_, buf, sizeof(buf), MSG_DONTWAIT);
+        if (r > 0) {
+            ack_buf_.append(reinterpret_cast<const char*>(buf), static_cast<size_t>(r));
+            continue;
+        }
+        if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            close_peer();
+            resync_ = true;
+        }
+        break;
+    }
+    size_t off = 0;
+    auto now = std::chrono::steady_clock::now();
+    while (ack_buf_.size() - off >= 8) {
+        uint64_t seq = get_u64(reinterpret_cast<const uint8_t*>(ack_buf_.data() + off));
+        off += 8;
+        acked_seq_ = seq;
+        while (!inflight_.empty() && inflight_.front().first <= seq) {
+            // end-to-end lag: oldest change in the frame until the standby applied it
+            lag_us_ = std::chrono::duration_cast<std::chrono::microseconds>(now - inflight_.front().second).count();
+            inflight_.pop_front();
+        }
+    }
+    ack_buf_.erase(0, off);
+}
+
+void ReplicationSender::run() {
+    while (running_) {
+        try {
+            loop();
+            return;
+        } catch (const std::exception &e) {
+            spdlog::error("Exception in replication sender thread: {}", e.what());
+        } catch (...) {
+            spdlog::error("Unknown exception in replication sender thread");
+        }
+        // start over: the standby may have missed deltas, resync it from a snapshot
+        restarts_++;
+        close_peer();
+        resync_ = true;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+void ReplicationSender::loop() {
+    std::vector<ReplicaDelta> pending;
+    pending.reserve(max_frame_deltas);
+    auto next_connect = std::chrono::steady_clock::now();
+
+    while (running_) {
+        auto now = std::chrono::steady_clock::now();
+        if (fd_ < 0) {
+            // keep the queue bounded while disconnected; a snapshot follows the reconnect
+            ReplicaDelta d;
+            while (queue_.pop(d)) {}
+            if (now < next_connect || !connect_peer()) {
+                if (now >= next_connect) next_connect = now + std::chrono::seconds(1);
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                continue;
+            }
+            resync_ = true;
+        }
+
+        if (resync_ && !send_snapshot()) continue;
+
+        pending.clear();
+        ReplicaDelta d;
+        while (pending.size() < max_frame_deltas && queue_.pop(d)) pending.push_back(std::move(d));
+
+        if (!pending.empty()) {
+            // coalesce: only the last change per IMSI in this batch matters
+            deltas_ += pending.size();
+            std::unordered_map<std::string, size_t> last;
+            last.reserve(pending.size());
+            for (size_t i = 0; i < pending.size(); ++i) last[pending[i].imsi] = i;
+
+            ReplicationFrame f;
+            time_point oldest = pending.front().at;
+            now = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < pending.size(); ++i) {
+                const auto &p = pending[i];
+                if (last[p.imsi] != i) continue;
+                auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(now - p.at).count();
+                SessionRecord r{p.imsi, static_cast<uint32_t>(std::max<int64_t>(0, idle))};
+                if (p.op == ReplicaOp::upsert) f.upserts.push_back(std::move(r));
+                else f.removes.push_back(std::move(r));
+            }
+            send_frame(f, oldest);
+        } else if (now - last_send_ >= std::chrono::milliseconds(heartbeat_ms)) {
+            ReplicationFrame hb;
+            hb.type = ReplicationFrame::heartbeat;
+            send_frame(hb, now);
+        }
+
+        if (fd_ >= 0) read_acks();
+        if (pending.size() < max_frame_deltas) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(batch_ms_));
+        }
+    }
+}
+
+// receiver
+
+ReplicationReceiver::ReplicationReceiver(const std::string &ip, int port, ApplyFn apply, size_t max_sessions)
+    : apply_(std::move(apply)), max_sessions_(max_sessions) {
+    last_frame_ms_ = steady_ms();
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        spdlog::critical("Replication socket() failed: {}", strerror(errno));
+        return;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0 ||
+        bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        spdlog::critical("Replication listen on {}:{} failed: {}", ip, port, strerror(errno));
+        close(fd);
+        return;
+    }
+    listen_fd_ = fd;
+    spdlog::info("Standby waiting for replication stream on {}:{}", ip, port);
+    thread_ = std::thread(&ReplicationReceiver::run, this);
+}
+
+ReplicationReceiver::~ReplicationReceiver() {
+    running_ = false;
+    if (thread_.joinable()) thread_.join();
+    if (listen_fd_ >= 0) close(listen_fd_);
+}
+
+int64_t ReplicationReceiver::silence_ms() const {
+    return steady_ms() - last_frame_ms_.load();
+}
+
+nlohmann::json ReplicationReceiver::stats() const {
+    return {
+        {"role", "standby"},
+        {"connected", connected_.load()},
+        {"seq_applied", applied_seq_.load()},
+        {"frames", frames_.load()},
+        {"records", records_.load()},
+        {"oversized_frames", oversized_.load()},
+        {"lag_us", lag_us_.load()},
+        {"silence_ms", silence_ms()}
+    };
+}
+
+void ReplicationReceiver::run() {
+    try {
+        accept_loop();
+    } catch (const std::exception &e) {
+        spdlog::error("Exception in replication receiver thread: {}", e.what());
+    } catch (...) {
+        spdlog::error("Unknown exception in replication receiver thread");
+    }
+    connected_ = false;
+}
+
+void ReplicationReceiver::accept_loop() {
+    while (running_) {
+        pollfd p{listen_fd_, POLLIN, 0};
+        if (poll(&p, 1, 200) <= 0) continue;
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) continue;
+        struct timeval tv{};
+        tv.tv_usec = 200000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        connected_ = true;
+        ever_connected_ = true;
+        spdlog::info("Replication stream connected");
+        try {
+            serve(fd);
+        } catch (...) {
+            connected_ = false;
+            close(fd);
+            throw;
+        }
+        connected_ = false;
+        close(fd);
+        spdlog::warn("Replication stream disconnected");
+    }
+}
+
+void ReplicationReceiver::serve(int fd) {
+    uint8_t hdr[replication_header_size];
+    std::string body;
+    while (running_) {
+        ReplicationFrame f;
+        uint32_t body_len = 0;
+        if (!recv_all(fd, hdr, sizeof(hdr), running_)) return;
+        if (!decode_replication_header(hdr, f, body_len)) {
+            spdlog::error("Replication stream: bad frame header");
+            return;
+        }
+        // the length comes from the peer: never allocate more than a frame can hold
+        if (body_len > replication_body_limit(f.type, max_sessions_)) {
+            oversized_++;
+            spdlog::error("Replication stream: {} byte frame body exceeds the limit (seq {})", body_len, f.seq);
+            return;
+        }
+        body.resize(body_len);
+        if (body_len > 0 && !recv_all(fd, reinterpret_cast<uint8_t*>(&body[0]), body_len, running_)) return;
+        if (f.type != ReplicationFrame::heartbeat && !decode_replication_body(body, f)) {
+            spdlog::error("Replication stream: bad frame body (seq {})", f.seq);
+            return;
+        }
+
+        if (f.type != ReplicationFrame::heartbeat) apply_(f);
+
+        last_frame_ms_ = steady_ms();
+        applied_seq_ = f.seq;
+        frames_++;
+        records_ += f.upserts.size() + f.removes.size();
+        lag_us_ = static_cast<int64_t>(wall_us()) - static_cast<int64_t>(f.sent_us);
+
+        std::string ack;
+        put_u64(ack, f.seq);
+        if (!send_all(fd, ack.data(), ack.size())) return;
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+#include <nlohmann/json.hpp>
+
+#include "session_batch.h"
+#include "bounded_queue.h"
+
+enum class ReplicaOp : uint8_t { upsert = 1, remove = 2 };
+
+struct ReplicaDelta {
+    ReplicaOp op = ReplicaOp::upsert;
+    std::string imsi;
+    std::chrono::steady_clock::time_point at{}; // when the change happened on the active node
+};
+
+// One frame of the active -> standby TCP stream (big-endian):
+//   "PGWR" | u8 type | u64 seq | u64 sent_us | u32 body_len | body
+//   body = u32 len | session batch (upserts) | u32 len | session batch (removes)
+// The standby acks every frame by writing back its u64 seq.
+struct ReplicationFrame {
+    enum Type : uint8_t { batch = 1, snapshot = 2, heartbeat = 3 };
+
+    uint8_t type = batch;
+    uint64_t seq = 0;
+    uint64_t sent_us = 0; // sender wall clock, lets the standby measure lag
+    std::vector<SessionRecord> upserts;
+    std::vector<SessionRecord> removes;
+};
+
+constexpr size_t replication_header_size = 25;
+
+std::string encode_replication_frame(const ReplicationFrame &f);
+bool decode_replication_header(const uint8_t *hdr, ReplicationFrame &f, uint32_t &body_len);
+// largest body a well-formed frame of `type` can have; snapshots carry up to
+// max_sessions sessions (0 = unbounded table, capped at 16M)
+uint64_t replication_body_limit(uint8_t type, size_t max_sessions);
+bool decode_replication_body(const std::string &body, ReplicationFrame &f);
+
+// Active side. push() is called with sess_m_ held and only touches a lock-free
+// queue; a background thread coalesces deltas into frames and streams them to
+// the standby. On queue overflow or reconnect the standby gets a full snapshot.
+class ReplicationSender {
+public:
+    using SnapshotFn = std::function<std::vector<SessionRecord>()>;
+
+    ReplicationSender(std::string host, int port, size_t queue_capacity, int batch_ms, SnapshotFn snapshot);
+    ~ReplicationSender();
+
+    ReplicationSender(const ReplicationSender&) = delete;
+    ReplicationSender& operator=(const ReplicationSender&) = delete;
+
+    void push(ReplicaOp op, const std::string &imsi, std::chrono::steady_clock::time_point at);
+
+    nlohmann::json stats() const;
+
+private:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    // thread body: loop(), restarted after an exception with a fresh
+    // connection and snapshot so replication outlives a bad record
+    void run();
+    void loop();
+    bool connect_peer();
+    void close_peer();
+    bool send_frame(ReplicationFrame &f, time_point oldest_event);
+    bool send_snapshot();
+    void read_acks();
+
+    std::string host_;
+    int port_;
+    int batch_ms_;
+    SnapshotFn snapshot_;
+
+    BoundedQueue<ReplicaDelta> queue_;
+    int fd_ = -1;
+    uint64_t seq_ = 0;
+    time_point last_send_{};
+    std::deque<std::pair<uint64_t, time_point>> inflight_; // seq -> oldest event in frame
+    std::string ack_buf_;
+
+    std::atomic<bool> running_{true};
+    std::atomic<bool> resync_{true};
+    std::atomic<bool> connected_{false};
+    std::atomic<uint64_t> sent_seq_{0};
+    std::atomic<uint64_t> acked_seq_{0};
+    std::atomic<uint64_t> deltas_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> snapshots_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<int64_t> lag_us_{0};
+    std::atomic<uint64_t> restarts_{0};
+    std::thread thread_;
+};
+
+// Standby side: accepts one stream at a time and hands decoded frames to `apply`.
+class ReplicationReceiver {
+public:
+    using ApplyFn = std::function<void(const ReplicationFrame&)>;
+
+    // frames larger than a snapshot of max_sessions sessions close the stream
+    ReplicationReceiver(const std::string &ip, int port, ApplyFn apply, size_t max_sessions = 0);
+    ~ReplicationReceiver();
+
+    ReplicationReceiver(const ReplicationReceiver&) = delete;
+    ReplicationReceiver& operator=(const ReplicationReceiver&) = delete;
+
+    bool listening() const { return listen_fd_ >= 0; }
+    bool ever_connected() const { return ever_connected_; }
+    // time since the last frame (or since start if none arrived yet)
+    int64_t silence_ms() const;
+
+    nlohmann::json stats() const;
+
+private:
+    // thread body: accept_loop() with exceptions logged instead of terminating
+    void run();
+    void accept_loop();
+    void serve(int fd);
+
+    ApplyFn apply_;
+    size_t max_sessions_;
+    int listen_fd_ = -1;
+
+    std::atomic<bool> running_{true};
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> ever_connected_{false};
+    std::atomic<int64_t> last_frame_ms_{0}; // steady clock
+    std::atomic<uint64_t> applied_seq_{0};
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> oversized_{0};
+    std::atomic<int64_t> lag_us_{0};
+    std::thread thread_;
+};
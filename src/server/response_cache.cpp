@@ -0,0 +1,75 @@
+#include "response_cache.h"
+#include "protocol.h"
+
+#include <algorithm>
+
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+ResponseCache::ResponseCache(size_t table_size, uint32_t ttl_ms)
+    : slots_(ttl_ms ? round_up_pow2(std::max<size_t>(table_size, probe_window)) : 0),
+      mask_(slots_.empty() ? 0 : slots_.size() - 1),
+      ttl_ns_(static_cast<uint64_t>(ttl_ms) * 1000000) {}
+
+uint64_t ResponseCache::key(uint32_t addr, uint16_t port, const uint8_t *data, size_t len) {
+    uint64_t id;
+    if (is_proto_v2(data, len)) {
+        // the txid already identifies the request
+        id = (uint64_t(data[4]) << 24) | (uint64_t(data[5]) << 16) | (uint64_t(data[6]) << 8) | data[7];
+        id |= 1ull << 63;
+    } else {
+        // FNV-1a over the datagram
+        id = 1469598103934665603ull;
+        for (size_t i = 0; i < len; ++i) {
+            id ^= data[i];
+            id *= 1099511628211ull;
+        }
+        id &= ~(1ull << 63);
+    }
+    uint64_t k = mix64(id ^ mix64((uint64_t(addr) << 16) | port));
+    return k ? k : 1;
+}
+
+size_t ResponseCache::home(uint64_t key) const {
+    return static_cast<size_t>(key >> 32) & mask_;
+}
+
+const std::string *ResponseCache::lookup(uint64_t key, uint64_t now_ns) const {
+    if (!enabled()) return nullptr;
+    size_t h = home(key);
+    for (size_t i = 0; i < probe_window; ++i) {
+        const Slot &s = slots_[(h + i) & mask_];
+        if (s.expires_ns > now_ns && s.key == key) return &s.reply;
+    }
+    return nullptr;
+}
+
+void ResponseCache::store(uint64_t key, uint64_t now_ns, const void *reply, size_t len) {
+    if (!enabled()) return;
+    size_t h = home(key);
+    Slot *victim = nullptr;
+    for (size_t i = 0; i < probe_window; ++i) {
+        Slot &s = slots_[(h + i) & mask_];
+        if (s.key == key || s.expires_ns <= now_ns) {
+            victim = &s;
+            break;
+        }
+        // table is hot: overwrite the entry closest to expiry
+        if (!victim || s.expires_ns < victim->expires_ns) victim = &s;
+    }
+    victim->key = key;
+    victim->expires_ns = now_ns + ttl_ns_;
+    victim->reply.assign(static_cast<const char*>(reply), len);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Short-lived cache of UDP replies keyed by source address/port plus request
+// identity (the txid for protocol v2, a hash of the datagram for legacy
+// requests). A retransmitted request that hits the cache gets the original
+// reply back without going through the session table again. Fixed-size
+// open-addressing table, same layout rules as SourceRateLimiter; only the UDP
+// thread touches it.
+class ResponseCache {
+public:
+    // ttl_ms == 0 disables the cache; table_size is rounded up to a power of two
+    ResponseCache(size_t table_size, uint32_t ttl_ms);
+
+    bool enabled() const { return ttl_ns_ != 0; }
+
+    // addr/port in network byte order
+    static uint64_t key(uint32_t addr, uint16_t port, const uint8_t *data, size_t len);
+
+    // returns the cached reply or nullptr; now_ns is a monotonic timestamp
+    const std::string *lookup(uint64_t key, uint64_t now_ns) const;
+    void store(uint64_t key, uint64_t now_ns, const void *reply, size_t len);
+
+private:
+    struct Slot {
+        uint64_t key = 0;
+        uint64_t expires_ns = 0; // 0 = empty
+        std::string reply;
+    };
+
+    static constexpr size_t probe_window = 8;
+
+    size_t home(uint64_t key) const;
+
+    std::vector<Slot> slots_;
+    size_t mask_;
+    uint64_t ttl_ns_;
+};
@@ -4,8 +4,14 @@
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include "imsi_to_bcd.h"
+#include "protocol.h"
+#include "cdr_index.h"
+#include "rate_limiter.h"
+#include "response_cache.h"
+#include "trace.h"
 
 #include <sys/socket.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -13,9 +19,80 @@
 #include <cerrno>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 #include <signal.h>
+#include <ctime>
 
-Server::Server(Config cfg) : cfg_(std::move(cfg)) {
+static uint32_t idle_ms(std::chrono::steady_clock::duration d) {
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+    if (ms < 0) return 0;
+    return static_cast<uint32_t>(std::min<int64_t>(ms, UINT32_MAX));
+}
+
+static bool parse_migration_peer(const std::string &addr, ClusterMember &peer) {
+    auto colon = addr.rfind(':');
+    if (colon == std::string::npos || colon == 0) return false;
+    try {
+        peer.ip = addr.substr(0, colon);
+        peer.http_port = std::stoi(addr.substr(colon + 1));
+    } catch (...) {
+        return false;
+    }
+    peer.id = addr;
+    return peer.http_port > 0 && peer.http_port < 65536;
+}
+
+static nlohmann::json histogram_json(const LatencyHistogram &h) {
+    return {
+        {"count", h.count()},
+        {"p50", h.percentile(0.5)},
+        {"p99", h.percentile(0.99)},
+        {"max", h.max()}
+    };
+}
+
+static nlohmann::json lock_stats_json(const InstrumentedMutex::Stats &s) {
+    static const char *bounds[InstrumentedMutex::buckets] = {"1us", "4us", "16us", "64us", "256us", "1ms", "4ms", "inf"};
+    nlohmann::json hist = nlohmann::json::object();
+    for (size_t i = 0; i < InstrumentedMutex::buckets; ++i) hist[bounds[i]] = s.wait_histogram[i];
+    return {
+        {"acquisitions", s.acquisitions},
+        {"contended", s.contended},
+        {"contention_rate", s.acquisitions ? static_cast<double>(s.contended) / s.acquisitions : 0.0},
+        {"wait_us", s.wait_ns / 1000},
+        {"max_wait_us", s.max_wait_ns / 1000},
+        {"hold_us", s.hold_ns / 1000},
+        {"max_hold_us", s.max_hold_ns / 1000},
+        {"wait_histogram", std::move(hist)}
+    };
+}
+
+static AdaptiveExpiry::Options adaptive_options(const Config &cfg) {
+    AdaptiveExpiry::Options o;
+    o.timeout = std::chrono::seconds(cfg.session_timeout_sec);
+    o.min_timeout = std::chrono::seconds(std::max(0, cfg.adaptive_timeout_min_sec));
+    o.occupancy_low = cfg.adaptive_occupancy_low;
+    o.occupancy_high = cfg.adaptive_occupancy_high;
+    o.memory_low_bytes = cfg.adaptive_memory_low_mb << 20;
+    o.memory_high_bytes = cfg.adaptive_memory_high_mb << 20;
+    return o;
+}
+
+Server::Server(Config cfg, std::shared_ptr<Clock> clock)
+    : cfg_(std::move(cfg)),
+      // with expected_sessions the table is built once the arena exists, so
+      // nothing is reserved on the heap first
+      sessions_(cfg_.expected_sessions > 0 ? 0 : cfg_.max_sessions),
+      blacklist_(cfg_.blacklist),
+      clock_(clock ? std::move(clock) : std::make_shared<SystemClock>()),
+      core_clock_{*clock_, dynamic_cast<const SystemClock*>(clock_.get()) != nullptr},
+      core_(store_, cdr_writer_, blacklist_, core_clock_,
+            cfg_.capacity_policy == "evict_lru" ? CapacityPolicy::evict_lru : CapacityPolicy::reject),
+      adaptive_(adaptive_options(cfg_)),
+      hitters_({cfg_.heavy_hitters_top, std::chrono::seconds(cfg_.heavy_hitters_window_sec),
+                cfg_.heavy_hitters_alert_share}),
+      events_(cfg_.events_buffer),
+      watchdog_(std::chrono::milliseconds(cfg_.watchdog_stall_ms)) {
     try {
         auto logger = spdlog::basic_logger_mt("pgw_logger", cfg_.log_file);
         spdlog::set_default_logger(logger);
@@ -31,20 +108,120 @@ Server::Server(Config cfg) : cfg_(std::move(cfg)) {
     else if (cfg_.log_level == "err" || cfg_.log_level == "error") spdlog::set_level(spdlog::level::err);
     else spdlog::set_level(spdlog::level::info);
 
-    cdr_out_.open(cfg_.cdr_file, std::ios::app);
-    if (!cdr_out_) {
-        spdlog::error("Failed to open CDR file '{}'", cfg_.cdr_file);
-    } else {
-        spdlog::info("CDR file opened: {}", cfg_.cdr_file);
+    trace_set_ring_size(cfg_.trace_ring_size);
+    watchdog_.watch(&udp_monitor_);
+    watchdog_.watch(&cleaner_monitor_);
+
+    cdr_ = std::make_unique<CdrLog>(cfg_.cdr_file);
+    if (cdr_->ok()) {
+        spdlog::info("CDR file opened: {} ({} records)", cfg_.cdr_file, cdr_->records());
+    }
+
+    if (cfg_.capacity_policy != "reject" && cfg_.capacity_policy != "evict_lru") {
+        spdlog::warn("Unknown capacity_policy '{}', using 'reject'", cfg_.capacity_policy);
+        cfg_.capacity_policy = "reject";
+    }
+    if (cfg_.overload_action != "shed" && cfg_.overload_action != "reject") {
+        spdlog::warn("Unknown overload_action '{}', using 'shed'", cfg_.overload_action);
+        cfg_.overload_action = "shed";
+    }
+    if (cfg_.max_sessions > 0) {
+        spdlog::info("Session capacity: {} (policy: {})", cfg_.max_sessions, cfg_.capacity_policy);
+    }
+
+    if (cfg_.replication_role != "none" && cfg_.replication_role != "active" && cfg_.replication_role != "standby") {
+        spdlog::warn("Unknown replication_role '{}', replication disabled", cfg_.replication_role);
+        cfg_.replication_role = "none";
+    }
+
+    if (!cfg_.session_shm_name.empty()) {
+        uint64_t slots = cfg_.session_shm_slots;
+        if (slots == 0) slots = cfg_.max_sessions > 0 ? 2 * static_cast<uint64_t>(cfg_.max_sessions) : 1u << 20;
+        shm_ = std::make_unique<SessionMirror>(cfg_.session_shm_name, slots,
+                                               std::chrono::seconds(cfg_.session_timeout_sec));
+        if (!shm_->ok()) shm_.reset();
+    }
+
+    if (cfg_.expected_sessions > 0) {
+        SessionArena::HugePages huge_pages;
+        if (!SessionArena::parse_huge_pages(cfg_.huge_pages, huge_pages)) {
+            spdlog::warn("Unknown huge_pages '{}', using 'transparent'", cfg_.huge_pages);
+            huge_pages = SessionArena::HugePages::transparent;
+        }
+        size_t n = std::max(cfg_.max_sessions, cfg_.expected_sessions);
+        arena_ = std::make_unique<SessionArena>(SessionTable::arena_bytes(n), huge_pages, cfg_.prefault);
+        if (arena_->ok()) {
+            sessions_ = SessionTable(cfg_.max_sessions, arena_.get(), cfg_.expected_sessions);
+        } else {
+            arena_.reset();
+            sessions_ = SessionTable(cfg_.max_sessions);
+        }
+    }
+
+    if (!cfg_.cold_tier_file.empty()) {
+        uint64_t slots = cfg_.cold_tier_slots;
+        if (slots == 0) slots = cfg_.max_sessions > 0 ? 2 * static_cast<uint64_t>(cfg_.max_sessions) : 1u << 24;
+        auto cold = std::make_unique<ColdTier>(cfg_.cold_tier_file, slots);
+        if (cold->ok()) sessions_.set_cold_tier(std::move(cold));
+    }
+
+    if (adaptive_.enabled()) {
+        sessions_.set_low_activity_refreshes(cfg_.adaptive_min_refreshes);
+        spdlog::info("Adaptive expiry: low-activity sessions down to {}s under pressure", cfg_.adaptive_timeout_min_sec);
+    } else if (cfg_.adaptive_timeout_min_sec > 0) {
+        spdlog::warn("adaptive_timeout_min_sec {} is not below session_timeout_sec, adaptive expiry off",
+                     cfg_.adaptive_timeout_min_sec);
+    }
+
+    if (!cfg_.capture_file.empty()) {
+        capture_ = std::make_unique<PacketCapture>(cfg_.capture_file, cfg_.capture_buffer_bytes, cfg_.capture_max_bytes);
+        if (!capture_->ok()) capture_.reset();
+    }
+
+    if (!cfg_.xdp_interface.empty()) {
+        XdpSocket::Options xo;
+        xo.interface = cfg_.xdp_interface;
+        xo.queue = cfg_.xdp_queue;
+        xo.udp_port = static_cast<uint16_t>(cfg_.udp_port);
+        xo.frames = cfg_.xdp_frames;
+        xo.mode = cfg_.xdp_mode;
+        in_addr ip{};
+        if (inet_pton(AF_INET, cfg_.udp_ip.c_str(), &ip) == 1) xo.ip = ip.s_addr;
+        xdp_ = std::make_unique<XdpSocket>(xo);
+        if (!xdp_->ok()) {
+            spdlog::error("AF_XDP on {} queue {} unavailable: {}", cfg_.xdp_interface, cfg_.xdp_queue, xdp_->error());
+            xdp_.reset();
+        } else {
+            spdlog::info("AF_XDP receive on {} queue {} ({} mode)", cfg_.xdp_interface, cfg_.xdp_queue, cfg_.xdp_mode);
+        }
+    }
+
+    if (!cfg_.cluster_node_id.empty()) {
+        if (cfg_.cluster_mode != "forward" && cfg_.cluster_mode != "redirect") {
+            spdlog::warn("Unknown cluster_mode '{}', using 'forward'", cfg_.cluster_mode);
+            cfg_.cluster_mode = "forward";
+        }
+        auto ring = std::make_shared<const HashRing>(cfg_.cluster_members, cfg_.cluster_vnodes);
+        if (!ring->contains(cfg_.cluster_node_id)) {
+            spdlog::warn("Cluster node '{}' is not listed in cluster_members", cfg_.cluster_node_id);
+        }
+        std::atomic_store(&ring_, ring);
+        spdlog::info("Cluster mode: node '{}', {} members, {}", cfg_.cluster_node_id,
+                     ring->members().size(), cfg_.cluster_mode);
     }
 }
 
 Server::~Server() {
     stop();
+    // detached offload/migration threads clear offloading_ as their last access to *this
+    while (offloading_) std::this_thread::sleep_for(std::chrono::milliseconds(10));
     if (http_thread_.joinable()) {
         try { http_thread_.join(); } catch (...) {}
     }
-    if (cdr_out_.is_open()) cdr_out_.close();
+    {
+        std::lock_guard<std::mutex> lk(rebalance_m_);
+        if (rebalance_thread_.joinable()) rebalance_thread_.join();
+    }
 }
 
 void Server::start() {
@@ -56,8 +233,34 @@ void Server::start() {
     spdlog::info("Starting server: UDP {}:{}, HTTP on {}",
                  cfg_.udp_ip, cfg_.udp_port, cfg_.http_port);
 
+    if (cfg_.replication_role == "active" && !repl_sender_) {
+        auto colon = cfg_.replication_peer.rfind(':');
+        if (colon == std::string::npos) {
+            spdlog::error("Invalid replication_peer '{}', expected ip:port", cfg_.replication_peer);
+        } else {
+            try {
+                repl_sender_ = std::make_unique<ReplicationSender>(
+                    cfg_.replication_peer.substr(0, colon), std::stoi(cfg_.replication_peer.substr(colon + 1)),
+                    cfg_.replication_queue, cfg_.replication_batch_ms,
+                    [this]() { return snapshot_sessions(); });
+            } catch (const std::exception &e) {
+                spdlog::error("Invalid replication_peer '{}': {}", cfg_.replication_peer, e.what());
+            }
+        }
+    }
+
+    if (cfg_.cdr_index_segment_bytes > 0 && cdr_->ok()) {
+        cdr_index_thread_ = std::thread(&Server::cdr_index_loop, this);
+    }
     http_thread_ = std::thread(&Server::http_loop, this);
-    udp_loop();
+    if (cfg_.status_udp_port > 0) start_status_threads();
+    watchdog_.start();
+    if (cfg_.replication_role != "standby" || run_standby()) {
+        udp_loop();
+    }
+    watchdog_.stop();
+    // the capture ends with the UDP loop, complete on disk once start() returns
+    if (capture_) capture_->close();
 
     if (http_thread_.joinable()) {
         try { http_thread_.join(); } catch (const std::exception &e) {
@@ -66,6 +269,9 @@ void Server::start() {
             spdlog::warn("Unknown exception while joining http thread");
         }
     }
+    if (cdr_index_thread_.joinable()) cdr_index_thread_.join();
+    for (auto &t : status_threads_) t.join();
+    status_threads_.clear();
 
     spdlog::info("Server stopped");
 }
@@ -73,23 +279,400 @@ void Server::start() {
 void Server::stop() {
     if (!running_) return;
 
+    if (standby_) {
+        // a waiting standby holds a replica, not sessions of its own: nothing to offload
+        spdlog::info("Stop requested on standby");
+        running_ = false;
+        stop_http_server();
+        return;
+    }
+
     spdlog::info("Stop requested: initiating graceful shutdown");
     if (!offloading_) {
-        start_offload(static_cast<size_t>(std::max(1, cfg_.graceful_shutdown_rate)));
+        size_t rate = static_cast<size_t>(std::max(1, cfg_.graceful_shutdown_rate));
+        ClusterMember peer;
+        if (!cfg_.migration_peer.empty() && parse_migration_peer(cfg_.migration_peer, peer)) {
+            start_migration(peer, rate);
+        } else {
+            start_offload(rate);
+        }
     }
 
     stop_http_server();
 
-    for (int i = 0; i < 10 && running_; ++i) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
-    }
+    // the offload gets two seconds of clock time; a migration runs to completion
+    // (hand-over requests carry their own timeouts)
+    auto deadline = clock_->now() + std::chrono::seconds(2);
+    while (running_ && migrating_) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    clock_->sleep_until(deadline, running_);
 
     running_ = false;
 }
 
 bool Server::is_active(const std::string &imsi) {
-    std::lock_guard<std::mutex> lk(sess_m_);
-    return sessions_.find(imsi) != sessions_.end();
+    std::lock_guard<InstrumentedMutex> lk(sess_m_);
+    return sessions_.contains(imsi);
+}
+
+size_t Server::session_count() {
+    std::lock_guard<InstrumentedMutex> lk(sess_m_);
+    return sessions_.size();
+}
+
+nlohmann::json Server::stats() {
+    size_t active, low_activity;
+    nlohmann::json cold;
+    {
+        std::lock_guard<InstrumentedMutex> lk(sess_m_);
+        active = sessions_.size();
+        low_activity = sessions_.low_activity_size();
+        if (const ColdTier *ct = sessions_.cold_tier()) {
+            cold = {
+                {"sessions", ct->size()},
+                {"slots", ct->slots()},
+                {"hot", sessions_.hot_size()},
+                {"demoted", sessions_.demoted_total()},
+                {"promoted", sessions_.promoted_total()}
+            };
+        }
+    }
+    nlohmann::json j;
+    j["sessions"] = {
+        {"active", active},
+        {"capacity", cfg_.max_sessions},
+        {"occupancy", cfg_.max_sessions ? static_cast<double>(active) / cfg_.max_sessions : 0.0},
+        {"policy", cfg_.capacity_policy},
+        {"evicted", evicted_total_.load()},
+        {"rejected_capacity", capacity_rejected_total_.load()}
+    };
+    if (!cold.is_null()) j["sessions"]["cold"] = std::move(cold);
+    j["expiry"] = adaptive_.json();
+    j["expiry"]["low_activity_sessions"] = low_activity;
+    j["expiry"]["expired_idle"] = expired_idle_total_.load();
+    j["expiry"]["expired_pressure"] = expired_pressure_total_.load();
+    j["expiry"]["max_per_tick"] = cfg_.expiry_max_per_tick;
+    j["expiry"]["budget_ms"] = cfg_.expiry_budget_ms;
+    j["expiry"]["carried_ticks"] = expiry_carried_ticks_.load();
+    j["expiry"]["lateness_ms"] = histogram_json(expiry_lateness_ms_);
+    j["expiry"]["lock_hold_us"] = histogram_json(expiry_hold_us_);
+    j["expiry"]["reply_us"] = {
+        {"all", histogram_json(reply_us_)},
+        {"while_expiring", histogram_json(reply_expiring_us_)}
+    };
+    j["udp"] = {
+        {"received", udp_received_total_.load()},
+        {"rate_limited", rate_limited_total_.load()},
+        {"shed", shed_total_.load()},
+        {"fast_rejected", fast_rejected_total_.load()},
+        {"kernel_drops", kernel_drops_.load()},
+        {"overloaded", overloaded_.load()},
+        {"rx_lag_us", rx_lag_us_.load()},
+        {"rcvbuf_bytes", rcvbuf_bytes_.load()},
+        {"v2_requests", v2_requests_total_.load()},
+        {"v2_imsis", v2_imsis_total_.load()},
+        {"v2_malformed", v2_malformed_total_.load()}
+    };
+    j["cdr"] = {
+        {"records", cdr_->records()},
+        {"bytes", cdr_->size()},
+        {"indexed_bytes", cdr_indexed_bytes_.load()},
+        {"index_segments", cdr_index_segments_.load()}
+    };
+    uint64_t hits = retransmit_hits_.load(), misses = retransmit_misses_.load();
+    j["retransmit_cache"] = {
+        {"enabled", cfg_.retransmit_cache_ms > 0},
+        {"ttl_ms", cfg_.retransmit_cache_ms},
+        {"hits", hits},
+        {"misses", misses},
+        {"hit_rate", hits + misses ? static_cast<double>(hits) / (hits + misses) : 0.0}
+    };
+    if (cfg_.status_udp_port > 0) {
+        j["status"] = {
+            {"port", cfg_.status_udp_port},
+            {"threads", cfg_.status_threads},
+            {"queries", status_queries_.load()},
+            {"imsis", status_imsis_.load()},
+            {"active", status_active_.load()},
+            {"malformed", status_malformed_.load()}
+        };
+    }
+    if (shm_) {
+        j["shm"] = {
+            {"name", shm_->name()},
+            {"slots", shm_->slots()},
+            {"sessions", shm_->sessions()},
+            {"dropped", shm_->dropped()}
+        };
+    }
+    j["startup"] = startup_json();
+    if (capture_) {
+        j["capture"] = {
+            {"file", capture_->path()},
+            {"records", capture_->records()},
+            {"bytes", capture_->bytes()},
+            {"dropped", capture_->dropped()},
+            {"limit_reached", capture_->limit_reached()}
+        };
+    }
+    if (events_.enabled()) {
+        j["events"] = {
+            {"buffer", events_.capacity()},
+            {"next_seq", events_.next_seq()},
+            {"oldest_seq", events_.oldest_seq()},
+            {"streams", event_streams_.load()}
+        };
+    }
+    if (xdp_) {
+        j["xdp"] = {
+            {"interface", cfg_.xdp_interface},
+            {"queue", cfg_.xdp_queue},
+            {"mode", cfg_.xdp_mode},
+            {"rx_packets", xdp_->rx_packets()},
+            {"tx_packets", xdp_->tx_packets()},
+            {"rx_invalid", xdp_->rx_invalid()},
+            {"tx_dropped", xdp_->tx_dropped()}
+        };
+    }
+    j["locks"] = {
+        {"sessions", lock_stats_json(sess_m_.stats())},
+        {"cdr", lock_stats_json(cdr_->lock_stats())}
+    };
+    j["loops"] = watchdog_.json();
+    j["loops"]["stall_threshold_ms"] = cfg_.watchdog_stall_ms;
+    j["loops"]["stalls"] = watchdog_.stalls();
+    if (std::atomic_load(&ring_)) j["cluster"] = cluster_json();
+    if (cfg_.replication_role != "none") j["replication"] = replication_json();
+    if (!cfg_.migration_peer.empty() || migration_state_.load() != std::string("idle")) j["migration"] = migration_json();
+    return j;
+}
+
+nlohmann::json Server::replication_json() {
+    if (repl_sender_) return repl_sender_->stats();
+    std::lock_guard<std::mutex> lk(repl_m_);
+    nlohmann::json j = repl_receiver_ ? repl_receiver_->stats() : nlohmann::json{{"role", cfg_.replication_role}};
+    j["taken_over"] = taken_over_.load();
+    return j;
+}
+
+void Server::replicate(ReplicaOp op, const std::string &imsi, std::chrono::steady_clock::time_point at) {
+    if (repl_sender_) repl_sender_->push(op, imsi, at);
+    if (shm_) {
+        if (op == ReplicaOp::upsert) shm_->upsert(imsi, at);
+        else shm_->remove(imsi);
+    }
+}
+
+std::vector<SessionRecord> Server::snapshot_sessions() {
+    std::vector<SessionRecord> out;
+    std::lock_guard<InstrumentedMutex> lk(sess_m_);
+    out.reserve(sessions_.size());
+    auto now = clock_->now();
+    sessions_.for_each([&](const std::string &imsi, SessionTable::time_point last_seen) {
+        out.push_back({imsi, idle_ms(now - last_seen)});
+    });
+    return out;
+}
+
+void Server::apply_replica(const ReplicationFrame &f) {
+    std::lock_guard<InstrumentedMutex> lk(sess_m_);
+    auto now = clock_->now();
+    if (f.type == ReplicationFrame::snapshot) {
+        sessions_.clear();
+        if (shm_) shm_->clear();
+    }
+    for (const auto &r : f.upserts) {
+        auto last_seen = now - std::chrono::milliseconds(r.idle_ms);
+        if (!sessions_.touch(r.imsi, last_seen)) sessions_.adopt(r.imsi, last_seen);
+        if (shm_) shm_->upsert(r.imsi, last_seen);
+    }
+    for (const auto &r : f.removes) {
+        sessions_.erase(r.imsi);
+        if (shm_) shm_->remove(r.imsi);
+    }
+}
+
+bool Server::run_standby() {
+    {
+        std::lock_guard<std::mutex> lk(repl_m_);
+        repl_receiver_ = std::make_unique<ReplicationReceiver>(
+            cfg_.udp_ip, cfg_.replication_port, [this](const ReplicationFrame &f) { apply_replica(f); },
+            cfg_.max_sessions);
+        if (!repl_receiver_->listening()) {
+            repl_receiver_.reset();
+            running_ = false;
+            stop_http_server();
+            return false;
+        }
+    }
+    standby_ = true;
+
+    while (running_ && !takeover_requested_) {
+        // only a node that has seen an active peer may decide the peer is gone
+        if (cfg_.replication_takeover_ms > 0 && repl_receiver_->ever_connected() &&
+            repl_receiver_->silence_ms() >= cfg_.replication_takeover_ms) {
+            spdlog::warn("No replication traffic for {} ms, taking over", repl_receiver_->silence_ms());
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(repl_m_);
+        repl_receiver_.reset();
+    }
+    standby_ = false;
+    if (!running_) return false;
+
+    taken_over_ = true;
+    spdlog::warn("Standby taking over UDP {}:{} with {} warm sessions",
+                 cfg_.udp_ip, cfg_.udp_port, session_count());
+    return true;
+}
+
+nlohmann::json Server::startup_json() {
+    nlohmann::json j;
+    int64_t startup_us = startup_us_.load();
+    j["startup_ms"] = startup_us < 0 ? nlohmann::json() : nlohmann::json(static_cast<double>(startup_us) / 1000.0);
+    j["expected_sessions"] = cfg_.expected_sessions;
+    if (arena_) {
+        std::lock_guard<InstrumentedMutex> lk(sess_m_);
+        j["arena"] = {
+            {"bytes", arena_->capacity()},
+            {"used", arena_->used()},
+            {"heap_fallbacks", arena_->heap_fallbacks()},
+            {"huge_pages", arena_->huge_pages()},
+            {"prefault_ms", arena_->prefault_ms()}
+        };
+    }
+    j["first_minute_us"] = histogram_json(first_minute_us_);
+    return j;
+}
+
+nlohmann::json Server::cluster_json() {
+    nlohmann::json j;
+    j["node_id"] = cfg_.cluster_node_id;
+    j["mode"] = cfg_.cluster_mode;
+    j["members"] = nlohmann::json::array();
+    if (auto ring = std::atomic_load(&ring_)) {
+        for (const auto &n : ring->members()) j["members"].push_back(cluster_member_to_json(n.member));
+    }
+    j["forwarded"] = fwd_counters_.forwarded.load();
+    j["relayed"] = fwd_counters_.relayed.load();
+    j["forward_timeouts"] = fwd_counters_.timeouts.load();
+    j["redirected"] = redirected_total_.load();
+    j["handed_over"] = handed_over_total_.load();
+    j["adopted"] = adopted_total_.load();
+    return j;
+}
+
+void Server::set_cluster_members(std::vector<ClusterMember> members) {
+    auto ring = std::make_shared<const HashRing>(std::move(members), cfg_.cluster_vnodes);
+    if (!ring->contains(cfg_.cluster_node_id)) {
+        spdlog::warn("Node '{}' left the ring; all its sessions will be handed over", cfg_.cluster_node_id);
+    }
+    std::atomic_store(&ring_, ring);
+    spdlog::info("Cluster membership updated: {} members", ring->members().size());
+
+    std::lock_guard<std::mutex> lk(rebalance_m_);
+    if (rebalance_thread_.joinable()) rebalance_thread_.join();
+    rebalance_thread_ = std::thread([this]() {
+        try {
+            rebalance();
+        } catch (const std::exception &e) {
+            spdlog::error("Exception in rebalance thread: {}", e.what());
+        } catch (...) {
+            spdlog::error("Unknown exception in rebalance thread");
+        }
+    });
+}
+
+void Server::rebalance() {
+    auto ring = std::atomic_load(&ring_);
+    if (!ring) return;
+
+    // sessions whose owner changed, grouped by new owner
+    std::unordered_map<std::string, std::vector<SessionRecord>> moving;
+    {
+        std::lock_guard<InstrumentedMutex> lk(sess_m_);
+        auto now = clock_->now();
+        sessions_.for_each([&](const std::string &imsi, SessionTable::time_point last_seen) {
+            const HashRing::Node *owner = ring->owner(imsi);
+            if (owner && owner->member.id != cfg_.cluster_node_id) {
+                moving[owner->member.id].push_back({imsi, idle_ms(now - last_seen)});
+            }
+        });
+    }
+    if (moving.empty()) return;
+
+    size_t total = 0;
+    for (const auto &n : ring->members()) {
+        auto it = moving.find(n.member.id);
+        if (it == moving.end()) continue;
+        const auto &records = it->second;
+        size_t batch = std::max<size_t>(1, cfg_.cluster_batch);
+        for (size_t off = 0; off < records.size(); off += batch) {
+            std::vector<SessionRecord> chunk(records.begin() + off,
+                                             records.begin() + std::min(records.size(), off + batch));
+            total += hand_over(n.member, chunk, "handed_over");
+        }
+    }
+    spdlog::info("Rebalance complete: {} sessions handed over", total);
+}
+
+size_t Server::hand_over(const ClusterMember &to, const std::vector<SessionRecord> &records, const char *cdr_action) {
+    // a session the batch format cannot carry stays here rather than
+    // failing the whole hand-over
+    std::vector<SessionRecord> moving;
+    moving.reserve(records.size());
+    for (const auto &r : records) {
+        if (valid_imsi(r.imsi)) moving.push_back(r);
+    }
+    if (moving.size() < records.size()) {
+        spdlog::warn("Keeping {} sessions with invalid IMSIs out of hand-over to {}",
+                     records.size() - moving.size(), to.id);
+    }
+    if (moving.empty()) return 0;
+    httplib::Client cli(to.ip, to.http_port);
+    cli.set_connection_timeout(2, 0);
+    cli.set_read_timeout(5, 0);
+    auto res = cli.Post("/cluster/adopt", encode_session_batch(moving), "application/octet-stream");
+    if (!res || res->status != 200) {
+        spdlog::warn("Hand-over of {} sessions to {} failed", moving.size(), to.id);
+        return 0;
+    }
+    {
+        std::lock_guard<InstrumentedMutex> lk(sess_m_);
+        auto now = clock_->now();
+        for (const auto &r : moving) {
+            if (sessions_.erase(r.imsi)) replicate(ReplicaOp::remove, r.imsi, now);
+        }
+    }
+    for (const auto &r : moving) append_cdr(r.imsi, cdr_action);
+    handed_over_total_ += moving.size();
+    spdlog::info("Handed over {} sessions to {}", moving.size(), to.id);
+    return moving.size();
+}
+
+size_t Server::adopt_sessions(const std::vector<SessionRecord> &records) {
+    std::vector<const SessionRecord*> adopted;
+    adopted.reserve(records.size());
+    {
+        std::lock_guard<InstrumentedMutex> lk(sess_m_);
+        auto now = clock_->now();
+        for (const auto &r : records) {
+            auto last_seen = now - std::chrono::milliseconds(r.idle_ms);
+            if (sessions_.adopt(r.imsi, last_seen)) {
+                replicate(ReplicaOp::upsert, r.imsi, last_seen);
+                adopted.push_back(&r);
+            }
+        }
+    }
+    for (const auto *r : adopted) append_cdr(r->imsi, "adopted");
+    adopted_total_ += adopted.size();
+    if (adopted.size() < records.size()) {
+        spdlog::warn("Adopted {} of {} sessions (duplicates or table full)", adopted.size(), records.size());
+    }
+    return adopted.size();
 }
 
 void Server::stop_http_server() {
@@ -102,46 +685,198 @@ void Server::stop_http_server() {
 }
 
 std::string Server::now_ts() {
-    std::time_t t = std::time(nullptr);
+    std::time_t t = std::chrono::system_clock::to_time_t(clock_->wall_now());
     char buf[64];
     std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&t));
     return std::string(buf);
 }
 
 void Server::append_cdr(const std::string &imsi, const std::string &action) {
-    std::lock_guard<std::mutex> lk(cdr_m_);
-    if (!cdr_out_) {
+    SessionEvents::Kind kind;
+    if (events_.enabled() && SessionEvents::kind_of(action, kind)) publish_event(kind, imsi);
+    if (!cdr_->ok()) {
         spdlog::error("CDR file not available; cannot write CDR for {} {}", imsi, action);
         return;
     }
-    cdr_out_ << now_ts() << ", " << imsi << ", " << action << "\n";
-    cdr_out_.flush();
+    cdr_->append(now_ts() + ", " + imsi + ", " + action);
+}
+
+std::shared_ptr<void> Server::acquire_stream() {
+    size_t n = streams_.load();
+    do {
+        if (cfg_.max_streams != 0 && n >= cfg_.max_streams) return nullptr;
+    } while (!streams_.compare_exchange_weak(n, n + 1));
+    return std::shared_ptr<void>(this, [](void *p) { static_cast<Server*>(p)->streams_--; });
+}
+
+void Server::publish_event(SessionEvents::Kind kind, const std::string &imsi) {
+    if (!events_.enabled()) return;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock_->wall_now().time_since_epoch()).count();
+    events_.publish(kind, pack_imsi(imsi), ms);
+}
+
+bool Server::ReplicatedStore::touch(const std::string &imsi, SessionTable::time_point now) {
+    if (!s.sessions_.touch(imsi, now)) return false;
+    s.replicate(ReplicaOp::upsert, imsi, now);
+    s.publish_event(SessionEvents::Kind::refreshed, imsi);
+    return true;
+}
+
+bool Server::ReplicatedStore::insert(const std::string &imsi, SessionTable::time_point now) {
+    if (!s.sessions_.insert(imsi, now)) return false;
+    s.replicate(ReplicaOp::upsert, imsi, now);
+    return true;
+}
+
+bool Server::ReplicatedStore::pop_oldest(std::string &imsi) {
+    if (!s.sessions_.pop_oldest(imsi)) return false;
+    s.replicate(ReplicaOp::remove, imsi, s.clock_->now());
+    return true;
+}
+
+size_t Server::ReplicatedStore::expire(SessionTable::time_point now, std::chrono::seconds timeout,
+                                       std::vector<std::string> &out, size_t max) {
+    size_t first = out.size();
+    size_t n = s.sessions_.expire(now, timeout, out, max);
+    for (size_t i = first; i < out.size(); ++i) s.replicate(ReplicaOp::remove, out[i], now);
+    return n;
 }
 
-bool Server::is_blacklisted(const std::string &imsi) {
-    for (const auto &b : cfg_.blacklist) {
-        if (b == imsi) return true;
+size_t Server::ReplicatedStore::expire_low_activity(SessionTable::time_point now, std::chrono::seconds timeout,
+                                                    std::vector<std::string> &out, size_t max) {
+    size_t first = out.size();
+    size_t n = s.sessions_.expire_low_activity(now, timeout, out, max);
+    for (size_t i = first; i < out.size(); ++i) s.replicate(ReplicaOp::remove, out[i], now);
+    return n;
+}
+
+// sessions removed per sess_m_ hold when expiry runs under a budget
+static constexpr size_t expiry_chunk = 256;
+
+// Without a budget every due session goes in one lock hold, as a mass
+// attach would have it. With expiry_max_per_tick or expiry_budget_ms the
+// work is split into chunks with sess_m_ released (and their CDRs written)
+// in between, and stops when the budget runs out; the rest are still the
+// oldest sessions and go first on the next tick.
+void Server::expire_due(uint64_t rss) {
+    const auto timeout = std::chrono::seconds(cfg_.session_timeout_sec);
+    const bool budgeted = cfg_.expiry_max_per_tick > 0 || cfg_.expiry_budget_ms > 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(cfg_.expiry_budget_ms);
+    size_t left = cfg_.expiry_max_per_tick > 0 ? cfg_.expiry_max_per_tick : SIZE_MAX;
+    auto low_timeout = timeout;
+    size_t idle_total = 0, pressure_total = 0;
+    bool first = true;
+
+    expiring_ = true;
+    for (;;) {
+        const size_t n = budgeted ? std::min(expiry_chunk, left) : SIZE_MAX;
+        std::vector<std::string> expired, pressured;
+        int64_t t0 = trace_now_ns();
+        {
+            std::lock_guard<InstrumentedMutex> lk(sess_m_);
+            auto held = std::chrono::steady_clock::now();
+            if (first) {
+                SessionTable::time_point oldest;
+                auto now = clock_->now();
+                if (sessions_.peek_oldest(oldest) && now - oldest >= timeout) {
+                    expiry_lateness_ms_.record(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(now - oldest - timeout).count()));
+                }
+            }
+            core_.expire(timeout, expired, n);
+            if (first && adaptive_.enabled()) low_timeout = adaptive_.update(sessions_.size(), cfg_.max_sessions, rss);
+            first = false;
+            if (low_timeout < timeout && expired.size() < n) {
+                core_.expire_low_activity(low_timeout, pressured, n - expired.size());
+            }
+            expiry_hold_us_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - held).count()));
+        }
+        // a budgeted storm is summarised per tick instead of a line per session
+        auto level = budgeted ? spdlog::level::debug : spdlog::level::info;
+        for (const auto &imsi : expired) {
+            append_cdr(imsi, "timeout");
+            spdlog::log(level, "Session {} timed out and removed", imsi);
+        }
+        for (const auto &imsi : pressured) {
+            append_cdr(imsi, "timeout_pressure");
+            spdlog::log(level, "Low-activity session {} timed out under pressure and removed", imsi);
+        }
+        const size_t got = expired.size() + pressured.size();
+        expired_idle_total_ += expired.size();
+        expired_pressure_total_ += pressured.size();
+        idle_total += expired.size();
+        pressure_total += pressured.size();
+        PGW_TRACE_SPAN_END(expiry_sweep, t0, got);
+
+        if (!budgeted || got < n) break;
+        left -= got;
+        if (left == 0 || (cfg_.expiry_budget_ms > 0 && std::chrono::steady_clock::now() >= deadline)) {
+            expiry_carried_ticks_++;
+            break;
+        }
+    }
+    expiring_ = false;
+    if (budgeted && idle_total + pressure_total > 0) {
+        spdlog::info("Expired {} idle and {} low-activity sessions this tick", idle_total, pressure_total);
     }
-    return false;
 }
 
-static size_t remove_sessions_batch(std::unordered_map<std::string, std::chrono::steady_clock::time_point> &sessions,
-                                    std::mutex &sess_m,
+static size_t remove_sessions_batch(SessionTable &sessions,
+                                    InstrumentedMutex &sess_m,
                                     size_t n,
                                     std::function<void(const std::string&)> cdr_writer) {
     std::vector<std::string> to_remove;
     {
-        std::lock_guard<std::mutex> lk(sess_m);
-        to_remove.reserve(n);
-        for (auto it = sessions.begin(); it != sessions.end() && to_remove.size() < n; ++it) {
-            to_remove.push_back(it->first);
-        }
-        for (const auto &imsi : to_remove) sessions.erase(imsi);
+        std::lock_guard<InstrumentedMutex> lk(sess_m);
+        to_remove.reserve(std::min(n, sessions.size()));
+        sessions.pop_batch(n, to_remove);
     }
     for (const auto &imsi : to_remove) cdr_writer(imsi);
     return to_remove.size();
 }
 
+// seals and indexes CDR segments in the background; append_cdr never waits on it
+void Server::cdr_index_loop() {
+    const uint64_t segment = cfg_.cdr_index_segment_bytes;
+    CdrIndexCursor cursor;
+    try {
+        while (running_) {
+            std::string err;
+            size_t n = update_cdr_indexes(cdr_->path(), segment, cdr_->size(), cursor, &err);
+            uint64_t end = cursor.end;
+            cdr_indexed_bytes_ = end;
+            cdr_index_segments_ += n;
+            if (n > 0) spdlog::info("Indexed {} CDR segment(s), {} bytes covered", n, end);
+            if (!err.empty()) {
+                spdlog::warn("CDR indexing: {}", err);
+                std::this_thread::sleep_for(std::chrono::seconds(1));
+            }
+            // sleep until the next segment can be sealed
+            cdr_->wait_beyond(end + segment - 1, std::chrono::milliseconds(500));
+        }
+    } catch (const std::exception &e) {
+        spdlog::error("Exception in CDR index thread: {}", e.what());
+    }
+}
+
+// deletes sessions at `rate` per second until none are left or the server stops
+void Server::offload_remaining(size_t rate) {
+    while (running_) {
+        size_t removed = remove_sessions_batch(sessions_, sess_m_, rate,
+            [this](const std::string &imsi) {
+                replicate(ReplicaOp::remove, imsi, clock_->now());
+                append_cdr(imsi, "offloaded");
+                spdlog::info("Offloaded {}", imsi);
+            });
+        if (removed == 0) {
+            spdlog::info("Offload complete - no sessions left");
+            break;
+        }
+        clock_->sleep_for(std::chrono::seconds(1), running_);
+    }
+}
+
 void Server::start_offload(size_t rate) {
     if (offloading_) {
         spdlog::warn("Offload already in progress");
@@ -152,29 +887,131 @@ void Server::start_offload(size_t rate) {
 
     std::thread([this, rate]() {
         try {
+            offload_remaining(rate);
+        } catch (const std::exception &e) {
+            spdlog::error("Exception in offload thread: {}", e.what());
+        } catch (...) {
+            spdlog::error("Unknown exception in offload thread");
+        }
+
+        this->running_ = false;
+        this->offloading_ = false;
+    }).detach();
+}
+
+void Server::start_migration(const ClusterMember &peer, size_t rate) {
+    if (offloading_) {
+        spdlog::warn("Offload already in progress");
+        return;
+    }
+    offloading_ = true;
+    migrating_ = true;
+    {
+        std::lock_guard<std::mutex> lk(migration_m_);
+        migration_peer_ = peer.ip + ":" + std::to_string(peer.http_port);
+    }
+    migration_state_ = "running";
+    migrated_total_ = 0;
+    migration_batches_ = 0;
+    migration_failures_ = 0;
+    migration_elapsed_us_ = 0;
+    migration_time_to_empty_us_ = -1;
+    spdlog::info("Starting migration of {} sessions to {}:{}", session_count(), peer.ip, peer.http_port);
+
+    std::thread([this, peer, rate]() {
+        auto t0 = std::chrono::steady_clock::now();
+        auto elapsed_us = [t0]() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+        };
+        const size_t batch = std::max<size_t>(1, cfg_.migration_batch);
+        bool fell_back = false;
+        try {
+            int failures_in_row = 0;
             while (running_) {
-                size_t removed = remove_sessions_batch(this->sessions_, this->sess_m_, rate,
-                    [this](const std::string &imsi) {
-                        this->append_cdr(imsi, "offloaded");
-                        spdlog::info("Offloaded {}", imsi);
+                // oldest first: the least recently seen sessions are the cheapest to lose on a failure
+                std::vector<SessionRecord> records;
+                {
+                    std::lock_guard<InstrumentedMutex> lk(sess_m_);
+                    records.reserve(std::min(batch, sessions_.size()));
+                    auto now = clock_->now();
+                    sessions_.for_each_oldest(batch, [&](const std::string &imsi, SessionTable::time_point last_seen) {
+                        records.push_back({imsi, idle_ms(now - last_seen)});
                     });
-                if (removed == 0) {
-                    spdlog::info("Offload complete - no sessions left");
+                }
+                if (records.empty()) {
+                    migration_time_to_empty_us_ = elapsed_us();
                     break;
                 }
-                std::this_thread::sleep_for(std::chrono::seconds(1));
+
+                size_t moved = hand_over(peer, records, "migrated");
+                migration_elapsed_us_ = elapsed_us();
+                if (moved == 0) {
+                    migration_failures_++;
+                    if (++failures_in_row >= 3) {
+                        spdlog::error("Migration peer {}:{} unavailable, offloading the remaining sessions",
+                                      peer.ip, peer.http_port);
+                        fell_back = true;
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200 * failures_in_row));
+                    continue;
+                }
+                failures_in_row = 0;
+                migrated_total_ += moved;
+                migration_batches_++;
             }
         } catch (const std::exception &e) {
-            spdlog::error("Exception in offload thread: {}", e.what());
+            spdlog::error("Exception in migration thread: {}", e.what());
+            fell_back = true;
         } catch (...) {
-            spdlog::error("Unknown exception in offload thread");
+            spdlog::error("Unknown exception in migration thread");
+            fell_back = true;
         }
+        // whatever stopped the migration, the sessions left behind still
+        // have to go before the node shuts down
+        if (fell_back) {
+            try {
+                offload_remaining(rate);
+            } catch (const std::exception &e) {
+                spdlog::error("Exception in migration thread: {}", e.what());
+            } catch (...) {
+                spdlog::error("Unknown exception in migration thread");
+            }
+        }
+
+        migration_elapsed_us_ = elapsed_us();
+        migration_state_ = fell_back ? "failed" : "done";
+        uint64_t moved = migrated_total_;
+        double secs = static_cast<double>(migration_elapsed_us_.load()) / 1e6;
+        spdlog::info("Migration {}: {} sessions in {:.3f} s ({:.0f} sessions/s)",
+                     fell_back ? "aborted" : "complete", moved, secs, secs > 0 ? moved / secs : 0.0);
 
         this->running_ = false;
+        this->stop_http_server();
+        this->migrating_ = false;
         this->offloading_ = false;
     }).detach();
 }
 
+nlohmann::json Server::migration_json() {
+    nlohmann::json j;
+    {
+        std::lock_guard<std::mutex> lk(migration_m_);
+        j["peer"] = migration_peer_.empty() ? cfg_.migration_peer : migration_peer_;
+    }
+    j["state"] = migration_state_.load();
+    uint64_t moved = migrated_total_.load();
+    int64_t elapsed = migration_elapsed_us_.load();
+    j["migrated"] = moved;
+    j["batches"] = migration_batches_.load();
+    j["failed_batches"] = migration_failures_.load();
+    j["elapsed_ms"] = elapsed / 1000;
+    j["sessions_per_sec"] = elapsed > 0 ? static_cast<double>(moved) * 1e6 / elapsed : 0.0;
+    int64_t tte = migration_time_to_empty_us_.load();
+    j["time_to_empty_ms"] = tte < 0 ? nlohmann::json(nullptr) : nlohmann::json(tte / 1000);
+    return j;
+}
+
 void Server::http_loop() {
     http_svr_ = std::make_shared<httplib::Server>();
     auto svr = http_svr_;
@@ -186,14 +1023,383 @@ void Server::http_loop() {
             return;
         }
         std::string imsi = req.get_param_value("imsi");
+        // checked before it is hashed or pasted into a forwarded path / Location header
+        if (!valid_imsi(imsi)) {
+            res.status = 400;
+            res.set_content("invalid imsi", "text/plain");
+            return;
+        }
+
+        // in cluster mode only the owner knows the answer; local=1 marks an already routed query
+        auto ring = std::atomic_load(&ring_);
+        const HashRing::Node *owner = ring ? ring->owner(imsi) : nullptr;
+        if (owner && owner->member.id != cfg_.cluster_node_id && !req.has_param("local")) {
+            std::string path = "/check_subscriber?imsi=" + imsi + "&local=1";
+            if (cfg_.cluster_mode == "redirect") {
+                res.set_redirect("http://" + owner->member.ip + ":" + std::to_string(owner->member.http_port) + path, 307);
+                return;
+            }
+            httplib::Client cli(owner->member.ip, owner->member.http_port);
+            cli.set_connection_timeout(1, 0);
+            cli.set_read_timeout(2, 0);
+            auto r = cli.Get(path);
+            if (!r) {
+                res.status = 502;
+                res.set_content("owner unreachable", "text/plain");
+                return;
+            }
+            res.status = r->status;
+            res.set_content(r->body, "text/plain");
+            return;
+        }
+
         bool active;
         {
-            std::lock_guard<std::mutex> lk(sess_m_);
-            active = sessions_.find(imsi) != sessions_.end();
+            std::lock_guard<InstrumentedMutex> lk(sess_m_);
+            active = sessions_.contains(imsi);
         }
         res.set_content(active ? "active" : "not active", "text/plain");
     });
 
+    svr->Get("/stats", [this](const httplib::Request&, httplib::Response &res){
+        res.set_content(stats().dump(), "application/json");
+    });
+
+    svr->Get("/trace", [](const httplib::Request &req, httplib::Response &res){
+        int64_t since = 0;
+        if (req.has_param("last_ms")) {
+            try {
+                since = trace_now_ns() - std::stoll(req.get_param_value("last_ms")) * 1000000;
+            } catch (...) {
+                res.status = 400;
+                res.set_content("invalid last_ms", "text/plain");
+                return;
+            }
+        }
+        res.set_content(trace_chrome_json(since), "application/json");
+    });
+
+    svr->Get("/heavy_hitters", [this](const httplib::Request &req, httplib::Response &res){
+        if (!hitters_.enabled()) {
+            res.status = 404;
+            res.set_content("heavy hitter tracking disabled", "text/plain");
+            return;
+        }
+        auto window = hitters_.window();
+        size_t limit = 10;
+        try {
+            if (req.has_param("window")) window = std::chrono::seconds(std::stoul(req.get_param_value("window")));
+            if (req.has_param("limit")) limit = std::stoul(req.get_param_value("limit"));
+        } catch (...) {
+            res.status = 400;
+            res.set_content("bad window or limit", "text/plain");
+            return;
+        }
+        res.set_content(hitters_.json(window, limit).dump(), "application/json");
+    });
+
+    // session lifecycle events, NDJSON or Server-Sent Events; replaces polling
+    // /check_subscriber. Streams only read the event ring, never the table.
+    svr->Get("/events", [this](const httplib::Request &req, httplib::Response &res){
+        if (!events_.enabled()) {
+            res.status = 404;
+            res.set_content("session events disabled", "text/plain");
+            return;
+        }
+        struct Cursor {
+            Server *s;
+            std::shared_ptr<void> slot;
+            uint64_t pos = 0;
+            uint32_t types = ~0u;
+            bool sse = false;
+            bool follow = true;
+            std::chrono::steady_clock::time_point last_write = std::chrono::steady_clock::now();
+            explicit Cursor(Server *srv) : s(srv) { s->event_streams_++; }
+            ~Cursor() { s->event_streams_--; }
+        };
+        auto cur = std::make_shared<Cursor>(this);
+        cur->pos = events_.next_seq();
+        cur->sse = req.get_param_value("format") == "sse" ||
+                   (!req.has_param("format") && req.get_header_value("Accept").find("text/event-stream") != std::string::npos);
+        try {
+            if (req.has_param("format") && !cur->sse && req.get_param_value("format") != "ndjson") {
+                throw std::invalid_argument("format");
+            }
+            // an SSE client reconnecting sends the id of the last event it saw
+            if (req.has_param("since")) cur->pos = std::stoull(req.get_param_value("since"));
+            else if (req.has_header("Last-Event-ID")) cur->pos = std::stoull(req.get_header_value("Last-Event-ID")) + 1;
+            if (req.has_param("follow")) cur->follow = req.get_param_value("follow") != "0";
+            if (req.has_param("types")) {
+                cur->types = 0;
+                std::stringstream ss(req.get_param_value("types"));
+                std::string t;
+                while (std::getline(ss, t, ',')) {
+                    SessionEvents::Kind kind;
+                    if (!SessionEvents::kind_of(t, kind)) throw std::invalid_argument(t);
+                    cur->types |= 1u << static_cast<unsigned>(kind);
+                }
+            }
+        } catch (...) {
+            res.status = 400;
+            res.set_content("bad since, types, format or follow", "text/plain");
+            return;
+        }
+        // a following consumer holds an HTTP worker for as long as it stays connected
+        cur->slot = acquire_stream();
+        if (!cur->slot) {
+            res.status = 503;
+            res.set_header("Retry-After", "1");
+            res.set_content("too many streams", "text/plain");
+            return;
+        }
+        res.set_header("X-Events-Seq", std::to_string(std::min(cur->pos, events_.next_seq())));
+        if (cur->sse) res.set_header("Cache-Control", "no-cache");
+
+        res.set_chunked_content_provider(cur->sse ? "text/event-stream" : "application/x-ndjson",
+                                         [this, cur](size_t, httplib::DataSink &sink) {
+            std::vector<SessionEvents::Event> batch;
+            uint64_t lost = 0;
+            uint64_t from = cur->pos;
+            cur->pos = events_.read(cur->pos, batch, 256, lost);
+
+            std::string out;
+            auto emit = [&](const char *event, uint64_t id, const nlohmann::json &j) {
+                if (cur->sse) {
+                    out += "id: " + std::to_string(id) + "\nevent: " + event + "\ndata: " + j.dump() + "\n\n";
+                } else {
+                    out += j.dump();
+                    out += '\n';
+                }
+            };
+            // a consumer the ring lapped is told what it missed, so it can resync
+            if (lost > 0) {
+                emit("gap", from + lost - 1, {{"event", "gap"}, {"from", from}, {"lost", lost}});
+            }
+            for (const auto &e : batch) {
+                if (!(cur->types & (1u << static_cast<unsigned>(e.kind)))) continue;
+                emit(SessionEvents::name(e.kind), e.seq, {
+                    {"seq", e.seq},
+                    {"event", SessionEvents::name(e.kind)},
+                    {"imsi", unpack_imsi(e.imsi)},
+                    {"ts_ms", e.unix_ms}
+                });
+            }
+            auto now = std::chrono::steady_clock::now();
+            if (out.empty() && cur->sse && now - cur->last_write >= std::chrono::seconds(15)) out = ": keepalive\n\n";
+            if (!out.empty()) {
+                cur->last_write = now;
+                if (!sink.write(out.data(), out.size())) return false;
+            }
+            if (!batch.empty() || lost > 0) return true;
+
+            // caught up
+            if (!running_ || !cur->follow) {
+                sink.done();
+                return true;
+            }
+            auto deadline = now + std::chrono::seconds(1);
+            while (running_ && events_.next_seq() <= cur->pos && std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return !sink.is_writable || sink.is_writable();
+        });
+    });
+
+    svr->Get("/cluster", [this](const httplib::Request&, httplib::Response &res){
+        if (!std::atomic_load(&ring_)) {
+            res.status = 404;
+            res.set_content("cluster mode disabled", "text/plain");
+            return;
+        }
+        res.set_content(cluster_json().dump(), "application/json");
+    });
+
+    // membership changes: full replacement, join (add or update one) and leave
+    svr->Post("/cluster/members", [this](const httplib::Request &req, httplib::Response &res){
+        if (!std::atomic_load(&ring_)) {
+            res.status = 404;
+            res.set_content("cluster mode disabled", "text/plain");
+            return;
+        }
+        std::vector<ClusterMember> members;
+        try {
+            auto j = nlohmann::json::parse(req.body);
+            for (const auto &m : j.at("members")) members.push_back(cluster_member_from_json(m));
+        } catch (const std::exception &e) {
+            res.status = 400;
+            res.set_content(std::string("bad members: ") + e.what(), "text/plain");
+            return;
+        }
+        set_cluster_members(std::move(members));
+        res.set_content("ok", "text/plain");
+    });
+
+    svr->Post("/cluster/join", [this](const httplib::Request &req, httplib::Response &res){
+        auto ring = std::atomic_load(&ring_);
+        if (!ring) {
+            res.status = 404;
+            res.set_content("cluster mode disabled", "text/plain");
+            return;
+        }
+        ClusterMember joining;
+        try {
+            joining = cluster_member_from_json(nlohmann::json::parse(req.body));
+        } catch (const std::exception &e) {
+            res.status = 400;
+            res.set_content(std::string("bad member: ") + e.what(), "text/plain");
+            return;
+        }
+        std::vector<ClusterMember> members;
+        for (const auto &n : ring->members()) {
+            if (n.member.id != joining.id) members.push_back(n.member);
+        }
+        members.push_back(joining);
+        set_cluster_members(std::move(members));
+        res.set_content("ok", "text/plain");
+    });
+
+    svr->Post("/cluster/leave", [this](const httplib::Request &req, httplib::Response &res){
+        auto ring = std::atomic_load(&ring_);
+        if (!ring) {
+            res.status = 404;
+            res.set_content("cluster mode disabled", "text/plain");
+            return;
+        }
+        if (!req.has_param("id")) {
+            res.status = 400;
+            res.set_content("missing id param", "text/plain");
+            return;
+        }
+        std::string id = req.get_param_value("id");
+        std::vector<ClusterMember> members;
+        for (const auto &n : ring->members()) {
+            if (n.member.id != id) members.push_back(n.member);
+        }
+        set_cluster_members(std::move(members));
+        res.set_content("ok", "text/plain");
+    });
+
+    svr->Get("/cdr/stream", [this](const httplib::Request &req, httplib::Response &res){
+        if (!cdr_->ok()) {
+            res.status = 503;
+            res.set_content("cdr file not available", "text/plain");
+            return;
+        }
+        uint64_t start = 0;
+        int wait_ms = 0;
+        try {
+            if (req.has_param("seq")) {
+                start = cdr_->offset_of_seq(std::stoull(req.get_param_value("seq")));
+                res.set_header("X-CDR-Seq", req.get_param_value("seq"));
+            } else if (req.has_param("offset")) {
+                start = std::stoull(req.get_param_value("offset"));
+            }
+            if (req.has_param("wait_ms")) wait_ms = std::clamp(std::stoi(req.get_param_value("wait_ms")), 0, 60000);
+        } catch (...) {
+            res.status = 400;
+            res.set_content("bad offset, seq or wait_ms", "text/plain");
+            return;
+        }
+        if (start > cdr_->size()) {
+            res.status = 416;
+            res.set_content("offset past end of cdr file", "text/plain");
+            return;
+        }
+        const bool follow = req.has_param("follow") && req.get_param_value("follow") == "1";
+        // a following or long-polling client holds an HTTP worker the whole time
+        auto slot = acquire_stream();
+        if (!slot) {
+            res.status = 503;
+            res.set_header("Retry-After", "1");
+            res.set_content("too many streams", "text/plain");
+            return;
+        }
+        res.set_header("X-CDR-Offset", std::to_string(start));
+
+        // whole records only: the writer publishes size() after each complete line.
+        // Data goes from the page cache mapping straight into the socket writes.
+        struct Cursor { uint64_t pos; std::shared_ptr<void> slot; bool sent = false; bool waited = false; };
+        auto cur = std::make_shared<Cursor>(Cursor{start, std::move(slot)});
+        res.set_chunked_content_provider("text/plain", [this, cur, wait_ms, follow](size_t, httplib::DataSink &sink) {
+            bool write_ok = true;
+            size_t n = cdr_->map_range(cur->pos, 1 << 20, [&](const char *data, size_t len) {
+                write_ok = sink.write(data, len);
+                return write_ok;
+            });
+            if (!write_ok) return false;
+            if (n > 0) {
+                cur->pos += n;
+                cur->sent = true;
+                return true;
+            }
+
+            // caught up with the writer
+            bool keep_waiting = follow || (!cur->sent && !cur->waited && wait_ms > 0);
+            if (!running_ || !keep_waiting) {
+                sink.done();
+                return true;
+            }
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(follow ? 1000 : wait_ms);
+            while (running_ && std::chrono::steady_clock::now() < deadline &&
+                   !cdr_->wait_beyond(cur->pos, std::chrono::milliseconds(200))) {}
+            cur->waited = true;
+            return !sink.is_writable || sink.is_writable();
+        });
+    });
+
+    svr->Get("/cdr/query", [this](const httplib::Request &req, httplib::Response &res){
+        if (!req.has_param("imsi")) {
+            res.status = 400;
+            res.set_content("missing imsi param", "text/plain");
+            return;
+        }
+        CdrQuery q;
+        q.imsi = req.get_param_value("imsi");
+        try {
+            if (req.has_param("from")) q.from_ts = std::stoll(req.get_param_value("from"));
+            if (req.has_param("to")) q.to_ts = std::stoll(req.get_param_value("to"));
+            if (req.has_param("since")) {
+                q.from_ts = std::chrono::system_clock::to_time_t(clock_->wall_now()) - std::stoll(req.get_param_value("since"));
+            }
+            if (req.has_param("limit")) q.limit = std::stoul(req.get_param_value("limit"));
+        } catch (...) {
+            res.status = 400;
+            res.set_content("bad from, to, since or limit", "text/plain");
+            return;
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        CdrQueryResult out;
+        std::string err;
+        if (!query_cdr(cdr_->path(), cdr_->size(), q, out, &err)) {
+            res.status = err == "invalid imsi" ? 400 : 500;
+            res.set_content(err, "text/plain");
+            return;
+        }
+        nlohmann::json j = {
+            {"imsi", q.imsi},
+            {"records", out.records},
+            {"segments_searched", out.segments_searched},
+            {"segments_skipped", out.segments_skipped},
+            {"tail_bytes_scanned", out.tail_bytes_scanned},
+            {"elapsed_us", std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - t0).count()}
+        };
+        res.set_content(j.dump(), "application/json");
+    });
+
+    svr->Post("/cluster/adopt", [this](const httplib::Request &req, httplib::Response &res){
+        std::vector<SessionRecord> records;
+        if (!decode_session_batch(req.body, records)) {
+            res.status = 400;
+            res.set_content("bad session batch", "text/plain");
+            return;
+        }
+        size_t adopted = adopt_sessions(records);
+        nlohmann::json j = {{"adopted", adopted}, {"skipped", records.size() - adopted}};
+        res.set_content(j.dump(), "application/json");
+    });
+
     svr->Post("/stop", [this, svr](const httplib::Request &req, httplib::Response &res){
         if (offloading_) {
             res.set_content("already offloading", "text/plain");
@@ -206,23 +1412,26 @@ void Server::http_loop() {
                 if (rate == 0) rate = 1;
             } catch (...) {}
         }
+
+        std::string peer_addr = req.has_param("peer") ? req.get_param_value("peer") : cfg_.migration_peer;
+        if (!peer_addr.empty()) {
+            ClusterMember peer;
+            if (!parse_migration_peer(peer_addr, peer)) {
+                res.status = 400;
+                res.set_content("invalid peer, expected ip:http_port", "text/plain");
+                return;
+            }
+            spdlog::info("HTTP /stop called, migrating sessions to {}", peer_addr);
+            start_migration(peer, rate);
+            res.set_content("migration_started", "text/plain");
+            return;
+        }
         spdlog::info("HTTP /stop called, starting offload at rate {}", rate);
 
         offloading_ = true;
         std::thread([this, rate, svr]() {
             try {
-                while (this->running_) {
-                    size_t removed = remove_sessions_batch(this->sessions_, this->sess_m_, rate,
-                        [this](const std::string &imsi) {
-                            this->append_cdr(imsi, "offloaded");
-                            spdlog::info("Offloaded {}", imsi);
-                        });
-                    if (removed == 0) {
-                        spdlog::info("Offload complete - no sessions left");
-                        break;
-                    }
-                    std::this_thread::sleep_for(std::chrono::seconds(1));
-                }
+                this->offload_remaining(rate);
             } catch (const std::exception &e) {
                 spdlog::error("Exception in offload thread: {}", e.what());
             } catch (...) {
@@ -242,6 +1451,16 @@ void Server::http_loop() {
         res.set_content("offload_started", "text/plain");
     });
 
+    svr->Post("/takeover", [this](const httplib::Request&, httplib::Response &res){
+        if (!standby_) {
+            res.status = 409;
+            res.set_content("not a waiting standby", "text/plain");
+            return;
+        }
+        takeover_requested_ = true;
+        res.set_content("takeover_started", "text/plain");
+    });
+
     svr->Get("/health", [](const httplib::Request&, httplib::Response &res){
         res.set_content("ok", "text/plain");
     });
@@ -254,6 +1473,210 @@ void Server::http_loop() {
     }
 }
 
+std::string Server::handle_imsi(const std::string &imsi) {
+    Core::Outcome out;
+    int64_t t0 = trace_now_ns();
+    {
+        std::lock_guard<InstrumentedMutex> lk(sess_m_);
+        PGW_TRACE_SPAN_END(session_lock, t0, 0);
+        int64_t t1 = trace_now_ns();
+        out = core_.handle(imsi);
+        PGW_TRACE_SPAN_END(session_decision, t1, pack_imsi(imsi));
+    }
+
+    std::string reply = out.reply;
+    if (reply == "rejected") {
+        spdlog::info("IMSI {} is blacklisted -> rejected", imsi);
+    } else if (reply == "active") {
+        spdlog::debug("Session refreshed for {}", imsi);
+    } else if (reply == "created") {
+        spdlog::info("Session created for {}", imsi);
+    } else if (reply == "no_capacity") {
+        capacity_rejected_total_++;
+        spdlog::warn("Session table full ({}), rejecting {}", cfg_.max_sessions, imsi);
+    }
+    if (!out.evicted.empty()) {
+        evicted_total_++;
+        spdlog::info("Session {} evicted to make room for {}", out.evicted, imsi);
+    }
+    return reply;
+}
+
+std::vector<uint8_t> Server::handle_v2(const sockaddr_in &cli, const uint8_t *data, size_t len,
+                                       bool relayed, ClusterForwarder *forwarder) {
+    ProtoHeader hdr;
+    std::vector<std::string> imsis;
+    if (!decode_v2_request(data, len, hdr, imsis)) {
+        v2_malformed_total_++;
+        spdlog::warn("Malformed v2 datagram ({} bytes) from {}:{}", len,
+                     inet_ntoa(cli.sin_addr), ntohs(cli.sin_port));
+        return {};
+    }
+    PGW_TRACE_INSTANT(packet_decoded, imsis.size());
+    v2_requests_total_++;
+    v2_imsis_total_ += imsis.size();
+    if (hitters_.enabled()) {
+        for (const auto &imsi : imsis) hitters_.add_imsi(pack_imsi(imsi));
+    }
+    spdlog::debug("Received v2 txid {} with {} IMSIs from {}:{}", hdr.txid, imsis.size(),
+                  inet_ntoa(cli.sin_addr), ntohs(cli.sin_port));
+
+    // cluster: a datagram that belongs entirely to one other node is forwarded
+    // as a unit; mixed datagrams answer not_owner for the foreign entries
+    auto ring = relayed ? nullptr : std::atomic_load(&ring_);
+    std::vector<const HashRing::Node*> owners(imsis.size(), nullptr);
+    if (ring) {
+        const HashRing::Node *single = nullptr;
+        bool one_owner = true;
+        for (size_t i = 0; i < imsis.size(); ++i) {
+            if (imsis[i].empty()) continue;
+            owners[i] = ring->owner(imsis[i]);
+            if (!owners[i]) continue;
+            if (!single) single = owners[i];
+            else if (owners[i]->member.id != single->member.id) one_owner = false;
+        }
+        if (forwarder && one_owner && single && single->member.id != cfg_.cluster_node_id) {
+            forwarder->forward(cli, data, len, single->udp_addr);
+            return {};
+        }
+    }
+
+    std::vector<ResultCode> results;
+    results.reserve(imsis.size());
+    for (size_t i = 0; i < imsis.size(); ++i) {
+        if (imsis[i].empty()) {
+            results.push_back(ResultCode::malformed);
+        } else if (owners[i] && owners[i]->member.id != cfg_.cluster_node_id) {
+            redirected_total_++;
+            results.push_back(ResultCode::not_owner);
+        } else {
+            results.push_back(result_code_from_reply(handle_imsi(imsis[i])));
+        }
+    }
+
+    return encode_v2_reply(hdr.txid, results);
+}
+
+// moves idle sessions to the cold tier in short batches so the attach path
+// never waits long for sess_m_
+void Server::demote_idle() {
+    constexpr size_t batch = 4096;
+    constexpr size_t per_sweep = 1u << 20;
+    const auto idle = std::chrono::seconds(cfg_.cold_tier_idle_sec);
+    for (size_t total = 0; total < per_sweep && running_;) {
+        size_t n;
+        uint64_t moved;
+        {
+            std::lock_guard<InstrumentedMutex> lk(sess_m_);
+            uint64_t before = sessions_.demoted_total();
+            n = sessions_.demote(clock_->now(), idle, batch);
+            moved = sessions_.demoted_total() - before;
+        }
+        total += n;
+        // a batch that moved nothing would only look at the same sessions again
+        if (n < batch || moved == 0) break;
+    }
+}
+
+bool Server::start_status_threads() {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(cfg_.status_udp_port));
+    if (inet_pton(AF_INET, cfg_.udp_ip.c_str(), &addr.sin_addr) <= 0) {
+        spdlog::error("Invalid UDP IP: {}", cfg_.udp_ip);
+        return false;
+    }
+
+    int threads = std::max(cfg_.status_threads, 1);
+    std::vector<int> socks;
+    for (int i = 0; i < threads; ++i) {
+        int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+        int one = 1;
+        // one socket per thread, the kernel spreads queries across them
+        if (sock < 0 || setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0 ||
+            bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            spdlog::error("Status port {} unavailable: {}", cfg_.status_udp_port, strerror(errno));
+            if (sock >= 0) close(sock);
+            for (int s : socks) close(s);
+            return false;
+        }
+        struct timeval tv{};
+        tv.tv_usec = 200000;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(tv));
+        socks.push_back(sock);
+    }
+    for (int sock : socks) status_threads_.emplace_back(&Server::status_loop, this, sock);
+    spdlog::info("Status queries on UDP {}:{} ({} threads)", cfg_.udp_ip, cfg_.status_udp_port, threads);
+    return true;
+}
+
+// A v2-framed status_query gets a status_reply bitmap; a bare BCD IMSI gets
+// one byte, 1 = active. Returns the reply length, 0 = nothing to send.
+size_t Server::handle_status(const uint8_t *data, size_t len, uint8_t *reply, size_t cap) {
+    thread_local std::vector<std::string> imsis;
+    thread_local std::vector<bool> active;
+    ProtoHeader hdr;
+
+    if (!is_proto_v2(data, len)) {
+        std::string imsi;
+        try {
+            imsi = decode_imsi_bcd(std::vector<uint8_t>(data, data + len));
+        } catch (...) {
+            status_malformed_++;
+            return 0;
+        }
+        status_imsis_++;
+        bool on = is_active(imsi);
+        if (on) status_active_++;
+        reply[0] = on ? 1 : 0;
+        return 1;
+    }
+
+    if (!decode_status_query(data, len, hdr, imsis)) {
+        status_malformed_++;
+        return 0;
+    }
+    active.assign(imsis.size(), false);
+    size_t hits = 0;
+    {
+        // one lock per datagram, never touches last-seen times
+        std::lock_guard<InstrumentedMutex> lk(sess_m_);
+        for (size_t i = 0; i < imsis.size(); ++i) {
+            if (!imsis[i].empty() && sessions_.contains(imsis[i])) {
+                active[i] = true;
+                ++hits;
+            }
+        }
+    }
+    status_imsis_ += imsis.size();
+    status_active_ += hits;
+
+    auto out = encode_status_reply(hdr.txid, active);
+    if (out.size() > cap) return 0;
+    std::memcpy(reply, out.data(), out.size());
+    return out.size();
+}
+
+void Server::status_loop(int sock) {
+    try {
+        trace_thread_name("status");
+        uint8_t buf[1500];
+        uint8_t reply[proto_v2_header_size + proto_v2_max_imsis / 8];
+        while (running_) {
+            sockaddr_in cli{};
+            socklen_t cli_len = sizeof(cli);
+            ssize_t r = recvfrom(sock, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&cli), &cli_len);
+            if (r <= 0) continue;
+            status_queries_++;
+            size_t n = handle_status(buf, static_cast<size_t>(r), reply, sizeof(reply));
+            if (n > 0) sendto(sock, reply, n, 0, reinterpret_cast<sockaddr*>(&cli), cli_len);
+        }
+    } catch (const std::exception &e) {
+        spdlog::error("Exception in status thread: {}", e.what());
+    }
+    close(sock);
+}
+
 void Server::udp_loop() {
     int sock = ::socket(AF_INET, SOCK_DGRAM, 0);
     if (sock < 0) {
@@ -278,32 +1701,74 @@ void Server::udp_loop() {
         running_ = false;
         return;
     }
+    const auto bound_at = std::chrono::steady_clock::now();
+    startup_us_ = std::chrono::duration_cast<std::chrono::microseconds>(bound_at - created_).count();
+    spdlog::info("Startup took {:.1f} ms", static_cast<double>(startup_us_.load()) / 1000.0);
 
     struct timeval tv{};
     tv.tv_sec = 1;
     tv.tv_usec = 0;
     setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&tv), sizeof(tv));
 
+    if (cfg_.udp_rcvbuf_bytes > 0) {
+        if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &cfg_.udp_rcvbuf_bytes, sizeof(cfg_.udp_rcvbuf_bytes)) < 0) {
+            spdlog::warn("setsockopt SO_RCVBUF failed: {}", strerror(errno));
+        }
+    }
+    int rcvbuf = 0;
+    socklen_t rcvbuf_len = sizeof(rcvbuf);
+    if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &rcvbuf_len) == 0) {
+        rcvbuf_bytes_ = rcvbuf;
+        spdlog::info("UDP receive buffer: {} bytes", rcvbuf);
+    }
+
+    // kernel drop counter and receive timestamps arrive as control messages
+    int one = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one)) < 0) {
+        spdlog::warn("setsockopt SO_RXQ_OVFL failed: {}", strerror(errno));
+    }
+    if ((cfg_.overload_lag_ms > 0 || capture_) &&
+        setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0) {
+        spdlog::warn("setsockopt SO_TIMESTAMPNS failed: {}", strerror(errno));
+    }
+
+    SourceRateLimiter limiter(cfg_.rate_limit_table_size, cfg_.rate_limit_pps, cfg_.rate_limit_burst);
+    ResponseCache replies(cfg_.retransmit_cache_size, cfg_.retransmit_cache_ms);
+
+    std::unique_ptr<ClusterForwarder> forwarder;
+    if (!cfg_.cluster_node_id.empty() && cfg_.cluster_mode == "forward") {
+        forwarder = std::make_unique<ClusterForwarder>(sock, cfg_.cluster_forward_timeout_ms, fwd_counters_);
+    }
+    const int64_t overload_enter_us = static_cast<int64_t>(cfg_.overload_lag_ms) * 1000;
+    const bool fast_reject = cfg_.overload_action == "reject";
+
     spdlog::info("UDP server listening on {}:{}", cfg_.udp_ip, cfg_.udp_port);
+    trace_thread_name("udp");
+
+    // reply latency: overall, while the cleaner is expiring sessions, and
+    // for the first minute while the table is still filling up
+    bool first_minute = true;
+    bool rx_expiring = false;
+    std::chrono::steady_clock::time_point rx_at;
+    auto replied = [&]() {
+        auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - rx_at).count());
+        reply_us_.record(us);
+        if (rx_expiring) reply_expiring_us_.record(us);
+        if (first_minute) first_minute_us_.record(us);
+    };
 
     std::thread cleaner([this]() {
         try {
+            trace_thread_name("cleaner");
             while (running_) {
-                std::this_thread::sleep_for(std::chrono::seconds(1));
-                std::vector<std::string> expired;
-                auto now = std::chrono::steady_clock::now();
-                {
-                    std::lock_guard<std::mutex> lk(sess_m_);
-                    for (auto it = sessions_.begin(); it != sessions_.end(); ++it) {
-                        auto diff = std::chrono::duration_cast<std::chrono::seconds>(now - it->second).count();
-                        if (diff >= cfg_.session_timeout_sec) expired.push_back(it->first);
-                    }
-                    for (const auto &imsi : expired) sessions_.erase(imsi);
-                }
-                for (const auto &imsi : expired) {
-                    append_cdr(imsi, "timeout");
-                    spdlog::info("Session {} timed out and removed", imsi);
-                }
+                if (!clock_->sleep_for(std::chrono::seconds(1), running_)) break;
+                cleaner_monitor_.busy();
+                uint64_t rss = cfg_.adaptive_memory_high_mb > 0 ? AdaptiveExpiry::process_rss_bytes() : 0;
+                expire_due(rss);
+                if (sessions_.cold_tier() && cfg_.cold_tier_idle_sec > 0) demote_idle();
+                if (shm_) shm_->tick();
+                cleaner_monitor_.idle();
             }
         } catch (const std::exception &e) {
             spdlog::error("Exception in cleaner thread: {}", e.what());
@@ -312,62 +1777,213 @@ void Server::udp_loop() {
         }
     });
 
-    while (running_) {
-        uint8_t buf[512];
-        sockaddr_in cli{};
-        socklen_t cli_len = sizeof(cli);
-        ssize_t r = recvfrom(sock, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&cli), &cli_len);
-        if (r < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) continue;
-            if (errno == EINTR) continue;
-            spdlog::error("recvfrom error: {}", strerror(errno));
-            break;
+    // one received datagram, from the socket or the XDP ring; replies go
+    // back the same way through send(data, len)
+    auto process = [&](const sockaddr_in &cli, const uint8_t *buf, ssize_t r, const timespec *rx_ts, auto &&send) {
+        rx_at = std::chrono::steady_clock::now();
+        rx_expiring = expiring_.load(std::memory_order_relaxed);
+        if (first_minute) first_minute = rx_at - bound_at < std::chrono::minutes(1);
+        udp_received_total_++;
+        PGW_TRACE_INSTANT(packet_received, r);
+
+        if (capture_) {
+            timespec ts{};
+            if (rx_ts) ts = *rx_ts;
+            else clock_gettime(CLOCK_REALTIME, &ts);
+            capture_->append(ts.tv_sec * 1000000000LL + ts.tv_nsec, cli.sin_addr.s_addr, cli.sin_port,
+                             buf, static_cast<size_t>(r));
+        }
+        if (hitters_.enabled()) hitters_.add_peer(cli.sin_addr.s_addr, core_clock_.now());
+
+        uint64_t now_ns = 0;
+        if (limiter.enabled() || replies.enabled()) {
+            now_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+        if (limiter.enabled() && !limiter.allow(cli.sin_addr.s_addr, now_ns)) {
+            rate_limited_total_++;
+            return;
+        }
+
+        // retransmitted request: answer from the cache, the session table and
+        // CDR log have already seen it (relayed datagrams come from ephemeral
+        // peer sockets and are not cached)
+        uint64_t cache_key = 0;
+        if (replies.enabled() && r > 0 && buf[0] != cluster_forward_marker) {
+            cache_key = ResponseCache::key(cli.sin_addr.s_addr, cli.sin_port, buf, static_cast<size_t>(r));
+            if (const std::string *cached = replies.lookup(cache_key, now_ns)) {
+                retransmit_hits_++;
+                send(cached->data(), cached->size());
+                replied();
+                return;
+            }
+            retransmit_misses_++;
+        }
+
+        if (overload_enter_us > 0 && rx_ts) {
+            // queueing delay: time the datagram spent in the socket buffer
+            timespec now{};
+            clock_gettime(CLOCK_REALTIME, &now);
+            int64_t lag_us = (now.tv_sec - rx_ts->tv_sec) * 1000000LL + (now.tv_nsec - rx_ts->tv_nsec) / 1000;
+            rx_lag_us_ = lag_us;
+            if (!overloaded_ && lag_us >= overload_enter_us) {
+                overloaded_ = true;
+                spdlog::warn("Overload: receive lag {} us, {} new requests", lag_us, fast_reject ? "rejecting" : "shedding");
+            } else if (overloaded_ && lag_us < overload_enter_us / 2) {
+                overloaded_ = false;
+                spdlog::info("Overload cleared: receive lag {} us", lag_us);
+            }
+        }
+        if (overloaded_) {
+            if (fast_reject) {
+                fast_rejected_total_++;
+                ProtoHeader hdr;
+                std::vector<std::string> imsis;
+                if (decode_v2_request(buf, static_cast<size_t>(r), hdr, imsis)) {
+                    auto busy = encode_v2_reply(hdr.txid, std::vector<ResultCode>(imsis.size(), ResultCode::busy));
+                    send(busy.data(), busy.size());
+                } else {
+                    static const char busy[] = "busy";
+                    send(busy, sizeof(busy) - 1);
+                }
+            } else {
+                shed_total_++;
+            }
+            return;
         }
 
-        std::vector<uint8_t> incoming(buf, buf + r);
+        // datagrams relayed by a peer carry a marker byte and are always ours
+        bool relayed = r > 0 && buf[0] == cluster_forward_marker;
+        const uint8_t *payload = relayed ? buf + 1 : buf;
+        size_t payload_len = static_cast<size_t>(r) - (relayed ? 1 : 0);
+
+        if (is_proto_v2(payload, payload_len)) {
+            auto reply = handle_v2(cli, payload, payload_len, relayed, forwarder.get());
+            if (reply.empty()) return;
+            if (cache_key) replies.store(cache_key, now_ns, reply.data(), reply.size());
+            ssize_t sent = send(reply.data(), reply.size());
+            if (sent < 0) spdlog::warn("sendto failed: {}", strerror(errno));
+            else PGW_TRACE_INSTANT(reply_sent, sent);
+            replied();
+            return;
+        }
+
+        std::vector<uint8_t> incoming(payload, payload + payload_len);
         std::string imsi;
         try {
             imsi = decode_imsi_bcd(incoming);
         } catch (...) {
             spdlog::warn("Failed to decode BCD IMSI from {} bytes", r);
-            continue;
+            return;
         }
+        // decode_imsi_bcd is lenient: empty datagrams and non-digit nibbles
+        // come out as "" or ":" and must not become sessions
+        if (!valid_imsi(imsi)) {
+            spdlog::warn("Invalid IMSI in {} byte datagram from {}:{}", r,
+                         inet_ntoa(cli.sin_addr), ntohs(cli.sin_port));
+            return;
+        }
+        PGW_TRACE_INSTANT(packet_decoded, 1);
+        if (hitters_.enabled()) hitters_.add_imsi(pack_imsi(imsi));
 
         spdlog::info("Received IMSI '{}' from {}:{}", imsi,
                      inet_ntoa(cli.sin_addr), ntohs(cli.sin_port));
 
-        std::string reply;
-        bool was_blacklisted = false;
-        {
-            std::lock_guard<std::mutex> lk(sess_m_);
-            if (is_blacklisted(imsi)) {
-                reply = "rejected";
-                was_blacklisted = true;
-            } else {
-                auto it = sessions_.find(imsi);
-                if (it == sessions_.end()) {
-                    sessions_[imsi] = std::chrono::steady_clock::now();
-                    append_cdr(imsi, "created");
-                    reply = "created";
-                    spdlog::info("Session created for {}", imsi);
+        if (!relayed) {
+            auto ring = std::atomic_load(&ring_);
+            const HashRing::Node *owner = ring ? ring->owner(imsi) : nullptr;
+            if (owner && owner->member.id != cfg_.cluster_node_id) {
+                if (forwarder) {
+                    spdlog::debug("IMSI {} owned by {}, forwarding", imsi, owner->member.id);
+                    forwarder->forward(cli, payload, payload_len, owner->udp_addr);
                 } else {
-                    it->second = std::chrono::steady_clock::now();
-                    reply = "active";
-                    spdlog::debug("Session refreshed for {}", imsi);
+                    redirected_total_++;
+                    std::string redirect = "redirect " + owner->member.ip + ":" + std::to_string(owner->member.udp_port);
+                    send(redirect.c_str(), redirect.size());
                 }
+                return;
             }
         }
 
-        if (was_blacklisted) {
-            append_cdr(imsi, "rejected");
-            spdlog::info("IMSI {} is blacklisted -> rejected", imsi);
-        }
+        std::string reply = handle_imsi(imsi);
+        if (cache_key) replies.store(cache_key, now_ns, reply.data(), reply.size());
 
-        ssize_t sent = sendto(sock, reply.c_str(), reply.size(), 0, reinterpret_cast<sockaddr*>(&cli), cli_len);
+        ssize_t sent = send(reply.c_str(), reply.size());
         if (sent < 0) spdlog::warn("sendto failed: {}", strerror(errno));
+        else PGW_TRACE_INSTANT(reply_sent, sent);
+        replied();
+    };
+
+    while (running_) {
+        uint8_t buf[1500];
+        sockaddr_in cli{};
+        alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(timespec))];
+        iovec iov{buf, sizeof(buf)};
+        msghdr msg{};
+        msg.msg_name = &cli;
+        msg.msg_namelen = sizeof(cli);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        udp_monitor_.idle();
+        int flags = 0;
+        if (xdp_) {
+            // both sources share this thread: wait on either, drain the XDP
+            // rings (completions too) every round, then the socket if ready
+            pollfd fds[2] = {{sock, POLLIN, 0}, {xdp_->fd(), POLLIN, 0}};
+            if (poll(fds, 2, 1000) < 0 && errno != EINTR) {
+                spdlog::error("poll error: {}", strerror(errno));
+                break;
+            }
+            udp_monitor_.busy();
+            // frames carry no kernel timestamp: take the time the ring was
+            // drained, so a backlog worked through in one round still shows
+            // up as receive lag for overload detection
+            timespec xdp_ts{};
+            clock_gettime(CLOCK_REALTIME, &xdp_ts);
+            xdp_->receive([&](XdpSocket::Packet &p) {
+                process(p.src, p.payload, static_cast<ssize_t>(p.len), &xdp_ts, [&](const void *data, size_t len) {
+                    if (p.send(data, len)) return static_cast<ssize_t>(len);
+                    errno = ENOBUFS;
+                    return static_cast<ssize_t>(-1);
+                });
+            });
+            udp_monitor_.idle();
+            flags = MSG_DONTWAIT;
+        }
+        ssize_t r = recvmsg(sock, &msg, flags);
+        if (r < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (hitters_.enabled()) hitters_.tick(core_clock_.now());
+                continue;
+            }
+            if (errno == EINTR) continue;
+            spdlog::error("recvmsg error: {}", strerror(errno));
+            break;
+        }
+        udp_monitor_.busy();
+        socklen_t cli_len = msg.msg_namelen;
+
+        const timespec *rx_ts = nullptr;
+        for (cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET) continue;
+            if (c->cmsg_type == SO_RXQ_OVFL) {
+                uint32_t drops;
+                std::memcpy(&drops, CMSG_DATA(c), sizeof(drops));
+                kernel_drops_ = drops;
+            } else if (c->cmsg_type == SCM_TIMESTAMPNS) {
+                rx_ts = reinterpret_cast<const timespec*>(CMSG_DATA(c));
+            }
+        }
+        process(cli, buf, r, rx_ts, [&](const void *data, size_t len) {
+            return sendto(sock, data, len, 0, reinterpret_cast<const sockaddr*>(&cli), cli_len);
+        });
     }
 
+    udp_monitor_.idle();
     spdlog::info("UDP loop exiting, closing socket");
+    forwarder.reset();
     close(sock);
 
     if (cleaner.joinable()) cleaner.join();
@@ -12,6 +12,25 @@
 #include <functional>
 
 #include <httplib.h>
+#include <nlohmann/json.hpp>
+
+#include "session_table.h"
+#include "cdr_log.h"
+#include "session_batch.h"
+#include "cluster.h"
+#include "replication.h"
+#include "session_mirror.h"
+#include "session_core.h"
+#include "clock.h"
+#include "instrumented_mutex.h"
+#include "loop_monitor.h"
+#include "packet_capture.h"
+#include "adaptive_expiry.h"
+#include "session_arena.h"
+#include "latency_histogram.h"
+#include "heavy_hitters.h"
+#include "xdp_socket.h"
+#include "session_events.h"
 
 struct Config {
     std::string udp_ip = "0.0.0.0";
@@ -23,11 +42,87 @@ struct Config {
     std::string log_file = "server.log";
     std::string log_level = "info";
     std::vector<std::string> blacklist;
+    size_t max_sessions = 0;                // 0 = unlimited
+    std::string capacity_policy = "reject"; // "reject" or "evict_lru"
+    int udp_rcvbuf_bytes = 0;               // SO_RCVBUF, 0 = kernel default
+    uint32_t rate_limit_pps = 0;            // per source address, 0 = disabled
+    uint32_t rate_limit_burst = 20;
+    size_t rate_limit_table_size = 4096;
+    int overload_lag_ms = 0;                // queueing delay that enables overload mode, 0 = disabled
+    std::string overload_action = "shed";   // "shed" (drop) or "reject" (reply "busy")
+    uint32_t retransmit_cache_ms = 0;       // window in which a repeated request gets the cached reply, 0 = off
+    size_t retransmit_cache_size = 4096;
+    uint64_t cdr_index_segment_bytes = 64ull << 20; // CDR bytes per indexed segment, 0 = no sidecar index
+    size_t max_streams = 4;                 // concurrent /cdr/stream and /events responses (each holds a worker), 0 = no limit
+    std::string session_shm_name;           // POSIX shm name of the session mirror, empty = off
+    uint64_t session_shm_slots = 0;         // 0 = twice max_sessions, or 1M when unbounded
+    size_t trace_ring_size = 4096;          // trace events kept per thread for /trace, 0 = off
+    std::string cold_tier_file;             // memory-mapped file for idle sessions, empty = RAM only
+    int cold_tier_idle_sec = 300;           // idle time before a session is moved to the cold tier
+    uint64_t cold_tier_slots = 0;           // 0 = twice max_sessions, or 16M when unbounded
+    int status_udp_port = 0;                // read-only status query port, 0 = off
+    int status_threads = 1;                 // threads serving it, one SO_REUSEPORT socket each
+    int watchdog_stall_ms = 1000;           // warn when a loop is busy this long without waiting, 0 = off
+    std::string capture_file;               // record received datagrams for pgw_replay, empty = off
+    size_t capture_buffer_bytes = 8u << 20; // ring between the UDP loop and the capture writer
+    uint64_t capture_max_bytes = 0;         // stop capturing at this file size, 0 = no limit
+
+    // expiry work per cleaner tick; what is left over waits for the next tick
+    size_t expiry_max_per_tick = 0;            // sessions removed per tick, 0 = no limit
+    int expiry_budget_ms = 0;                  // time spent removing them per tick, 0 = no limit
+
+    // adaptive expiry: low-activity sessions time out sooner under pressure
+    int adaptive_timeout_min_sec = 0;          // their timeout at full pressure, 0 = off
+    uint32_t adaptive_min_refreshes = 1;       // sessions refreshed fewer times are low-activity
+    double adaptive_occupancy_low = 0.7;       // watermarks, fraction of max_sessions
+    double adaptive_occupancy_high = 0.9;
+    uint64_t adaptive_memory_low_mb = 0;       // RSS watermarks, 0 = memory not watched
+    uint64_t adaptive_memory_high_mb = 0;
+
+    // session storage pre-sized at startup: 0 = grows on demand
+    size_t expected_sessions = 0;              // sessions to reserve (at least max_sessions)
+    std::string huge_pages = "transparent";    // "off", "transparent" or "explicit" (MAP_HUGETLB)
+    bool prefault = true;                      // touch every page before the UDP socket is bound
+
+    // busiest IMSIs and source addresses, GET /heavy_hitters
+    size_t heavy_hitters_top = 0;              // counters per slot and key kind, 0 = off
+    int heavy_hitters_window_sec = 60;         // sliding window, kept in 10 slots of at least 1 s
+    double heavy_hitters_alert_share = 0;      // log a warning when one key sends more of a slot, 0 = off
+
+    // session lifecycle events for GET /events
+    size_t events_buffer = 0;                  // events kept for slow or resuming consumers, 0 = off
+
+    // AF_XDP receive path next to the UDP socket (build with -DENABLE_XDP=ON)
+    std::string xdp_interface;                 // interface to attach to, empty = off
+    uint32_t xdp_queue = 0;                    // RX queue bound to the XDP socket
+    std::string xdp_mode = "generic";          // "generic" (SKB, works on veth) or "native" (driver)
+    uint32_t xdp_frames = 4096;                // UMEM frames of 2 KiB
+
+    // cluster mode is off while cluster_node_id is empty
+    std::string cluster_node_id;
+    std::vector<ClusterMember> cluster_members; // including this node
+    std::string cluster_mode = "forward";      // "forward" or "redirect"
+    int cluster_vnodes = 64;
+    int cluster_forward_timeout_ms = 500;
+    size_t cluster_batch = 1000;               // sessions per hand-over request
+
+    // hot-standby replication
+    std::string replication_role = "none";     // "none", "active" or "standby"
+    std::string replication_peer;              // active: standby address "ip:port"
+    int replication_port = 0;                  // standby: TCP port for the stream (bound on udp_ip)
+    size_t replication_queue = 65536;          // deltas buffered before falling back to a snapshot
+    int replication_batch_ms = 10;
+    int replication_takeover_ms = 3000;        // standby: stream silence before taking over, 0 = only via /takeover
+
+    // graceful shutdown hands sessions over to this pgw_server ("ip:http_port") instead of deleting them
+    std::string migration_peer;
+    size_t migration_batch = 10000;            // sessions per hand-over request
 };
 
 class Server {
 public:
-    explicit Server(Config cfg);
+    // clock defaults to SystemClock; tests pass a ManualClock
+    explicit Server(Config cfg, std::shared_ptr<Clock> clock = nullptr);
     ~Server();
 
     Server(const Server&) = delete;
@@ -41,6 +136,10 @@ public:
 
     // query
     bool is_active(const std::string &imsi);
+    size_t session_count();
+
+    // counters for /stats
+    nlohmann::json stats();
 
     // safe stop http from outside
     void stop_http_server();
@@ -49,28 +148,187 @@ private:
     // core routines
     void udp_loop();
     void http_loop();
+    // read-only status queries on status_udp_port; returns false if the port cannot be bound
+    bool start_status_threads();
+    void status_loop(int sock);
+    void demote_idle();
+    // one cleaner tick of session expiry, within the per-tick budget
+    void expire_due(uint64_t rss);
+    size_t handle_status(const uint8_t *data, size_t len, uint8_t *reply, size_t cap);
 
     // offload
     void start_offload(size_t rate);
+    void offload_remaining(size_t rate);
+    void cdr_index_loop();
+    // streams live sessions to `peer` in batches, falls back to offload if it is unreachable
+    void start_migration(const ClusterMember &peer, size_t rate);
+    nlohmann::json migration_json();
+    // session arena, time to UDP bind and reply latency over the first minute
+    nlohmann::json startup_json();
+
+    // session decision for one IMSI, returns the reply text
+    std::string handle_imsi(const std::string &imsi);
+    // protocol v2 datagram (multi-IMSI); returns the encoded reply, empty if nothing is to be sent
+    std::vector<uint8_t> handle_v2(const sockaddr_in &cli, const uint8_t *data, size_t len,
+                                   bool relayed, ClusterForwarder *forwarder);
+
+    // cluster
+    void set_cluster_members(std::vector<ClusterMember> members);
+    void rebalance();
+    size_t hand_over(const ClusterMember &to, const std::vector<SessionRecord> &records, const char *cdr_action);
+    size_t adopt_sessions(const std::vector<SessionRecord> &records);
+    nlohmann::json cluster_json();
+
+    // replication
+    void replicate(ReplicaOp op, const std::string &imsi, std::chrono::steady_clock::time_point at);
+    std::vector<SessionRecord> snapshot_sessions();
+    void apply_replica(const ReplicationFrame &f);
+    bool run_standby();
+    nlohmann::json replication_json();
 
     // helpers
     void append_cdr(const std::string &imsi, const std::string &action);
-    bool is_blacklisted(const std::string &imsi);
+    // claims one of max_streams for a long-lived response until the token is
+    // dropped; null when all are taken
+    std::shared_ptr<void> acquire_stream();
+    void publish_event(SessionEvents::Kind kind, const std::string &imsi);
     std::string now_ts();
 
+    // SessionCore policies over the server's own table, CDR log and config;
+    // every change to the table is also fed to replication and the shm mirror
+    struct ReplicatedStore {
+        Server &s;
+        bool touch(const std::string &imsi, SessionTable::time_point now);
+        bool insert(const std::string &imsi, SessionTable::time_point now);
+        bool full() const { return s.sessions_.full(); }
+        bool pop_oldest(std::string &imsi);
+        size_t expire(SessionTable::time_point now, std::chrono::seconds timeout, std::vector<std::string> &out,
+                      size_t max = SIZE_MAX);
+        size_t expire_low_activity(SessionTable::time_point now, std::chrono::seconds timeout,
+                                   std::vector<std::string> &out, size_t max = SIZE_MAX);
+    };
+    struct CdrWriter {
+        Server &s;
+        void operator()(const std::string &imsi, const char *action) { s.append_cdr(imsi, action); }
+    };
+    // the server's clock as the core sees it: on SystemClock (pgw_server)
+    // the steady clock is read inline, so the per-request path makes no
+    // virtual call; an injected clock is called through the interface
+    struct CoreClock {
+        const Clock &c;
+        bool system;
+        SessionTable::time_point now() const { return system ? std::chrono::steady_clock::now() : c.now(); }
+    };
+    using Core = SessionCore<ReplicatedStore, CdrWriter, VectorBlacklist, CoreClock>;
+
 
 private:
+    // startup: construction to UDP bind, then reply latency over the first minute
+    const std::chrono::steady_clock::time_point created_ = std::chrono::steady_clock::now();
+    std::atomic<int64_t> startup_us_{-1};
+    LatencyHistogram first_minute_us_;
+
     Config cfg_;
 
-    std::unordered_map<std::string, std::chrono::steady_clock::time_point> sessions_;
-    std::mutex sess_m_;
+    std::unique_ptr<SessionArena> arena_; // null unless expected_sessions is set; outlives sessions_
+    SessionTable sessions_;
+    InstrumentedMutex sess_m_;
+    ReplicatedStore store_{*this};
+    CdrWriter cdr_writer_{*this};
+    VectorBlacklist blacklist_;
+    std::shared_ptr<Clock> clock_;
+    CoreClock core_clock_;
+    Core core_; // guarded by sess_m_
+    std::atomic<uint64_t> evicted_total_{0};
+    std::atomic<uint64_t> capacity_rejected_total_{0};
+
+    // expiry
+    AdaptiveExpiry adaptive_;
+    std::atomic<uint64_t> expired_idle_total_{0};
+    std::atomic<uint64_t> expired_pressure_total_{0};
+    std::atomic<uint64_t> expiry_carried_ticks_{0}; // ticks stopped by the budget, the rest carried over
+    std::atomic<bool> expiring_{false};             // cleaner is inside an expiry pass
+    LatencyHistogram expiry_lateness_ms_;           // per tick: how long the oldest due session overstayed
+    LatencyHistogram expiry_hold_us_;               // sess_m_ held per expiry chunk
+    LatencyHistogram reply_us_;                     // datagram received to reply sent
+    LatencyHistogram reply_expiring_us_;            // same, for datagrams taken while expiring_
+
+    // udp ingress counters
+    std::atomic<uint64_t> udp_received_total_{0};
+    std::atomic<uint64_t> rate_limited_total_{0};
+    std::atomic<uint64_t> shed_total_{0};
+    std::atomic<uint64_t> fast_rejected_total_{0};
+    std::atomic<uint64_t> kernel_drops_{0};
+    std::atomic<int64_t> rx_lag_us_{0};
+    std::atomic<bool> overloaded_{false};
+    std::atomic<int> rcvbuf_bytes_{0};
+    std::atomic<uint64_t> v2_requests_total_{0};
+    std::atomic<uint64_t> v2_imsis_total_{0};
+    std::atomic<uint64_t> v2_malformed_total_{0};
+    std::atomic<uint64_t> retransmit_hits_{0};
+    std::atomic<uint64_t> retransmit_misses_{0};
+    HeavyHitters hitters_; // fed by the UDP loop
+    SessionEvents events_;
+    std::atomic<uint64_t> event_streams_{0};
+
+    // status query port
+    std::vector<std::thread> status_threads_;
+    std::atomic<uint64_t> status_queries_{0};
+    std::atomic<uint64_t> status_imsis_{0};
+    std::atomic<uint64_t> status_active_{0};
+    std::atomic<uint64_t> status_malformed_{0};
+
+    // cluster
+    std::shared_ptr<const HashRing> ring_; // null when not clustered; atomic_load/atomic_store
+    ForwardCounters fwd_counters_;
+    std::atomic<uint64_t> redirected_total_{0};
+    std::atomic<uint64_t> handed_over_total_{0};
+    std::atomic<uint64_t> adopted_total_{0};
+    std::thread rebalance_thread_;
+    std::mutex rebalance_m_;
 
-    std::ofstream cdr_out_;
-    std::mutex cdr_m_;
+    // replication
+    std::unique_ptr<ReplicationSender> repl_sender_;
+    std::unique_ptr<ReplicationReceiver> repl_receiver_;
+    std::mutex repl_m_; // guards repl_receiver_ reset against /stats
+    std::atomic<bool> standby_{false};
+    std::atomic<bool> takeover_requested_{false};
+    std::atomic<bool> taken_over_{false};
+
+    // read-only session mirror for local processes
+    std::unique_ptr<SessionMirror> shm_;
+
+    // received datagrams for replay, null when off
+    std::unique_ptr<PacketCapture> capture_;
+
+    // AF_XDP socket drained by the UDP loop, null when off
+    std::unique_ptr<XdpSocket> xdp_;
+
+    std::unique_ptr<CdrLog> cdr_;
+    std::thread cdr_index_thread_;
+    std::atomic<uint64_t> cdr_indexed_bytes_{0};
+    std::atomic<uint64_t> cdr_index_segments_{0};
+    std::atomic<size_t> streams_{0};  // open /cdr/stream and /events responses
 
     std::atomic<bool> running_{false};
     std::atomic<bool> offloading_{false};
 
+    // migration on shutdown
+    std::atomic<bool> migrating_{false};
+    std::atomic<const char*> migration_state_{"idle"}; // idle, running, done, failed
+    std::atomic<uint64_t> migrated_total_{0};
+    std::atomic<uint64_t> migration_batches_{0};
+    std::atomic<uint64_t> migration_failures_{0};
+    std::atomic<int64_t> migration_elapsed_us_{0};
+    std::atomic<int64_t> migration_time_to_empty_us_{-1};
+    std::mutex migration_m_;
+    std::string migration_peer_;
+
+    // loop utilisation and stall detection
+    LoopMonitor udp_monitor_{"udp"};
+    LoopMonitor cleaner_monitor_{"cleaner"};
+    Watchdog watchdog_;
+
     std::thread http_thread_;
     std::shared_ptr<httplib::Server> http_svr_;
 };
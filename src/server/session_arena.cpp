@@ -0,0 +1,117 @@
+#include "session_arena.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <string>
+
+static constexpr size_t huge_page = 2u << 20;
+
+SessionArena::SessionArena(size_t bytes, HugePages huge_pages, bool prefault) {
+    size_t len = (bytes + huge_page - 1) & ~(huge_page - 1);
+    void *p = MAP_FAILED;
+    if (huge_pages == HugePages::explicit_) {
+        p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) {
+            spdlog::warn("No explicit huge pages for the session arena ({}), using transparent ones",
+                         strerror(errno));
+            huge_pages = HugePages::transparent;
+        } else {
+            map_len_ = len;
+        }
+    }
+    if (p == MAP_FAILED) {
+        // one huge page of slack to align the start, so THP can back all of it
+        size_t map_len = len + huge_page;
+        p = mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            spdlog::error("Failed to map {} bytes for the session arena: {}", len, strerror(errno));
+            return;
+        }
+        char *raw = static_cast<char*>(p);
+        char *aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(raw) + huge_page - 1) & ~(huge_page - 1));
+        if (aligned > raw) munmap(raw, static_cast<size_t>(aligned - raw));
+        size_t tail = static_cast<size_t>(raw + map_len - (aligned + len));
+        if (tail) munmap(aligned + len, tail);
+        p = aligned;
+        map_len_ = len;
+        if (huge_pages == HugePages::transparent && madvise(p, len, MADV_HUGEPAGE) != 0) {
+            spdlog::warn("madvise(MADV_HUGEPAGE) failed for the session arena: {}", strerror(errno));
+            huge_pages = HugePages::off;
+        }
+    }
+    base_ = static_cast<char*>(p);
+    len_ = len;
+    huge_pages_ = huge_pages;
+
+    if (prefault) {
+        auto t0 = std::chrono::steady_clock::now();
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        for (size_t off = 0; off < len_; off += page) {
+            static_cast<volatile char*>(base_)[off] = 0;
+        }
+        prefault_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    }
+    spdlog::info("Session arena: {} MiB, huge pages {}, prefault {:.1f} ms",
+                 len_ >> 20, this->huge_pages(), prefault_ms_);
+}
+
+SessionArena::~SessionArena() {
+    if (base_) munmap(base_, map_len_);
+}
+
+const char *SessionArena::huge_pages() const {
+    switch (huge_pages_) {
+        case HugePages::transparent: return "transparent";
+        case HugePages::explicit_: return "explicit";
+        default: return "off";
+    }
+}
+
+bool SessionArena::parse_huge_pages(const std::string &s, HugePages &out) {
+    if (s == "off") out = HugePages::off;
+    else if (s == "transparent") out = HugePages::transparent;
+    else if (s == "explicit") out = HugePages::explicit_;
+    else return false;
+    return true;
+}
+
+void *SessionArena::allocate(size_t bytes, size_t align) {
+    if (base_ && bytes <= small_max && align <= grain) {
+        size_t cls = (bytes + grain - 1) / grain;
+        if (void *p = free_[cls]) {
+            free_[cls] = *static_cast<void**>(p);
+            return p;
+        }
+        bytes = cls * grain;
+    }
+    if (base_) {
+        size_t a = align < grain ? grain : align;
+        size_t start = (used_ + a - 1) & ~(a - 1);
+        if (start + bytes <= len_) {
+            used_ = start + bytes;
+            return base_ + start;
+        }
+    }
+    ++heap_fallbacks_;
+    return ::operator new(bytes);
+}
+
+void SessionArena::deallocate(void *p, size_t bytes) noexcept {
+    if (!owns(p)) {
+        ::operator delete(p);
+        return;
+    }
+    if (bytes <= small_max) {
+        size_t cls = (bytes + grain - 1) / grain;
+        *static_cast<void**>(p) = free_[cls];
+        free_[cls] = p;
+        return;
+    }
+    // large blocks are only taken back when they are the last one handed out
+    if (static_cast<char*>(p) + bytes == base_ + used_) used_ = static_cast<size_t>(static_cast<char*>(p) - base_);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <type_traits>
+
+// Memory for the session table, mapped and optionally prefaulted once at
+// startup so the first sessions after a restart neither page-fault nor wait
+// for a rehash. Backed by transparent huge pages (madvise) or explicit ones
+// (MAP_HUGETLB, falls back to normal pages if none are reserved).
+//
+// Small blocks (hash map nodes) are recycled through per-size free lists;
+// large ones (vector and bucket arrays, reserved once) come off a bump
+// pointer and are not reused. Once the arena is used up, allocations fall
+// back to the heap, so a table that outgrows its estimate keeps working.
+// Not thread-safe: it belongs to one SessionTable, which the owner serialises.
+class SessionArena {
+public:
+    enum class HugePages { off, transparent, explicit_ };
+
+    SessionArena(size_t bytes, HugePages huge_pages, bool prefault);
+    ~SessionArena();
+
+    SessionArena(const SessionArena&) = delete;
+    SessionArena& operator=(const SessionArena&) = delete;
+
+    bool ok() const { return base_ != nullptr; }
+
+    void *allocate(size_t bytes, size_t align);
+    void deallocate(void *p, size_t bytes) noexcept;
+
+    size_t capacity() const { return len_; }
+    size_t used() const { return used_; }
+    uint64_t heap_fallbacks() const { return heap_fallbacks_; }
+    // what the mapping actually got: "off", "transparent" or "explicit"
+    const char *huge_pages() const;
+    double prefault_ms() const { return prefault_ms_; }
+
+    static bool parse_huge_pages(const std::string &s, HugePages &out);
+
+private:
+    static constexpr size_t grain = 16;
+    static constexpr size_t small_max = 256;
+
+    bool owns(const void *p) const {
+        return base_ && static_cast<const char*>(p) >= base_ && static_cast<const char*>(p) < base_ + len_;
+    }
+
+    char *base_ = nullptr;
+    size_t len_ = 0;
+    size_t map_len_ = 0;
+    size_t used_ = 0;
+    HugePages huge_pages_ = HugePages::off;
+    double prefault_ms_ = 0;
+    uint64_t heap_fallbacks_ = 0;
+    std::array<void*, small_max / grain + 1> free_{}; // by size class
+};
+
+// std allocator over a SessionArena; a null arena means plain operator new
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator(SessionArena *arena = nullptr) noexcept : arena_(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena_(other.arena()) {}
+
+    T *allocate(size_t n) {
+        if (!arena_) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *p, size_t n) noexcept {
+        if (!arena_) ::operator delete(p);
+        else arena_->deallocate(p, n * sizeof(T));
+    }
+
+    SessionArena *arena() const { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena_ == other.arena(); }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena_ != other.arena(); }
+
+private:
+    SessionArena *arena_;
+};
@@ -0,0 +1,67 @@
+#include "session_batch.h"
+#include "imsi_to_bcd.h"
+
+#include <cstring>
+
+static constexpr char batch_magic[4] = {'P', 'G', 'W', 'S'};
+static constexpr uint8_t batch_version = 1;
+
+static void put_u32(std::string &out, uint32_t v) {
+    out.push_back(static_cast<char>((v >> 24) & 0xFF));
+    out.push_back(static_cast<char>((v >> 16) & 0xFF));
+    out.push_back(static_cast<char>((v >> 8) & 0xFF));
+    out.push_back(static_cast<char>(v & 0xFF));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+std::string encode_session_batch(const std::vector<SessionRecord> &records) {
+    std::string out;
+    out.reserve(9 + records.size() * 13);
+    out.append(batch_magic, sizeof(batch_magic));
+    out.push_back(static_cast<char>(batch_version));
+    put_u32(out, 0);
+    uint32_t count = 0;
+    for (const auto &r : records) {
+        // only valid IMSIs (at most 8 BCD bytes, so the u8 length fits)
+        if (!valid_imsi(r.imsi)) continue;
+        auto bcd = encode_imsi_bcd(r.imsi);
+        out.push_back(static_cast<char>(bcd.size()));
+        out.append(reinterpret_cast<const char*>(bcd.data()), bcd.size());
+        put_u32(out, r.idle_ms);
+        ++count;
+    }
+    std::string n;
+    put_u32(n, count);
+    out.replace(5, 4, n);
+    return out;
+}
+
+bool decode_session_batch(const std::string &data, std::vector<SessionRecord> &out) {
+    const auto *p = reinterpret_cast<const unsigned char*>(data.data());
+    size_t n = data.size();
+    if (n < 9 || std::memcmp(p, batch_magic, sizeof(batch_magic)) != 0 || p[4] != batch_version) return false;
+
+    uint32_t count = get_u32(p + 5);
+    size_t pos = 9;
+    // every record takes at least 6 bytes: never trust the count further
+    if (count > (n - 9) / 6) return false;
+    out.reserve(out.size() + count);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (pos >= n) return false;
+        size_t len = p[pos++];
+        // the encoder only writes 1-15 digit IMSIs: anything else is a forged batch
+        if (len == 0 || len > 8 || pos + len + 4 > n) return false;
+        SessionRecord r;
+        r.imsi = decode_imsi_bcd(std::vector<uint8_t>(p + pos, p + pos + len));
+        if (!valid_imsi(r.imsi)) return false;
+        pos += len;
+        r.idle_ms = get_u32(p + pos);
+        pos += 4;
+        out.push_back(std::move(r));
+    }
+    return pos == n;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Compact binary batch of sessions exchanged between pgw_server nodes.
+// Layout (big-endian): "PGWS" | u8 version | u32 count |
+//   count * (u8 bcd_len | bcd bytes | u32 idle_ms)
+struct SessionRecord {
+    std::string imsi;
+    uint32_t idle_ms = 0; // time since the last refresh on the sending node
+};
+
+// records whose IMSI is not 1-15 digits are left out
+std::string encode_session_batch(const std::vector<SessionRecord> &records);
+
+// false on malformed input, including records whose IMSI is not 1-15 digits;
+// `out` is left with the records decoded so far
+bool decode_session_batch(const std::string &data, std::vector<SessionRecord> &out);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Request-handling core shared by pgw_server, benchmarks and tests.
+//
+// SessionCore decides what happens to one IMSI (reject, refresh, create,
+// evict, no capacity) and is parameterised on its collaborators, so
+// alternative implementations plug in at compile time with no virtual calls:
+//
+//   Store     - bool touch(imsi, tp); bool insert(imsi, tp); bool full() const;
+//               bool pop_oldest(std::string &imsi);
+//               size_t expire(tp, std::chrono::seconds, std::vector<std::string> &out)
+//               (SessionTable fits as is)
+//   CdrSink   - void operator()(const std::string &imsi, const char *action)
+//   Blacklist - bool contains(const std::string &imsi) const
+//   Clock     - time_point now()
+//
+// The core does no locking: the owner serialises calls (Server::sess_m_).
+// Policies are held by reference and must outlive the core.
+
+struct SteadyClock {
+    using time_point = std::chrono::steady_clock::time_point;
+    time_point now() const { return std::chrono::steady_clock::now(); }
+};
+
+// linear scan, fastest for the handful of entries a config usually lists
+class VectorBlacklist {
+public:
+    explicit VectorBlacklist(std::vector<std::string> imsis) : imsis_(std::move(imsis)) {}
+    bool contains(const std::string &imsi) const {
+        return std::find(imsis_.begin(), imsis_.end(), imsi) != imsis_.end();
+    }
+
+private:
+    std::vector<std::string> imsis_;
+};
+
+class HashBlacklist {
+public:
+    explicit HashBlacklist(const std::vector<std::string> &imsis) : imsis_(imsis.begin(), imsis.end()) {}
+    bool contains(const std::string &imsi) const { return imsis_.count(imsi) != 0; }
+
+private:
+    std::unordered_set<std::string> imsis_;
+};
+
+struct NullCdrSink {
+    void operator()(const std::string&, const char*) const {}
+};
+
+enum class CapacityPolicy { reject, evict_lru };
+
+template <typename Store, typename CdrSink, typename Blacklist, typename Clock = SteadyClock>
+class SessionCore {
+public:
+    using time_point = decltype(std::declval<Clock&>().now());
+
+    struct Outcome {
+        const char *reply;    // "created", "active", "rejected" or "no_capacity"
+        std::string evicted;  // session dropped to make room (evict_lru), empty otherwise
+    };
+
+    SessionCore(Store &store, CdrSink &cdr, const Blacklist &blacklist, Clock &clock,
+                CapacityPolicy policy = CapacityPolicy::reject)
+        : store_(store), cdr_(cdr), blacklist_(blacklist), clock_(clock), policy_(policy) {}
+
+    Outcome handle(const std::string &imsi) {
+        Outcome out{"created", {}};
+        if (blacklist_.contains(imsi)) {
+            cdr_(imsi, "rejected");
+            out.reply = "rejected";
+            return out;
+        }
+        const time_point now = clock_.now();
+        if (store_.touch(imsi, now)) {
+            out.reply = "active";
+            return out;
+        }
+        if (store_.full()) {
+            if (policy_ != CapacityPolicy::evict_lru || !store_.pop_oldest(out.evicted)) {
+                cdr_(imsi, "rejected_capacity");
+                out.reply = "no_capacity";
+                return out;
+            }
+            cdr_(out.evicted, "evicted");
+        }
+        store_.insert(imsi, now);
+        cdr_(imsi, "created");
+        return out;
+    }
+
+    // removes idle sessions; their "timeout" records are left to the caller,
+    // which usually writes them after releasing its lock
+    size_t expire(std::chrono::seconds timeout, std::vector<std::string> &out) {
+        return store_.expire(clock_.now(), timeout, out);
+    }
+
+    // at most `max` of them, for budgeted expiry; needs a Store::expire
+    // taking the limit as a fourth argument
+    size_t expire(std::chrono::seconds timeout, std::vector<std::string> &out, size_t max) {
+        return store_.expire(clock_.now(), timeout, out, max);
+    }
+
+    // same for low-activity sessions only (adaptive expiry); needs
+    // Store::expire_low_activity with the signature of expire
+    size_t expire_low_activity(std::chrono::seconds timeout, std::vector<std::string> &out, size_t max = SIZE_MAX) {
+        return store_.expire_low_activity(clock_.now(), timeout, out, max);
+    }
+
+    time_point now() { return clock_.now(); }
+    CapacityPolicy policy() const { return policy_; }
+
+private:
+    Store &store_;
+    CdrSink &cdr_;
+    const Blacklist &blacklist_;
+    Clock &clock_;
+    CapacityPolicy policy_;
+};
@@ -0,0 +1,94 @@
+#include "session_events.h"
+
+static const char *const kind_names[SessionEvents::kinds] = {
+    "created",
+    "refreshed",
+    "rejected",
+    "rejected_capacity",
+    "evicted",
+    "timeout",
+    "timeout_pressure",
+    "offloaded",
+    "handed_over",
+    "migrated",
+    "adopted",
+};
+
+static constexpr uint64_t ms_mask = (1ull << 56) - 1;
+
+SessionEvents::SessionEvents(size_t capacity) {
+    if (capacity == 0) return;
+    uint64_t n = 1;
+    while (n < capacity) n <<= 1;
+    slots_.reset(new Slot[n]);
+    mask_ = n - 1;
+}
+
+void SessionEvents::publish(Kind kind, uint64_t imsi, int64_t unix_ms) {
+    if (!slots_) return;
+    uint64_t seq = head_.fetch_add(1, std::memory_order_acq_rel);
+    Slot &s = slots_[seq & mask_];
+    s.version.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.imsi.store(imsi, std::memory_order_relaxed);
+    s.meta.store(static_cast<uint64_t>(kind) << 56 | (static_cast<uint64_t>(unix_ms) & ms_mask),
+                 std::memory_order_relaxed);
+    s.version.store(seq + 1, std::memory_order_release);
+}
+
+uint64_t SessionEvents::oldest_seq() const {
+    uint64_t head = next_seq();
+    return head > capacity() ? head - capacity() : 0;
+}
+
+uint64_t SessionEvents::read(uint64_t from, std::vector<Event> &out, size_t max, uint64_t &lost) const {
+    lost = 0;
+    if (!slots_) return from;
+    const uint64_t cap = capacity();
+    uint64_t head = next_seq();
+    if (from > head) from = head;
+    if (head - from > cap) {
+        lost = head - from - cap;
+        from = head - cap;
+    }
+    for (size_t n = 0; n < max && from < head; ) {
+        const Slot &s = slots_[from & mask_];
+        uint64_t v = s.version.load(std::memory_order_acquire);
+        if (v == from + 1) {
+            Event e;
+            e.seq = from;
+            e.imsi = s.imsi.load(std::memory_order_relaxed);
+            uint64_t meta = s.meta.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s.version.load(std::memory_order_relaxed) == v) {
+                e.kind = static_cast<Kind>(meta >> 56);
+                e.unix_ms = static_cast<int64_t>(meta & ms_mask);
+                out.push_back(e);
+                ++n;
+                ++from;
+                continue;
+            }
+        } else if (v <= from && next_seq() - from <= cap) {
+            break; // claimed but not written yet: picked up on the next read
+        }
+        // overwritten by a writer one lap ahead
+        ++lost;
+        ++from;
+    }
+    return from;
+}
+
+const char *SessionEvents::name(Kind kind) {
+    auto i = static_cast<size_t>(kind);
+    return i < kinds ? kind_names[i] : "unknown";
+}
+
+bool SessionEvents::kind_of(const std::string &action, Kind &kind) {
+    for (size_t i = 0; i < kinds; ++i) {
+        if (action == kind_names[i]) {
+            kind = static_cast<Kind>(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Session lifecycle events for GET /events, so downstream systems are told
+// about attaches and timeouts instead of polling /check_subscriber.
+//
+// Fixed ring of sequenced slots written lock-free from any thread (UDP loop,
+// cleaner, HTTP handlers): a writer claims the next sequence number and fills
+// its slot under a per-slot version, like the shared-memory mirror. Readers
+// copy events from a sequence number onwards and never hold anything the
+// writers wait on, so a slow consumer only falls behind; once the ring laps
+// it, read() reports the lost range and carries on from the oldest event.
+class SessionEvents {
+public:
+    enum class Kind : uint8_t {
+        created,
+        refreshed,
+        rejected,
+        rejected_capacity,
+        evicted,
+        timeout,
+        timeout_pressure,
+        offloaded,
+        handed_over,
+        migrated,
+        adopted,
+    };
+    static constexpr size_t kinds = 11;
+
+    struct Event {
+        uint64_t seq = 0;
+        Kind kind = Kind::created;
+        uint64_t imsi = 0;      // packed, see pack_imsi()
+        int64_t unix_ms = 0;
+    };
+
+    // capacity is rounded up to a power of two, 0 = off
+    explicit SessionEvents(size_t capacity);
+
+    bool enabled() const { return slots_ != nullptr; }
+    size_t capacity() const { return slots_ ? mask_ + 1 : 0; }
+
+    // any thread; a no-op when off
+    void publish(Kind kind, uint64_t imsi, int64_t unix_ms);
+
+    // sequence number the next event will get
+    uint64_t next_seq() const { return head_.load(std::memory_order_acquire); }
+    // oldest sequence number still in the ring
+    uint64_t oldest_seq() const;
+
+    // appends up to `max` events starting at `from` and returns the sequence
+    // to continue from. Events overwritten before they could be read are
+    // skipped: `lost` gets their count (0 when none).
+    uint64_t read(uint64_t from, std::vector<Event> &out, size_t max, uint64_t &lost) const;
+
+    static const char *name(Kind kind);
+    // CDR action ("created", "timeout", ...) to kind; false if unknown
+    static bool kind_of(const std::string &action, Kind &kind);
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> version{0};   // seq + 1 once written, 0 while being written
+        std::atomic<uint64_t> imsi{0};
+        std::atomic<uint64_t> meta{0};      // kind in the top byte, unix ms below
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    uint64_t mask_ = 0;
+    std::atomic<uint64_t> head_{0};
+};
@@ -0,0 +1,176 @@
+#include "session_mirror.h"
+#include "imsi_to_bcd.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <algorithm>
+
+static int64_t to_ns(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+SessionMirror::SessionMirror(const std::string &name, uint64_t slots, std::chrono::milliseconds session_timeout)
+    : name_(session_shm_path(name)) {
+    uint64_t n = 1;
+    while (n < slots) n <<= 1;
+
+    // readers of a previous instance keep their mapping and see its heartbeat stop
+    shm_unlink(name_.c_str());
+    int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        spdlog::error("Failed to create shared memory '{}': {}", name_, strerror(errno));
+        return;
+    }
+    size_t len = session_shm_bytes(n);
+    if (ftruncate(fd, static_cast<off_t>(len)) != 0) {
+        spdlog::error("Failed to size shared memory '{}': {}", name_, strerror(errno));
+        ::close(fd);
+        shm_unlink(name_.c_str());
+        return;
+    }
+    void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        spdlog::error("Failed to map shared memory '{}': {}", name_, strerror(errno));
+        shm_unlink(name_.c_str());
+        return;
+    }
+
+    // the fresh segment is zero-filled: every slot is empty with an even seq
+    auto *hdr = new (p) SessionShmHeader{};
+    hdr->version = session_shm_version;
+    hdr->slots = n;
+    hdr->session_timeout_ms = session_timeout.count();
+    hdr->pid = static_cast<int32_t>(getpid());
+    hdr->heartbeat_ns.store(to_ns(std::chrono::steady_clock::now()), std::memory_order_relaxed);
+    hdr->magic.store(session_shm_magic, std::memory_order_release);
+
+    hdr_ = hdr;
+    slots_ = reinterpret_cast<SessionShmSlot*>(hdr + 1);
+    len_ = len;
+    spdlog::info("Session mirror published in shared memory '{}' ({} slots)", name_, n);
+}
+
+SessionMirror::~SessionMirror() {
+    if (!hdr_) return;
+    hdr_->heartbeat_ns.store(0, std::memory_order_release);
+    munmap(hdr_, len_);
+    shm_unlink(name_.c_str());
+}
+
+void SessionMirror::write_slot(SessionShmSlot &s, uint64_t key, int64_t last_seen_ns) {
+    uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s.key.store(key, std::memory_order_relaxed);
+    s.last_seen_ns.store(last_seen_ns, std::memory_order_relaxed);
+    s.seq.store(seq + 2, std::memory_order_release);
+}
+
+bool SessionMirror::upsert(const std::string &imsi, time_point last_seen) {
+    if (!hdr_) return false;
+    const uint64_t key = pack_imsi(imsi);
+    if (!key) return false;
+
+    std::lock_guard<std::mutex> lk(m_);
+    const uint64_t mask = hdr_->slots - 1;
+    uint64_t i = session_shm_home(key, hdr_->slots);
+    for (uint64_t n = 0; n <= mask; ++n, i = (i + 1) & mask) {
+        SessionShmSlot &s = slots_[i];
+        uint64_t k = s.key.load(std::memory_order_relaxed);
+        if (k == key) {
+            // refresh in place, only the timestamp changes
+            s.last_seen_ns.store(to_ns(last_seen), std::memory_order_relaxed);
+            hdr_->heartbeat_ns.store(to_ns(std::chrono::steady_clock::now()), std::memory_order_release);
+            return true;
+        }
+        if (k == session_shm_empty) {
+            write_slot(s, key, to_ns(last_seen));
+            hdr_->sessions.fetch_add(1, std::memory_order_relaxed);
+            hdr_->heartbeat_ns.store(to_ns(std::chrono::steady_clock::now()), std::memory_order_release);
+            return true;
+        }
+    }
+    if (dropped_.fetch_add(1, std::memory_order_relaxed) == 0) {
+        spdlog::warn("Session mirror '{}' is full, raise session_shm_slots", name_);
+    }
+    return false;
+}
+
+void SessionMirror::remove(const std::string &imsi) {
+    if (!hdr_) return;
+    const uint64_t key = pack_imsi(imsi);
+    if (!key) return;
+
+    std::lock_guard<std::mutex> lk(m_);
+    const uint64_t mask = hdr_->slots - 1;
+    uint64_t i = session_shm_home(key, hdr_->slots);
+    for (uint64_t n = 0;; ++n, i = (i + 1) & mask) {
+        uint64_t k = slots_[i].key.load(std::memory_order_relaxed);
+        if (k == session_shm_empty || n > mask) return;
+        if (k == key) break;
+    }
+
+    // backward-shift deletion, as in the cold tier: an entry is copied back
+    // before its old slot is reused, so a reader may see it twice but a
+    // lookup that misses while `moves` is odd or changing retries
+    bool moving = false;
+    for (uint64_t j = (i + 1) & mask; j != i; j = (j + 1) & mask) {
+        SessionShmSlot &s = slots_[j];
+        uint64_t k = s.key.load(std::memory_order_relaxed);
+        if (k == session_shm_empty) break;
+        uint64_t home = session_shm_home(k, hdr_->slots);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            if (!moving) {
+                moving = true;
+                hdr_->moves.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+            }
+            write_slot(slots_[i], k, s.last_seen_ns.load(std::memory_order_relaxed));
+            i = j;
+        }
+    }
+    write_slot(slots_[i], session_shm_empty, 0);
+    if (moving) hdr_->moves.fetch_add(1, std::memory_order_release);
+    hdr_->sessions.fetch_sub(1, std::memory_order_relaxed);
+    hdr_->heartbeat_ns.store(to_ns(std::chrono::steady_clock::now()), std::memory_order_release);
+}
+
+size_t SessionMirror::longest_probe() {
+    if (!hdr_) return 0;
+    std::lock_guard<std::mutex> lk(m_);
+    size_t longest = 0, run = 0;
+    // twice round so a run that wraps past the last slot is counted whole
+    for (uint64_t n = 0; n < 2 * hdr_->slots; ++n) {
+        if (slots_[n & (hdr_->slots - 1)].key.load(std::memory_order_relaxed) == session_shm_empty) {
+            run = 0;
+        } else {
+            longest = std::max(longest, ++run);
+        }
+    }
+    return std::min<size_t>(longest, hdr_->slots);
+}
+
+void SessionMirror::clear() {
+    if (!hdr_) return;
+    std::lock_guard<std::mutex> lk(m_);
+    for (uint64_t i = 0; i < hdr_->slots; ++i) {
+        if (slots_[i].key.load(std::memory_order_relaxed) != session_shm_empty) {
+            write_slot(slots_[i], session_shm_empty, 0);
+        }
+    }
+    hdr_->sessions.store(0, std::memory_order_relaxed);
+    hdr_->generation.fetch_add(1, std::memory_order_release);
+    hdr_->heartbeat_ns.store(to_ns(std::chrono::steady_clock::now()), std::memory_order_release);
+}
+
+void SessionMirror::tick() {
+    if (hdr_) hdr_->heartbeat_ns.store(to_ns(std::chrono::steady_clock::now()), std::memory_order_release);
+}
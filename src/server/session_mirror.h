@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "session_shm.h"
+
+// Writer side of the shared-memory session mirror (layout in session_shm.h).
+// Fed with the same upsert/remove deltas as the replication stream; its own
+// mutex orders writers, readers in other processes stay lock-free.
+class SessionMirror {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    // slots is rounded up to a power of two; an existing segment of the same
+    // name (left by a crashed server) is replaced
+    SessionMirror(const std::string &name, uint64_t slots, std::chrono::milliseconds session_timeout);
+    ~SessionMirror();
+
+    SessionMirror(const SessionMirror&) = delete;
+    SessionMirror& operator=(const SessionMirror&) = delete;
+
+    bool ok() const { return hdr_ != nullptr; }
+    const std::string &name() const { return name_; }
+    uint64_t slots() const { return hdr_ ? hdr_->slots : 0; }
+    uint64_t sessions() const { return hdr_ ? hdr_->sessions.load(std::memory_order_relaxed) : 0; }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // false if the IMSI does not pack or the table is full
+    bool upsert(const std::string &imsi, time_point last_seen);
+    void remove(const std::string &imsi);
+    void clear();
+
+    // longest run of occupied slots, the most a lookup can probe
+    size_t longest_probe();
+
+    // refreshes the heartbeat readers use to detect a dead server
+    void tick();
+
+private:
+    void write_slot(SessionShmSlot &s, uint64_t key, int64_t last_seen_ns);
+
+    std::string name_;
+    SessionShmHeader *hdr_ = nullptr;
+    SessionShmSlot *slots_ = nullptr;
+    size_t len_ = 0;
+    std::mutex m_;
+    std::atomic<uint64_t> dropped_{0};
+};
@@ -0,0 +1,280 @@
+#include "session_table.h"
+
+#include <algorithm>
+
+SessionTable::SessionTable(size_t capacity, SessionArena *arena, size_t expected)
+    : nodes_(ArenaAllocator<Node>(arena)), free_(ArenaAllocator<uint32_t>(arena)),
+      index_(0, std::hash<std::string>(), std::equal_to<std::string>(), Index::allocator_type(arena)),
+      capacity_(capacity) {
+    // allocate everything up front so memory stays flat under load and the
+    // first sessions do not pay for growth or rehashing
+    size_t n = std::max(capacity_, expected);
+    if (n != 0) {
+        nodes_.reserve(n);
+        free_.reserve(n);
+        index_.reserve(n);
+    }
+}
+
+size_t SessionTable::arena_bytes(size_t sessions) {
+    // node and free slot, a hash node (key, value, next pointer and cached
+    // hash, rounded up) and about one bucket pointer per session
+    size_t per_session = sizeof(Node) + sizeof(uint32_t) + 64 + 2 * sizeof(void*);
+    size_t bytes = sessions * per_session;
+    return bytes + bytes / 8 + (1u << 20);
+}
+
+void SessionTable::set_cold_tier(std::unique_ptr<ColdTier> cold) {
+    cold_ = std::move(cold);
+}
+
+uint64_t SessionTable::cold_key(const std::string &imsi) const {
+    if (!cold_ || cold_->size() == 0) return 0;
+    uint64_t key = pack_imsi(imsi);
+    return key && cold_->contains(key) ? key : 0;
+}
+
+bool SessionTable::contains(const std::string &imsi) const {
+    return index_.find(imsi) != index_.end() || cold_key(imsi) != 0;
+}
+
+bool SessionTable::touch(const std::string &imsi, time_point now) {
+    auto it = index_.find(imsi);
+    if (it == index_.end()) {
+        // promote from the cold tier
+        uint64_t key = cold_key(imsi);
+        int64_t last_seen_ns;
+        if (!key || !cold_->take(key, last_seen_ns)) return false;
+        uint32_t idx = alloc(imsi, now, regular);
+        index_.emplace(imsi, idx);
+        link_back(idx);
+        ++promoted_;
+        return true;
+    }
+    uint32_t idx = it->second;
+    Node &n = nodes_[idx];
+    n.last_seen = now;
+    ++n.refreshes;
+    bool graduate = n.list == low && n.refreshes >= low_activity_refreshes_;
+    if (graduate || idx != lists_[n.list].tail) {
+        unlink(idx);
+        if (graduate) n.list = regular;
+        link_back(idx);
+    }
+    return true;
+}
+
+bool SessionTable::insert(const std::string &imsi, time_point now) {
+    if (full() || cold_key(imsi)) return false;
+    auto res = index_.emplace(imsi, npos);
+    if (!res.second) return false;
+
+    uint32_t idx = alloc(imsi, now, low_activity_refreshes_ ? low : regular);
+    res.first->second = idx;
+    link_back(idx);
+    return true;
+}
+
+bool SessionTable::adopt(const std::string &imsi, time_point last_seen) {
+    if (full() || cold_key(imsi)) return false;
+    auto res = index_.emplace(imsi, npos);
+    if (!res.second) return false;
+
+    // its activity elsewhere is unknown, so it is not treated as low-activity
+    uint32_t idx = alloc(imsi, last_seen, regular);
+    res.first->second = idx;
+
+    // walk back from the hot end to the first entry not newer than last_seen
+    uint32_t pos = lists_[regular].tail;
+    while (pos != npos && nodes_[pos].last_seen > last_seen) pos = nodes_[pos].prev;
+    link_after(pos, idx);
+    return true;
+}
+
+bool SessionTable::erase(const std::string &imsi) {
+    auto it = index_.find(imsi);
+    if (it == index_.end()) {
+        uint64_t key = cold_key(imsi);
+        return key && cold_->erase(key);
+    }
+    remove(it->second);
+    return true;
+}
+
+void SessionTable::clear() {
+    // the vectors keep their capacity and the index its buckets, hash nodes
+    // go back to the arena's free lists
+    index_.clear();
+    nodes_.clear();
+    free_.clear();
+    lists_[low] = List{};
+    lists_[regular] = List{};
+    low_activity_ = 0;
+    if (cold_) {
+        uint64_t key;
+        int64_t ts;
+        while (cold_->oldest(key, ts)) cold_->take(key, ts);
+    }
+}
+
+uint32_t SessionTable::oldest_hot() const {
+    uint32_t a = lists_[low].head, b = lists_[regular].head;
+    if (a == npos) return b;
+    if (b == npos) return a;
+    return nodes_[a].last_seen <= nodes_[b].last_seen ? a : b;
+}
+
+bool SessionTable::peek_oldest(time_point &last_seen) {
+    uint64_t key;
+    int64_t cold_ns;
+    uint32_t head = oldest_hot();
+    bool cold = cold_ && cold_->oldest(key, cold_ns);
+    if (cold && (head == npos || from_ns(cold_ns) <= nodes_[head].last_seen)) {
+        last_seen = from_ns(cold_ns);
+        return true;
+    }
+    if (head == npos) return false;
+    last_seen = nodes_[head].last_seen;
+    return true;
+}
+
+bool SessionTable::pop_oldest(std::string &imsi) {
+    uint64_t key;
+    int64_t cold_ns;
+    uint32_t head = oldest_hot();
+    if (cold_ && cold_->oldest(key, cold_ns) && (head == npos || from_ns(cold_ns) <= nodes_[head].last_seen)) {
+        cold_->erase(key);
+        imsi = unpack_imsi(key);
+        return true;
+    }
+    if (head == npos) return false;
+    imsi = std::move(nodes_[head].imsi);
+    index_.erase(imsi);
+    unlink(head);
+    release(head);
+    return true;
+}
+
+size_t SessionTable::pop_batch(size_t n, std::vector<std::string> &out) {
+    size_t removed = 0;
+    std::string imsi;
+    while (removed < n && pop_oldest(imsi)) {
+        out.push_back(std::move(imsi));
+        ++removed;
+    }
+    return removed;
+}
+
+size_t SessionTable::expire(time_point now, std::chrono::seconds timeout, std::vector<std::string> &out,
+                            size_t max) {
+    size_t removed = 0;
+    std::string imsi;
+    time_point oldest;
+    while (removed < max && peek_oldest(oldest) && now - oldest >= timeout) {
+        pop_oldest(imsi);
+        out.push_back(std::move(imsi));
+        ++removed;
+    }
+    return removed;
+}
+
+size_t SessionTable::expire_low_activity(time_point now, std::chrono::seconds timeout, std::vector<std::string> &out,
+                                         size_t max) {
+    size_t removed = 0;
+    for (uint32_t idx = lists_[low].head; removed < max && idx != npos && now - nodes_[idx].last_seen >= timeout;
+         idx = lists_[low].head) {
+        out.push_back(nodes_[idx].imsi);
+        remove(idx);
+        ++removed;
+    }
+    return removed;
+}
+
+size_t SessionTable::demote(time_point now, std::chrono::seconds idle, size_t max) {
+    if (!cold_ || !cold_->ok()) return 0;
+    size_t examined = 0, moved = 0;
+    // walk both lists oldest first; a session the tier cannot key stays hot
+    // in place, so it neither blocks the ones behind it nor loses its turn
+    // for expiry
+    uint32_t a = lists_[low].head, b = lists_[regular].head;
+    while (examined < max) {
+        bool from_low = b == npos || (a != npos && nodes_[a].last_seen <= nodes_[b].last_seen);
+        uint32_t idx = from_low ? a : b;
+        if (idx == npos || now - nodes_[idx].last_seen < idle) break;
+        (from_low ? a : b) = nodes_[idx].next;
+        ++examined;
+        uint64_t key = pack_imsi(nodes_[idx].imsi);
+        if (!key) continue;
+        if (!cold_->put(key, to_ns(nodes_[idx].last_seen))) break; // tier full
+        remove(idx);
+        ++moved;
+    }
+    demoted_ += moved;
+    return examined;
+}
+
+uint32_t SessionTable::alloc(const std::string &imsi, time_point last_seen, uint8_t list) {
+    uint32_t idx;
+    if (!free_.empty()) {
+        idx = free_.back();
+        free_.pop_back();
+    } else {
+        idx = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    }
+    Node &n = nodes_[idx];
+    n.imsi = imsi;
+    n.last_seen = last_seen;
+    n.refreshes = 0;
+    n.list = list;
+    return idx;
+}
+
+void SessionTable::link_back(uint32_t idx) {
+    Node &n = nodes_[idx];
+    List &l = lists_[n.list];
+    n.prev = l.tail;
+    n.next = npos;
+    if (l.tail != npos) nodes_[l.tail].next = idx;
+    else l.head = idx;
+    l.tail = idx;
+    if (n.list == low) ++low_activity_;
+}
+
+// pos == npos links at the head
+void SessionTable::link_after(uint32_t pos, uint32_t idx) {
+    Node &n = nodes_[idx];
+    List &l = lists_[n.list];
+    if (pos == l.tail) {
+        link_back(idx);
+        return;
+    }
+    n.prev = pos;
+    n.next = (pos == npos) ? l.head : nodes_[pos].next;
+    nodes_[n.next].prev = idx;
+    if (pos == npos) l.head = idx;
+    else nodes_[pos].next = idx;
+    if (n.list == low) ++low_activity_;
+}
+
+void SessionTable::unlink(uint32_t idx) {
+    Node &n = nodes_[idx];
+    List &l = lists_[n.list];
+    if (n.prev != npos) nodes_[n.prev].next = n.next;
+    else l.head = n.next;
+    if (n.next != npos) nodes_[n.next].prev = n.prev;
+    else l.tail = n.prev;
+    n.prev = n.next = npos;
+    if (n.list == low) --low_activity_;
+}
+
+void SessionTable::remove(uint32_t idx) {
+    index_.erase(nodes_[idx].imsi);
+    unlink(idx);
+    release(idx);
+}
+
+void SessionTable::release(uint32_t idx) {
+    nodes_[idx].imsi.clear();
+    free_.push_back(idx);
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+#include "cold_tier.h"
+#include "imsi_to_bcd.h"
+#include "session_arena.h"
+
+// Session storage with O(1) lookup and an intrusive recency list.
+// Entries are kept in least-recently-refreshed order (head = oldest), so LRU
+// eviction, timeout sweeps and offload batches only touch the cold end.
+// Optionally backed by a ColdTier: demote() moves sessions idle for longer
+// than a threshold out of RAM, touch() promotes them back, and every other
+// operation (lookup, expiry, eviction, iteration) covers both tiers.
+// With set_low_activity_refreshes(n), sessions refreshed fewer than n times
+// sit on a list of their own (same order), so expire_low_activity() can
+// apply a shorter timeout to them without scanning the rest; everything else
+// sees the two lists merged by last-seen time.
+// Hot-tier storage can come from a SessionArena, pre-sized for the expected
+// number of sessions; without one it is ordinary heap memory.
+// Not thread-safe: the owner serialises access (Server::sess_m_).
+class SessionTable {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    // capacity == 0 means unbounded; storage for max(capacity, expected)
+    // sessions is reserved up front, from the arena if one is given (it must
+    // outlive the table)
+    explicit SessionTable(size_t capacity = 0, SessionArena *arena = nullptr, size_t expected = 0);
+
+    // arena size that holds `sessions` hot sessions without falling back to the heap
+    static size_t arena_bytes(size_t sessions);
+
+    size_t size() const { return index_.size() + cold_size(); }
+    size_t capacity() const { return capacity_; }
+    bool full() const { return capacity_ != 0 && size() >= capacity_; }
+    bool empty() const { return size() == 0; }
+
+    // cold tier; the table owns it from here on
+    void set_cold_tier(std::unique_ptr<ColdTier> cold);
+    const ColdTier *cold_tier() const { return cold_.get(); }
+    size_t hot_size() const { return index_.size(); }
+    size_t cold_size() const { return cold_ ? cold_->size() : 0; }
+    uint64_t demoted_total() const { return demoted_; }
+    uint64_t promoted_total() const { return promoted_; }
+
+    // sessions refreshed fewer than n times count as low-activity, 0 = none
+    // (the default); set before the first insert
+    void set_low_activity_refreshes(uint32_t n) { low_activity_refreshes_ = n; }
+    size_t low_activity_size() const { return low_activity_; }
+
+    // moves sessions idle for at least `idle` to the cold tier, oldest first,
+    // looking at up to max of them; returns how many it looked at (sessions
+    // whose IMSI does not pack stay hot) and stops early when the tier is full
+    size_t demote(time_point now, std::chrono::seconds idle, size_t max);
+
+    bool contains(const std::string &imsi) const;
+
+    // refresh last-seen and move to the hot end; false if not present
+    bool touch(const std::string &imsi, time_point now);
+
+    // insert a new session at the hot end; false if present or table is full
+    bool insert(const std::string &imsi, time_point now);
+
+    // insert a session carried over from another node, keeping recency order
+    // by its original last-seen time; false if present or table is full
+    bool adopt(const std::string &imsi, time_point last_seen);
+
+    bool erase(const std::string &imsi);
+
+    // remove every session from both tiers, keeping the reserved storage
+    // and the settings
+    void clear();
+
+    // remove the least-recently-refreshed session
+    bool pop_oldest(std::string &imsi);
+
+    // remove up to n sessions, oldest first; returns number removed
+    size_t pop_batch(size_t n, std::vector<std::string> &out);
+
+    // remove up to `max` sessions idle for at least `timeout`, oldest first
+    size_t expire(time_point now, std::chrono::seconds timeout, std::vector<std::string> &out,
+                  size_t max = SIZE_MAX);
+
+    // same, for low-activity sessions only
+    size_t expire_low_activity(time_point now, std::chrono::seconds timeout, std::vector<std::string> &out,
+                               size_t max = SIZE_MAX);
+
+    // last-seen time of the oldest session in either tier
+    bool peek_oldest(time_point &last_seen);
+
+    // visit sessions oldest first: f(imsi, last_seen)
+    template <typename F>
+    void for_each(F &&f) const {
+        for_each_oldest(SIZE_MAX, std::forward<F>(f));
+    }
+
+    // same, stopping after n sessions; cold sessions come first, they are
+    // older than anything still hot
+    template <typename F>
+    void for_each_oldest(size_t n, F &&f) const {
+        if (cold_ && n > 0) {
+            cold_->for_each([&](uint64_t key, int64_t last_seen_ns) {
+                f(unpack_imsi(key), from_ns(last_seen_ns));
+                return --n > 0;
+            });
+        }
+        uint32_t a = lists_[low].head, b = lists_[regular].head;
+        for (; (a != npos || b != npos) && n > 0; --n) {
+            uint32_t i;
+            if (b == npos || (a != npos && nodes_[a].last_seen <= nodes_[b].last_seen)) {
+                i = a;
+                a = nodes_[a].next;
+            } else {
+                i = b;
+                b = nodes_[b].next;
+            }
+            f(nodes_[i].imsi, nodes_[i].last_seen);
+        }
+    }
+
+private:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    // recency lists: low-activity sessions and everything else
+    enum : uint8_t { low = 0, regular = 1 };
+
+    struct Node {
+        std::string imsi;
+        time_point last_seen;
+        uint32_t prev = npos;
+        uint32_t next = npos;
+        uint32_t refreshes = 0;
+        uint8_t list = regular;
+    };
+
+    struct List {
+        uint32_t head = npos;
+        uint32_t tail = npos;
+    };
+
+    static int64_t to_ns(time_point t) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+    }
+    static time_point from_ns(int64_t ns) {
+        return time_point(std::chrono::duration_cast<time_point::duration>(std::chrono::nanoseconds(ns)));
+    }
+    // packed key of imsi if the cold tier is on and holds it, else 0
+    uint64_t cold_key(const std::string &imsi) const;
+    // oldest hot session over both lists, npos if none
+    uint32_t oldest_hot() const;
+
+    uint32_t alloc(const std::string &imsi, time_point last_seen, uint8_t list);
+    // list operations act on the node's own list
+    void link_back(uint32_t idx);
+    void link_after(uint32_t pos, uint32_t idx);
+    void unlink(uint32_t idx);
+    void remove(uint32_t idx); // unlink, drop from the index and free
+    void release(uint32_t idx);
+
+    using Index = std::unordered_map<std::string, uint32_t, std::hash<std::string>, std::equal_to<std::string>,
+                                     ArenaAllocator<std::pair<const std::string, uint32_t>>>;
+
+    std::vector<Node, ArenaAllocator<Node>> nodes_;
+    std::vector<uint32_t, ArenaAllocator<uint32_t>> free_;
+    Index index_;
+    List lists_[2];
+    size_t low_activity_ = 0;
+    uint32_t low_activity_refreshes_ = 0;
+    size_t capacity_;
+    std::unique_ptr<ColdTier> cold_;
+    uint64_t demoted_ = 0;
+    uint64_t promoted_ = 0;
+};
@@ -0,0 +1,193 @@
+#include "trace.h"
+
+#include <nlohmann/json.hpp>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+namespace {
+
+struct TraceRing {
+    // seq = index + 1 once complete, 0 while being overwritten
+    struct Entry {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<int64_t> ts{0};
+        std::atomic<int64_t> dur{-1}; // -1 = instant
+        std::atomic<uint64_t> arg{0};
+        std::atomic<uint32_t> event{0};
+    };
+
+    explicit TraceRing(size_t cap)
+        : entries(new Entry[cap]), mask(cap - 1), tid(static_cast<int>(syscall(SYS_gettid))) {}
+
+    std::unique_ptr<Entry[]> entries;
+    const uint64_t mask;
+    std::atomic<uint64_t> head{0}; // written by the owning thread only
+    const int tid;
+    std::atomic<bool> alive{true};
+    std::mutex name_m;
+    std::string name;
+};
+
+std::atomic<size_t> g_ring_size{4096};
+std::mutex g_rings_m;
+std::vector<std::shared_ptr<TraceRing>> g_rings;
+constexpr size_t max_dead_rings = 8; // rings of exited threads kept for dumps
+
+// owns the calling thread's ring; retires it when the thread exits
+struct RingHolder {
+    std::shared_ptr<TraceRing> ring;
+    ~RingHolder() {
+        if (!ring) return;
+        ring->alive = false;
+        std::lock_guard<std::mutex> lk(g_rings_m);
+        size_t dead = static_cast<size_t>(std::count_if(g_rings.begin(), g_rings.end(),
+            [](const std::shared_ptr<TraceRing> &r) { return !r->alive; }));
+        for (auto it = g_rings.begin(); dead > max_dead_rings && it != g_rings.end();) {
+            if (!(*it)->alive) {
+                it = g_rings.erase(it);
+                --dead;
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+thread_local RingHolder t_ring;
+
+TraceRing *local_ring() {
+    if (t_ring.ring) return t_ring.ring.get();
+    size_t want = g_ring_size.load(std::memory_order_relaxed);
+    if (want == 0) return nullptr;
+    size_t cap = 1;
+    while (cap < want) cap <<= 1;
+    t_ring.ring = std::make_shared<TraceRing>(cap);
+    std::lock_guard<std::mutex> lk(g_rings_m);
+    g_rings.push_back(t_ring.ring);
+    return t_ring.ring.get();
+}
+
+void record(TraceEvent e, int64_t ts, int64_t dur, uint64_t arg) {
+    if (!trace_enabled()) return;
+    TraceRing *r = local_ring();
+    if (!r) return;
+    uint64_t h = r->head.load(std::memory_order_relaxed);
+    TraceRing::Entry &en = r->entries[h & r->mask];
+    en.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    en.ts.store(ts, std::memory_order_relaxed);
+    en.dur.store(dur, std::memory_order_relaxed);
+    en.arg.store(arg, std::memory_order_relaxed);
+    en.event.store(static_cast<uint32_t>(e), std::memory_order_relaxed);
+    en.seq.store(h + 1, std::memory_order_release);
+    r->head.store(h + 1, std::memory_order_release);
+}
+
+} // namespace
+
+const char *trace_event_name(TraceEvent e) {
+    switch (e) {
+        case TraceEvent::packet_received: return "packet_received";
+        case TraceEvent::packet_decoded: return "packet_decoded";
+        case TraceEvent::session_lock: return "session_lock";
+        case TraceEvent::session_decision: return "session_decision";
+        case TraceEvent::cdr_append: return "cdr_append";
+        case TraceEvent::reply_sent: return "reply_sent";
+        case TraceEvent::expiry_sweep: return "expiry_sweep";
+        default: return "unknown";
+    }
+}
+
+void trace_set_ring_size(size_t events) {
+    g_ring_size.store(events, std::memory_order_relaxed);
+}
+
+bool trace_enabled() {
+    return g_ring_size.load(std::memory_order_relaxed) != 0;
+}
+
+void trace_thread_name(const std::string &name) {
+    TraceRing *r = local_ring();
+    if (!r) return;
+    std::lock_guard<std::mutex> lk(r->name_m);
+    r->name = name;
+}
+
+int64_t trace_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void trace_instant(TraceEvent e, uint64_t arg) {
+    record(e, trace_now_ns(), -1, arg);
+}
+
+void trace_complete(TraceEvent e, int64_t start_ns, int64_t end_ns, uint64_t arg) {
+    record(e, start_ns, end_ns - start_ns, arg);
+}
+
+std::string trace_chrome_json(int64_t since_ns) {
+    std::vector<std::shared_ptr<TraceRing>> rings;
+    {
+        std::lock_guard<std::mutex> lk(g_rings_m);
+        rings = g_rings;
+    }
+
+    const int pid = static_cast<int>(getpid());
+    nlohmann::json events = nlohmann::json::array();
+    struct Copy { int64_t ts, dur; uint64_t arg; uint32_t event; };
+    std::vector<Copy> copy;
+    for (const auto &r : rings) {
+        const uint64_t cap = r->mask + 1;
+        uint64_t h1 = r->head.load(std::memory_order_acquire);
+        uint64_t first = h1 > cap ? h1 - cap : 0;
+        copy.clear();
+        for (uint64_t i = first; i < h1; ++i) {
+            const TraceRing::Entry &en = r->entries[i & r->mask];
+            uint64_t s1 = en.seq.load(std::memory_order_acquire);
+            Copy c{en.ts.load(std::memory_order_relaxed), en.dur.load(std::memory_order_relaxed),
+                   en.arg.load(std::memory_order_relaxed), en.event.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // skip entries the writer has lapped meanwhile
+            if (s1 != i + 1 || en.seq.load(std::memory_order_relaxed) != s1) continue;
+            if (c.ts < since_ns || c.event >= static_cast<uint32_t>(TraceEvent::count_)) continue;
+            copy.push_back(c);
+        }
+        if (copy.empty()) continue;
+
+        {
+            std::lock_guard<std::mutex> lk(r->name_m);
+            if (!r->name.empty()) {
+                events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", pid}, {"tid", r->tid},
+                                  {"args", {{"name", r->name}}}});
+            }
+        }
+        for (const Copy &c : copy) {
+            nlohmann::json ev = {
+                {"name", trace_event_name(static_cast<TraceEvent>(c.event))},
+                {"cat", "pgw"},
+                {"pid", pid},
+                {"tid", r->tid},
+                {"ts", static_cast<double>(c.ts) / 1000.0},
+                {"args", {{"arg", c.arg}}}
+            };
+            if (c.dur >= 0) {
+                ev["ph"] = "X";
+                ev["dur"] = static_cast<double>(c.dur) / 1000.0;
+            } else {
+                ev["ph"] = "i";
+                ev["s"] = "t";
+            }
+            events.push_back(std::move(ev));
+        }
+    }
+    nlohmann::json out = {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ns"}};
+    return out.dump();
+}
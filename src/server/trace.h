@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Hot-path tracing.
+//
+// Every trace point is both a static USDT probe (provider "pgw", usable from
+// bpftrace/perf when <sys/sdt.h> is available at build time; a nop otherwise)
+// and an entry in an always-on per-thread ring of recent events. A ring has
+// a single writer (its thread) and is read without locks, so recording costs
+// a clock read and a few relaxed stores. GET /trace dumps the rings in Chrome
+// trace format (chrome://tracing, Perfetto) to diagnose stalls after the fact.
+
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PGW_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef PGW_HAVE_USDT
+#define PGW_USDT1(name, a) DTRACE_PROBE1(pgw, name, a)
+#define PGW_USDT2(name, a, b) DTRACE_PROBE2(pgw, name, a, b)
+#else
+#define PGW_USDT1(name, a) do { (void)(a); } while (0)
+#define PGW_USDT2(name, a, b) do { (void)(a); (void)(b); } while (0)
+#endif
+
+enum class TraceEvent : uint8_t {
+    packet_received,   // instant, arg = datagram bytes
+    packet_decoded,    // instant, arg = number of IMSIs
+    session_lock,      // span: waiting for sess_m_
+    session_decision,  // span: SessionCore under sess_m_, arg = packed IMSI
+    cdr_append,        // span: CDR write incl. its mutex, arg = record bytes
+    reply_sent,        // instant, arg = reply bytes
+    expiry_sweep,      // span, arg = sessions expired
+    count_
+};
+
+const char *trace_event_name(TraceEvent e);
+
+// events kept per thread (rounded up to a power of two), 0 disables
+// recording; rings already created keep their size
+void trace_set_ring_size(size_t events);
+bool trace_enabled();
+
+// labels the calling thread in dumps
+void trace_thread_name(const std::string &name);
+
+int64_t trace_now_ns();
+void trace_instant(TraceEvent e, uint64_t arg = 0);
+void trace_complete(TraceEvent e, int64_t start_ns, int64_t end_ns, uint64_t arg = 0);
+
+// trace points: `name` is both the TraceEvent and the USDT probe name
+#define PGW_TRACE_INSTANT(name, arg) do { \
+        uint64_t pgw_arg_ = static_cast<uint64_t>(arg); \
+        PGW_USDT1(name, pgw_arg_); \
+        trace_instant(TraceEvent::name, pgw_arg_); \
+    } while (0)
+
+// closes a span opened at start_ns; the probe gets (arg, duration_ns)
+#define PGW_TRACE_SPAN_END(name, start_ns, arg) do { \
+        int64_t pgw_end_ = trace_now_ns(); \
+        uint64_t pgw_arg_ = static_cast<uint64_t>(arg); \
+        PGW_USDT2(name, pgw_arg_, pgw_end_ - (start_ns)); \
+        trace_complete(TraceEvent::name, (start_ns), pgw_end_, pgw_arg_); \
+    } while (0)
+
+// Chrome trace JSON of events newer than since_ns (steady clock), all rings
+std::string trace_chrome_json(int64_t since_ns = 0);
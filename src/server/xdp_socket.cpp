@@ -0,0 +1,393 @@
+#include "xdp_socket.h"
+
+#include <cstddef>
+#include <cstring>
+
+bool XdpSocket::Packet::send(const void *data, size_t n) {
+    return owner && owner->reply(*this, data, n);
+}
+
+#ifdef PGW_XDP
+
+#include <linux/bpf.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <cerrno>
+#include <vector>
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+static constexpr uint32_t frame_size = 2048;
+static constexpr size_t eth_len = 14;
+static constexpr size_t ip_len = 20;
+static constexpr size_t udp_len = 8;
+static constexpr size_t headers_len = eth_len + ip_len + udp_len;
+
+static long sys_bpf(int cmd, bpf_attr &attr) {
+    return syscall(__NR_bpf, cmd, &attr, sizeof(attr));
+}
+
+static bpf_insn insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+    bpf_insn i{};
+    i.code = code;
+    i.dst_reg = dst & 0xf;
+    i.src_reg = src & 0xf;
+    i.off = off;
+    i.imm = imm;
+    return i;
+}
+
+// one's complement sum over the IPv4 header, 0 when a stored checksum is right
+static uint16_t ip_checksum(const uint8_t *hdr, size_t len) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < len; i += 2) sum += static_cast<uint32_t>(hdr[i] << 8 | hdr[i + 1]);
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return static_cast<uint16_t>(~sum);
+}
+
+template <typename T>
+static T load_acquire(const T *p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+template <typename T>
+static void store_release(T *p, T v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+XdpSocket::XdpSocket(Options opts) : opts_(std::move(opts)) {
+    uint32_t n = 64;
+    while (n < opts_.frames) n <<= 1;
+    opts_.frames = n;
+    if (opts_.mode != "generic" && opts_.mode != "native") {
+        error_ = "unknown mode '" + opts_.mode + "'";
+        return;
+    }
+    if (!setup()) close_all();
+}
+
+XdpSocket::~XdpSocket() {
+    close_all();
+}
+
+void XdpSocket::close_all() {
+    // closing the link detaches the program from the interface
+    for (int *f : {&link_fd_, &prog_fd_, &map_fd_}) {
+        if (*f >= 0) close(*f);
+        *f = -1;
+    }
+    for (Ring *r : {&fill_, &comp_, &rx_, &tx_}) {
+        if (r->map) munmap(r->map, r->map_len);
+        *r = Ring{};
+    }
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+    if (umem_) munmap(umem_, umem_len_);
+    umem_ = nullptr;
+}
+
+bool XdpSocket::map_ring(Ring &ring, uint32_t entries, uint64_t pgoff, const void *offsets, size_t desc_size) {
+    const auto *off = static_cast<const xdp_ring_offset*>(offsets);
+    ring.map_len = off->desc + entries * desc_size;
+    void *p = mmap(nullptr, ring.map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                   static_cast<off_t>(pgoff));
+    if (p == MAP_FAILED) {
+        error_ = std::string("mmap ring: ") + strerror(errno);
+        return false;
+    }
+    auto *base = static_cast<uint8_t*>(p);
+    ring.map = p;
+    ring.producer = reinterpret_cast<uint32_t*>(base + off->producer);
+    ring.consumer = reinterpret_cast<uint32_t*>(base + off->consumer);
+    ring.flags = reinterpret_cast<uint32_t*>(base + off->flags);
+    ring.desc = base + off->desc;
+    ring.mask = entries - 1;
+    return true;
+}
+
+bool XdpSocket::setup() {
+    ifindex_ = static_cast<int>(if_nametoindex(opts_.interface.c_str()));
+    if (ifindex_ == 0) {
+        error_ = "no interface '" + opts_.interface + "'";
+        return false;
+    }
+    fd_ = socket(AF_XDP, SOCK_RAW, 0);
+    if (fd_ < 0) {
+        error_ = std::string("socket(AF_XDP): ") + strerror(errno);
+        return false;
+    }
+
+    umem_len_ = static_cast<size_t>(opts_.frames) * frame_size;
+    void *p = mmap(nullptr, umem_len_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (p == MAP_FAILED) {
+        error_ = std::string("mmap umem: ") + strerror(errno);
+        return false;
+    }
+    umem_ = static_cast<uint8_t*>(p);
+
+    xdp_umem_reg reg{};
+    reg.addr = reinterpret_cast<uint64_t>(umem_);
+    reg.len = umem_len_;
+    reg.chunk_size = frame_size;
+    reg.headroom = 0;
+    if (setsockopt(fd_, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+        error_ = std::string("XDP_UMEM_REG: ") + strerror(errno);
+        return false;
+    }
+    // every frame fits in the fill and completion rings; RX and TX take half
+    uint32_t all = opts_.frames, half = opts_.frames / 2;
+    if (setsockopt(fd_, SOL_XDP, XDP_UMEM_FILL_RING, &all, sizeof(all)) < 0 ||
+        setsockopt(fd_, SOL_XDP, XDP_UMEM_COMPLETION_RING, &all, sizeof(all)) < 0 ||
+        setsockopt(fd_, SOL_XDP, XDP_RX_RING, &half, sizeof(half)) < 0 ||
+        setsockopt(fd_, SOL_XDP, XDP_TX_RING, &half, sizeof(half)) < 0) {
+        error_ = std::string("XDP ring sizes: ") + strerror(errno);
+        return false;
+    }
+    xdp_mmap_offsets off{};
+    socklen_t optlen = sizeof(off);
+    if (getsockopt(fd_, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) {
+        error_ = std::string("XDP_MMAP_OFFSETS: ") + strerror(errno);
+        return false;
+    }
+    if (!map_ring(fill_, all, XDP_UMEM_PGOFF_FILL_RING, &off.fr, sizeof(uint64_t)) ||
+        !map_ring(comp_, all, XDP_UMEM_PGOFF_COMPLETION_RING, &off.cr, sizeof(uint64_t)) ||
+        !map_ring(rx_, half, XDP_PGOFF_RX_RING, &off.rx, sizeof(xdp_desc)) ||
+        !map_ring(tx_, half, XDP_PGOFF_TX_RING, &off.tx, sizeof(xdp_desc))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < opts_.frames; ++i) recycle(static_cast<uint64_t>(i) * frame_size);
+    store_release(fill_.producer, fill_prod_);
+
+    sockaddr_xdp sxdp{};
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = static_cast<uint32_t>(ifindex_);
+    sxdp.sxdp_queue_id = opts_.queue;
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | (opts_.mode == "generic" ? XDP_COPY : 0);
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&sxdp), sizeof(sxdp)) < 0) {
+        error_ = std::string("bind AF_XDP: ") + strerror(errno);
+        return false;
+    }
+    return load_program();
+}
+
+bool XdpSocket::load_program() {
+    bpf_attr attr{};
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = opts_.queue + 1;
+    map_fd_ = static_cast<int>(sys_bpf(BPF_MAP_CREATE, attr));
+    if (map_fd_ < 0) {
+        error_ = std::string("XSKMAP: ") + strerror(errno);
+        return false;
+    }
+    uint32_t key = opts_.queue, value = static_cast<uint32_t>(fd_);
+    attr = bpf_attr{};
+    attr.map_fd = static_cast<uint32_t>(map_fd_);
+    attr.key = reinterpret_cast<uint64_t>(&key);
+    attr.value = reinterpret_cast<uint64_t>(&value);
+    if (sys_bpf(BPF_MAP_UPDATE_ELEM, attr) < 0) {
+        error_ = std::string("XSKMAP update: ") + strerror(errno);
+        return false;
+    }
+
+    // r1 = ctx; redirect IPv4 (no options, not fragmented) UDP to udp_port,
+    // pass everything else; the header loads read network order as-is, so
+    // the constants are in network order too
+    const int pass = 22;
+    std::vector<bpf_insn> prog = {
+        /*  0 */ insn(BPF_LDX | BPF_W | BPF_MEM, 2, 1, offsetof(xdp_md, data), 0),
+        /*  1 */ insn(BPF_LDX | BPF_W | BPF_MEM, 3, 1, offsetof(xdp_md, data_end), 0),
+        /*  2 */ insn(BPF_ALU64 | BPF_MOV | BPF_X, 4, 2, 0, 0),
+        /*  3 */ insn(BPF_ALU64 | BPF_ADD | BPF_K, 4, 0, 0, static_cast<int32_t>(headers_len)),
+        /*  4 */ insn(BPF_JMP | BPF_JGT | BPF_X, 4, 3, pass - 5, 0),
+        /*  5 */ insn(BPF_LDX | BPF_H | BPF_MEM, 5, 2, 12, 0),
+        /*  6 */ insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, pass - 7, htons(ETH_P_IP)),
+        /*  7 */ insn(BPF_LDX | BPF_B | BPF_MEM, 5, 2, eth_len, 0),
+        /*  8 */ insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, pass - 9, 0x45),
+        /*  9 */ insn(BPF_LDX | BPF_B | BPF_MEM, 5, 2, eth_len + 9, 0),
+        /* 10 */ insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, pass - 11, IPPROTO_UDP),
+        /* 11 */ insn(BPF_LDX | BPF_H | BPF_MEM, 5, 2, eth_len + 6, 0),
+        /* 12 */ insn(BPF_ALU64 | BPF_AND | BPF_K, 5, 0, 0, htons(0x3fff)),
+        /* 13 */ insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, pass - 14, 0),
+        /* 14 */ insn(BPF_LDX | BPF_H | BPF_MEM, 5, 2, eth_len + ip_len + 2, 0),
+        /* 15 */ insn(BPF_JMP | BPF_JNE | BPF_K, 5, 0, pass - 16, htons(opts_.udp_port)),
+        /* 16 */ insn(BPF_LDX | BPF_W | BPF_MEM, 2, 1, offsetof(xdp_md, rx_queue_index), 0),
+        /* 17 */ insn(BPF_LD | BPF_DW | BPF_IMM, 1, BPF_PSEUDO_MAP_FD, 0, map_fd_),
+        /* 18 */ insn(0, 0, 0, 0, 0),
+        /* 19 */ insn(BPF_ALU64 | BPF_MOV | BPF_K, 3, 0, 0, XDP_PASS), // no socket on the queue
+        /* 20 */ insn(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+        /* 21 */ insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+        /* 22 */ insn(BPF_ALU64 | BPF_MOV | BPF_K, 0, 0, 0, XDP_PASS),
+        /* 23 */ insn(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+    };
+    static const char license[] = "GPL";
+    char log[4096] = {};
+    attr = bpf_attr{};
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = reinterpret_cast<uint64_t>(prog.data());
+    attr.insn_cnt = static_cast<uint32_t>(prog.size());
+    attr.license = reinterpret_cast<uint64_t>(license);
+    attr.log_buf = reinterpret_cast<uint64_t>(log);
+    attr.log_size = sizeof(log);
+    attr.log_level = 1;
+    prog_fd_ = static_cast<int>(sys_bpf(BPF_PROG_LOAD, attr));
+    if (prog_fd_ < 0) {
+        error_ = std::string("XDP program load: ") + strerror(errno) + (log[0] ? std::string(": ") + log : "");
+        return false;
+    }
+
+    attr = bpf_attr{};
+    attr.link_create.prog_fd = static_cast<uint32_t>(prog_fd_);
+    attr.link_create.target_ifindex = static_cast<uint32_t>(ifindex_);
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = opts_.mode == "generic" ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE;
+    link_fd_ = static_cast<int>(sys_bpf(BPF_LINK_CREATE, attr));
+    if (link_fd_ < 0) {
+        error_ = std::string("XDP attach to ") + opts_.interface + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+void XdpSocket::recycle(uint64_t addr) {
+    // back to the start of its frame
+    static_cast<uint64_t*>(fill_.desc)[fill_prod_++ & fill_.mask] = addr & ~static_cast<uint64_t>(frame_size - 1);
+}
+
+bool XdpSocket::next(Packet &p) {
+    uint32_t prod = load_acquire(rx_.producer);
+    while (rx_cons_ != prod) {
+        const xdp_desc d = static_cast<const xdp_desc*>(rx_.desc)[rx_cons_++ & rx_.mask];
+        const uint8_t *f = umem_ + d.addr;
+        // the program filtered already; the headers are checked again here
+        // because user space is what trusts the lengths
+        bool ok = d.len >= headers_len;
+        size_t ihl = 0, tot = 0, ulen = 0;
+        if (ok) {
+            uint16_t ethertype = static_cast<uint16_t>(f[12] << 8 | f[13]);
+            const uint8_t *ip = f + eth_len;
+            ihl = static_cast<size_t>(ip[0] & 0x0f) * 4;
+            tot = static_cast<size_t>(ip[2] << 8 | ip[3]);
+            ok = ethertype == ETH_P_IP && (ip[0] >> 4) == 4 && ihl == ip_len && ip[9] == IPPROTO_UDP &&
+                 (static_cast<uint16_t>(ip[6] << 8 | ip[7]) & 0x3fff) == 0 &&
+                 tot >= ip_len + udp_len && eth_len + tot <= d.len && ip_checksum(ip, ip_len) == 0;
+        }
+        if (ok) {
+            const uint8_t *udp = f + eth_len + ip_len;
+            ulen = static_cast<size_t>(udp[4] << 8 | udp[5]);
+            uint16_t dport = static_cast<uint16_t>(udp[2] << 8 | udp[3]);
+            uint32_t daddr;
+            std::memcpy(&daddr, f + eth_len + 16, sizeof(daddr));
+            ok = dport == opts_.udp_port && ulen >= udp_len && ulen <= tot - ip_len &&
+                 (opts_.ip == 0 || daddr == opts_.ip);
+        }
+        if (!ok) {
+            rx_invalid_.fetch_add(1, std::memory_order_relaxed);
+            recycle(d.addr);
+            continue;
+        }
+        p = Packet{};
+        p.src.sin_family = AF_INET;
+        std::memcpy(&p.src.sin_addr.s_addr, f + eth_len + 12, sizeof(uint32_t));
+        std::memcpy(&p.src.sin_port, f + eth_len + ip_len, sizeof(uint16_t));
+        p.payload = f + headers_len;
+        p.len = ulen - udp_len;
+        p.owner = this;
+        p.addr = d.addr;
+        rx_packets_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+bool XdpSocket::reply(Packet &p, const void *data, size_t n) {
+    if (p.replied) return false;
+    uint32_t prod = *tx_.producer;
+    if (prod - load_acquire(tx_.consumer) > tx_.mask || headers_len + n > frame_size - (p.addr & (frame_size - 1))) {
+        tx_dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // rewrite the request frame in place: swap addresses and ports, new lengths
+    uint8_t *f = umem_ + p.addr;
+    uint8_t mac[6], ips[8], ports[4];
+    std::memcpy(mac, f, 6);
+    std::memcpy(f, f + 6, 6);
+    std::memcpy(f + 6, mac, 6);
+    uint8_t *ip = f + eth_len;
+    std::memcpy(ips, ip + 16, 4);
+    std::memcpy(ips + 4, ip + 12, 4);
+    uint8_t *udp = ip + ip_len;
+    std::memcpy(ports, udp + 2, 2);
+    std::memcpy(ports + 2, udp, 2);
+    std::memmove(f + headers_len, data, n);
+
+    uint16_t tot = htons(static_cast<uint16_t>(ip_len + udp_len + n));
+    uint16_t flags = htons(0x4000); // don't fragment
+    ip[0] = 0x45;
+    ip[1] = 0;
+    std::memcpy(ip + 2, &tot, 2);
+    std::memset(ip + 4, 0, 2);
+    std::memcpy(ip + 6, &flags, 2);
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    std::memset(ip + 10, 0, 2);
+    std::memcpy(ip + 12, ips, 8);
+    uint16_t sum = htons(ip_checksum(ip, ip_len));
+    std::memcpy(ip + 10, &sum, 2);
+    uint16_t ulen = htons(static_cast<uint16_t>(udp_len + n));
+    std::memcpy(udp, ports, 4);
+    std::memcpy(udp + 4, &ulen, 2);
+    std::memset(udp + 6, 0, 2); // no UDP checksum, allowed over IPv4
+
+    xdp_desc &d = static_cast<xdp_desc*>(tx_.desc)[prod & tx_.mask];
+    d.addr = p.addr;
+    d.len = static_cast<uint32_t>(headers_len + n);
+    d.options = 0;
+    store_release(tx_.producer, prod + 1);
+    ++tx_pending_;
+    tx_packets_.fetch_add(1, std::memory_order_relaxed);
+    p.replied = true;
+    return true;
+}
+
+void XdpSocket::flush() {
+    store_release(rx_.consumer, rx_cons_);
+    if (tx_pending_) {
+        // copy mode transmits from the sendto() call itself
+        if (opts_.mode == "generic" || (load_acquire(tx_.flags) & XDP_RING_NEED_WAKEUP)) {
+            sendto(fd_, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+        }
+        tx_pending_ = 0;
+    }
+    uint32_t cons = *comp_.consumer;
+    uint32_t prod = load_acquire(comp_.producer);
+    for (; cons != prod; ++cons) recycle(static_cast<const uint64_t*>(comp_.desc)[cons & comp_.mask]);
+    store_release(comp_.consumer, cons);
+    store_release(fill_.producer, fill_prod_);
+}
+
+#else
+
+XdpSocket::XdpSocket(Options opts) : opts_(std::move(opts)) {
+    error_ = "built without ENABLE_XDP";
+}
+
+XdpSocket::~XdpSocket() = default;
+
+void XdpSocket::close_all() {}
+bool XdpSocket::setup() { return false; }
+bool XdpSocket::map_ring(Ring&, uint32_t, uint64_t, const void*, size_t) { return false; }
+bool XdpSocket::load_program() { return false; }
+bool XdpSocket::next(Packet&) { return false; }
+bool XdpSocket::reply(Packet&, const void*, size_t) { return false; }
+void XdpSocket::recycle(uint64_t) {}
+void XdpSocket::flush() {}
+
+#endif
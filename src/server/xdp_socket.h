@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include <netinet/in.h>
+
+// AF_XDP receive path for the UDP port, bypassing the kernel UDP stack.
+//
+// A small XDP program on the interface queue redirects IPv4/UDP frames for
+// udp_port into an AF_XDP socket; everything else (ARP, other ports, IP
+// options, fragments) passes on to the kernel as usual. Frames land in a
+// UMEM shared with user space, where the Ethernet/IPv4/UDP headers are
+// checked again and the payload is handed to the caller. A reply is built
+// in the same frame (addresses and ports swapped) and goes out through the
+// TX ring; frames come back through the completion ring to the fill ring.
+//
+// "generic" mode attaches in SKB mode with copying, so it works on any
+// interface including veth pairs; "native" asks the driver for it and lets
+// the kernel pick zero-copy where the NIC supports it.
+//
+// Built only with -DENABLE_XDP=ON (no libbpf needed, the program is loaded
+// with raw bpf() calls); otherwise ok() is false and error() says so.
+// Needs CAP_NET_ADMIN and CAP_BPF (or root). Single-threaded: one owner
+// drives receive().
+class XdpSocket {
+public:
+    struct Options {
+        std::string interface;
+        uint32_t queue = 0;
+        uint32_t ip = 0;                 // destination address, network order; 0 = any
+        uint16_t udp_port = 9000;
+        uint32_t frames = 4096;          // UMEM frames of 2 KiB, rounded up to a power of two
+        std::string mode = "generic";    // "generic" (SKB, copy) or "native" (driver)
+    };
+
+    // one redirected datagram; send() queues at most one reply to its source
+    struct Packet {
+        sockaddr_in src{};
+        const uint8_t *payload = nullptr;
+        size_t len = 0;
+
+        bool send(const void *data, size_t n);
+
+    private:
+        friend class XdpSocket;
+        XdpSocket *owner = nullptr;
+        uint64_t addr = 0;
+        bool replied = false;
+    };
+
+    explicit XdpSocket(Options opts);
+    ~XdpSocket();
+
+    XdpSocket(const XdpSocket&) = delete;
+    XdpSocket& operator=(const XdpSocket&) = delete;
+
+    bool ok() const { return fd_ >= 0; }
+    const std::string &error() const { return error_; }
+    int fd() const { return fd_; }
+    const Options &options() const { return opts_; }
+
+    // handles up to `max` received datagrams, f(Packet&); returns how many
+    template <typename F>
+    size_t receive(F &&f, size_t max = 64) {
+        Packet p;
+        size_t n = 0;
+        for (; n < max && next(p); ++n) {
+            f(p);
+            if (!p.replied) recycle(p.addr);
+        }
+        flush();
+        return n;
+    }
+
+    uint64_t rx_packets() const { return rx_packets_.load(std::memory_order_relaxed); }
+    uint64_t tx_packets() const { return tx_packets_.load(std::memory_order_relaxed); }
+    uint64_t rx_invalid() const { return rx_invalid_.load(std::memory_order_relaxed); }
+    uint64_t tx_dropped() const { return tx_dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Ring {
+        uint32_t *producer = nullptr;
+        uint32_t *consumer = nullptr;
+        uint32_t *flags = nullptr;
+        void *desc = nullptr;
+        uint32_t mask = 0;
+        void *map = nullptr;
+        size_t map_len = 0;
+    };
+
+    bool setup();
+    void close_all();
+    bool map_ring(Ring &ring, uint32_t entries, uint64_t pgoff, const void *offsets, size_t desc_size);
+    bool load_program();
+    // next valid datagram from the RX ring, invalid frames are recycled
+    bool next(Packet &p);
+    bool reply(Packet &p, const void *data, size_t n);
+    void recycle(uint64_t addr);
+    // releases consumed RX entries, kicks TX, returns completed frames to the fill ring
+    void flush();
+
+    Options opts_;
+    std::string error_;
+    int fd_ = -1;
+    int ifindex_ = 0;
+    int map_fd_ = -1;
+    int prog_fd_ = -1;
+    int link_fd_ = -1;
+    uint8_t *umem_ = nullptr;
+    size_t umem_len_ = 0;
+    Ring fill_, comp_, rx_, tx_;
+    uint32_t rx_cons_ = 0;    // local copies of our ends of the rings, published by flush()
+    uint32_t fill_prod_ = 0;
+    uint32_t tx_pending_ = 0; // TX descriptors queued since the last kick
+
+    std::atomic<uint64_t> rx_packets_{0};
+    std::atomic<uint64_t> tx_packets_{0};
+    std::atomic<uint64_t> rx_invalid_{0};
+    std::atomic<uint64_t> tx_dropped_{0};
+};
@@ -0,0 +1,565 @@
+#include "async_client.h"
+#include "latency_histogram.h"
+#include "protocol.h"
+
+#include <httplib.h>
+#include <nlohmann/json.hpp>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// End-to-end load driver: starts pgw_server as a child process, runs the
+// load phases of a scenario against it and writes a JSON report with
+// per-phase throughput and latency and periodic samples of the server's RSS,
+// CPU, session count and CDR lag.
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+namespace fs = std::filesystem;
+
+static void usage() {
+    std::cerr << "Usage: pgw_bench <pgw_server binary> [scenario.json] [--report out.json]\n";
+}
+
+static double seconds_since(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+static json summary(const LatencyHistogram &h) {
+    json j = {{"count", h.count()}, {"max", h.max()}};
+    for (auto q : {std::make_pair("p50", 0.5), std::make_pair("p90", 0.9),
+                   std::make_pair("p99", 0.99), std::make_pair("p999", 0.999)}) {
+        j[q.first] = h.percentile(q.second);
+    }
+    return j;
+}
+
+struct PhaseStats {
+    std::atomic<uint64_t> sent{0};
+    std::atomic<uint64_t> ok{0};
+    std::atomic<uint64_t> errors{0};
+    std::atomic<uint64_t> timeouts{0};
+    std::array<std::atomic<uint64_t>, 8> results{}; // by ResultCode
+    LatencyHistogram latency;
+};
+
+// the server under test
+class ServerProcess {
+public:
+    bool start(const std::string &binary, const std::string &config_path, int http_port) {
+        pid_ = fork();
+        if (pid_ < 0) return false;
+        if (pid_ == 0) {
+            execl(binary.c_str(), binary.c_str(), config_path.c_str(), static_cast<char*>(nullptr));
+            std::cerr << "exec " << binary << " failed: " << strerror(errno) << "\n";
+            _exit(127);
+        }
+        httplib::Client http("127.0.0.1", http_port);
+        http.set_connection_timeout(0, 200000);
+        for (int i = 0; i < 100; ++i) {
+            if (!alive()) return false;
+            auto res = http.Get("/health");
+            if (res && res->status == 200) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return false;
+    }
+
+    pid_t pid() const { return pid_; }
+
+    bool alive() {
+        if (pid_ <= 0) return false;
+        int status;
+        if (waitpid(pid_, &status, WNOHANG) == pid_) {
+            pid_ = -1;
+            return false;
+        }
+        return true;
+    }
+
+    bool wait_exit(std::chrono::seconds limit) {
+        auto deadline = Clock::now() + limit;
+        while (Clock::now() < deadline) {
+            if (!alive()) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+
+    void stop() {
+        if (!alive()) return;
+        kill(pid_, SIGINT);
+        if (!wait_exit(std::chrono::seconds(30))) {
+            kill(pid_, SIGKILL);
+            wait_exit(std::chrono::seconds(5));
+        }
+    }
+
+private:
+    pid_t pid_ = -1;
+};
+
+// RSS and CPU of a process from /proc
+class ProcSampler {
+public:
+    explicit ProcSampler(pid_t pid) : pid_(pid), last_(Clock::now()), last_ticks_(cpu_ticks()) {}
+
+    uint64_t rss_kb() const {
+        std::ifstream f("/proc/" + std::to_string(pid_) + "/status");
+        std::string line;
+        while (std::getline(f, line)) {
+            if (line.rfind("VmRSS:", 0) == 0) return std::stoull(line.substr(6));
+        }
+        return 0;
+    }
+
+    // percent of one core since the previous call
+    double cpu_pct() {
+        auto now = Clock::now();
+        uint64_t ticks = cpu_ticks();
+        double wall = std::chrono::duration<double>(now - last_).count();
+        double cpu = static_cast<double>(ticks - last_ticks_) / static_cast<double>(sysconf(_SC_CLK_TCK));
+        last_ = now;
+        last_ticks_ = ticks;
+        return wall > 0 ? 100.0 * cpu / wall : 0.0;
+    }
+
+private:
+    uint64_t cpu_ticks() const {
+        std::ifstream f("/proc/" + std::to_string(pid_) + "/stat");
+        std::string stat;
+        std::getline(f, stat);
+        // fields after the parenthesised command name; utime and stime are 14 and 15
+        auto close = stat.rfind(')');
+        if (close == std::string::npos) return last_ticks_;
+        std::istringstream in(stat.substr(close + 2));
+        std::string field;
+        uint64_t utime = 0, stime = 0;
+        for (int i = 3; i <= 15 && in >> field; ++i) {
+            if (i == 14) utime = std::stoull(field);
+            if (i == 15) stime = std::stoull(field);
+        }
+        return utime + stime;
+    }
+
+    pid_t pid_;
+    Clock::time_point last_;
+    uint64_t last_ticks_ = 0;
+};
+
+// follows the CDR file and counts "created" records, to compare with the
+// "created" replies the client has seen
+class CdrTail {
+public:
+    explicit CdrTail(std::string path) : path_(std::move(path)) {}
+
+    uint64_t created() {
+        std::ifstream f(path_, std::ios::binary);
+        if (!f) return created_;
+        f.seekg(static_cast<std::streamoff>(offset_));
+        std::string line;
+        while (std::getline(f, line)) {
+            if (f.eof()) break; // partial last line, re-read next time
+            offset_ += line.size() + 1;
+            if (line.size() > 9 && line.compare(line.size() - 9, 9, ", created") == 0) ++created_;
+        }
+        return created_;
+    }
+
+private:
+    std::string path_;
+    uint64_t offset_ = 0;
+    uint64_t created_ = 0;
+};
+
+class Bench {
+public:
+    Bench(json scenario, std::string binary) : sc_(std::move(scenario)), binary_(std::move(binary)) {
+        udp_port_ = sc_.value("udp_port", 19000);
+        http_port_ = sc_.value("http_port", 18080);
+        work_dir_ = sc_.value("work_dir", std::string("pgw_bench_run"));
+        subscribers_ = sc_.value("subscribers", 100000ull);
+        sample_ms_ = sc_.value("sample_ms", 1000);
+    }
+
+    int run(json &report) {
+        fs::create_directories(work_dir_);
+        json cfg = sc_.value("server_config", json::object());
+        cfg["udp_ip"] = "127.0.0.1";
+        cfg["udp_port"] = udp_port_;
+        cfg["http_port"] = http_port_;
+        cfg["cdr_file"] = cdr_path();
+        cfg["log_file"] = (fs::path(work_dir_) / "server.log").string();
+        if (!cfg.contains("log_level")) cfg["log_level"] = "warn";
+        session_timeout_sec_ = cfg.value("session_timeout_sec", 30);
+        fs::remove(cdr_path());
+        std::string cfg_path = (fs::path(work_dir_) / "server.json").string();
+        std::ofstream(cfg_path) << cfg.dump(2);
+
+        if (!server_.start(binary_, cfg_path, http_port_)) {
+            std::cerr << "pgw_server did not come up\n";
+            return 1;
+        }
+
+        AsyncClientOptions opts;
+        opts.server_port = udp_port_;
+        opts.timeout_ms = sc_.value("timeout_ms", 2000);
+        opts.retries = sc_.value("retries", 0);
+        opts.max_in_flight = sc_.value("max_in_flight", 1024ull);
+        client_ = std::make_unique<AsyncClient>(opts);
+        max_in_flight_ = opts.max_in_flight;
+        drain_limit_ = std::chrono::milliseconds(static_cast<int64_t>(opts.timeout_ms) * (opts.retries + 1) + 1000);
+
+        report = {
+            {"server", binary_},
+            {"started", wall_time()},
+            {"server_config", cfg},
+            {"phases", json::array()},
+            {"samples", json::array()}
+        };
+
+        t0_ = Clock::now();
+        ProcSampler proc(server_.pid());
+        std::thread sampler([&]() { sample_loop(proc, report["samples"]); });
+
+        int rc = 0;
+        for (const auto &phase : sc_.value("phases", json::array())) {
+            if (!server_.alive()) {
+                std::cerr << "pgw_server exited unexpectedly\n";
+                rc = 1;
+                break;
+            }
+            json out = run_phase(phase);
+            std::cerr << out.dump() << "\n";
+            std::lock_guard<std::mutex> lk(report_m_);
+            report["phases"].push_back(std::move(out));
+        }
+
+        stop_sampler_ = true;
+        sampler.join();
+        client_.reset();
+        server_.stop();
+
+        uint64_t peak = 0;
+        for (const auto &s : report["samples"]) peak = std::max(peak, s["rss_kb"].get<uint64_t>());
+        report["peak_rss_kb"] = peak;
+        report["duration_sec"] = seconds_since(t0_);
+        return rc;
+    }
+
+private:
+    static std::string wall_time() {
+        std::time_t now = std::time(nullptr);
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+        return buf;
+    }
+
+    std::string cdr_path() const {
+        return (fs::path(work_dir_) / "cdr.log").string();
+    }
+
+    json server_stats() {
+        httplib::Client http("127.0.0.1", http_port_);
+        http.set_read_timeout(2, 0);
+        auto res = http.Get("/stats");
+        if (!res || res->status != 200) return json();
+        try {
+            return json::parse(res->body);
+        } catch (...) {
+            return json();
+        }
+    }
+
+    bool subscriber_active(const std::string &imsi) {
+        httplib::Client http("127.0.0.1", http_port_);
+        http.set_read_timeout(2, 0);
+        auto res = http.Get(("/check_subscriber?imsi=" + imsi).c_str());
+        return !res || res->body == "active";
+    }
+
+    size_t active_sessions() {
+        json st = server_stats();
+        return st.is_null() ? SIZE_MAX : st["sessions"]["active"].get<size_t>();
+    }
+
+    void sample_loop(ProcSampler &proc, json &samples) {
+        CdrTail cdr(cdr_path());
+        uint64_t last_replies = 0;
+        auto last = Clock::now();
+        while (!stop_sampler_) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(sample_ms_));
+            if (!server_.alive()) continue;
+            json st = server_stats();
+            auto now = Clock::now();
+            uint64_t replies = client_ ? client_->stats().replies : last_replies;
+            double dt = std::chrono::duration<double>(now - last).count();
+            uint64_t created_cdrs = cdr.created();
+            json s = {
+                {"t", seconds_since(t0_)},
+                {"phase", current_phase()},
+                {"rss_kb", proc.rss_kb()},
+                {"cpu_pct", proc.cpu_pct()},
+                {"reply_rate", dt > 0 ? static_cast<double>(replies - last_replies) / dt : 0.0},
+                {"cdr_lag", static_cast<int64_t>(created_replies_.load()) - static_cast<int64_t>(created_cdrs)}
+            };
+            if (!st.is_null()) {
+                s["active_sessions"] = st["sessions"]["active"];
+                s["cdr_records"] = st["cdr"]["records"];
+            }
+            last_replies = replies;
+            last = now;
+            std::lock_guard<std::mutex> lk(report_m_);
+            samples.push_back(std::move(s));
+        }
+    }
+
+    std::string current_phase() {
+        std::lock_guard<std::mutex> lk(phase_m_);
+        return phase_;
+    }
+
+    // track_created remembers the newest IMSI the server reported as created
+    void send_one(PhaseStats &st, const std::string &imsi, bool track_created = false) {
+        while (outstanding_.load() >= max_in_flight_) std::this_thread::sleep_for(std::chrono::microseconds(100));
+        outstanding_++;
+        st.sent++;
+        auto start = Clock::now();
+        client_->attach({imsi}, [this, &st, start, imsi, track_created](const AttachResult &r) {
+            if (r.ok) {
+                st.ok++;
+                st.latency.record(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count()));
+                for (ResultCode rc : r.results) {
+                    st.results[static_cast<size_t>(rc) & 7]++;
+                    if (rc != ResultCode::created) continue;
+                    created_replies_++;
+                    if (track_created) {
+                        std::lock_guard<std::mutex> lk(created_m_);
+                        if (imsi > last_created_) last_created_ = imsi;
+                        last_created_at_ = Clock::now();
+                    }
+                }
+            } else if (r.error == "timeout") {
+                st.timeouts++;
+            } else {
+                st.errors++;
+            }
+            outstanding_--;
+        });
+    }
+
+    void drain() {
+        auto deadline = Clock::now() + drain_limit_;
+        while (outstanding_.load() > 0 && Clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // sends until `due(t)` requests have gone out at time t, for `duration` seconds
+    void paced(PhaseStats &st, double duration, const std::function<double(double)> &due,
+               const std::function<std::string()> &next_imsi) {
+        auto start = Clock::now();
+        uint64_t sent = 0;
+        for (double t = 0; t < duration; t = seconds_since(start)) {
+            uint64_t target = static_cast<uint64_t>(due(t));
+            while (sent < target) {
+                send_one(st, next_imsi());
+                ++sent;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        drain();
+    }
+
+    std::string pool_imsi() {
+        return imsi_for(1000000000ull + rng_() % subscribers_);
+    }
+    std::string fresh_imsi() {
+        return imsi_for(9000000000ull + fresh_++);
+    }
+    static std::string imsi_for(uint64_t n) {
+        std::string digits = std::to_string(n);
+        return "00101" + std::string(10 - std::min<size_t>(10, digits.size()), '0') + digits;
+    }
+
+    json run_phase(const json &phase) {
+        std::string type = phase.value("type", std::string());
+        {
+            std::lock_guard<std::mutex> lk(phase_m_);
+            phase_ = type;
+        }
+        PhaseStats st;
+        json extra = json::object();
+        auto start = Clock::now();
+
+        if (type == "steady") {
+            double rate = phase.value("rate", 1000.0);
+            paced(st, phase.value("duration_sec", 10.0), [rate](double t) { return rate * t; },
+                  [this]() { return pool_imsi(); });
+        } else if (type == "ramp") {
+            double from = phase.value("from", 100.0), to = phase.value("to", 10000.0);
+            double d = phase.value("duration_sec", 10.0);
+            // integral of a linear rate
+            paced(st, d, [=](double t) { return from * t + (to - from) * t * t / (2 * d); },
+                  [this]() { return pool_imsi(); });
+        } else if (type == "storm") {
+            uint64_t count = phase.value("count", 100000ull);
+            for (uint64_t i = 0; i < count; ++i) send_one(st, fresh_imsi());
+            drain();
+        } else if (type == "mass_timeout") {
+            // attach a burst of new sessions and leave them idle; the burst is
+            // gone once its newest session has expired
+            uint64_t count = phase.value("count", 100000ull);
+            size_t before = active_sessions();
+            {
+                std::lock_guard<std::mutex> lk(created_m_);
+                last_created_.clear();
+            }
+            for (uint64_t i = 0; i < count; ++i) send_one(st, fresh_imsi(), true);
+            drain();
+            size_t peak = active_sessions();
+            std::string newest;
+            Clock::time_point idle_from;
+            {
+                std::lock_guard<std::mutex> lk(created_m_);
+                newest = last_created_;
+                idle_from = last_created_at_;
+            }
+            bool expired = false;
+            auto limit = idle_from + std::chrono::seconds(session_timeout_sec_ + 60);
+            while (!newest.empty() && Clock::now() < limit) {
+                if (!subscriber_active(newest)) {
+                    expired = true;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+            double after = seconds_since(idle_from);
+            extra["sessions_before"] = before;
+            extra["sessions_peak"] = peak;
+            extra["sessions_after"] = active_sessions();
+            extra["expired"] = expired;
+            extra["expired_after_sec"] = after;
+            extra["expiry_lateness_sec"] = after - session_timeout_sec_;
+        } else if (type == "drain") {
+            // graceful shutdown through /stop, timed until the process exits
+            size_t active = active_sessions();
+            httplib::Client http("127.0.0.1", http_port_);
+            std::string path = "/stop";
+            if (phase.contains("rate")) path += "?rate=" + std::to_string(phase["rate"].get<uint64_t>());
+            auto res = http.Post(path.c_str());
+            bool exited = res && server_.wait_exit(std::chrono::seconds(phase.value("limit_sec", 600)));
+            extra["sessions"] = active;
+            extra["exited"] = exited;
+        } else {
+            extra["error"] = "unknown phase type";
+        }
+
+        double elapsed = seconds_since(start);
+        json results = json::object();
+        for (size_t i = 1; i < st.results.size(); ++i) {
+            if (uint64_t n = st.results[i].load()) results[result_code_name(static_cast<ResultCode>(i))] = n;
+        }
+        json out = {
+            {"type", type},
+            {"params", phase},
+            {"duration_sec", elapsed},
+            {"sent", st.sent.load()},
+            {"ok", st.ok.load()},
+            {"timeouts", st.timeouts.load()},
+            {"errors", st.errors.load()},
+            {"results", results},
+            {"throughput_rps", elapsed > 0 ? static_cast<double>(st.ok.load()) / elapsed : 0.0},
+            {"latency_us", summary(st.latency)}
+        };
+        out.update(extra);
+        return out;
+    }
+
+    json sc_;
+    std::string binary_;
+    int udp_port_;
+    int http_port_;
+    std::string work_dir_;
+    uint64_t subscribers_;
+    int sample_ms_;
+    int session_timeout_sec_ = 30;
+
+    ServerProcess server_;
+    std::unique_ptr<AsyncClient> client_;
+    size_t max_in_flight_ = 1024;
+    std::chrono::milliseconds drain_limit_{3000};
+    std::atomic<size_t> outstanding_{0};
+    std::atomic<uint64_t> created_replies_{0};
+    std::mutex created_m_;
+    std::string last_created_;
+    Clock::time_point last_created_at_;
+    std::mt19937_64 rng_{42};
+    uint64_t fresh_ = 0;
+
+    Clock::time_point t0_;
+    std::mutex report_m_;
+    std::mutex phase_m_;
+    std::string phase_;
+    std::atomic<bool> stop_sampler_{false};
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    std::string binary = argv[1];
+    std::string scenario_path = "configs/pgw_bench_conf.json";
+    std::string report_path;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--report" && i + 1 < argc) report_path = argv[++i];
+        else if (arg.rfind("--", 0) == 0) {
+            usage();
+            return 2;
+        } else scenario_path = arg;
+    }
+
+    json scenario;
+    try {
+        std::ifstream f(scenario_path);
+        if (!f) throw std::runtime_error("cannot open " + scenario_path);
+        f >> scenario;
+    } catch (const std::exception &e) {
+        std::cerr << "Bad scenario: " << e.what() << "\n";
+        return 2;
+    }
+
+    json report;
+    int rc = Bench(std::move(scenario), binary).run(report);
+    if (report.is_null()) return rc;
+    if (report_path.empty()) {
+        std::cout << report.dump(2) << "\n";
+    } else {
+        std::ofstream(report_path) << report.dump(2) << "\n";
+        std::cerr << "report written to " << report_path << "\n";
+    }
+    return rc;
+}
@@ -0,0 +1,73 @@
+#include "cdr_index.h"
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <ctime>
+
+static void usage() {
+    std::cerr << "Usage: pgw_cdr_query <cdr_file> <imsi> [--since SEC] [--from UNIX_TS] [--to UNIX_TS] [--limit N]\n"
+                 "       pgw_cdr_query <cdr_file> --build-index [SEGMENT_BYTES]\n";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        usage();
+        return 2;
+    }
+    std::string cdr_file = argv[1];
+
+    // offline indexing of an existing file (the server indexes as it writes)
+    if (std::string(argv[2]) == "--build-index") {
+        uint64_t segment = cdr_index_default_segment_bytes;
+        try {
+            if (argc > 3) segment = std::stoull(argv[3]);
+        } catch (...) {
+            usage();
+            return 2;
+        }
+        uint64_t end = 0;
+        std::string err;
+        size_t n = update_cdr_indexes(cdr_file, segment, 0, &end, &err);
+        if (!err.empty()) {
+            std::cerr << err << "\n";
+            return 1;
+        }
+        std::cerr << "indexed " << n << " new segment(s), " << end << " bytes covered\n";
+        return 0;
+    }
+
+    CdrQuery q;
+    q.imsi = argv[2];
+    try {
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string opt = argv[i];
+            std::string val = argv[i + 1];
+            if (opt == "--since") q.from_ts = std::time(nullptr) - std::stoll(val);
+            else if (opt == "--from") q.from_ts = std::stoll(val);
+            else if (opt == "--to") q.to_ts = std::stoll(val);
+            else if (opt == "--limit") q.limit = std::stoul(val);
+            else {
+                usage();
+                return 2;
+            }
+        }
+    } catch (...) {
+        usage();
+        return 2;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    CdrQueryResult out;
+    std::string err;
+    if (!query_cdr(cdr_file, 0, q, out, &err)) {
+        std::cerr << err << "\n";
+        return 1;
+    }
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+
+    for (const auto &r : out.records) std::cout << r << "\n";
+    std::cerr << out.records.size() << " record(s); " << out.segments_searched << " segment(s) searched, "
+              << out.segments_skipped << " skipped, " << out.tail_bytes_scanned << " tail bytes scanned in "
+              << us << " us\n";
+    return 0;
+}
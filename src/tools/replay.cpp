@@ -0,0 +1,188 @@
+#include "capture.h"
+
+#include <nlohmann/json.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Feeds a capture taken by pgw_server (capture_file) back to a server,
+// keeping the recorded inter-arrival times (scaled by --speed) or as fast as
+// the socket takes it (--max). Datagrams of one original source always leave
+// through the same local socket, so per-source behaviour (retransmit cache,
+// rate limiting by port) sees the same flows; --sockets sets how many.
+
+using json = nlohmann::json;
+
+static void usage() {
+    std::cerr << "Usage: pgw_replay <capture_file> <server_ip> <server_port> [--speed X] [--max] "
+                 "[--sockets N] [--loop N] [--wait-ms MS]\n";
+}
+
+static int64_t mono_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// sleeps for the bulk of the wait and spins the last stretch: nanosleep
+// alone oversleeps by tens of microseconds, more than typical gaps in a burst
+static void wait_until(int64_t due_ns) {
+    constexpr int64_t spin_ns = 100000;
+    int64_t now = mono_ns();
+    if (due_ns - now > spin_ns) {
+        int64_t wake = due_ns - spin_ns;
+        timespec ts{static_cast<time_t>(wake / 1000000000LL), static_cast<long>(wake % 1000000000LL)};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+    }
+    while (mono_ns() < due_ns) {}
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        usage();
+        return 2;
+    }
+    std::string path = argv[1];
+    std::string ip = argv[2];
+    int port = 0;
+    double speed = 1.0;
+    bool max_speed = false;
+    int sockets = 16;
+    int loops = 1;
+    int wait_ms = 500;
+    try {
+        port = std::stoi(argv[3]);
+        for (int i = 4; i < argc; ++i) {
+            std::string opt = argv[i];
+            if (opt == "--max") {
+                max_speed = true;
+                continue;
+            }
+            if (i + 1 >= argc) throw std::invalid_argument(opt);
+            std::string val = argv[++i];
+            if (opt == "--speed") speed = std::stod(val);
+            else if (opt == "--sockets") sockets = std::stoi(val);
+            else if (opt == "--loop") loops = std::stoi(val);
+            else if (opt == "--wait-ms") wait_ms = std::stoi(val);
+            else throw std::invalid_argument(opt);
+        }
+        if (speed <= 0 || sockets < 1 || loops < 1 || port <= 0 || port > 65535) throw std::invalid_argument("range");
+    } catch (...) {
+        usage();
+        return 2;
+    }
+
+    CaptureReader reader(path);
+    if (!reader.ok()) {
+        std::cerr << reader.error() << "\n";
+        return 1;
+    }
+
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, ip.c_str(), &server.sin_addr) != 1) {
+        std::cerr << "Invalid server IP: " << ip << "\n";
+        return 2;
+    }
+    std::vector<pollfd> fds;
+    for (int i = 0; i < sockets; ++i) {
+        int fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&server), sizeof(server)) != 0) {
+            std::cerr << "socket: " << strerror(errno) << "\n";
+            return 1;
+        }
+        fds.push_back({fd, POLLIN, 0});
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> replies{0};
+    std::thread receiver([&]() {
+        std::vector<pollfd> pfds = fds;
+        char buf[2048];
+        while (!done) {
+            if (poll(pfds.data(), pfds.size(), 50) <= 0) continue;
+            for (auto &p : pfds) {
+                if (!(p.revents & POLLIN)) continue;
+                while (recv(p.fd, buf, sizeof(buf), MSG_DONTWAIT) >= 0) replies++;
+            }
+        }
+    });
+
+    uint64_t sent = 0, bytes = 0, send_errors = 0;
+    int64_t late_max_ns = 0;
+    double late_sum_ns = 0;
+    int64_t span_ns = 0;
+    const int64_t start = mono_ns();
+    int64_t pass_start = start;
+
+    CaptureRecordHeader rec;
+    std::vector<uint8_t> payload;
+    for (int pass = 0; pass < loops; ++pass) {
+        if (pass > 0) reader.rewind();
+        int64_t first_ts = -1;
+        while (reader.next(rec, payload)) {
+            if (first_ts < 0) first_ts = rec.ts_ns;
+            int64_t offset = rec.ts_ns - first_ts;
+            span_ns = std::max(span_ns, offset);
+            if (!max_speed) {
+                int64_t due = pass_start + static_cast<int64_t>(static_cast<double>(offset) / speed);
+                wait_until(due);
+                int64_t late = mono_ns() - due;
+                late_sum_ns += static_cast<double>(late);
+                late_max_ns = std::max(late_max_ns, late);
+            }
+            uint32_t h = rec.src_ip * 0x9e3779b1u ^ rec.src_port;
+            int fd = fds[h % fds.size()].fd;
+            if (send(fd, payload.data(), payload.size(), 0) < 0) {
+                send_errors++;
+                continue;
+            }
+            sent++;
+            bytes += payload.size();
+        }
+        if (reader.truncated()) std::cerr << "capture ends with a partial record\n";
+        pass_start = max_speed ? mono_ns() : pass_start + static_cast<int64_t>(static_cast<double>(span_ns) / speed);
+    }
+    double elapsed = static_cast<double>(mono_ns() - start) / 1e9;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(wait_ms));
+    done = true;
+    receiver.join();
+    for (auto &p : fds) ::close(p.fd);
+
+    json out = {
+        {"capture", path},
+        {"speed", max_speed ? json("max") : json(speed)},
+        {"passes", loops},
+        {"datagrams", sent},
+        {"bytes", bytes},
+        {"send_errors", send_errors},
+        {"replies", replies.load()},
+        {"capture_span_sec", static_cast<double>(span_ns) / 1e9},
+        {"duration_sec", elapsed},
+        {"rate_pps", elapsed > 0 ? static_cast<double>(sent) / elapsed : 0.0}
+    };
+    if (!max_speed) {
+        out["lateness_us"] = {
+            {"mean", sent ? late_sum_ns / static_cast<double>(sent + send_errors) / 1000.0 : 0.0},
+            {"max", late_max_ns / 1000}
+        };
+    }
+    std::cout << out.dump(2) << "\n";
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include "session_shm.h"
+#include <iostream>
+#include <string>
+
+// Checks subscribers against the session mirror of a local pgw_server
+// (session_shm_name) without going through its HTTP API.
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: pgw_shm_check <shm_name> <imsi> [<imsi>...]\n";
+        return 2;
+    }
+    SessionShmReader reader(argv[1]);
+    if (!reader.ok()) {
+        std::cerr << "cannot open session mirror " << session_shm_path(argv[1]) << "\n";
+        return 1;
+    }
+    if (!reader.fresh(std::chrono::seconds(5))) {
+        std::cerr << "warning: session mirror is stale, pgw_server may be down\n";
+    }
+
+    bool all_active = true;
+    for (int i = 2; i < argc; ++i) {
+        uint64_t idle_ms = 0;
+        if (reader.lookup(argv[i], &idle_ms)) {
+            std::cout << argv[i] << " active idle_ms=" << idle_ms << "\n";
+        } else {
+            std::cout << argv[i] << " not active\n";
+            all_active = false;
+        }
+    }
+    return all_active ? 0 : 3;
+}
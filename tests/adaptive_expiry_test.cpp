@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include "adaptive_expiry.h"
+
+using namespace std::chrono;
+
+static AdaptiveExpiry::Options options() {
+    AdaptiveExpiry::Options o;
+    o.timeout = seconds(100);
+    o.min_timeout = seconds(10);
+    o.occupancy_low = 0.5;
+    o.occupancy_high = 0.9;
+    return o;
+}
+
+TEST(AdaptiveExpiry, TimeoutSlidesBetweenWatermarks) {
+    AdaptiveExpiry a(options());
+    ASSERT_TRUE(a.enabled());
+
+    EXPECT_EQ(a.update(40, 100, 0), seconds(100));
+    EXPECT_STREQ(a.state(), "normal");
+    EXPECT_DOUBLE_EQ(a.pressure(), 0.0);
+
+    EXPECT_EQ(a.update(70, 100, 0), seconds(55));
+    EXPECT_STREQ(a.state(), "elevated");
+    EXPECT_NEAR(a.pressure(), 0.5, 1e-9);
+
+    EXPECT_EQ(a.update(95, 100, 0), seconds(10));
+    EXPECT_STREQ(a.state(), "critical");
+
+    // back to normal as the table drains
+    EXPECT_EQ(a.update(10, 100, 0), seconds(100));
+    EXPECT_STREQ(a.state(), "normal");
+    EXPECT_EQ(a.low_activity_timeout(), seconds(100));
+}
+
+TEST(AdaptiveExpiry, MemoryWatermarks) {
+    auto o = options();
+    o.memory_low_bytes = 100 << 20;
+    o.memory_high_bytes = 200 << 20;
+    AdaptiveExpiry a(o);
+
+    // unbounded table: occupancy is not a signal
+    EXPECT_EQ(a.update(1000000, 0, 50 << 20), seconds(100));
+    EXPECT_EQ(a.update(1000000, 0, 150 << 20), seconds(55));
+    // the stronger signal wins
+    EXPECT_EQ(a.update(95, 100, 150 << 20), seconds(10));
+
+    auto j = a.json();
+    EXPECT_EQ(j["state"], "critical");
+    EXPECT_EQ(j["low_activity_timeout_sec"], 10);
+    EXPECT_EQ(j["memory"]["rss_bytes"], 150u << 20);
+}
+
+TEST(AdaptiveExpiry, DisabledKeepsTheTimeout) {
+    auto o = options();
+    o.min_timeout = seconds(0);
+    AdaptiveExpiry off(o);
+    EXPECT_FALSE(off.enabled());
+    EXPECT_EQ(off.update(100, 100, 0), seconds(100));
+
+    o.min_timeout = seconds(200); // not below the timeout
+    EXPECT_FALSE(AdaptiveExpiry(o).enabled());
+
+    EXPECT_GT(AdaptiveExpiry::process_rss_bytes(), 0u);
+}
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include "async_client.h"
+#include "timer_wheel.h"
+#include "protocol.h"
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+TEST(TimerWheel, FiresInOrderAcrossRevolutions) {
+    TimerWheel<int> w(8);
+    w.schedule(1, 3);
+    w.schedule(2, 20); // more than one revolution out
+    w.schedule(3, 0);  // in the past: next tick
+    std::vector<std::pair<int, uint64_t>> fired;
+    auto rec = [&](int k, uint64_t due) { fired.push_back({k, due}); };
+
+    w.advance(3, rec);
+    ASSERT_EQ(fired.size(), 2u);
+    EXPECT_EQ(fired[0].first, 3);
+    EXPECT_EQ(fired[1].first, 1);
+    EXPECT_EQ(w.size(), 1u);
+
+    w.advance(19, rec);
+    EXPECT_EQ(fired.size(), 2u);
+    w.advance(20, rec);
+    ASSERT_EQ(fired.size(), 3u);
+    EXPECT_EQ(fired[2].first, 2);
+    EXPECT_EQ(w.size(), 0u);
+}
+
+TEST(TimerWheel, FireMayReschedule) {
+    TimerWheel<int> w(4);
+    w.schedule(7, 1);
+    int count = 0;
+    w.advance(10, [&](int k, uint64_t due) {
+        ++count;
+        if (count < 3) w.schedule(k, due + 2);
+    });
+    EXPECT_EQ(count, 3);
+    EXPECT_EQ(w.size(), 0u);
+}
+
+// minimal protocol v2 responder on 127.0.0.1
+class FakeServer {
+public:
+    // drop_first: ignore the first datagram of every txid; batch: collect that
+    // many requests and answer them in reverse order
+    FakeServer(bool drop_first, size_t batch) : drop_first_(drop_first), batch_(batch) {
+        sock_ = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in a{};
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(sock_, reinterpret_cast<sockaddr*>(&a), sizeof(a));
+        socklen_t len = sizeof(a);
+        getsockname(sock_, reinterpret_cast<sockaddr*>(&a), &len);
+        port_ = ntohs(a.sin_port);
+        timeval tv{0, 20000};
+        setsockopt(sock_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        thread_ = std::thread([this]() { run(); });
+    }
+    ~FakeServer() {
+        stop_ = true;
+        thread_.join();
+        close(sock_);
+    }
+    int port() const { return port_; }
+    size_t received() const { return received_; }
+
+private:
+    void run() {
+        std::vector<uint32_t> seen;
+        std::vector<std::pair<std::vector<uint8_t>, sockaddr_in>> queued;
+        while (!stop_) {
+            uint8_t buf[1500];
+            sockaddr_in from{};
+            socklen_t fl = sizeof(from);
+            ssize_t r = recvfrom(sock_, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &fl);
+            if (r <= 0) continue;
+            received_++;
+            ProtoHeader hdr;
+            std::vector<std::string> imsis;
+            if (!decode_v2_request(buf, static_cast<size_t>(r), hdr, imsis)) continue;
+            if (drop_first_ && std::find(seen.begin(), seen.end(), hdr.txid) == seen.end()) {
+                seen.push_back(hdr.txid);
+                continue;
+            }
+            queued.push_back({encode_v2_reply(hdr.txid, std::vector<ResultCode>(imsis.size(), ResultCode::created)), from});
+            if (queued.size() < batch_) continue;
+            for (auto it = queued.rbegin(); it != queued.rend(); ++it) {
+                sendto(sock_, it->first.data(), it->first.size(), 0,
+                       reinterpret_cast<sockaddr*>(&it->second), sizeof(it->second));
+            }
+            queued.clear();
+        }
+    }
+
+    bool drop_first_;
+    size_t batch_;
+    int sock_ = -1;
+    int port_ = 0;
+    std::atomic<bool> stop_{false};
+    std::atomic<size_t> received_{0};
+    std::thread thread_;
+};
+
+TEST(AsyncClient, PipelinedRequestsMatchedOutOfOrder) {
+    const size_t n = 64;
+    FakeServer srv(false, n);
+    AsyncClientOptions opts;
+    opts.server_port = srv.port();
+    opts.retries = 0;
+    AsyncClient client(opts);
+    ASSERT_TRUE(client.ok());
+
+    std::vector<std::future<AttachResult>> futs;
+    for (size_t i = 0; i < n; ++i) {
+        futs.push_back(client.attach({"00101000000" + std::to_string(1000 + i), "001010000009999"}));
+    }
+    for (auto &f : futs) {
+        AttachResult r = f.get();
+        EXPECT_TRUE(r.ok) << r.error;
+        ASSERT_EQ(r.results.size(), 2u);
+        EXPECT_EQ(r.results[0], ResultCode::created);
+        EXPECT_EQ(r.attempts, 1);
+    }
+    EXPECT_EQ(client.in_flight(), 0u);
+    EXPECT_EQ(client.stats().replies, n);
+    EXPECT_EQ(client.stats().sent, n);
+}
+
+TEST(AsyncClient, RetriesAfterTimeout) {
+    FakeServer srv(true, 1);
+    AsyncClientOptions opts;
+    opts.server_port = srv.port();
+    opts.timeout_ms = 100;
+    opts.retries = 2;
+    opts.retry_backoff_ms = 20;
+    AsyncClient client(opts);
+
+    AttachResult r = client.attach({"001010000000001"}).get();
+    EXPECT_TRUE(r.ok) << r.error;
+    EXPECT_EQ(r.attempts, 2);
+    EXPECT_EQ(client.stats().retries, 1u);
+}
+
+TEST(AsyncClient, FailsWithTimeoutWhenRetriesRunOut) {
+    FakeServer srv(false, 1000); // never answers
+    AsyncClientOptions opts;
+    opts.server_port = srv.port();
+    opts.timeout_ms = 30;
+    opts.retries = 1;
+    opts.retry_backoff_ms = 10;
+    AsyncClient client(opts);
+
+    auto t0 = std::chrono::steady_clock::now();
+    AttachResult r = client.attach({"001010000000001"}).get();
+    auto elapsed = std::chrono::steady_clock::now() - t0;
+    EXPECT_FALSE(r.ok);
+    EXPECT_EQ(r.error, "timeout");
+    EXPECT_EQ(r.attempts, 2);
+    EXPECT_GE(elapsed, std::chrono::milliseconds(70));
+    EXPECT_EQ(srv.received(), 2u);
+    EXPECT_EQ(client.stats().timeouts, 1u);
+}
+
+TEST(AsyncClient, ZeroBackoffStillRetries) {
+    FakeServer srv(true, 1);
+    AsyncClientOptions opts;
+    opts.server_port = srv.port();
+    opts.timeout_ms = 50;
+    opts.retries = 2;
+    opts.retry_backoff_ms = 0;
+    AsyncClient client(opts);
+
+    auto f = client.attach({"001010000000001"});
+    ASSERT_EQ(f.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    AttachResult r = f.get();
+    EXPECT_TRUE(r.ok) << r.error;
+    EXPECT_EQ(r.attempts, 2);
+
+    opts.retry_backoff_ms = -1;
+    AsyncClient negative(opts);
+    EXPECT_FALSE(negative.ok());
+}
+
+TEST(AsyncClient, RejectsBadInputAndCancelsOnDestruction) {
+    FakeServer srv(false, 1000);
+    AsyncClientOptions opts;
+    opts.server_port = srv.port();
+    opts.timeout_ms = 10000;
+    std::future<AttachResult> pending;
+    {
+        AsyncClient client(opts);
+        EXPECT_THROW(client.attach({"12ab"}), std::invalid_argument);
+        pending = client.attach({"001010000000001"});
+    }
+    AttachResult r = pending.get();
+    EXPECT_FALSE(r.ok);
+    EXPECT_EQ(r.error, "cancelled");
+
+    AsyncClientOptions bad;
+    bad.server_ip = "not-an-ip";
+    AsyncClient broken(bad);
+    EXPECT_FALSE(broken.ok());
+    EXPECT_FALSE(broken.attach({"001010000000001"}).get().ok);
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include "cdr_index.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <ctime>
+
+namespace fs = std::filesystem;
+
+class CdrIndexTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / ("pgw_cdr_index_test_" + std::to_string(std::time(nullptr)));
+        fs::create_directories(dir_);
+        path_ = (dir_ / "cdr.log").string();
+    }
+
+    void TearDown() override {
+        if (fs::exists(dir_)) {
+            fs::remove_all(dir_);
+        }
+    }
+
+    // one record per minute starting at 2025-01-01T00:00:00Z, IMSIs cycle through 10 subscribers
+    void write_records(int from, int to) {
+        std::ofstream f(path_, std::ios::app);
+        for (int i = from; i < to; ++i) {
+            std::time_t t = 1735689600 + i * 60;
+            char ts[32];
+            std::strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S+0000", std::gmtime(&t));
+            f << ts << ", 00101000000000" << (i % 10) << ", " << (i % 3 ? "active" : "created") << "\n";
+        }
+    }
+
+    fs::path dir_;
+    std::string path_;
+};
+
+TEST_F(CdrIndexTest, ParseTime) {
+    const char *ts = "2025-01-01T03:00:00+0300";
+    EXPECT_EQ(parse_cdr_time(ts, std::strlen(ts)), 1735689600);
+    EXPECT_EQ(parse_cdr_time("garbage", 7), -1);
+}
+
+TEST_F(CdrIndexTest, IndexedAndTailAgree) {
+    write_records(0, 1000);
+
+    CdrQuery q;
+    q.imsi = "001010000000003";
+    CdrQueryResult before;
+    ASSERT_TRUE(query_cdr(path_, 0, q, before));
+    EXPECT_EQ(before.records.size(), 100u);
+    EXPECT_EQ(before.segments_searched, 0u);
+
+    uint64_t end = 0;
+    EXPECT_GT(update_cdr_indexes(path_, 4096, 0, &end), 5u);
+    EXPECT_GT(end, 0u);
+    EXPECT_TRUE(fs::exists(cdr_index_path(path_, 0)));
+
+    CdrQueryResult after;
+    ASSERT_TRUE(query_cdr(path_, 0, q, after));
+    EXPECT_EQ(after.records, before.records);
+    EXPECT_GT(after.segments_searched, 5u);
+    EXPECT_LT(after.tail_bytes_scanned, 4096u + 100u);
+
+    // idempotent: sealed segments are not rebuilt
+    EXPECT_EQ(update_cdr_indexes(path_, 4096, 0, &end), 0u);
+}
+
+TEST_F(CdrIndexTest, CursorResumesWithoutRescanning) {
+    write_records(0, 1000);
+    CdrIndexCursor cursor;
+    size_t first = update_cdr_indexes(path_, 4096, fs::file_size(path_), cursor);
+    EXPECT_GT(first, 5u);
+    EXPECT_EQ(cursor.segment, first);
+
+    // nothing new to seal: the CDR file is not even opened
+    uint64_t size = fs::file_size(path_);
+    fs::rename(path_, path_ + ".moved");
+    std::string err;
+    EXPECT_EQ(update_cdr_indexes(path_, 4096, size, cursor, &err), 0u);
+    EXPECT_TRUE(err.empty()) << err;
+    fs::rename(path_ + ".moved", path_);
+
+    // growth seals only the new segments, as a fresh scan would
+    write_records(1000, 2000);
+    size_t more = update_cdr_indexes(path_, 4096, fs::file_size(path_), cursor);
+    EXPECT_GT(more, 5u);
+    uint64_t end = 0;
+    EXPECT_EQ(update_cdr_indexes(path_, 4096, 0, &end), 0u);
+    EXPECT_EQ(end, cursor.end);
+    EXPECT_EQ(cursor.segment, first + more);
+}
+
+TEST_F(CdrIndexTest, TimeRangeSkipsSegments) {
+    write_records(0, 2000);
+    update_cdr_indexes(path_, 4096, 0);
+
+    CdrQuery q;
+    q.imsi = "001010000000007";
+    q.from_ts = 1735689600 + 1900 * 60; // last 100 minutes
+    CdrQueryResult out;
+    ASSERT_TRUE(query_cdr(path_, 0, q, out));
+    EXPECT_EQ(out.records.size(), 10u);
+    EXPECT_GT(out.segments_skipped, 10u);
+    for (const auto &r : out.records) EXPECT_NE(r.find("001010000000007"), std::string::npos);
+}
+
+TEST_F(CdrIndexTest, LimitKeepsMostRecent) {
+    write_records(0, 100);
+    CdrQuery q;
+    q.imsi = "001010000000001";
+    q.limit = 2;
+    CdrQueryResult out;
+    ASSERT_TRUE(query_cdr(path_, 0, q, out));
+    ASSERT_EQ(out.records.size(), 2u);
+    EXPECT_NE(out.records.back().find("T01:31:00"), std::string::npos); // record 91
+}
+
+TEST_F(CdrIndexTest, InvalidImsi) {
+    write_records(0, 10);
+    CdrQuery q;
+    q.imsi = "abc";
+    CdrQueryResult out;
+    std::string err;
+    EXPECT_FALSE(query_cdr(path_, 0, q, out, &err));
+    EXPECT_EQ(err, "invalid imsi");
+}
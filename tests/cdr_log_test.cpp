@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include "cdr_log.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <ctime>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+namespace fs = std::filesystem;
+
+class CdrLogTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / ("pgw_cdr_log_test_" + std::to_string(std::time(nullptr)));
+        fs::create_directories(dir_);
+        path_ = (dir_ / "cdr.log").string();
+    }
+
+    void TearDown() override {
+        if (fs::exists(dir_)) {
+            fs::remove_all(dir_);
+        }
+    }
+
+    std::string read_from(const CdrLog &log, uint64_t offset) {
+        std::string out;
+        log.map_range(offset, 1 << 20, [&](const char *d, size_t n) {
+            out.append(d, n);
+            return true;
+        });
+        return out;
+    }
+
+    fs::path dir_;
+    std::string path_;
+};
+
+TEST_F(CdrLogTest, AppendAndMap) {
+    CdrLog log(path_);
+    ASSERT_TRUE(log.ok());
+    EXPECT_TRUE(log.append("a, 1, created"));
+    EXPECT_TRUE(log.append("b, 2, timeout"));
+    EXPECT_EQ(log.records(), 2u);
+    EXPECT_EQ(log.size(), 28u);
+    EXPECT_EQ(read_from(log, 0), "a, 1, created\nb, 2, timeout\n");
+    EXPECT_EQ(read_from(log, 14), "b, 2, timeout\n");
+    EXPECT_EQ(read_from(log, 28), "");
+}
+
+TEST_F(CdrLogTest, WaitersWakeWithoutTheWriterMutex) {
+    CdrLog log(path_);
+    ASSERT_TRUE(log.ok());
+    std::atomic<int> woken{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 8; ++i) {
+        readers.emplace_back([&]() {
+            if (log.wait_beyond(0, std::chrono::seconds(5))) woken++;
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_TRUE(log.append("a, 1, created"));
+    for (auto &t : readers) t.join();
+    EXPECT_EQ(woken.load(), 8);
+    // only the append itself took the writer mutex
+    EXPECT_EQ(log.lock_stats().acquisitions, 1u);
+    EXPECT_FALSE(log.wait_beyond(log.size(), std::chrono::milliseconds(1)));
+}
+
+TEST_F(CdrLogTest, SeqToOffsetAcrossCheckpoints) {
+    CdrLog log(path_);
+    const uint64_t n = CdrLog::checkpoint_every * 2 + 10;
+    for (uint64_t i = 0; i < n; ++i) log.append("rec" + std::to_string(i));
+
+    for (uint64_t seq : {uint64_t(0), uint64_t(1), CdrLog::checkpoint_every - 1, CdrLog::checkpoint_every,
+                         CdrLog::checkpoint_every * 2 + 3}) {
+        std::string tail = read_from(log, log.offset_of_seq(seq));
+        EXPECT_EQ(tail.substr(0, tail.find('\n')), "rec" + std::to_string(seq)) << seq;
+    }
+    EXPECT_EQ(log.offset_of_seq(n), log.size());
+}
+
+TEST_F(CdrLogTest, ReopenCountsExistingRecords) {
+    {
+        CdrLog log(path_);
+        for (int i = 0; i < 5000; ++i) log.append("rec" + std::to_string(i));
+    }
+    CdrLog log(path_);
+    EXPECT_EQ(log.records(), 5000u);
+    std::string tail = read_from(log, log.offset_of_seq(4100));
+    EXPECT_EQ(tail.substr(0, tail.find('\n')), "rec4100");
+}
+
+TEST_F(CdrLogTest, PartialLastRecordIsTerminated) {
+    {
+        std::ofstream f(path_);
+        f << "whole\npart";
+    }
+    CdrLog log(path_);
+    EXPECT_EQ(log.records(), 2u);
+    log.append("next");
+    EXPECT_EQ(read_from(log, 0), "whole\npart\nnext\n");
+}
@@ -0,0 +1,406 @@
+#include <gtest/gtest.h>
+#include "server.h"
+#include "cluster.h"
+#include "session_batch.h"
+#include "imsi_to_bcd.h"
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <ctime>
+#include <httplib.h>
+
+namespace fs = std::filesystem;
+
+static std::vector<ClusterMember> make_members(int n) {
+    std::vector<ClusterMember> out;
+    for (int i = 0; i < n; ++i) out.push_back({"node" + std::to_string(i), "127.0.0.1", 9000 + i, 8080 + i});
+    return out;
+}
+
+static std::string imsi_n(int i) {
+    std::string s = std::to_string(i);
+    return std::string(15 - s.size(), '0') + s;
+}
+
+// ring
+
+TEST(HashRing, EmptyRingHasNoOwner) {
+    HashRing ring({}, 16);
+    EXPECT_EQ(ring.owner("001010123456789"), nullptr);
+}
+
+TEST(HashRing, OwnerIsStable) {
+    HashRing a(make_members(3), 64);
+    HashRing b(make_members(3), 64);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(a.owner(imsi_n(i))->member.id, b.owner(imsi_n(i))->member.id);
+    }
+}
+
+TEST(HashRing, LoadIsSpread) {
+    HashRing ring(make_members(4), 128);
+    std::map<std::string, int> load;
+    for (int i = 0; i < 40000; ++i) load[ring.owner(imsi_n(i))->member.id]++;
+    ASSERT_EQ(load.size(), 4u);
+    for (const auto &kv : load) {
+        EXPECT_GT(kv.second, 6000) << kv.first;
+        EXPECT_LT(kv.second, 14000) << kv.first;
+    }
+}
+
+TEST(HashRing, JoinMovesOnlyToNewMember) {
+    HashRing before(make_members(3), 64);
+    HashRing after(make_members(4), 64);
+    int moved = 0;
+    for (int i = 0; i < 10000; ++i) {
+        auto was = before.owner(imsi_n(i))->member.id;
+        auto now = after.owner(imsi_n(i))->member.id;
+        if (was != now) {
+            EXPECT_EQ(now, "node3");
+            ++moved;
+        }
+    }
+    EXPECT_GT(moved, 1000);
+    EXPECT_LT(moved, 4000);
+}
+
+// session batch
+
+TEST(SessionBatch, RoundTrip) {
+    std::vector<SessionRecord> in = {{"001010123456789", 0}, {"12345", 4000000000u}, {"1", 17}};
+    std::vector<SessionRecord> out;
+    ASSERT_TRUE(decode_session_batch(encode_session_batch(in), out));
+    ASSERT_EQ(out.size(), in.size());
+    for (size_t i = 0; i < in.size(); ++i) {
+        EXPECT_EQ(out[i].imsi, in[i].imsi);
+        EXPECT_EQ(out[i].idle_ms, in[i].idle_ms);
+    }
+}
+
+TEST(SessionBatch, RejectsGarbage) {
+    std::vector<SessionRecord> out;
+    EXPECT_FALSE(decode_session_batch("", out));
+    EXPECT_FALSE(decode_session_batch("PGWS\x01\x00\x00\x00\x05", out));
+    auto good = encode_session_batch({{"123", 1}});
+    EXPECT_FALSE(decode_session_batch(good.substr(0, good.size() - 1), out));
+}
+
+TEST(SessionBatch, CountBoundedByBodySize) {
+    // a huge count in a tiny body is rejected before anything is reserved
+    std::vector<SessionRecord> out;
+    EXPECT_FALSE(decode_session_batch(std::string("PGWS\x01\xFF\xFF\xFF\xFF", 9), out));
+    EXPECT_EQ(out.capacity(), 0u);
+    auto good = encode_session_batch({{"123", 1}});
+    good[8] = 2;
+    EXPECT_FALSE(decode_session_batch(good, out));
+    EXPECT_EQ(out.capacity(), 0u);
+}
+
+TEST(SessionBatch, SkipsInvalidImsis) {
+    // "" and ":" are what decode_imsi_bcd makes of an empty or 0xAA datagram
+    std::vector<SessionRecord> in = {{"", 1}, {"12345", 2}, {":", 3}, {std::string(300, '1'), 4}};
+    std::vector<SessionRecord> out;
+    ASSERT_TRUE(decode_session_batch(encode_session_batch(in), out));
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].imsi, "12345");
+    EXPECT_EQ(out[0].idle_ms, 2u);
+}
+
+TEST(SessionBatch, RejectsInvalidImsiRecords) {
+    std::vector<SessionRecord> out;
+    // 0xAA decodes to ":", a nine byte BCD to 18 digits
+    auto colon = encode_session_batch({{"123", 1}});
+    colon.replace(10, 2, "\xAA");
+    colon[9] = 1;
+    EXPECT_FALSE(decode_session_batch(colon, out));
+    auto good = encode_session_batch({{"123456789012345", 1}});
+    auto longer = good;
+    longer[9] = 9;
+    longer.insert(18, 1, '\x11');
+    EXPECT_FALSE(decode_session_batch(longer, out));
+    EXPECT_TRUE(out.empty());
+}
+
+// multi-node on loopback
+
+class ClusterTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = fs::temp_directory_path() / ("pgw_cluster_test_" + std::to_string(std::time(nullptr)));
+        fs::create_directories(test_dir_);
+        for (int i = 0; i < 2; ++i) {
+            members_.push_back({"node" + std::to_string(i), "127.0.0.1", find_free_port(), find_free_port()});
+        }
+    }
+
+    void TearDown() override {
+        if (fs::exists(test_dir_)) {
+            fs::remove_all(test_dir_);
+        }
+    }
+
+    Config node_config(int i, std::vector<ClusterMember> members) {
+        Config cfg;
+        cfg.udp_ip = "127.0.0.1";
+        cfg.udp_port = members_[i].udp_port;
+        cfg.http_port = members_[i].http_port;
+        cfg.session_timeout_sec = 30;
+        cfg.cdr_file = (test_dir_ / ("cdr" + std::to_string(i) + ".log")).string();
+        cfg.log_file = (test_dir_ / "server.log").string();
+        cfg.log_level = "error";
+        cfg.cluster_node_id = members_[i].id;
+        cfg.cluster_members = std::move(members);
+        return cfg;
+    }
+
+    // first IMSI owned by the given member under the given membership
+    std::string owned_by(const std::string &id, const std::vector<ClusterMember> &members, int skip = 0) {
+        HashRing ring(members, Config{}.cluster_vnodes);
+        for (int i = 0;; ++i) {
+            if (ring.owner(imsi_n(i))->member.id == id && skip-- == 0) return imsi_n(i);
+        }
+    }
+
+    int find_free_port() {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0) return 0;
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = 0;
+
+        if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close(sock);
+            return 0;
+        }
+
+        socklen_t len = sizeof(addr);
+        getsockname(sock, reinterpret_cast<sockaddr*>(&addr), &len);
+        int port = ntohs(addr.sin_port);
+        close(sock);
+        return port;
+    }
+
+    std::string send_imsi(int port, const std::string &imsi) {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in srv{};
+        srv.sin_family = AF_INET;
+        srv.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &srv.sin_addr);
+
+        struct timeval tv{};
+        tv.tv_sec = 2;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        auto bcd = encode_imsi_bcd(imsi);
+        sendto(sock, bcd.data(), bcd.size(), 0,
+               reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+        char buf[256] = {0};
+        ssize_t r = recvfrom(sock, buf, sizeof(buf) - 1, 0, nullptr, nullptr);
+        close(sock);
+        return r > 0 ? std::string(buf, r) : std::string();
+    }
+
+    fs::path test_dir_;
+    std::vector<ClusterMember> members_;
+};
+
+TEST_F(ClusterTest, ForwardToOwner) {
+    Server a(node_config(0, members_));
+    Server b(node_config(1, members_));
+    std::thread ta([&a]() { a.start(); });
+    std::thread tb([&b]() { b.start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    std::string remote = owned_by("node1", members_);
+    std::string local = owned_by("node0", members_);
+
+    EXPECT_EQ(send_imsi(members_[0].udp_port, remote), "created");
+    EXPECT_EQ(send_imsi(members_[0].udp_port, local), "created");
+    EXPECT_EQ(send_imsi(members_[0].udp_port, remote), "active");
+
+    EXPECT_TRUE(b.is_active(remote));
+    EXPECT_FALSE(a.is_active(remote));
+    EXPECT_TRUE(a.is_active(local));
+
+    // /check_subscriber on the non-owner is answered by the owner
+    httplib::Client cli("127.0.0.1", members_[0].http_port);
+    auto res = cli.Get("/check_subscriber?imsi=" + remote);
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->body, "active");
+
+    EXPECT_EQ(a.stats()["cluster"]["relayed"].get<uint64_t>(), 2u);
+
+    a.stop();
+    b.stop();
+    ta.join();
+    tb.join();
+}
+
+TEST_F(ClusterTest, RedirectMode) {
+    Config cfg_a = node_config(0, members_);
+    cfg_a.cluster_mode = "redirect";
+    Server a(cfg_a);
+    std::thread ta([&a]() { a.start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    std::string remote = owned_by("node1", members_);
+    EXPECT_EQ(send_imsi(members_[0].udp_port, remote),
+              "redirect 127.0.0.1:" + std::to_string(members_[1].udp_port));
+    EXPECT_FALSE(a.is_active(remote));
+
+    httplib::Client cli("127.0.0.1", members_[0].http_port);
+    auto res = cli.Get("/check_subscriber?imsi=" + remote);
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->status, 307);
+
+    // a bad imsi is refused before it can be routed into a Location header
+    res = cli.Get("/check_subscriber?imsi=1%0D%0AX-Injected:%201");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->status, 400);
+    EXPECT_FALSE(res->has_header("Location"));
+
+    a.stop();
+    ta.join();
+}
+
+TEST_F(ClusterTest, AdoptRejectsInvalidImsis) {
+    Server a(node_config(0, members_));
+    std::thread ta([&a]() { a.start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // a record decoding to ":" must not reach the session table
+    auto batch = encode_session_batch({{"001010000000001", 0}, {"123", 0}});
+    size_t bad = batch.size() - 4 - 2;
+    batch[bad - 1] = 1;
+    batch.replace(bad, 2, "\xAA");
+
+    httplib::Client cli("127.0.0.1", members_[0].http_port);
+    cli.set_connection_timeout(2, 0);
+    auto res = cli.Post("/cluster/adopt", batch, "application/octet-stream");
+    EXPECT_TRUE(res);
+    if (res) {
+        EXPECT_EQ(res->status, 400);
+    }
+    EXPECT_FALSE(a.is_active(":"));
+    EXPECT_FALSE(a.is_active("001010000000001"));
+
+    a.stop();
+    ta.join();
+}
+
+TEST_F(ClusterTest, JoinRebalancesSessions) {
+    std::vector<ClusterMember> solo = {members_[0]};
+    Server a(node_config(0, solo));
+    Server b(node_config(1, members_));
+    std::thread ta([&a]() { a.start(); });
+    std::thread tb([&b]() { b.start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    std::vector<std::string> moving;
+    for (int i = 0; i < 5; ++i) {
+        moving.push_back(owned_by("node1", members_, i));
+        EXPECT_EQ(send_imsi(members_[0].udp_port, moving.back()), "created");
+    }
+    std::string staying = owned_by("node0", members_);
+    EXPECT_EQ(send_imsi(members_[0].udp_port, staying), "created");
+    EXPECT_EQ(a.session_count(), 6u);
+
+    httplib::Client cli("127.0.0.1", members_[0].http_port);
+    auto res = cli.Post("/cluster/join", cluster_member_to_json(members_[1]).dump(), "application/json");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->status, 200);
+
+    for (int i = 0; i < 50 && b.session_count() < moving.size(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(a.session_count(), 1u);
+    EXPECT_TRUE(a.is_active(staying));
+    for (const auto &imsi : moving) EXPECT_TRUE(b.is_active(imsi)) << imsi;
+
+    // refresh through the old node now lands on the new owner without a re-attach
+    EXPECT_EQ(send_imsi(members_[0].udp_port, moving[0]), "active");
+
+    a.stop();
+    b.stop();
+    ta.join();
+    tb.join();
+}
+
+// migration on graceful shutdown
+
+TEST_F(ClusterTest, MigrationOnStop) {
+    Config peer_cfg = node_config(1, {});
+    peer_cfg.cluster_node_id.clear();
+    Config cfg = node_config(0, {});
+    cfg.cluster_node_id.clear();
+    cfg.migration_peer = "127.0.0.1:" + std::to_string(peer_cfg.http_port);
+    cfg.migration_batch = 128;
+
+    Server peer(peer_cfg);
+    std::thread tp([&peer]() { peer.start(); });
+    Server node(cfg);
+    std::thread tn([&node]() { node.start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (int i = 0; i < 500; ++i) {
+        ASSERT_EQ(send_imsi(cfg.udp_port, imsi_n(i)), "created");
+    }
+
+    node.stop();
+    tn.join();
+
+    EXPECT_EQ(node.session_count(), 0u);
+    EXPECT_EQ(peer.session_count(), 500u);
+    auto st = node.stats()["migration"];
+    EXPECT_EQ(st["state"].get<std::string>(), "done");
+    EXPECT_EQ(st["migrated"].get<uint64_t>(), 500u);
+    EXPECT_EQ(st["batches"].get<uint64_t>(), 4u);
+    EXPECT_FALSE(st["time_to_empty_ms"].is_null());
+
+    // no re-attach on the peer
+    EXPECT_EQ(send_imsi(peer_cfg.udp_port, imsi_n(7)), "active");
+
+    peer.stop();
+    tp.join();
+
+    std::ifstream cdr(cfg.cdr_file);
+    std::string line;
+    int migrated = 0, offloaded = 0;
+    while (std::getline(cdr, line)) {
+        if (line.find(", migrated") != std::string::npos) migrated++;
+        if (line.find(", offloaded") != std::string::npos) offloaded++;
+    }
+    EXPECT_EQ(migrated, 500);
+    EXPECT_EQ(offloaded, 0);
+}
+
+TEST_F(ClusterTest, MigrationFallsBackToOffload) {
+    Config cfg = node_config(0, {});
+    cfg.cluster_node_id.clear();
+    cfg.migration_peer = "127.0.0.1:" + std::to_string(members_[1].http_port); // nobody listens
+    cfg.graceful_shutdown_rate = 100;
+
+    Server node(cfg);
+    std::thread tn([&node]() { node.start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(send_imsi(cfg.udp_port, imsi_n(i)), "created");
+    }
+
+    node.stop();
+    tn.join();
+
+    EXPECT_EQ(node.session_count(), 0u);
+    auto st = node.stats()["migration"];
+    EXPECT_EQ(st["state"].get<std::string>(), "failed");
+    EXPECT_EQ(st["migrated"].get<uint64_t>(), 0u);
+    EXPECT_EQ(st["failed_batches"].get<uint64_t>(), 3u);
+}
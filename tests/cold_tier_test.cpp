@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "cold_tier.h"
+#include <filesystem>
+#include <unordered_map>
+#include <random>
+#include <vector>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static std::string tier_path(const char *name) {
+    return (fs::temp_directory_path() / (std::string("pgw_cold_") + name + "_" + std::to_string(getpid()))).string();
+}
+
+TEST(ColdTier, PutTakeErase) {
+    std::string path = tier_path("basic");
+    {
+        ColdTier t(path, 16);
+        ASSERT_TRUE(t.ok());
+        EXPECT_TRUE(fs::exists(path));
+        EXPECT_TRUE(t.put(10, 100));
+        EXPECT_FALSE(t.put(10, 200));
+        EXPECT_FALSE(t.put(0, 1)); // 0 marks empty slots
+        EXPECT_TRUE(t.contains(10));
+        EXPECT_EQ(t.size(), 1u);
+
+        int64_t ts = 0;
+        EXPECT_TRUE(t.take(10, ts));
+        EXPECT_EQ(ts, 100);
+        EXPECT_FALSE(t.contains(10));
+        EXPECT_FALSE(t.erase(10));
+        EXPECT_EQ(t.size(), 0u);
+    }
+    // the file goes away with the tier
+    EXPECT_FALSE(fs::exists(path));
+}
+
+TEST(ColdTier, OldestSkipsStaleEntries) {
+    ColdTier t(tier_path("oldest"), 16);
+    t.put(1, 10);
+    t.put(2, 20);
+    t.put(3, 30);
+    t.erase(1);
+    int64_t ts;
+    t.take(2, ts);
+    t.put(2, 40); // demoted again later
+
+    uint64_t key;
+    ASSERT_TRUE(t.oldest(key, ts));
+    EXPECT_EQ(key, 3u);
+    EXPECT_EQ(ts, 30);
+
+    std::vector<uint64_t> order;
+    t.for_each([&](uint64_t k, int64_t) { order.push_back(k); return true; });
+    EXPECT_EQ(order, (std::vector<uint64_t>{3, 2}));
+}
+
+TEST(ColdTier, OlderSessionsKeepLastSeenOrder) {
+    // an adopted session can reach the tier after newer demotions
+    ColdTier t(tier_path("order"), 16);
+    t.put(1, 100);
+    t.put(2, 200);
+    t.put(3, 50);
+    t.put(4, 150);
+    t.put(5, 300);
+
+    uint64_t key;
+    int64_t ts;
+    ASSERT_TRUE(t.oldest(key, ts));
+    EXPECT_EQ(key, 3u);
+    EXPECT_EQ(ts, 50);
+
+    std::vector<uint64_t> order;
+    t.for_each([&](uint64_t k, int64_t) { order.push_back(k); return true; });
+    EXPECT_EQ(order, (std::vector<uint64_t>{3, 1, 4, 2, 5}));
+}
+
+TEST(ColdTier, StaysConsistentUnderChurn) {
+    ColdTier t(tier_path("churn"), 4096);
+    std::unordered_map<uint64_t, int64_t> model;
+    std::mt19937_64 rng(7);
+    int64_t now = 0;
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t key = 2 + rng() % 5000;
+        ++now;
+        if (rng() % 3) {
+            bool fits = t.size() < 4096 / 4 * 3;
+            bool put = t.put(key, now);
+            if (!model.count(key) && fits) {
+                EXPECT_TRUE(put);
+            }
+            if (put) model[key] = now;
+        } else {
+            int64_t ts;
+            bool took = t.take(key, ts);
+            EXPECT_EQ(took, model.count(key) == 1);
+            if (took) {
+                EXPECT_EQ(ts, model[key]);
+                model.erase(key);
+            }
+        }
+    }
+    EXPECT_EQ(t.size(), model.size());
+    for (const auto &kv : model) EXPECT_TRUE(t.contains(kv.first));
+}
+
+TEST(ColdTier, RefusesBeyondThreeQuartersLoad) {
+    ColdTier t(tier_path("full"), 1024);
+    size_t stored = 0;
+    for (uint64_t k = 2; k < 2000; ++k) stored += t.put(k, 1);
+    EXPECT_EQ(stored, 768u);
+}
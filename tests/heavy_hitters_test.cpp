@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include "heavy_hitters.h"
+#include "imsi_to_bcd.h"
+#include <map>
+#include <random>
+#include <vector>
+#include <string>
+
+using namespace std::chrono;
+
+TEST(SpaceSaving, ExactWhileKeysFit) {
+    SpaceSaving s(8);
+    for (uint64_t k = 1; k <= 5; ++k) {
+        for (uint64_t i = 0; i < k; ++i) s.add(k);
+    }
+    s.add(0); // reserved, ignored
+    auto top = s.top();
+    ASSERT_EQ(top.size(), 5u);
+    for (size_t i = 0; i < top.size(); ++i) {
+        EXPECT_EQ(top[i].key, 5 - i);
+        EXPECT_EQ(top[i].count, 5 - i);
+        EXPECT_EQ(top[i].error, 0u);
+    }
+    EXPECT_EQ(s.total(), 15u);
+    s.clear();
+    EXPECT_TRUE(s.top().empty());
+    EXPECT_EQ(s.total(), 0u);
+}
+
+TEST(SpaceSaving, FindsHeavyKeysWithinErrorBounds) {
+    // a few heavy keys hidden in a long tail of distinct ones
+    SpaceSaving s(32);
+    std::map<uint64_t, uint64_t> exact;
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 200000; ++i) {
+        uint64_t key;
+        if (i % 5 == 0) key = 1;        // 20%
+        else if (i % 10 == 1) key = 2;  // 10%
+        else if (i % 20 == 3) key = 3;  // 5%, above total / k
+        else key = 1000 + rng() % 100000;
+        s.add(key);
+        ++exact[key];
+    }
+    auto top = s.top();
+    ASSERT_EQ(top.size(), 32u);
+    EXPECT_EQ(top[0].key, 1u);
+    EXPECT_EQ(top[1].key, 2u);
+    EXPECT_EQ(top[2].key, 3u);
+    for (const auto &e : top) {
+        EXPECT_GE(e.count, exact[e.key]);
+        EXPECT_LE(e.count - e.error, exact[e.key]);
+        EXPECT_LE(e.error, s.total() / 32);
+    }
+}
+
+TEST(HeavyHitters, OffByDefault) {
+    HeavyHitters h({});
+    EXPECT_FALSE(h.enabled());
+    EXPECT_EQ(h.json(seconds(60), 10)["enabled"], false);
+}
+
+TEST(HeavyHitters, MergesSlotsOverTheWindow) {
+    HeavyHitters h({8, seconds(10), 0});
+    ASSERT_TRUE(h.enabled());
+    EXPECT_EQ(h.slot(), seconds(1));
+    auto t = steady_clock::time_point{} + hours(1);
+    uint64_t busy = pack_imsi("250990000000001");
+    uint64_t quiet = pack_imsi("250990000000002");
+
+    // three slots: the busy IMSI from 10.0.0.1 in each, the quiet one once
+    for (int slot = 0; slot < 3; ++slot) {
+        for (int i = 0; i < 10; ++i) {
+            h.add_peer(0x0100000a, t);
+            h.add_imsi(busy);
+        }
+        if (slot == 0) {
+            h.add_peer(0x0200000a, t);
+            h.add_imsi(quiet);
+        }
+        t += seconds(1);
+    }
+    // nothing is published until a slot closes
+    h.tick(t);
+
+    auto j = h.json(seconds(10), 10);
+    EXPECT_EQ(j["window_sec"], 3.0);
+    EXPECT_EQ(j["imsis"]["total"], 31);
+    ASSERT_EQ(j["imsis"]["top"].size(), 2u);
+    EXPECT_EQ(j["imsis"]["top"][0]["key"], "250990000000001");
+    EXPECT_EQ(j["imsis"]["top"][0]["count"], 30);
+    EXPECT_EQ(j["imsis"]["top"][0]["guaranteed"], 30);
+    EXPECT_EQ(j["sources"]["top"][0]["key"], "10.0.0.1");
+    EXPECT_EQ(j["sources"]["top"][1]["key"], "10.0.0.2");
+
+    // the last two seconds leave out the quiet IMSI
+    j = h.json(seconds(2), 10);
+    EXPECT_EQ(j["imsis"]["total"], 20);
+    ASSERT_EQ(j["imsis"]["top"].size(), 1u);
+    EXPECT_EQ(j["imsis"]["top"][0]["share"], 1.0);
+    EXPECT_EQ(h.json(seconds(10), 1)["imsis"]["top"].size(), 1u);
+
+    // a long quiet spell ages everything out
+    h.tick(t + seconds(30));
+    j = h.json(seconds(10), 10);
+    EXPECT_EQ(j["imsis"]["total"], 0);
+    EXPECT_TRUE(j["imsis"]["top"].empty());
+}
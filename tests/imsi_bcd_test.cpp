@@ -112,3 +112,21 @@ TEST(IMSI_BCD, ByteFormatLong) {
     EXPECT_EQ(b[0], 0x21);
     EXPECT_EQ(b[1], 0x43);
 }
+
+TEST(IMSI_BCD, PackKeepsLeadingZeros) {
+    EXPECT_NE(pack_imsi("001"), pack_imsi("01"));
+    EXPECT_EQ(unpack_imsi(pack_imsi("001010123456789")), "001010123456789");
+    EXPECT_EQ(unpack_imsi(pack_imsi("999999999999999")), "999999999999999");
+    EXPECT_EQ(pack_imsi(""), 0u);
+    EXPECT_EQ(pack_imsi("12a"), 0u);
+    EXPECT_EQ(pack_imsi("1234567890123456"), 0u);
+}
+
+TEST(IMSI_BCD, ValidImsi) {
+    EXPECT_TRUE(valid_imsi("1"));
+    EXPECT_TRUE(valid_imsi("001010123456789"));
+    EXPECT_FALSE(valid_imsi(""));
+    EXPECT_FALSE(valid_imsi(":"));
+    EXPECT_FALSE(valid_imsi("1234567890123456"));
+    EXPECT_FALSE(valid_imsi(decode_imsi_bcd({0xAA})));
+}
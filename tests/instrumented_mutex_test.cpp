@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "instrumented_mutex.h"
+#include "loop_monitor.h"
+#include <thread>
+#include <chrono>
+
+TEST(InstrumentedMutex, CountsUncontendedAcquisitions) {
+    InstrumentedMutex m;
+    for (int i = 0; i < 10; ++i) {
+        std::lock_guard<InstrumentedMutex> lk(m);
+    }
+    ASSERT_TRUE(m.try_lock());
+    m.unlock();
+
+    auto s = m.stats();
+    EXPECT_EQ(s.acquisitions, 11u);
+    EXPECT_EQ(s.contended, 0u);
+    EXPECT_EQ(s.wait_ns, 0u);
+}
+
+TEST(InstrumentedMutex, RecordsWaitAndHoldUnderContention) {
+    InstrumentedMutex m;
+    m.lock();
+    std::thread waiter([&m]() {
+        std::lock_guard<InstrumentedMutex> lk(m);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    m.unlock();
+    waiter.join();
+
+    auto s = m.stats();
+    EXPECT_EQ(s.acquisitions, 2u);
+    EXPECT_EQ(s.contended, 1u);
+    EXPECT_GE(s.max_wait_ns, 10000000u);
+    EXPECT_GE(s.max_hold_ns, 10000000u);
+    // 10 ms and more lands in the last bucket
+    EXPECT_EQ(s.wait_histogram[InstrumentedMutex::buckets - 1], 1u);
+}
+
+TEST(InstrumentedMutex, WorksWithConditionVariableAny) {
+    InstrumentedMutex m;
+    std::condition_variable_any cv;
+    bool ready = false;
+    std::thread t([&]() {
+        std::lock_guard<InstrumentedMutex> lk(m);
+        ready = true;
+        cv.notify_all();
+    });
+    {
+        std::unique_lock<InstrumentedMutex> lk(m);
+        EXPECT_TRUE(cv.wait_for(lk, std::chrono::seconds(5), [&]() { return ready; }));
+    }
+    t.join();
+    EXPECT_GE(m.stats().acquisitions, 2u);
+}
+
+TEST(LoopMonitor, SplitsBusyAndIdleTime) {
+    LoopMonitor mon("test");
+    mon.busy();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_NE(mon.snapshot().busy_since_ns, 0);
+    mon.idle();
+    mon.idle(); // repeated calls do not count
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    mon.busy();
+    mon.idle();
+
+    auto s = mon.snapshot();
+    EXPECT_EQ(s.iterations, 2u);
+    EXPECT_EQ(s.busy_since_ns, 0);
+    EXPECT_GE(s.max_busy_ns, 20000000u);
+    EXPECT_GE(s.idle_ns, 5000000u);
+}
+
+TEST(Watchdog, ReportsStallOncePerPhase) {
+    LoopMonitor mon("stuck");
+    Watchdog wd(std::chrono::milliseconds(50));
+    wd.watch(&mon);
+    wd.start();
+
+    mon.busy();
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    EXPECT_EQ(wd.stalls(), 1u);
+    mon.idle();
+
+    mon.busy();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    mon.idle();
+    wd.stop();
+
+    EXPECT_EQ(wd.stalls(), 2u);
+    auto j = wd.json();
+    EXPECT_EQ(j["stuck"]["stalls"], 2);
+    EXPECT_EQ(j["stuck"]["iterations"], 2);
+}
+
+TEST(Watchdog, DisabledThresholdNeverStalls) {
+    LoopMonitor mon("busy");
+    Watchdog wd(std::chrono::milliseconds(0));
+    wd.watch(&mon);
+    wd.start();
+    mon.busy();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    wd.stop();
+    EXPECT_EQ(wd.stalls(), 0u);
+    // a loop that never waited is fully utilised
+    EXPECT_GT(wd.json()["busy"]["utilisation"].get<double>(), 0.9);
+}
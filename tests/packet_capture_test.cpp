@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include "packet_capture.h"
+#include "capture.h"
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static std::string capture_path(const char *name) {
+    return (fs::temp_directory_path() / (std::string("pgw_capture_") + name + "_" + std::to_string(getpid()))).string();
+}
+
+static std::vector<uint8_t> datagram(size_t len, uint8_t seed) {
+    std::vector<uint8_t> d(len);
+    for (size_t i = 0; i < len; ++i) d[i] = static_cast<uint8_t>(seed + i);
+    return d;
+}
+
+TEST(PacketCapture, RoundTrip) {
+    std::string path = capture_path("roundtrip");
+    {
+        PacketCapture cap(path, 0, 0);
+        ASSERT_TRUE(cap.ok());
+        cap.append(1000, 0x0100007f, 0x3930, datagram(8, 1).data(), 8);
+        cap.append(2500, 0x0200007f, 0x3931, datagram(0, 0).data(), 0);
+        cap.append(4000, 0x0100007f, 0x3930, datagram(300, 7).data(), 300);
+        cap.close();
+        EXPECT_EQ(cap.records(), 3u);
+        EXPECT_EQ(cap.dropped(), 0u);
+        EXPECT_EQ(cap.bytes(), fs::file_size(path));
+        cap.append(5000, 0, 0, datagram(8, 1).data(), 8); // ignored once closed
+    }
+
+    CaptureReader r(path);
+    ASSERT_TRUE(r.ok()) << r.error();
+    EXPECT_GT(r.start_ns(), 0);
+    CaptureRecordHeader rec;
+    std::vector<uint8_t> payload;
+    ASSERT_TRUE(r.next(rec, payload));
+    EXPECT_EQ(rec.ts_ns, 1000);
+    EXPECT_EQ(rec.src_ip, 0x0100007fu);
+    EXPECT_EQ(rec.src_port, 0x3930);
+    EXPECT_EQ(payload, datagram(8, 1));
+    ASSERT_TRUE(r.next(rec, payload));
+    EXPECT_EQ(rec.ts_ns, 2500);
+    EXPECT_TRUE(payload.empty());
+    ASSERT_TRUE(r.next(rec, payload));
+    EXPECT_EQ(payload, datagram(300, 7));
+    EXPECT_FALSE(r.next(rec, payload));
+    EXPECT_FALSE(r.truncated());
+
+    r.rewind();
+    ASSERT_TRUE(r.next(rec, payload));
+    EXPECT_EQ(rec.ts_ns, 1000);
+    fs::remove(path);
+}
+
+TEST(PacketCapture, RingWrapsAroundWhileDraining) {
+    std::string path = capture_path("wrap");
+    const int n = 20000; // many times the 64 KiB minimum ring
+    {
+        PacketCapture cap(path, 0, 0);
+        ASSERT_TRUE(cap.ok());
+        for (int i = 0; i < n; ++i) {
+            auto d = datagram(static_cast<size_t>(i % 97 + 1), static_cast<uint8_t>(i));
+            cap.append(i, 0, 0, d.data(), d.size());
+            if (i % 1000 == 999) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        cap.close();
+        EXPECT_EQ(cap.records() + cap.dropped(), static_cast<uint64_t>(n));
+    }
+
+    // whatever was kept is intact and in order
+    CaptureReader r(path);
+    ASSERT_TRUE(r.ok());
+    CaptureRecordHeader rec;
+    std::vector<uint8_t> payload;
+    int64_t last = -1;
+    size_t count = 0;
+    while (r.next(rec, payload)) {
+        EXPECT_GT(rec.ts_ns, last);
+        last = rec.ts_ns;
+        int i = static_cast<int>(rec.ts_ns);
+        ASSERT_EQ(payload, datagram(static_cast<size_t>(i % 97 + 1), static_cast<uint8_t>(i)));
+        ++count;
+    }
+    EXPECT_FALSE(r.truncated());
+    EXPECT_GT(count, static_cast<size_t>(n / 2));
+    fs::remove(path);
+}
+
+TEST(PacketCapture, StopsAtMaxBytes) {
+    std::string path = capture_path("limit");
+    {
+        PacketCapture cap(path, 0, 16 + 10 * 24);
+        ASSERT_TRUE(cap.ok());
+        auto d = datagram(8, 0);
+        for (int i = 0; i < 50; ++i) cap.append(i, 0, 0, d.data(), d.size());
+        cap.close();
+        EXPECT_EQ(cap.records(), 10u);
+        EXPECT_TRUE(cap.limit_reached());
+    }
+    EXPECT_EQ(fs::file_size(path), 16u + 10 * 24);
+    fs::remove(path);
+}
+
+TEST(PacketCapture, ReaderRejectsOtherFilesAndTruncatedRecords) {
+    std::string path = capture_path("bad");
+    std::ofstream(path) << "2025-11-08T15:36:42+0300, 1021021021, created\n";
+    CaptureReader bad(path);
+    EXPECT_FALSE(bad.ok());
+    EXPECT_FALSE(bad.error().empty());
+
+    {
+        PacketCapture cap(path, 0, 0);
+        auto d = datagram(40, 3);
+        cap.append(1, 0, 0, d.data(), d.size());
+        cap.append(2, 0, 0, d.data(), d.size());
+    }
+    fs::resize_file(path, fs::file_size(path) - 10);
+    CaptureReader r(path);
+    ASSERT_TRUE(r.ok());
+    CaptureRecordHeader rec;
+    std::vector<uint8_t> payload;
+    EXPECT_TRUE(r.next(rec, payload));
+    EXPECT_FALSE(r.next(rec, payload));
+    EXPECT_TRUE(r.truncated());
+    fs::remove(path);
+}
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include "protocol.h"
+#include "imsi_to_bcd.h"
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+TEST(ProtocolV2, RequestRoundTrip) {
+    std::vector<std::string> imsis = {"001010123456789", "123", "9"};
+    auto data = encode_v2_request(0xDEADBEEF, imsis);
+    EXPECT_TRUE(is_proto_v2(data.data(), data.size()));
+
+    ProtoHeader hdr;
+    std::vector<std::string> out;
+    ASSERT_TRUE(decode_v2_request(data.data(), data.size(), hdr, out));
+    EXPECT_EQ(hdr.txid, 0xDEADBEEFu);
+    EXPECT_EQ(hdr.count, 3u);
+    EXPECT_EQ(out, imsis);
+}
+
+TEST(ProtocolV2, ReplyRoundTrip) {
+    std::vector<ResultCode> codes = {ResultCode::created, ResultCode::active, ResultCode::not_owner};
+    auto data = encode_v2_reply(7, codes);
+    EXPECT_EQ(data.size(), proto_v2_header_size + 3);
+
+    ProtoHeader hdr;
+    std::vector<ResultCode> out;
+    ASSERT_TRUE(decode_v2_reply(data.data(), data.size(), hdr, out));
+    EXPECT_EQ(hdr.txid, 7u);
+    EXPECT_EQ(out, codes);
+
+    // a reply is not a request
+    std::vector<std::string> imsis;
+    EXPECT_FALSE(decode_v2_request(data.data(), data.size(), hdr, imsis));
+}
+
+TEST(ProtocolV2, StatusQueryAndBitmapReply) {
+    std::vector<std::string> imsis(10, "001010000000001");
+    auto q = encode_status_query(9, imsis);
+    ProtoHeader hdr;
+    std::vector<std::string> out;
+    ASSERT_TRUE(decode_status_query(q.data(), q.size(), hdr, out));
+    EXPECT_EQ(out, imsis);
+    // a status query is not an attach request
+    EXPECT_FALSE(decode_v2_request(q.data(), q.size(), hdr, out));
+
+    std::vector<bool> active = {true, false, false, true, false, false, false, false, true, true};
+    auto r = encode_status_reply(9, active);
+    EXPECT_EQ(r.size(), proto_v2_header_size + 2);
+    EXPECT_EQ(r[proto_v2_header_size], 0x09);
+    EXPECT_EQ(r[proto_v2_header_size + 1], 0x03);
+
+    std::vector<bool> back;
+    ASSERT_TRUE(decode_status_reply(r.data(), r.size(), hdr, back));
+    EXPECT_EQ(hdr.txid, 9u);
+    EXPECT_EQ(back, active);
+    EXPECT_FALSE(decode_status_reply(r.data(), r.size() - 1, hdr, back));
+}
+
+TEST(ProtocolV2, LegacyDatagramIsNotV2) {
+    for (const char *imsi : {"001010123456789", "9", "99999999999999"}) {
+        auto bcd = encode_imsi_bcd(imsi);
+        EXPECT_FALSE(is_proto_v2(bcd.data(), bcd.size())) << imsi;
+    }
+}
+
+TEST(ProtocolV2, TruncatedRequestRejected) {
+    auto data = encode_v2_request(1, {"001010123456789", "001010123456780"});
+    ProtoHeader hdr;
+    std::vector<std::string> out;
+    for (size_t len = 0; len < data.size(); ++len) {
+        EXPECT_FALSE(decode_v2_request(data.data(), len, hdr, out)) << len;
+    }
+}
+
+TEST(ProtocolV2, BadEntryIsMarkedNotFatal) {
+    auto data = encode_v2_request(1, {"12", "34"});
+    // corrupt the first entry's BCD byte with a non-digit nibble
+    data[proto_v2_header_size + 1] = 0x2C;
+    ProtoHeader hdr;
+    std::vector<std::string> out;
+    ASSERT_TRUE(decode_v2_request(data.data(), data.size(), hdr, out));
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_TRUE(out[0].empty());
+    EXPECT_EQ(out[1], "34");
+}
+
+TEST(ProtocolV2, SixteenDigitEntryIsMarked) {
+    auto data = encode_v2_request(1, {"123456789012345"});
+    // fill the filler nibble with a digit: 16 digits, not a valid IMSI
+    data.back() = (data.back() & 0x0F) | 0x60;
+    ProtoHeader hdr;
+    std::vector<std::string> out;
+    ASSERT_TRUE(decode_v2_request(data.data(), data.size(), hdr, out));
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_TRUE(out[0].empty());
+}
+
+TEST(ProtocolV2, EncodeLimits) {
+    EXPECT_THROW(encode_v2_request(1, {}), std::invalid_argument);
+    EXPECT_THROW(encode_v2_request(1, {"12a"}), std::invalid_argument);
+    EXPECT_THROW(encode_v2_request(1, {"1234567890123456"}), std::invalid_argument);
+    std::vector<std::string> many(proto_v2_max_imsis + 1, "1");
+    EXPECT_THROW(encode_v2_request(1, many), std::invalid_argument);
+}
+
+TEST(ProtocolV2, ResultCodeFromReply) {
+    EXPECT_EQ(result_code_from_reply("created"), ResultCode::created);
+    EXPECT_EQ(result_code_from_reply("active"), ResultCode::active);
+    EXPECT_EQ(result_code_from_reply("rejected"), ResultCode::rejected);
+    EXPECT_EQ(result_code_from_reply("no_capacity"), ResultCode::no_capacity);
+    EXPECT_STREQ(result_code_name(ResultCode::not_owner), "not_owner");
+}
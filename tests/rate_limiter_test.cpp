@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+#include "rate_limiter.h"
+
+static constexpr uint64_t ms = 1000000ull;
+
+TEST(RateLimiter, DisabledAllowsEverything) {
+    SourceRateLimiter rl(16, 0, 1);
+    EXPECT_FALSE(rl.enabled());
+    for (int i = 0; i < 1000; ++i) EXPECT_TRUE(rl.allow(1, 1));
+}
+
+TEST(RateLimiter, BurstThenRefill) {
+    SourceRateLimiter rl(16, 10, 3);
+    uint64_t t = 1000 * ms;
+    EXPECT_TRUE(rl.allow(42, t));
+    EXPECT_TRUE(rl.allow(42, t));
+    EXPECT_TRUE(rl.allow(42, t));
+    EXPECT_FALSE(rl.allow(42, t));
+
+    // 10 pps -> one token per 100 ms
+    EXPECT_FALSE(rl.allow(42, t + 50 * ms));
+    EXPECT_TRUE(rl.allow(42, t + 150 * ms));
+    EXPECT_FALSE(rl.allow(42, t + 150 * ms));
+}
+
+TEST(RateLimiter, FloodIsCappedNotBlocked) {
+    // 10 pps and a datagram every 50 us: each gap is worth half a milli-token
+    SourceRateLimiter rl(16, 10, 1);
+    uint64_t t = 1000 * ms;
+    int allowed = 0;
+    for (uint64_t i = 0; i < 200000; ++i) {
+        if (rl.allow(7, t + i * 50000)) ++allowed;
+    }
+    // 10 s of traffic: the burst token plus ~10 per second
+    EXPECT_GE(allowed, 100);
+    EXPECT_LE(allowed, 102);
+}
+
+TEST(RateLimiter, HugeRateDoesNotOverflow) {
+    SourceRateLimiter rl(16, 4000000000u, 1);
+    uint64_t t = 1000 * ms;
+    EXPECT_TRUE(rl.allow(9, t));
+    // a long idle gap hits the elapsed cap; the refill must not wrap to zero
+    EXPECT_TRUE(rl.allow(9, t + 3600000 * ms));
+    EXPECT_TRUE(rl.allow(9, t + 3600000 * ms + 1000));
+}
+
+TEST(RateLimiter, SourcesAreIndependent) {
+    SourceRateLimiter rl(16, 1, 1);
+    uint64_t t = 1000 * ms;
+    EXPECT_TRUE(rl.allow(1, t));
+    EXPECT_FALSE(rl.allow(1, t));
+    EXPECT_TRUE(rl.allow(2, t));
+    EXPECT_EQ(rl.tracked(), 2u);
+}
+
+TEST(RateLimiter, TableStaysBounded) {
+    SourceRateLimiter rl(64, 100, 5);
+    for (uint32_t a = 1; a <= 10000; ++a) rl.allow(a, a * ms);
+    EXPECT_LE(rl.tracked(), 64u);
+}
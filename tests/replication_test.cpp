@@ -0,0 +1,246 @@
+#include <gtest/gtest.h>
+#include "server.h"
+#include "replication.h"
+#include "bounded_queue.h"
+#include "imsi_to_bcd.h"
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <set>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <ctime>
+#include <httplib.h>
+
+namespace fs = std::filesystem;
+
+// queue
+
+TEST(BoundedQueue, FifoAndFull) {
+    BoundedQueue<int> q(4);
+    EXPECT_EQ(q.capacity(), 4u);
+    for (int i = 0; i < 4; ++i) EXPECT_TRUE(q.push(i));
+    EXPECT_FALSE(q.push(4));
+    int v;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(q.pop(v));
+        EXPECT_EQ(v, i);
+    }
+    EXPECT_FALSE(q.pop(v));
+}
+
+TEST(BoundedQueue, ManyProducers) {
+    BoundedQueue<int> q(1 << 16);
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 4; ++t) {
+        producers.emplace_back([&q, t]() {
+            for (int i = 0; i < 10000; ++i) q.push(t * 10000 + i);
+        });
+    }
+    for (auto &p : producers) p.join();
+    std::set<int> seen;
+    int v;
+    while (q.pop(v)) seen.insert(v);
+    EXPECT_EQ(seen.size(), 40000u);
+}
+
+// wire format
+
+TEST(ReplicationFrame, RoundTrip) {
+    ReplicationFrame f;
+    f.type = ReplicationFrame::batch;
+    f.seq = 42;
+    f.sent_us = 1234567890123ull;
+    f.upserts = {{"001010123456789", 5}, {"123", 0}};
+    f.removes = {{"999999999999999", 0}};
+
+    std::string data = encode_replication_frame(f);
+    ASSERT_GE(data.size(), replication_header_size);
+
+    ReplicationFrame g;
+    uint32_t body_len = 0;
+    ASSERT_TRUE(decode_replication_header(reinterpret_cast<const uint8_t*>(data.data()), g, body_len));
+    EXPECT_EQ(body_len, data.size() - replication_header_size);
+    ASSERT_TRUE(decode_replication_body(data.substr(replication_header_size), g));
+    EXPECT_EQ(g.seq, 42u);
+    EXPECT_EQ(g.sent_us, f.sent_us);
+    ASSERT_EQ(g.upserts.size(), 2u);
+    EXPECT_EQ(g.upserts[0].imsi, "001010123456789");
+    EXPECT_EQ(g.upserts[0].idle_ms, 5u);
+    ASSERT_EQ(g.removes.size(), 1u);
+    EXPECT_EQ(g.removes[0].imsi, "999999999999999");
+}
+
+// active -> standby on loopback
+
+class ReplicationTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = fs::temp_directory_path() / ("pgw_repl_test_" + std::to_string(std::time(nullptr)));
+        fs::create_directories(test_dir_);
+    }
+
+    void TearDown() override {
+        if (fs::exists(test_dir_)) {
+            fs::remove_all(test_dir_);
+        }
+    }
+
+    Config node_config(const std::string &name) {
+        Config cfg;
+        cfg.udp_ip = "127.0.0.1";
+        cfg.udp_port = find_free_port();
+        cfg.http_port = find_free_port();
+        cfg.session_timeout_sec = 30;
+        cfg.cdr_file = (test_dir_ / ("cdr_" + name + ".log")).string();
+        cfg.log_file = (test_dir_ / "server.log").string();
+        cfg.log_level = "error";
+        return cfg;
+    }
+
+    int find_free_port() {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock < 0) return 0;
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = 0;
+
+        if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            close(sock);
+            return 0;
+        }
+
+        socklen_t len = sizeof(addr);
+        getsockname(sock, reinterpret_cast<sockaddr*>(&addr), &len);
+        int port = ntohs(addr.sin_port);
+        close(sock);
+        return port;
+    }
+
+    std::string send_imsi(int port, const std::string &imsi) {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in srv{};
+        srv.sin_family = AF_INET;
+        srv.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &srv.sin_addr);
+
+        struct timeval tv{};
+        tv.tv_sec = 2;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        auto bcd = encode_imsi_bcd(imsi);
+        sendto(sock, bcd.data(), bcd.size(), 0,
+               reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+        char buf[256] = {0};
+        ssize_t r = recvfrom(sock, buf, sizeof(buf) - 1, 0, nullptr, nullptr);
+        close(sock);
+        return r > 0 ? std::string(buf, r) : std::string();
+    }
+
+    fs::path test_dir_;
+};
+
+TEST_F(ReplicationTest, ReceiverRejectsOversizedFrame) {
+    int port = find_free_port();
+    std::atomic<int> applied{0};
+    ReplicationReceiver rx("127.0.0.1", port, [&](const ReplicationFrame&) { applied++; }, 1000);
+    ASSERT_TRUE(rx.listening());
+    EXPECT_LT(replication_body_limit(ReplicationFrame::snapshot, 1000), 20000u);
+    EXPECT_LT(replication_body_limit(ReplicationFrame::batch, 0), 1u << 20);
+
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    ASSERT_EQ(connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)), 0);
+    struct timeval tv{};
+    tv.tv_sec = 2;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // a forged snapshot header claiming a 4 GiB body
+    std::string hdr = encode_replication_frame(ReplicationFrame{}).substr(0, replication_header_size);
+    hdr[4] = ReplicationFrame::snapshot;
+    for (int i = 21; i < 25; ++i) hdr[i] = '\xFF';
+    send(sock, hdr.data(), hdr.size(), MSG_NOSIGNAL);
+    char buf[8];
+    EXPECT_EQ(recv(sock, buf, sizeof(buf), 0), 0); // closed, no ack
+    close(sock);
+    EXPECT_EQ(rx.stats()["oversized_frames"], 1u);
+    EXPECT_EQ(applied.load(), 0);
+}
+
+TEST_F(ReplicationTest, SenderRestartsAfterException) {
+    int port = find_free_port();
+    std::atomic<int> snapshots{0};
+    ReplicationReceiver rx("127.0.0.1", port, [&](const ReplicationFrame &f) {
+        if (f.type == ReplicationFrame::snapshot) snapshots++;
+    });
+    ASSERT_TRUE(rx.listening());
+
+    std::atomic<int> calls{0};
+    ReplicationSender tx("127.0.0.1", port, 1024, 5, [&]() {
+        if (calls++ == 0) throw std::runtime_error("snapshot failed");
+        return std::vector<SessionRecord>{{"001010000000001", 0}};
+    });
+    for (int i = 0; i < 200 && snapshots.load() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(snapshots.load(), 1);
+    EXPECT_EQ(tx.stats()["restarts"], 1u);
+}
+
+TEST_F(ReplicationTest, StandbyKeepsWarmCopyAndTakesOver) {
+    Config standby_cfg = node_config("standby");
+    standby_cfg.replication_role = "standby";
+    standby_cfg.replication_port = find_free_port();
+    standby_cfg.replication_takeover_ms = 0;
+
+    Config active_cfg = node_config("active");
+    active_cfg.replication_role = "active";
+    active_cfg.replication_peer = "127.0.0.1:" + std::to_string(standby_cfg.replication_port);
+    active_cfg.replication_batch_ms = 5;
+
+    Server standby(standby_cfg);
+    std::thread ts([&standby]() { standby.start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    Server active(active_cfg);
+    std::thread ta([&active]() { active.start(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(send_imsi(active_cfg.udp_port, "1000000000000" + std::to_string(10 + i)), "created");
+    }
+    for (int i = 0; i < 100 && standby.session_count() < 20; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(standby.session_count(), 20u);
+    EXPECT_TRUE(standby.is_active("100000000000010"));
+
+    auto st = active.stats()["replication"];
+    EXPECT_TRUE(st["connected"].get<bool>());
+    EXPECT_GT(st["seq_acked"].get<uint64_t>(), 0u);
+    EXPECT_GE(st["lag_us"].get<int64_t>(), 0);
+    EXPECT_EQ(st["dropped"].get<uint64_t>(), 0u);
+
+    // the standby does not serve UDP until it takes over
+    httplib::Client cli("127.0.0.1", standby_cfg.http_port);
+    auto res = cli.Post("/takeover", "", "text/plain");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->body, "takeover_started");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // warm sessions: no re-attach
+    EXPECT_EQ(send_imsi(standby_cfg.udp_port, "100000000000010"), "active");
+    EXPECT_TRUE(standby.stats()["replication"]["taken_over"].get<bool>());
+
+    active.stop();
+    standby.stop();
+    ta.join();
+    ts.join();
+}
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "response_cache.h"
+#include "protocol.h"
+#include <string>
+#include <vector>
+
+static constexpr uint64_t ms = 1000000ull;
+
+static uint64_t legacy_key(uint32_t addr, uint16_t port, const std::string &payload) {
+    return ResponseCache::key(addr, port, reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+}
+
+TEST(ResponseCache, DisabledNeverHits) {
+    ResponseCache c(16, 0);
+    EXPECT_FALSE(c.enabled());
+    c.store(1, 1, "x", 1);
+    EXPECT_EQ(c.lookup(1, 1), nullptr);
+}
+
+TEST(ResponseCache, HitWithinWindowOnly) {
+    ResponseCache c(16, 100);
+    uint64_t k = legacy_key(1, 2, "\x21\x43");
+    c.store(k, 1000 * ms, "created", 7);
+
+    const std::string *hit = c.lookup(k, 1050 * ms);
+    ASSERT_NE(hit, nullptr);
+    EXPECT_EQ(*hit, "created");
+    EXPECT_EQ(c.lookup(k, 1101 * ms), nullptr);
+}
+
+TEST(ResponseCache, KeyDependsOnSourceAndRequest) {
+    EXPECT_NE(legacy_key(1, 2, "\x21"), legacy_key(1, 3, "\x21"));
+    EXPECT_NE(legacy_key(1, 2, "\x21"), legacy_key(4, 2, "\x21"));
+    EXPECT_NE(legacy_key(1, 2, "\x21"), legacy_key(1, 2, "\x22"));
+    EXPECT_EQ(legacy_key(1, 2, "\x21"), legacy_key(1, 2, "\x21"));
+}
+
+TEST(ResponseCache, V2KeyedByTxid) {
+    auto a = encode_v2_request(7, {"123"});
+    auto b = encode_v2_request(7, {"123", "456"});
+    auto c = encode_v2_request(8, {"123"});
+    EXPECT_EQ(ResponseCache::key(1, 2, a.data(), a.size()), ResponseCache::key(1, 2, b.data(), b.size()));
+    EXPECT_NE(ResponseCache::key(1, 2, a.data(), a.size()), ResponseCache::key(1, 2, c.data(), c.size()));
+}
+
+TEST(ResponseCache, FullWindowOverwritesOldest) {
+    ResponseCache c(8, 1000);
+    // more keys than the table holds: the cache stays bounded and the newest
+    // entries remain reachable
+    std::vector<uint64_t> keys;
+    for (int i = 0; i < 64; ++i) {
+        keys.push_back(legacy_key(1, static_cast<uint16_t>(i), "\x21"));
+        c.store(keys.back(), (1000 + i) * ms, "active", 6);
+    }
+    EXPECT_NE(c.lookup(keys.back(), 1100 * ms), nullptr);
+}
@@ -1,11 +1,15 @@
 #include <gtest/gtest.h>
 #include "server.h"
 #include "imsi_to_bcd.h"
+#include "protocol.h"
+#include "session_shm.h"
+#include "capture.h"
 #include <fstream>
 #include <thread>
 #include <chrono>
 #include <filesystem>
 #include <sstream>
+#include <set>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -388,9 +392,30 @@ TEST_F(ServerTest, HTTPCheckSubscriberMissingParam) {
 
 
 
+// simulated time: polls `pred` for up to a second of real time
+template <typename Pred>
+static bool eventually(Pred pred) {
+    for (int i = 0; i < 200; ++i) {
+        if (pred()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return pred();
+}
+
+static size_t count_cdr(const std::string &path, const std::string &action) {
+    std::ifstream f(path);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(f, line)) {
+        if (line.size() >= action.size() && line.compare(line.size() - action.size(), action.size(), action) == 0) ++n;
+    }
+    return n;
+}
+
 TEST_F(ServerTest, SessionTimeout) {
-    cfg_.session_timeout_sec = 1;
-    Server server(cfg_);
+    cfg_.session_timeout_sec = 30;
+    auto clock = std::make_shared<ManualClock>();
+    Server server(cfg_, clock);
     
     std::thread server_thread([&server]() {
         server.start();
@@ -413,13 +438,18 @@ TEST_F(ServerTest, SessionTimeout) {
     recvfrom(sock, buf, sizeof(buf), 0, nullptr, nullptr);
     close(sock);
     
+    EXPECT_TRUE(server.is_active(imsi));
+
+    // idle for 29 simulated seconds: still there
+    clock->advance(std::chrono::seconds(29));
     std::this_thread::sleep_for(std::chrono::milliseconds(50));
     EXPECT_TRUE(server.is_active(imsi));
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+    clock->advance(std::chrono::seconds(2));
     
     // Session should be expired
-    EXPECT_FALSE(server.is_active(imsi));
+    EXPECT_TRUE(eventually([&]() { return !server.is_active(imsi); }));
+    EXPECT_TRUE(eventually([&]() { return count_cdr(cfg_.cdr_file, "timeout") == 1; }));
     
     server.stop();
     if (server_thread.joinable()) {
@@ -430,7 +460,9 @@ TEST_F(ServerTest, SessionTimeout) {
 // shutdown test
 
 TEST_F(ServerTest, GracefulShutdown) {
-    Server server(cfg_);
+    cfg_.graceful_shutdown_rate = 10;
+    auto clock = std::make_shared<ManualClock>();
+    Server server(cfg_, clock);
     
     std::thread server_thread([&server]() {
         server.start();
@@ -444,8 +476,8 @@ TEST_F(ServerTest, GracefulShutdown) {
     srv.sin_port = htons(cfg_.udp_port);
     inet_pton(AF_INET, "127.0.0.1", &srv.sin_addr);
     
-    for (int i = 0; i < 3; ++i) {
-        std::string imsi = "12345678901234" + std::to_string(i);
+    for (int i = 0; i < 15; ++i) {
+        std::string imsi = "1234567890" + std::to_string(10000 + i);
         auto bcd = encode_imsi_bcd(imsi);
         sendto(sock, bcd.data(), bcd.size(), 0,
                reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
@@ -453,16 +485,940 @@ TEST_F(ServerTest, GracefulShutdown) {
         recvfrom(sock, buf, sizeof(buf), 0, nullptr, nullptr);
     }
     close(sock);
+    ASSERT_EQ(server.session_count(), 15u);
     
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // 10 sessions per simulated second; stop() itself waits two simulated seconds
+    std::thread stopper([&server]() { server.stop(); });
+    EXPECT_TRUE(eventually([&]() { return server.session_count() == 5; }));
+    clock->advance(std::chrono::seconds(1));
+    EXPECT_TRUE(eventually([&]() { return server.session_count() == 0; }));
+    clock->advance(std::chrono::seconds(1));
+    stopper.join();
     
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+    EXPECT_EQ(count_cdr(cfg_.cdr_file, "offloaded"), 15u);
+}
+
+
+// capacity
+
+static std::string send_imsi(int port, const std::string &imsi, int timeout_ms = 2000) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in srv{};
+    srv.sin_family = AF_INET;
+    srv.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &srv.sin_addr);
+
+    struct timeval tv{};
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    auto bcd = encode_imsi_bcd(imsi);
+    sendto(sock, bcd.data(), bcd.size(), 0,
+           reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+    char buf[256] = {0};
+    ssize_t r = recvfrom(sock, buf, sizeof(buf) - 1, 0, nullptr, nullptr);
+    close(sock);
+    return r > 0 ? std::string(buf, r) : std::string();
+}
+
+TEST_F(ServerTest, CapacityReject) {
+    cfg_.max_sessions = 2;
+    cfg_.capacity_policy = "reject";
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000001"), "created");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000002"), "created");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000003"), "no_capacity");
+    // existing sessions can still refresh
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000001"), "active");
+
+    EXPECT_EQ(server.session_count(), 2u);
+    EXPECT_FALSE(server.is_active("100000000000003"));
+    auto st = server.stats();
+    EXPECT_EQ(st["sessions"]["rejected_capacity"].get<uint64_t>(), 1u);
+    EXPECT_EQ(st["sessions"]["evicted"].get<uint64_t>(), 0u);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, CapacityEvictLRU) {
+    cfg_.max_sessions = 2;
+    cfg_.capacity_policy = "evict_lru";
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000001"), "created");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000002"), "created");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000001"), "active");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000003"), "created");
+
+    // ...002 was the least recently refreshed
+    EXPECT_TRUE(server.is_active("100000000000001"));
+    EXPECT_FALSE(server.is_active("100000000000002"));
+    EXPECT_TRUE(server.is_active("100000000000003"));
+    EXPECT_EQ(server.stats()["sessions"]["evicted"].get<uint64_t>(), 1u);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+
+    std::ifstream cdr(cfg_.cdr_file);
+    std::string line;
+    bool found = false;
+    while (std::getline(cdr, line)) {
+        if (line.find("100000000000002, evicted") != std::string::npos) found = true;
+    }
+    EXPECT_TRUE(found);
+}
+
+// ingress protection
+
+TEST_F(ServerTest, PerSourceRateLimit) {
+    cfg_.rate_limit_pps = 1;
+    cfg_.rate_limit_burst = 2;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000001", 300), "created");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000002", 300), "created");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000003", 300), "");
+
+    auto st = server.stats();
+    EXPECT_EQ(st["udp"]["received"].get<uint64_t>(), 3u);
+    EXPECT_EQ(st["udp"]["rate_limited"].get<uint64_t>(), 1u);
+    EXPECT_FALSE(server.is_active("100000000000003"));
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, ReceiveBufferSize) {
+    cfg_.udp_rcvbuf_bytes = 256 * 1024;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto st = server.stats();
+    EXPECT_GT(st["udp"]["rcvbuf_bytes"].get<int>(), 0);
+    EXPECT_EQ(st["udp"]["kernel_drops"].get<uint64_t>(), 0u);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, RetransmitCache) {
+    cfg_.retransmit_cache_ms = 2000;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // same source socket, same datagram: a client retry
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in srv{};
+    srv.sin_family = AF_INET;
+    srv.sin_port = htons(cfg_.udp_port);
+    inet_pton(AF_INET, "127.0.0.1", &srv.sin_addr);
+    struct timeval tv{};
+    tv.tv_sec = 2;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    auto bcd = encode_imsi_bcd("100000000000001");
+    for (int i = 0; i < 3; ++i) {
+        sendto(sock, bcd.data(), bcd.size(), 0, reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+        char buf[64] = {0};
+        ssize_t r = recvfrom(sock, buf, sizeof(buf) - 1, 0, nullptr, nullptr);
+        ASSERT_GT(r, 0);
+        EXPECT_EQ(std::string(buf, r), "created");
+    }
+    // an empty datagram is neither a hit nor a miss
+    sendto(sock, bcd.data(), 0, 0, reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+    close(sock);
+
+    // another source is a new request
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "100000000000001"), "active");
+
+    auto st = server.stats()["retransmit_cache"];
+    EXPECT_EQ(st["hits"].get<uint64_t>(), 2u);
+    EXPECT_EQ(st["misses"].get<uint64_t>(), 2u);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+
+    std::ifstream cdr(cfg_.cdr_file);
+    std::string line;
+    int created = 0;
+    while (std::getline(cdr, line)) {
+        if (line.find("100000000000001, created") != std::string::npos) created++;
+    }
+    EXPECT_EQ(created, 1);
+}
+
+// cdr streaming
+
+TEST_F(ServerTest, CdrStreamFromSeqAndLongPoll) {
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int i = 1; i <= 3; ++i) {
+        EXPECT_EQ(send_imsi(cfg_.udp_port, "30000000000000" + std::to_string(i)), "created");
+    }
+
+    httplib::Client cli("127.0.0.1", cfg_.http_port);
+    auto res = cli.Get("/cdr/stream?seq=1");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->status, 200);
+    EXPECT_EQ(res->body.find("300000000000001"), std::string::npos);
+    EXPECT_NE(res->body.find("300000000000002, created\n"), std::string::npos);
+    EXPECT_NE(res->body.find("300000000000003, created\n"), std::string::npos);
+
+    // resume from the end: long-poll returns the next record as soon as it is written
+    uint64_t end = std::stoull(res->get_header_value("X-CDR-Offset")) + res->body.size();
+    std::string polled;
+    std::thread poller([&]() {
+        httplib::Client c("127.0.0.1", cfg_.http_port);
+        c.set_read_timeout(5, 0);
+        auto r = c.Get("/cdr/stream?offset=" + std::to_string(end) + "&wait_ms=3000");
+        if (r) polled = r->body;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "300000000000004"), "created");
+    poller.join();
+    EXPECT_NE(polled.find("300000000000004, created\n"), std::string::npos);
+    EXPECT_EQ(polled.find("300000000000003"), std::string::npos);
+
+    auto bad = cli.Get("/cdr/stream?offset=99999999");
+    ASSERT_TRUE(bad);
+    EXPECT_EQ(bad->status, 416);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, CdrStreamLimitLeavesApiResponsive) {
+    cfg_.max_streams = 1;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "300000000000001"), "created");
+
+    // a following client takes the only stream slot
+    std::atomic<bool> streaming{false};
+    std::thread follower([&]() {
+        httplib::Client c("127.0.0.1", cfg_.http_port);
+        c.Get("/cdr/stream?follow=1", [&](const char *, size_t) {
+            streaming = true;
+            return true;
+        });
+    });
+    EXPECT_TRUE(eventually([&]() { return streaming.load(); }));
+
+    httplib::Client cli("127.0.0.1", cfg_.http_port);
+    cli.set_connection_timeout(2, 0);
+    auto res = cli.Get("/cdr/stream?follow=1");
+    EXPECT_TRUE(res && res->status == 503);
+    res = cli.Get("/stats");
+    EXPECT_TRUE(res && res->status == 200);
+
+    server.stop();
+    follower.join();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, CdrQueryUsesIndex) {
+    cfg_.cdr_index_segment_bytes = 256;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 1; i <= 9; ++i) {
+            send_imsi(cfg_.udp_port, "40000000000000" + std::to_string(i));
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+
+    auto st = server.stats()["cdr"];
+    EXPECT_EQ(st["records"].get<uint64_t>(), 9u);
+    EXPECT_GT(st["index_segments"].get<uint64_t>(), 0u);
+
+    httplib::Client cli("127.0.0.1", cfg_.http_port);
+    auto res = cli.Get("/cdr/query?imsi=400000000000003&since=3600");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->status, 200);
+    auto j = nlohmann::json::parse(res->body);
+    ASSERT_EQ(j["records"].size(), 1u);
+    EXPECT_NE(j["records"][0].get<std::string>().find("400000000000003, created"), std::string::npos);
+
+    auto bad = cli.Get("/cdr/query?imsi=xyz");
+    ASSERT_TRUE(bad);
+    EXPECT_EQ(bad->status, 400);
+
     server.stop();
-    
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    
     if (server_thread.joinable()) {
         server_thread.join();
     }
-    
 }
 
+TEST_F(ServerTest, SessionShmMirror) {
+    cfg_.session_shm_name = "pgw_test_shm_" + std::to_string(cfg_.udp_port);
+    cfg_.max_sessions = 16;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    send_imsi(cfg_.udp_port, "500000000000001");
+    send_imsi(cfg_.udp_port, "500000000000002");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    SessionShmReader reader(cfg_.session_shm_name);
+    ASSERT_TRUE(reader.ok());
+    EXPECT_EQ(reader.slots(), 32u);
+    EXPECT_TRUE(reader.fresh(std::chrono::seconds(2)));
+    EXPECT_EQ(reader.sessions(), 2u);
+    uint64_t idle = 0;
+    EXPECT_TRUE(reader.lookup("500000000000001", &idle));
+    EXPECT_LT(idle, 1000u);
+    EXPECT_FALSE(reader.lookup("500000000000003"));
+
+    // sessions expire (timeout 2s) and leave the mirror as well
+    std::this_thread::sleep_for(std::chrono::milliseconds(3500));
+    EXPECT_FALSE(reader.lookup("500000000000001"));
+    EXPECT_EQ(reader.sessions(), 0u);
+    EXPECT_EQ(server.stats()["shm"]["slots"].get<uint64_t>(), 32u);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, TraceEndpoint) {
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "600000000000001"), "created");
+
+    httplib::Client cli("127.0.0.1", cfg_.http_port);
+    auto res = cli.Get("/trace?last_ms=5000");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->status, 200);
+    auto events = nlohmann::json::parse(res->body)["traceEvents"];
+    std::set<std::string> names;
+    for (const auto &ev : events) names.insert(ev["name"].get<std::string>());
+    for (const char *n : {"packet_received", "packet_decoded", "session_lock", "session_decision",
+                          "cdr_append", "reply_sent"}) {
+        EXPECT_TRUE(names.count(n)) << n;
+    }
+
+    auto bad = cli.Get("/trace?last_ms=x");
+    ASSERT_TRUE(bad);
+    EXPECT_EQ(bad->status, 400);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, LockAndLoopStats) {
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "610000000000001"), "created");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "610000000000001"), "active");
+
+    auto stats = server.stats();
+    EXPECT_GE(stats["locks"]["sessions"]["acquisitions"].get<uint64_t>(), 2u);
+    EXPECT_GE(stats["locks"]["cdr"]["acquisitions"].get<uint64_t>(), 1u);
+    EXPECT_TRUE(stats["locks"]["sessions"]["wait_histogram"].contains("1us"));
+    // the reply goes out before the loop marks itself idle again
+    EXPECT_TRUE(eventually([&]() { return server.stats()["loops"]["udp"]["iterations"].get<uint64_t>() >= 2u; }));
+    EXPECT_TRUE(stats["loops"].contains("cleaner"));
+    EXPECT_EQ(stats["loops"]["stalls"], 0);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, StatusPort) {
+    cfg_.status_udp_port = find_free_port();
+    cfg_.status_threads = 2;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "620000000000001"), "created");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "620000000000003"), "created");
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in srv{};
+    srv.sin_family = AF_INET;
+    srv.sin_port = htons(cfg_.status_udp_port);
+    inet_pton(AF_INET, "127.0.0.1", &srv.sin_addr);
+    struct timeval tv{2, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    auto q = encode_status_query(77, {"620000000000001", "620000000000002", "620000000000003"});
+    sendto(sock, q.data(), q.size(), 0, reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+    uint8_t buf[256];
+    ssize_t r = recvfrom(sock, buf, sizeof(buf), 0, nullptr, nullptr);
+    ProtoHeader hdr;
+    std::vector<bool> active;
+    ASSERT_TRUE(r > 0 && decode_status_reply(buf, static_cast<size_t>(r), hdr, active));
+    EXPECT_EQ(hdr.txid, 77u);
+    EXPECT_EQ(active, (std::vector<bool>{true, false, true}));
+
+    auto bcd = encode_imsi_bcd("620000000000002");
+    sendto(sock, bcd.data(), bcd.size(), 0, reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+    r = recvfrom(sock, buf, sizeof(buf), 0, nullptr, nullptr);
+    ASSERT_EQ(r, 1);
+    EXPECT_EQ(buf[0], 0);
+    close(sock);
+
+    // queries do not create sessions
+    EXPECT_FALSE(server.is_active("620000000000002"));
+    auto st = server.stats()["status"];
+    EXPECT_EQ(st["queries"].get<uint64_t>(), 2u);
+    EXPECT_EQ(st["imsis"].get<uint64_t>(), 4u);
+    EXPECT_EQ(st["active"].get<uint64_t>(), 2u);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, ColdTierDemotesAndPromotes) {
+    cfg_.session_timeout_sec = 60;
+    cfg_.cold_tier_file = (test_dir_ / "cold.tier").string();
+    cfg_.cold_tier_idle_sec = 10;
+    auto clock = std::make_shared<ManualClock>();
+    Server server(cfg_, clock);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "630000000000001"), "created");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "630000000000002"), "created");
+
+    // every jump waits for the cleaner to be asleep, so its deadline predates the jump
+    auto cleaner_asleep = [&]() { return eventually([&]() { return clock->sleepers() > 0; }); };
+    EXPECT_TRUE(cleaner_asleep());
+    clock->advance(std::chrono::seconds(11));
+    ASSERT_TRUE(eventually([&]() { return server.stats()["sessions"]["cold"]["sessions"] == 2; }));
+    EXPECT_TRUE(server.is_active("630000000000001"));
+
+    // a refresh promotes the session back
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "630000000000001"), "active");
+    auto cold = server.stats()["sessions"]["cold"];
+    EXPECT_EQ(cold["sessions"], 1);
+    EXPECT_EQ(cold["promoted"], 1);
+
+    // expiry still reaches the cold session
+    EXPECT_TRUE(cleaner_asleep());
+    clock->advance(std::chrono::seconds(50));
+    EXPECT_TRUE(eventually([&]() { return !server.is_active("630000000000002"); }));
+    EXPECT_TRUE(server.is_active("630000000000001"));
+    EXPECT_TRUE(eventually([&]() { return count_cdr(cfg_.cdr_file, "timeout") == 1; }));
+    EXPECT_TRUE(cleaner_asleep());
+    clock->advance(std::chrono::seconds(20));
+    EXPECT_TRUE(eventually([&]() { return count_cdr(cfg_.cdr_file, "timeout") == 2; }));
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, BudgetedExpiryCarriesOverAndMeasuresLateness) {
+    cfg_.session_timeout_sec = 30;
+    cfg_.expiry_max_per_tick = 2;
+    auto clock = std::make_shared<ManualClock>();
+    Server server(cfg_, clock);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (int i = 1; i <= 5; ++i) {
+        EXPECT_EQ(send_imsi(cfg_.udp_port, "66000000000000" + std::to_string(i)), "created");
+    }
+
+    // all five are due at once; each tick takes two, oldest first
+    clock->advance(std::chrono::seconds(31));
+    EXPECT_TRUE(eventually([&]() { return server.session_count() == 3; }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(server.session_count(), 3u);
+    EXPECT_FALSE(server.is_active("660000000000001"));
+    EXPECT_TRUE(server.is_active("660000000000005"));
+
+    clock->advance(std::chrono::seconds(1));
+    EXPECT_TRUE(eventually([&]() { return server.session_count() == 1; }));
+    clock->advance(std::chrono::seconds(1));
+    EXPECT_TRUE(eventually([&]() { return server.session_count() == 0; }));
+    EXPECT_TRUE(eventually([&]() { return count_cdr(cfg_.cdr_file, ", timeout") == 5; }));
+
+    auto expiry = server.stats()["expiry"];
+    EXPECT_EQ(expiry["expired_idle"], 5);
+    EXPECT_EQ(expiry["carried_ticks"], 2);
+    EXPECT_EQ(expiry["lateness_ms"]["count"], 3);
+    EXPECT_EQ(expiry["lateness_ms"]["max"], 3000);
+    EXPECT_EQ(expiry["lock_hold_us"]["count"], 3);
+    EXPECT_EQ(expiry["reply_us"]["all"]["count"], 5);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, AdaptiveExpiryUnderOccupancyPressure) {
+    cfg_.session_timeout_sec = 60;
+    cfg_.max_sessions = 4;
+    cfg_.adaptive_timeout_min_sec = 5;
+    cfg_.adaptive_occupancy_low = 0.25;
+    cfg_.adaptive_occupancy_high = 0.5;
+    auto clock = std::make_shared<ManualClock>();
+    Server server(cfg_, clock);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "650000000000001"), "created");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "650000000000002"), "created");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "650000000000003"), "created");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "650000000000001"), "active");
+    EXPECT_EQ(server.stats()["expiry"]["low_activity_sessions"], 2);
+
+    // 3/4 full is past the high watermark: never-refreshed sessions get 5 s
+    clock->advance(std::chrono::seconds(6));
+    EXPECT_TRUE(eventually([&]() {
+        clock->advance(std::chrono::milliseconds(10));
+        return server.session_count() == 1;
+    }));
+    EXPECT_TRUE(server.is_active("650000000000001"));
+    EXPECT_TRUE(eventually([&]() { return count_cdr(cfg_.cdr_file, "timeout_pressure") == 2; }));
+
+    // one session left, pressure is gone and the full timeout applies again
+    EXPECT_TRUE(eventually([&]() {
+        clock->advance(std::chrono::milliseconds(10));
+        return server.stats()["expiry"]["state"] == "normal";
+    }));
+    auto expiry = server.stats()["expiry"];
+    EXPECT_EQ(expiry["low_activity_timeout_sec"], 60);
+    EXPECT_EQ(expiry["expired_pressure"], 2);
+    EXPECT_EQ(expiry["expired_idle"], 0);
+
+    clock->advance(std::chrono::seconds(60));
+    EXPECT_TRUE(eventually([&]() {
+        clock->advance(std::chrono::milliseconds(10));
+        return count_cdr(cfg_.cdr_file, ", timeout") == 1;
+    }));
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, CaptureRecordsReceivedDatagrams) {
+    cfg_.capture_file = (test_dir_ / "udp.cap").string();
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    timespec before{};
+    clock_gettime(CLOCK_REALTIME, &before);
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "640000000000001"), "created");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "640000000000002"), "created");
+    EXPECT_TRUE(eventually([&]() { return server.stats()["capture"]["records"] == 2; }));
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+
+    CaptureReader r(cfg_.capture_file);
+    ASSERT_TRUE(r.ok()) << r.error();
+    CaptureRecordHeader rec;
+    std::vector<uint8_t> payload;
+    int64_t last = before.tv_sec * 1000000000LL + before.tv_nsec;
+    for (const char *imsi : {"640000000000001", "640000000000002"}) {
+        ASSERT_TRUE(r.next(rec, payload));
+        EXPECT_EQ(payload, encode_imsi_bcd(imsi));
+        EXPECT_EQ(rec.src_ip, htonl(INADDR_LOOPBACK));
+        EXPECT_GE(rec.ts_ns, last);
+        last = rec.ts_ns;
+    }
+    EXPECT_FALSE(r.next(rec, payload));
+}
+
+TEST_F(ServerTest, PresizedSessionArenaAndStartupStats) {
+    cfg_.expected_sessions = 1000;
+    cfg_.huge_pages = "transparent";
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "630000000000001"), "created");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "630000000000001"), "active");
+
+    EXPECT_TRUE(eventually([&]() { return server.stats()["startup"]["first_minute_us"]["count"] == 2; }));
+    auto startup = server.stats()["startup"];
+    EXPECT_EQ(startup["expected_sessions"], 1000);
+    EXPECT_GE(startup["arena"]["bytes"].get<uint64_t>(), SessionTable::arena_bytes(1000));
+    EXPECT_GT(startup["arena"]["used"].get<uint64_t>(), 0u);
+    EXPECT_EQ(startup["arena"]["heap_fallbacks"], 0);
+    EXPECT_TRUE(startup["startup_ms"].is_number());
+    EXPECT_LE(startup["first_minute_us"]["p99"].get<uint64_t>(), startup["first_minute_us"]["max"].get<uint64_t>());
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, HeavyHittersEndpoint) {
+    cfg_.heavy_hitters_top = 8;
+    cfg_.heavy_hitters_window_sec = 10;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "620000000000001"), "created");
+    for (int i = 0; i < 4; ++i) ASSERT_EQ(send_imsi(cfg_.udp_port, "620000000000001"), "active");
+    ASSERT_EQ(send_imsi(cfg_.udp_port, "620000000000002"), "created");
+
+    // published once the 1 s slot closes
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    httplib::Client cli("127.0.0.1", cfg_.http_port);
+    cli.set_connection_timeout(2, 0);
+    nlohmann::json j;
+    EXPECT_TRUE(eventually([&]() {
+        auto res = cli.Get("/heavy_hitters?limit=1");
+        if (!res || res->status != 200) return false;
+        j = nlohmann::json::parse(res->body);
+        return j["imsis"]["total"] == 6;
+    }));
+    ASSERT_EQ(j["imsis"]["top"].size(), 1u);
+    EXPECT_EQ(j["imsis"]["top"][0]["key"], "620000000000001");
+    EXPECT_EQ(j["imsis"]["top"][0]["count"], 5);
+    EXPECT_EQ(j["sources"]["top"][0]["key"], "127.0.0.1");
+    EXPECT_EQ(j["sources"]["top"][0]["count"], 6);
+
+    auto res = cli.Get("/heavy_hitters?window=abc");
+    ASSERT_TRUE(res);
+    EXPECT_EQ(res->status, 400);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, XdpUnavailableFallsBackToSocket) {
+    // no such interface (or no XDP in this build): served from the UDP socket
+    cfg_.xdp_interface = "pgw-no-such0";
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "630000000000001"), "created");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "630000000000001"), "active");
+
+    httplib::Client cli("127.0.0.1", cfg_.http_port);
+    cli.set_connection_timeout(2, 0);
+    auto res = cli.Get("/stats");
+    EXPECT_TRUE(res && res->status == 200);
+    if (res) {
+        EXPECT_FALSE(nlohmann::json::parse(res->body).contains("xdp"));
+    }
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, SessionEventStream) {
+    cfg_.events_buffer = 1024;
+    cfg_.blacklist = {"640000000000009"};
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "640000000000001"), "created");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "640000000000001"), "active");
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "640000000000009"), "rejected");
+
+    httplib::Client cli("127.0.0.1", cfg_.http_port);
+    cli.set_connection_timeout(2, 0);
+    auto res = cli.Get("/events?since=0&follow=0");
+    EXPECT_TRUE(res && res->status == 200);
+    std::vector<nlohmann::json> events;
+    if (res) {
+        std::stringstream ss(res->body);
+        std::string line;
+        while (std::getline(ss, line)) events.push_back(nlohmann::json::parse(line));
+    }
+    EXPECT_EQ(events.size(), 3u);
+    if (events.size() == 3) {
+        EXPECT_EQ(events[0]["seq"], 0);
+        EXPECT_EQ(events[0]["event"], "created");
+        EXPECT_EQ(events[0]["imsi"], "640000000000001");
+        EXPECT_EQ(events[1]["event"], "refreshed");
+        EXPECT_EQ(events[2]["event"], "rejected");
+        EXPECT_EQ(events[2]["imsi"], "640000000000009");
+    }
+
+    // SSE resumes after Last-Event-ID; types filters
+    res = cli.Get("/events?format=sse&follow=0", {{"Last-Event-ID", "0"}});
+    EXPECT_TRUE(res && res->status == 200);
+    if (res) {
+        EXPECT_EQ(res->get_header_value("Content-Type"), "text/event-stream");
+        EXPECT_EQ(res->body.find("event: created"), std::string::npos);
+        EXPECT_NE(res->body.find("id: 1\nevent: refreshed\ndata: "), std::string::npos);
+    }
+    res = cli.Get("/events?since=0&follow=0&types=rejected");
+    EXPECT_TRUE(res && res->status == 200);
+    if (res) {
+        EXPECT_EQ(std::count(res->body.begin(), res->body.end(), '\n'), 1);
+    }
+
+    // a following stream gets events published after it connected
+    std::string streamed;
+    std::thread reader([&]() {
+        httplib::Client c("127.0.0.1", cfg_.http_port);
+        c.Get("/events?types=created", [&](const char *data, size_t len) {
+            streamed.append(data, len);
+            return streamed.find('\n') == std::string::npos;
+        });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "640000000000002"), "created");
+    reader.join();
+    EXPECT_NE(streamed.find("\"imsi\":\"640000000000002\""), std::string::npos);
+
+    res = cli.Get("/events?types=attached");
+    EXPECT_TRUE(res && res->status == 400);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, EventStreamsShareTheStreamLimit) {
+    cfg_.events_buffer = 64;
+    cfg_.max_streams = 1;
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // a following consumer takes the only slot; /stats keeps answering
+    std::thread follower([&]() {
+        httplib::Client c("127.0.0.1", cfg_.http_port);
+        c.Get("/events", [](const char *, size_t) { return true; });
+    });
+    httplib::Client cli("127.0.0.1", cfg_.http_port);
+    cli.set_connection_timeout(2, 0);
+    EXPECT_TRUE(eventually([&]() {
+        auto r = cli.Get("/stats");
+        return r && r->status == 200 && nlohmann::json::parse(r->body)["events"]["streams"] == 1;
+    }));
+
+    auto res = cli.Get("/events?follow=0");
+    EXPECT_TRUE(res && res->status == 503);
+    res = cli.Get("/cdr/stream");
+    EXPECT_TRUE(res && res->status == 503);
+    res = cli.Get("/check_subscriber?imsi=001010000000001");
+    EXPECT_TRUE(res && res->status == 200);
+
+    server.stop();
+    follower.join();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+TEST_F(ServerTest, MalformedImsiCreatesNoSession) {
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in srv{};
+    srv.sin_family = AF_INET;
+    srv.sin_port = htons(cfg_.udp_port);
+    inet_pton(AF_INET, "127.0.0.1", &srv.sin_addr);
+    const uint8_t bad = 0xAA;
+    const uint8_t too_long[9] = {0x21, 0x43, 0x65, 0x87, 0x09, 0x21, 0x43, 0x65, 0x87};
+    sendto(sock, &bad, 0, 0, reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+    sendto(sock, &bad, 1, 0, reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+    sendto(sock, too_long, sizeof(too_long), 0, reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+    close(sock);
+
+    // datagrams from one socket are handled in order
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "670000000000001"), "created");
+    EXPECT_EQ(server.session_count(), 1u);
+    EXPECT_EQ(server.stats()["udp"]["received"], 4);
+
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
+
+// protocol v2
+
+TEST_F(ServerTest, ProtocolV2MultiImsi) {
+    Server server(cfg_);
+
+    std::thread server_thread([&server]() {
+        server.start();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in srv{};
+    srv.sin_family = AF_INET;
+    srv.sin_port = htons(cfg_.udp_port);
+    inet_pton(AF_INET, "127.0.0.1", &srv.sin_addr);
+    struct timeval tv{};
+    tv.tv_sec = 2;
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::vector<std::string> imsis;
+    for (int i = 0; i < 40; ++i) imsis.push_back("2000000000000" + std::to_string(10 + i));
+    imsis.push_back("001010123456789"); // blacklisted
+    imsis.push_back("200000000000010"); // duplicate within the datagram
+
+    auto req = encode_v2_request(4242, imsis);
+    sendto(sock, req.data(), req.size(), 0, reinterpret_cast<sockaddr*>(&srv), sizeof(srv));
+    uint8_t buf[1500];
+    ssize_t r = recvfrom(sock, buf, sizeof(buf), 0, nullptr, nullptr);
+    ASSERT_GT(r, 0);
+
+    ProtoHeader hdr;
+    std::vector<ResultCode> results;
+    ASSERT_TRUE(decode_v2_reply(buf, static_cast<size_t>(r), hdr, results));
+    EXPECT_EQ(hdr.txid, 4242u);
+    ASSERT_EQ(results.size(), imsis.size());
+    for (int i = 0; i < 40; ++i) EXPECT_EQ(results[i], ResultCode::created) << i;
+    EXPECT_EQ(results[40], ResultCode::rejected);
+    EXPECT_EQ(results[41], ResultCode::active);
+    EXPECT_EQ(server.session_count(), 40u);
+
+    // legacy clients are unaffected
+    EXPECT_EQ(send_imsi(cfg_.udp_port, "200000000000011"), "active");
+
+    auto st = server.stats();
+    EXPECT_EQ(st["udp"]["v2_requests"].get<uint64_t>(), 1u);
+    EXPECT_EQ(st["udp"]["v2_imsis"].get<uint64_t>(), imsis.size());
+
+    close(sock);
+    server.stop();
+    if (server_thread.joinable()) {
+        server_thread.join();
+    }
+}
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include "session_arena.h"
+#include "session_table.h"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstring>
+
+TEST(SessionArena, MapsAndPrefaults) {
+    SessionArena arena(3u << 20, SessionArena::HugePages::off, true);
+    ASSERT_TRUE(arena.ok());
+    EXPECT_EQ(arena.capacity(), 4u << 20); // rounded up to huge pages
+    EXPECT_EQ(arena.used(), 0u);
+    EXPECT_STREQ(arena.huge_pages(), "off");
+    EXPECT_GE(arena.prefault_ms(), 0.0);
+}
+
+TEST(SessionArena, ParsesHugePagesSetting) {
+    SessionArena::HugePages hp;
+    EXPECT_TRUE(SessionArena::parse_huge_pages("off", hp));
+    EXPECT_EQ(hp, SessionArena::HugePages::off);
+    EXPECT_TRUE(SessionArena::parse_huge_pages("transparent", hp));
+    EXPECT_EQ(hp, SessionArena::HugePages::transparent);
+    EXPECT_TRUE(SessionArena::parse_huge_pages("explicit", hp));
+    EXPECT_EQ(hp, SessionArena::HugePages::explicit_);
+    EXPECT_FALSE(SessionArena::parse_huge_pages("always", hp));
+}
+
+TEST(SessionArena, ExplicitHugePagesFallBack) {
+    // usually no hugetlbfs pages are reserved; either way the arena works
+    SessionArena arena(1u << 20, SessionArena::HugePages::explicit_, false);
+    ASSERT_TRUE(arena.ok());
+    std::string mode = arena.huge_pages();
+    EXPECT_TRUE(mode == "explicit" || mode == "transparent" || mode == "off");
+    void *p = arena.allocate(100, 8);
+    std::memset(p, 1, 100);
+    arena.deallocate(p, 100);
+}
+
+TEST(SessionArena, RecyclesSmallBlocks) {
+    SessionArena arena(1u << 20, SessionArena::HugePages::off, false);
+    void *a = arena.allocate(40, 8);
+    void *b = arena.allocate(40, 8);
+    EXPECT_NE(a, b);
+    size_t used = arena.used();
+    arena.deallocate(a, 40);
+    EXPECT_EQ(arena.allocate(33, 8), a); // same 48-byte size class
+    EXPECT_EQ(arena.used(), used);
+    EXPECT_NE(arena.allocate(40, 8), a);
+}
+
+TEST(SessionArena, FallsBackToHeapWhenFull) {
+    SessionArena arena(1u << 20, SessionArena::HugePages::off, false);
+    void *big = arena.allocate(arena.capacity() - 64, 64);
+    ASSERT_NE(big, nullptr);
+    EXPECT_EQ(arena.heap_fallbacks(), 0u);
+    void *more = arena.allocate(4096, 16);
+    ASSERT_NE(more, nullptr);
+    std::memset(more, 0, 4096);
+    EXPECT_EQ(arena.heap_fallbacks(), 1u);
+    arena.deallocate(more, 4096); // back to the heap
+    arena.deallocate(big, arena.capacity() - 64);
+    EXPECT_EQ(arena.used(), 0u); // last large block is taken back
+}
+
+TEST(SessionArena, BacksSessionTable) {
+    const size_t n = 10000;
+    SessionArena arena(SessionTable::arena_bytes(n), SessionArena::HugePages::transparent, true);
+    ASSERT_TRUE(arena.ok());
+    SessionTable t(0, &arena, n);
+    size_t reserved = arena.used();
+    EXPECT_GT(reserved, 0u);
+
+    auto now = std::chrono::steady_clock::time_point{} + std::chrono::hours(1);
+    for (size_t i = 0; i < n; ++i) ASSERT_TRUE(t.insert(std::to_string(100000000000000 + i), now));
+    EXPECT_EQ(t.size(), n);
+    EXPECT_EQ(arena.heap_fallbacks(), 0u);
+
+    // churn reuses freed hash nodes instead of growing
+    std::vector<std::string> out;
+    ASSERT_EQ(t.pop_batch(n / 2, out), n / 2);
+    size_t used = arena.used();
+    for (size_t i = 0; i < n / 2; ++i) ASSERT_TRUE(t.insert(std::to_string(200000000000000 + i), now));
+    EXPECT_EQ(arena.used(), used);
+
+    // clearing keeps the reserved storage
+    t.clear();
+    EXPECT_TRUE(t.empty());
+    EXPECT_TRUE(t.insert("1", now));
+    EXPECT_EQ(arena.used(), used);
+    EXPECT_EQ(arena.heap_fallbacks(), 0u);
+}
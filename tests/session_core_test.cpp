@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include "session_core.h"
+#include "session_table.h"
+#include "clock.h"
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std::chrono;
+
+struct TestClock {
+    using time_point = steady_clock::time_point;
+    time_point t = time_point{} + hours(1);
+    time_point now() const { return t; }
+};
+
+struct RecordingSink {
+    std::vector<std::pair<std::string, std::string>> records;
+    void operator()(const std::string &imsi, const char *action) { records.emplace_back(imsi, action); }
+};
+
+// minimal alternative store: no recency list, oldest found by scanning
+struct MapStore {
+    std::map<std::string, steady_clock::time_point> m;
+    size_t capacity = 0;
+
+    bool touch(const std::string &imsi, steady_clock::time_point now) {
+        auto it = m.find(imsi);
+        if (it == m.end()) return false;
+        it->second = now;
+        return true;
+    }
+    bool insert(const std::string &imsi, steady_clock::time_point now) { return m.emplace(imsi, now).second; }
+    bool full() const { return capacity != 0 && m.size() >= capacity; }
+    bool pop_oldest(std::string &imsi) {
+        if (m.empty()) return false;
+        auto oldest = m.begin();
+        for (auto it = m.begin(); it != m.end(); ++it) {
+            if (it->second < oldest->second) oldest = it;
+        }
+        imsi = oldest->first;
+        m.erase(oldest);
+        return true;
+    }
+    size_t expire(steady_clock::time_point now, seconds timeout, std::vector<std::string> &out) {
+        size_t n = 0;
+        for (auto it = m.begin(); it != m.end();) {
+            if (now - it->second >= timeout) {
+                out.push_back(it->first);
+                it = m.erase(it);
+                ++n;
+            } else {
+                ++it;
+            }
+        }
+        return n;
+    }
+};
+
+TEST(SessionCore, CreateRefreshReject) {
+    SessionTable store;
+    RecordingSink cdr;
+    VectorBlacklist bl({"999"});
+    TestClock clock;
+    SessionCore<SessionTable, RecordingSink, VectorBlacklist, TestClock> core(store, cdr, bl, clock);
+
+    EXPECT_STREQ(core.handle("1").reply, "created");
+    EXPECT_STREQ(core.handle("1").reply, "active");
+    EXPECT_STREQ(core.handle("999").reply, "rejected");
+    EXPECT_FALSE(store.contains("999"));
+
+    using Rec = std::pair<std::string, std::string>;
+    std::vector<Rec> expected{{"1", "created"}, {"999", "rejected"}};
+    EXPECT_EQ(cdr.records, expected);
+}
+
+TEST(SessionCore, CapacityPolicies) {
+    TestClock clock;
+    HashBlacklist bl({});
+    {
+        SessionTable store(1);
+        RecordingSink cdr;
+        SessionCore<SessionTable, RecordingSink, HashBlacklist, TestClock> core(store, cdr, bl, clock);
+        core.handle("1");
+        auto out = core.handle("2");
+        EXPECT_STREQ(out.reply, "no_capacity");
+        EXPECT_TRUE(out.evicted.empty());
+        EXPECT_EQ(cdr.records.back(), std::make_pair(std::string("2"), std::string("rejected_capacity")));
+    }
+    {
+        SessionTable store(2);
+        RecordingSink cdr;
+        SessionCore<SessionTable, RecordingSink, HashBlacklist, TestClock> core(
+            store, cdr, bl, clock, CapacityPolicy::evict_lru);
+        core.handle("1");
+        clock.t += seconds(1);
+        core.handle("2");
+        clock.t += seconds(1);
+        core.handle("1"); // "2" is now the least recently refreshed
+        auto out = core.handle("3");
+        EXPECT_STREQ(out.reply, "created");
+        EXPECT_EQ(out.evicted, "2");
+        EXPECT_TRUE(store.contains("1"));
+        EXPECT_TRUE(store.contains("3"));
+    }
+}
+
+TEST(SessionCore, ExpireUsesPolicyClock) {
+    MapStore store;
+    NullCdrSink cdr;
+    VectorBlacklist bl({});
+    TestClock clock;
+    SessionCore<MapStore, NullCdrSink, VectorBlacklist, TestClock> core(store, cdr, bl, clock);
+
+    core.handle("1");
+    clock.t += seconds(20);
+    core.handle("2");
+    clock.t += seconds(15);
+
+    std::vector<std::string> expired;
+    EXPECT_EQ(core.expire(seconds(30), expired), 1u);
+    EXPECT_EQ(expired, std::vector<std::string>{"1"});
+    EXPECT_EQ(store.m.count("2"), 1u);
+}
+
+TEST(SessionCore, AlternativeStoreEvicts) {
+    MapStore store;
+    store.capacity = 2;
+    RecordingSink cdr;
+    HashBlacklist bl({});
+    TestClock clock;
+    SessionCore<MapStore, RecordingSink, HashBlacklist, TestClock> core(store, cdr, bl, clock, CapacityPolicy::evict_lru);
+
+    core.handle("a");
+    clock.t += seconds(1);
+    core.handle("b");
+    EXPECT_EQ(core.handle("c").evicted, "a");
+    EXPECT_EQ(cdr.records.size(), 4u); // created a, b; evicted a; created c
+}
+
+TEST(SessionCore, MassExpiryOnSimulatedTime) {
+    const int n = 500000;
+    SessionTable store;
+    NullCdrSink cdr;
+    VectorBlacklist bl({});
+    ManualClock clock;
+    SessionCore<SessionTable, NullCdrSink, VectorBlacklist, Clock> core(store, cdr, bl, clock);
+
+    // half the sessions arrive a simulated minute later
+    for (int i = 0; i < n; ++i) {
+        if (i == n / 2) clock.advance(minutes(1));
+        core.handle(std::to_string(100000000000000LL + i));
+    }
+    clock.advance(seconds(30));
+
+    std::vector<std::string> expired;
+    EXPECT_EQ(core.expire(seconds(60), expired), static_cast<size_t>(n / 2));
+    EXPECT_EQ(store.size(), static_cast<size_t>(n / 2));
+    clock.advance(minutes(1));
+    expired.clear();
+    EXPECT_EQ(core.expire(seconds(60), expired), static_cast<size_t>(n / 2));
+    EXPECT_TRUE(store.empty());
+}
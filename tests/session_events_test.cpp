@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "session_events.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using Kind = SessionEvents::Kind;
+
+TEST(SessionEvents, DisabledIsNoOp) {
+    SessionEvents ev(0);
+    EXPECT_FALSE(ev.enabled());
+    ev.publish(Kind::created, 1, 0);
+    std::vector<SessionEvents::Event> out;
+    uint64_t lost = 1;
+    EXPECT_EQ(ev.read(0, out, 10, lost), 0u);
+    EXPECT_TRUE(out.empty());
+    EXPECT_EQ(lost, 0u);
+}
+
+TEST(SessionEvents, ReadsInOrderAndResumes) {
+    SessionEvents ev(5);
+    EXPECT_EQ(ev.capacity(), 8u);
+    ev.publish(Kind::created, 11, 1000);
+    ev.publish(Kind::refreshed, 11, 2000);
+    ev.publish(Kind::timeout, 11, 3000);
+
+    std::vector<SessionEvents::Event> out;
+    uint64_t lost = 0;
+    uint64_t next = ev.read(0, out, 2, lost);
+    EXPECT_EQ(next, 2u);
+    ASSERT_EQ(out.size(), 2u);
+    EXPECT_EQ(out[0].seq, 0u);
+    EXPECT_EQ(out[0].kind, Kind::created);
+    EXPECT_EQ(out[0].imsi, 11u);
+    EXPECT_EQ(out[0].unix_ms, 1000);
+    EXPECT_EQ(out[1].kind, Kind::refreshed);
+
+    out.clear();
+    next = ev.read(next, out, 10, lost);
+    EXPECT_EQ(next, 3u);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].kind, Kind::timeout);
+    EXPECT_EQ(lost, 0u);
+
+    // caught up; a sequence from the future waits at the head
+    out.clear();
+    EXPECT_EQ(ev.read(next, out, 10, lost), 3u);
+    EXPECT_EQ(ev.read(100, out, 10, lost), 3u);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST(SessionEvents, LappedReaderReportsLoss) {
+    SessionEvents ev(4);
+    for (uint64_t i = 0; i < 10; ++i) ev.publish(Kind::created, i + 1, 0);
+    EXPECT_EQ(ev.oldest_seq(), 6u);
+
+    std::vector<SessionEvents::Event> out;
+    uint64_t lost = 0;
+    uint64_t next = ev.read(1, out, 10, lost);
+    EXPECT_EQ(lost, 5u);
+    EXPECT_EQ(next, 10u);
+    ASSERT_EQ(out.size(), 4u);
+    EXPECT_EQ(out.front().seq, 6u);
+    EXPECT_EQ(out.front().imsi, 7u);
+}
+
+TEST(SessionEvents, KindNames) {
+    for (size_t i = 0; i < SessionEvents::kinds; ++i) {
+        Kind k;
+        ASSERT_TRUE(SessionEvents::kind_of(SessionEvents::name(static_cast<Kind>(i)), k));
+        EXPECT_EQ(static_cast<size_t>(k), i);
+    }
+    Kind k;
+    EXPECT_TRUE(SessionEvents::kind_of("timeout_pressure", k));
+    EXPECT_EQ(k, Kind::timeout_pressure);
+    EXPECT_FALSE(SessionEvents::kind_of("attached", k));
+}
+
+TEST(SessionEvents, ConcurrentWritersSlowReader) {
+    // every event is either delivered once, in sequence order, or counted lost
+    SessionEvents ev(64);
+    constexpr int writers = 4, per_writer = 20000;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&ev, w]() {
+            for (int i = 0; i < per_writer; ++i) {
+                ev.publish(Kind::refreshed, static_cast<uint64_t>(w) << 32 | i, i);
+            }
+        });
+    }
+    std::thread finisher([&]() {
+        for (auto &t : threads) t.join();
+        done = true;
+    });
+
+    uint64_t pos = 0, delivered = 0, lost_total = 0;
+    std::vector<SessionEvents::Event> out;
+    for (;;) {
+        bool finished = done.load();
+        out.clear();
+        uint64_t lost = 0;
+        uint64_t from = pos;
+        pos = ev.read(pos, out, 16, lost);
+        lost_total += lost;
+        EXPECT_EQ(pos - from, out.size() + lost);
+        for (const auto &e : out) {
+            EXPECT_GE(e.seq, from);
+            from = e.seq + 1;
+            // payload belongs to the writer that claimed this slot
+            EXPECT_EQ(static_cast<int64_t>(e.imsi & 0xffffffffu), e.unix_ms);
+            ++delivered;
+        }
+        if (finished && pos == ev.next_seq()) break;
+        std::this_thread::yield();
+    }
+    finisher.join();
+    EXPECT_EQ(delivered + lost_total, static_cast<uint64_t>(writers) * per_writer);
+    EXPECT_GT(delivered, 0u);
+}
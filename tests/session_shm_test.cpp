@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include "session_mirror.h"
+#include "session_shm.h"
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+static std::string shm_name(const char *tag) {
+    return std::string("pgw_shm_test_") + tag + "_" + std::to_string(getpid());
+}
+
+static std::string imsi_of(int i) {
+    std::string s = std::to_string(i);
+    return std::string(15 - s.size(), '0') + s;
+}
+
+TEST(SessionShm, ReaderSeesWriterUpdates) {
+    auto name = shm_name("basic");
+    SessionMirror m(name, 100, std::chrono::seconds(30));
+    ASSERT_TRUE(m.ok());
+    EXPECT_EQ(m.slots(), 128u);
+
+    SessionShmReader r(name);
+    ASSERT_TRUE(r.ok());
+    EXPECT_EQ(r.slots(), 128u);
+    EXPECT_EQ(r.session_timeout_ms(), 30000);
+    EXPECT_TRUE(r.fresh(std::chrono::seconds(1)));
+
+    auto now = std::chrono::steady_clock::now();
+    EXPECT_TRUE(m.upsert("001010123456789", now - std::chrono::seconds(5)));
+    uint64_t idle = 0;
+    EXPECT_TRUE(r.lookup("001010123456789", &idle));
+    EXPECT_GE(idle, 5000u);
+    EXPECT_LT(idle, 6000u);
+
+    // refresh keeps a single entry
+    EXPECT_TRUE(m.upsert("001010123456789", now));
+    EXPECT_TRUE(r.lookup("001010123456789", &idle));
+    EXPECT_LT(idle, 1000u);
+    EXPECT_EQ(r.sessions(), 1u);
+
+    // leading zeros are significant
+    EXPECT_FALSE(r.lookup("01010123456789"));
+    EXPECT_FALSE(r.lookup("not-an-imsi"));
+
+    m.remove("001010123456789");
+    EXPECT_FALSE(r.lookup("001010123456789"));
+    EXPECT_EQ(r.sessions(), 0u);
+}
+
+TEST(SessionShm, RemovalKeepsChainsAndFreesSlots) {
+    auto name = shm_name("chain");
+    SessionMirror m(name, 16, std::chrono::seconds(30));
+    SessionShmReader r(name);
+    ASSERT_TRUE(r.ok());
+
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 16; ++i) EXPECT_TRUE(m.upsert(imsi_of(i), now));
+    EXPECT_FALSE(m.upsert(imsi_of(100), now));
+    EXPECT_EQ(m.dropped(), 1u);
+
+    for (int i = 0; i < 16; i += 2) m.remove(imsi_of(i));
+    for (int i = 1; i < 16; i += 2) EXPECT_TRUE(r.lookup(imsi_of(i))) << i;
+    for (int i = 0; i < 16; i += 2) EXPECT_FALSE(r.lookup(imsi_of(i))) << i;
+
+    for (int i = 100; i < 108; ++i) EXPECT_TRUE(m.upsert(imsi_of(i), now));
+    EXPECT_EQ(r.sessions(), 16u);
+    for (int i = 100; i < 108; ++i) EXPECT_TRUE(r.lookup(imsi_of(i)));
+}
+
+TEST(SessionShm, ChurnKeepsProbesShort) {
+    auto name = shm_name("churn");
+    SessionMirror m(name, 1024, std::chrono::seconds(30));
+    SessionShmReader r(name);
+    ASSERT_TRUE(r.ok());
+
+    // a quarter of the table stays, many times its size in IMSIs come and go
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 256; ++i) m.upsert(imsi_of(i), now);
+    for (int i = 1000; i < 101000; ++i) {
+        m.upsert(imsi_of(i), now);
+        if (i >= 1064) m.remove(imsi_of(i - 64));
+    }
+    EXPECT_EQ(m.sessions(), 256u + 64u);
+    EXPECT_LT(m.longest_probe(), 64u);
+    for (int i = 0; i < 256; ++i) EXPECT_TRUE(r.lookup(imsi_of(i))) << i;
+    EXPECT_FALSE(r.lookup(imsi_of(1000)));
+}
+
+TEST(SessionShm, ClearBumpsGeneration) {
+    auto name = shm_name("clear");
+    SessionMirror m(name, 64, std::chrono::seconds(30));
+    SessionShmReader r(name);
+    ASSERT_TRUE(r.ok());
+
+    m.upsert(imsi_of(1), std::chrono::steady_clock::now());
+    uint64_t gen = r.generation();
+    m.clear();
+    EXPECT_EQ(r.generation(), gen + 1);
+    EXPECT_FALSE(r.lookup(imsi_of(1)));
+    EXPECT_EQ(r.sessions(), 0u);
+}
+
+TEST(SessionShm, WriterGoneIsNotFresh) {
+    auto name = shm_name("gone");
+    auto m = std::make_unique<SessionMirror>(name, 64, std::chrono::seconds(30));
+    SessionShmReader r(name);
+    ASSERT_TRUE(r.ok());
+    EXPECT_TRUE(r.fresh(std::chrono::seconds(1)));
+    m.reset();
+    EXPECT_FALSE(r.fresh(std::chrono::seconds(1)));
+
+    SessionShmReader missing(name);
+    EXPECT_FALSE(missing.ok());
+}
+
+TEST(SessionShm, ConcurrentReadersSeeConsistentEntries) {
+    auto name = shm_name("race");
+    SessionMirror m(name, 1024, std::chrono::seconds(30));
+    SessionShmReader r(name);
+    ASSERT_TRUE(r.ok());
+
+    // even IMSIs stay, odd ones churn
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 512; i += 2) m.upsert(imsi_of(i), now);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> misses{0};
+    std::thread reader([&]() {
+        while (!done) {
+            for (int i = 0; i < 512; i += 2) {
+                if (!r.lookup(imsi_of(i))) misses++;
+            }
+        }
+    });
+    for (int round = 0; round < 200; ++round) {
+        for (int i = 1; i < 512; i += 2) m.upsert(imsi_of(i), std::chrono::steady_clock::now());
+        for (int i = 1; i < 512; i += 2) m.remove(imsi_of(i));
+    }
+    done = true;
+    reader.join();
+    EXPECT_EQ(misses.load(), 0);
+}
@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+#include "session_table.h"
+#include <vector>
+#include <string>
+#include <chrono>
+#include <memory>
+#include <filesystem>
+
+using namespace std::chrono;
+
+static SessionTable::time_point t0() {
+    return SessionTable::time_point{} + hours(1);
+}
+
+TEST(SessionTable, InsertTouchErase) {
+    SessionTable t;
+    EXPECT_TRUE(t.insert("1", t0()));
+    EXPECT_FALSE(t.insert("1", t0()));
+    EXPECT_TRUE(t.contains("1"));
+    EXPECT_TRUE(t.touch("1", t0() + seconds(1)));
+    EXPECT_FALSE(t.touch("2", t0()));
+    EXPECT_TRUE(t.erase("1"));
+    EXPECT_FALSE(t.erase("1"));
+    EXPECT_TRUE(t.empty());
+}
+
+TEST(SessionTable, CapacityBound) {
+    SessionTable t(2);
+    EXPECT_TRUE(t.insert("1", t0()));
+    EXPECT_TRUE(t.insert("2", t0()));
+    EXPECT_TRUE(t.full());
+    EXPECT_FALSE(t.insert("3", t0()));
+    EXPECT_EQ(t.size(), 2u);
+}
+
+TEST(SessionTable, PopOldestFollowsRefreshOrder) {
+    SessionTable t(3);
+    t.insert("1", t0());
+    t.insert("2", t0() + seconds(1));
+    t.insert("3", t0() + seconds(2));
+    t.touch("1", t0() + seconds(3));
+
+    std::string imsi;
+    ASSERT_TRUE(t.pop_oldest(imsi));
+    EXPECT_EQ(imsi, "2");
+    ASSERT_TRUE(t.pop_oldest(imsi));
+    EXPECT_EQ(imsi, "3");
+    ASSERT_TRUE(t.pop_oldest(imsi));
+    EXPECT_EQ(imsi, "1");
+    EXPECT_FALSE(t.pop_oldest(imsi));
+}
+
+TEST(SessionTable, ExpireOnlyIdle) {
+    SessionTable t;
+    t.insert("1", t0());
+    t.insert("2", t0() + seconds(5));
+    t.insert("3", t0() + seconds(10));
+
+    std::vector<std::string> out;
+    EXPECT_EQ(t.expire(t0() + seconds(12), seconds(7), out), 2u);
+    EXPECT_EQ(out, (std::vector<std::string>{"1", "2"}));
+    EXPECT_TRUE(t.contains("3"));
+}
+
+TEST(SessionTable, ExpireUpToLimit) {
+    SessionTable t;
+    for (int i = 1; i <= 5; ++i) t.insert(std::to_string(i), t0() + seconds(i));
+
+    std::vector<std::string> out;
+    SessionTable::time_point oldest;
+    EXPECT_EQ(t.expire(t0() + seconds(20), seconds(10), out, 2), 2u);
+    EXPECT_EQ(out, (std::vector<std::string>{"1", "2"}));
+    ASSERT_TRUE(t.peek_oldest(oldest));
+    EXPECT_EQ(oldest, t0() + seconds(3));
+    EXPECT_EQ(t.expire(t0() + seconds(20), seconds(10), out, 10), 3u);
+    EXPECT_EQ(t.size(), 0u);
+}
+
+TEST(SessionTable, SlotsAreReused) {
+    SessionTable t(1);
+    for (int i = 0; i < 100; ++i) {
+        std::string imsi;
+        t.pop_oldest(imsi);
+        EXPECT_TRUE(t.insert(std::to_string(i), t0()));
+    }
+    EXPECT_EQ(t.size(), 1u);
+    EXPECT_TRUE(t.contains("99"));
+}
+
+TEST(SessionTable, PopBatch) {
+    SessionTable t;
+    for (int i = 0; i < 10; ++i) t.insert(std::to_string(i), t0() + seconds(i));
+    std::vector<std::string> out;
+    EXPECT_EQ(t.pop_batch(4, out), 4u);
+    EXPECT_EQ(out.front(), "0");
+    EXPECT_EQ(out.back(), "3");
+    EXPECT_EQ(t.size(), 6u);
+}
+
+TEST(SessionTable, AdoptKeepsRecencyOrder) {
+    SessionTable t;
+    t.insert("1", t0());
+    t.insert("3", t0() + seconds(10));
+    t.adopt("2", t0() + seconds(5));
+    t.adopt("0", t0() - seconds(5));
+
+    std::vector<std::string> out;
+    t.expire(t0() + seconds(11), seconds(5), out);
+    EXPECT_EQ(out, (std::vector<std::string>{"0", "1", "2"}));
+    EXPECT_TRUE(t.contains("3"));
+}
+
+// cold tier
+
+TEST(SessionTable, LowActivitySessionsExpireSeparately) {
+    SessionTable t;
+    t.set_low_activity_refreshes(2);
+    t.insert("1", t0());
+    t.insert("2", t0() + seconds(1));
+    t.insert("3", t0() + seconds(2));
+    EXPECT_EQ(t.low_activity_size(), 3u);
+
+    // "1" graduates on its second refresh
+    t.touch("1", t0() + seconds(3));
+    t.touch("2", t0() + seconds(4));
+    EXPECT_EQ(t.low_activity_size(), 3u);
+    t.touch("1", t0() + seconds(5));
+    EXPECT_EQ(t.low_activity_size(), 2u);
+
+    // the lists merge by last-seen for everything else
+    std::vector<std::string> order;
+    t.for_each([&](const std::string &imsi, SessionTable::time_point) { order.push_back(imsi); });
+    EXPECT_EQ(order, (std::vector<std::string>{"3", "2", "1"}));
+
+    std::vector<std::string> out;
+    EXPECT_EQ(t.expire_low_activity(t0() + seconds(12), seconds(10), out), 1u);
+    EXPECT_EQ(out, (std::vector<std::string>{"3"}));
+    EXPECT_EQ(t.low_activity_size(), 1u);
+
+    std::string oldest;
+    EXPECT_TRUE(t.pop_oldest(oldest));
+    EXPECT_EQ(oldest, "2");
+    EXPECT_EQ(t.low_activity_size(), 0u);
+
+    // a graduated session only goes with the regular timeout
+    EXPECT_EQ(t.expire_low_activity(t0() + hours(1), seconds(10), out), 0u);
+    EXPECT_EQ(t.expire(t0() + seconds(15), seconds(10), out), 1u);
+    EXPECT_TRUE(t.empty());
+}
+
+TEST(SessionTable, LowActivityOffByDefault) {
+    SessionTable t;
+    t.insert("1", t0());
+    EXPECT_EQ(t.low_activity_size(), 0u);
+    std::vector<std::string> out;
+    EXPECT_EQ(t.expire_low_activity(t0() + hours(1), seconds(1), out), 0u);
+    EXPECT_TRUE(t.contains("1"));
+}
+
+static std::unique_ptr<ColdTier> cold_tier(const char *name) {
+    return std::make_unique<ColdTier>(
+        (std::filesystem::temp_directory_path() / (std::string("pgw_st_cold_") + name)).string(), 1024);
+}
+
+TEST(SessionTable, DemotesIdleSessionsAndPromotesOnTouch) {
+    SessionTable t;
+    t.set_cold_tier(cold_tier("promote"));
+    t.insert("001010000000001", t0());
+    t.insert("001010000000002", t0() + seconds(5));
+    t.insert("001010000000003", t0() + seconds(20));
+
+    EXPECT_EQ(t.demote(t0() + seconds(30), seconds(20), 100), 2u);
+    EXPECT_EQ(t.hot_size(), 1u);
+    EXPECT_EQ(t.cold_size(), 2u);
+    EXPECT_EQ(t.size(), 3u);
+    EXPECT_TRUE(t.contains("001010000000001"));
+    EXPECT_FALSE(t.insert("001010000000001", t0()));
+
+    EXPECT_TRUE(t.touch("001010000000001", t0() + seconds(31)));
+    EXPECT_EQ(t.cold_size(), 1u);
+    EXPECT_EQ(t.promoted_total(), 1u);
+
+    // oldest first across both tiers: cold 002, then hot 003, 001
+    std::vector<std::string> order;
+    t.for_each([&](const std::string &imsi, SessionTable::time_point) { order.push_back(imsi); });
+    EXPECT_EQ(order, (std::vector<std::string>{"001010000000002", "001010000000003", "001010000000001"}));
+}
+
+TEST(SessionTable, DemoteSkipsUnpackableSessions) {
+    SessionTable t;
+    t.set_cold_tier(cold_tier("unpackable"));
+    t.insert("not-an-imsi", t0());
+    t.insert("001010000000001", t0() + seconds(1));
+    t.insert("001010000000002", t0() + seconds(2));
+
+    // the first pass looks at the bad session and one more
+    EXPECT_EQ(t.demote(t0() + seconds(60), seconds(30), 2), 2u);
+    EXPECT_EQ(t.cold_size(), 1u);
+    EXPECT_EQ(t.demote(t0() + seconds(60), seconds(30), 100), 2u);
+    EXPECT_EQ(t.cold_size(), 2u);
+    EXPECT_EQ(t.hot_size(), 1u);
+    EXPECT_EQ(t.demoted_total(), 2u);
+
+    // it keeps its place at the cold end
+    std::string oldest;
+    ASSERT_TRUE(t.pop_oldest(oldest));
+    EXPECT_EQ(oldest, "not-an-imsi");
+}
+
+TEST(SessionTable, ExpiryAndEvictionSpanBothTiers) {
+    SessionTable t(3);
+    t.set_cold_tier(cold_tier("expire"));
+    t.insert("1001", t0());
+    t.insert("1002", t0() + seconds(10));
+    t.demote(t0() + seconds(60), seconds(30), 100);
+    t.insert("1003", t0() + seconds(40));
+    EXPECT_TRUE(t.full());
+
+    std::string oldest;
+    ASSERT_TRUE(t.pop_oldest(oldest));
+    EXPECT_EQ(oldest, "1001");
+
+    std::vector<std::string> expired;
+    EXPECT_EQ(t.expire(t0() + seconds(75), seconds(30), expired), 2u);
+    EXPECT_EQ(expired, (std::vector<std::string>{"1002", "1003"}));
+    EXPECT_TRUE(t.empty());
+
+    // erase reaches the cold tier too
+    t.insert("1004", t0());
+    t.demote(t0() + seconds(60), seconds(30), 100);
+    EXPECT_TRUE(t.erase("1004"));
+    EXPECT_FALSE(t.contains("1004"));
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include "trace.h"
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+
+static nlohmann::json dump(int64_t since = 0) {
+    return nlohmann::json::parse(trace_chrome_json(since))["traceEvents"];
+}
+
+// rings are per thread and process-wide, each test records on a fresh thread
+
+TEST(Trace, InstantAndSpanInChromeFormat) {
+    int64_t since = trace_now_ns();
+    std::thread([]() {
+        trace_thread_name("trace-test-1");
+        trace_instant(TraceEvent::packet_received, 42);
+        int64_t t0 = trace_now_ns();
+        PGW_TRACE_SPAN_END(session_decision, t0, 7);
+    }).join();
+
+    bool instant = false, span = false, named = false;
+    for (const auto &ev : dump(since)) {
+        if (ev["ph"] == "M" && ev["args"]["name"] == "trace-test-1") named = true;
+        if (ev["name"] == "packet_received" && ev["args"]["arg"] == 42) {
+            EXPECT_EQ(ev["ph"], "i");
+            instant = true;
+        }
+        if (ev["name"] == "session_decision" && ev["args"]["arg"] == 7) {
+            EXPECT_EQ(ev["ph"], "X");
+            EXPECT_GE(ev["dur"].get<double>(), 0.0);
+            span = true;
+        }
+    }
+    EXPECT_TRUE(instant);
+    EXPECT_TRUE(span);
+    EXPECT_TRUE(named);
+}
+
+TEST(Trace, RingKeepsMostRecentEvents) {
+    trace_set_ring_size(16);
+    std::thread([]() {
+        trace_thread_name("trace-test-2");
+        for (uint64_t i = 0; i < 100; ++i) trace_instant(TraceEvent::cdr_append, 1000 + i);
+    }).join();
+    trace_set_ring_size(4096);
+
+    std::vector<uint64_t> args;
+    for (const auto &ev : dump()) {
+        if (ev["name"] == "cdr_append" && ev["args"]["arg"].get<uint64_t>() >= 1000) {
+            args.push_back(ev["args"]["arg"].get<uint64_t>());
+        }
+    }
+    ASSERT_EQ(args.size(), 16u);
+    EXPECT_EQ(args.front(), 1084u);
+    EXPECT_EQ(args.back(), 1099u);
+}
+
+TEST(Trace, DisabledRecordsNothing) {
+    trace_set_ring_size(0);
+    EXPECT_FALSE(trace_enabled());
+    int64_t since = trace_now_ns();
+    std::thread([]() { trace_instant(TraceEvent::reply_sent, 5); }).join();
+    trace_set_ring_size(4096);
+    EXPECT_TRUE(dump(since).empty());
+}
+
+TEST(Trace, ConcurrentDumpWhileRecording) {
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        for (uint64_t i = 0; !done; ++i) trace_instant(TraceEvent::packet_decoded, i);
+    });
+    for (int i = 0; i < 20; ++i) {
+        for (const auto &ev : dump()) {
+            ASSERT_TRUE(ev.contains("ph"));
+        }
+    }
+    done = true;
+    writer.join();
+}